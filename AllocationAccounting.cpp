@@ -0,0 +1,192 @@
+// Counting of heap allocations made through operator new
+
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include "Stats.h"
+#include "AllocationAccounting.h"
+
+std::atomic<bool> AllocationAccounting::s_bEnabled(false);
+std::atomic<uint64_t> AllocationAccounting::s_nAllocations(0);
+std::atomic<uint64_t> AllocationAccounting::s_nBytes(0);
+std::atomic<int64_t> AllocationAccounting::s_liveBytes(0);
+std::atomic<int64_t> AllocationAccounting::s_peakBytes(0);
+std::thread::id AllocationAccounting::s_peakThreadId;
+
+// Usable size of a block from malloc, or from AlignedAllocate if cbAlignment isn't zero; lets frees be
+// counted without a header on every block.
+static inline int64_t BlockSize(void* p, size_t cbAlignment)
+{
+#ifdef _WIN32
+	return int64_t((0 != cbAlignment) ? _aligned_msize(p, cbAlignment, 0) : _msize(p));
+#else
+	// posix_memalign blocks come from the malloc heap.
+	(void)cbAlignment;
+	return int64_t(malloc_usable_size(p));
+#endif
+}
+
+// Raises the peak to at least liveBytes
+static inline void RaisePeak(std::atomic<int64_t>& peakBytes, int64_t liveBytes)
+{
+	int64_t peak = peakBytes.load(std::memory_order_relaxed);
+	while (liveBytes > peak && !peakBytes.compare_exchange_weak(peak, liveBytes, std::memory_order_relaxed))
+	{
+	}
+}
+
+void AllocationAccounting::Enable()
+{
+	s_peakThreadId = std::this_thread::get_id();
+	s_bEnabled.store(true, std::memory_order_relaxed);
+}
+
+AllocationAccounting::Snapshot_t AllocationAccounting::Current()
+{
+	Snapshot_t snapshot;
+	snapshot.nAllocations = s_nAllocations.load(std::memory_order_relaxed);
+	snapshot.nBytes = s_nBytes.load(std::memory_order_relaxed);
+	snapshot.liveBytes = s_liveBytes.load(std::memory_order_relaxed);
+	return snapshot;
+}
+
+int64_t AllocationAccounting::ResetPeak()
+{
+	return s_peakBytes.exchange(s_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void AllocationAccounting::RestorePeak(int64_t previousPeak)
+{
+	RaisePeak(s_peakBytes, previousPeak);
+}
+
+void AllocationAccounting::OnAllocate(void* p, size_t cb, size_t cbAlignment)
+{
+	if (!Enabled())
+		return;
+	s_nAllocations.fetch_add(1, std::memory_order_relaxed);
+	s_nBytes.fetch_add(cb, std::memory_order_relaxed);
+	const int64_t cbBlock = BlockSize(p, cbAlignment);
+	RaisePeak(s_peakBytes, s_liveBytes.fetch_add(cbBlock, std::memory_order_relaxed) + cbBlock);
+}
+
+void AllocationAccounting::OnFree(void* p, size_t cbAlignment)
+{
+	if (!Enabled() || nullptr == p)
+		return;
+	s_liveBytes.fetch_sub(BlockSize(p, cbAlignment), std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------------------------------------------
+// Replacements for the global operator new and operator delete. The nothrow and array forms
+// that aren't replaced here call these.
+
+#if STATS_ENABLED
+void* operator new(std::size_t cb)
+{
+	if (0 == cb)
+		cb = 1;
+	void* p;
+	while (nullptr == (p = malloc(cb)))
+	{
+		std::new_handler handler = std::get_new_handler();
+		if (nullptr == handler)
+			throw std::bad_alloc();
+		handler();
+	}
+	AllocationAccounting::OnAllocate(p, cb);
+	return p;
+}
+
+void* operator new[](std::size_t cb)
+{
+	return operator new(cb);
+}
+
+void operator delete(void* p) noexcept
+{
+	AllocationAccounting::OnFree(p);
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+// Over-aligned types (alignas greater than __STDCPP_DEFAULT_NEW_ALIGNMENT__) use these forms. On Windows
+// their blocks must be freed with _aligned_free rather than free.
+
+static void* AlignedAllocate(std::size_t cb, std::size_t cbAlignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(cb, cbAlignment);
+#else
+	// posix_memalign requires a multiple of sizeof(void*), which every new-extended alignment is.
+	void* p = nullptr;
+	return (0 == posix_memalign(&p, cbAlignment, cb)) ? p : nullptr;
+#endif
+}
+
+static void AlignedFree(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void* operator new(std::size_t cb, std::align_val_t alignment)
+{
+	if (0 == cb)
+		cb = 1;
+	const std::size_t cbAlignment = static_cast<std::size_t>(alignment);
+	void* p;
+	while (nullptr == (p = AlignedAllocate(cb, cbAlignment)))
+	{
+		std::new_handler handler = std::get_new_handler();
+		if (nullptr == handler)
+			throw std::bad_alloc();
+		handler();
+	}
+	AllocationAccounting::OnAllocate(p, cb, cbAlignment);
+	return p;
+}
+
+void* operator new[](std::size_t cb, std::align_val_t alignment)
+{
+	return operator new(cb, alignment);
+}
+
+void operator delete(void* p, std::align_val_t alignment) noexcept
+{
+	AllocationAccounting::OnFree(p, static_cast<std::size_t>(alignment));
+	AlignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept
+{
+	operator delete(p, alignment);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(p, alignment);
+}
+#endif
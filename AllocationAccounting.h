@@ -0,0 +1,85 @@
+// Counting of heap allocations made through operator new
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+
+/// <summary>
+/// Process-wide counts of heap allocations made through the global operator new and operator delete,
+/// including their std::align_val_t forms, which AllocationAccounting.cpp replaces (unless NO_STATS is defined). The counts include the
+/// allocations of standard containers and strings, but not memory allocated directly from the C
+/// runtime or Windows (e.g., SysAllocString BSTRs, LocalAlloc).
+///
+/// Counting is off until Enable is called; until then, the replacements cost one relaxed atomic load
+/// per call. Live bytes are the allocator's usable sizes of the blocks, so they can exceed the sizes
+/// requested; blocks allocated before Enable and freed afterwards can make live bytes negative.
+///
+/// Stats::ScopedTimer (STATS_SCOPE) uses these counts to report allocations per phase with -allocs.
+/// </summary>
+class AllocationAccounting
+{
+public:
+	/// <summary>
+	/// Allocation counts at a point in time
+	/// </summary>
+	struct Snapshot_t
+	{
+		uint64_t nAllocations;   // Allocations since Enable
+		uint64_t nBytes;         // Bytes requested by those allocations
+		int64_t liveBytes;       // Bytes allocated minus bytes freed since Enable
+	};
+
+	/// <summary>
+	/// Turns on counting. The calling thread becomes the peak thread (see ResetPeak).
+	/// </summary>
+	static void Enable();
+
+	/// <summary>
+	/// true if counting is on
+	/// </summary>
+	static bool Enabled() { return s_bEnabled.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Current counts
+	/// </summary>
+	static Snapshot_t Current();
+
+	/// <summary>
+	/// Highest live bytes since counting began or since the last ResetPeak
+	/// </summary>
+	static int64_t Peak() { return s_peakBytes.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Starts measuring a new peak from the current live bytes, and returns the previous peak.
+	/// Pass the returned value to RestorePeak when done, so that an enclosing measurement still sees
+	/// the highest value. Peaks are process-wide, so a phase's peak includes other threads' allocations.
+	/// Measurements must nest, so only the peak thread may call this: a reset on another thread would
+	/// hide from the peak thread's open measurements whatever was live before the reset.
+	/// </summary>
+	static int64_t ResetPeak();
+
+	/// <summary>
+	/// Raises the peak to at least the value returned by an earlier ResetPeak.
+	/// </summary>
+	static void RestorePeak(int64_t previousPeak);
+
+	/// <summary>
+	/// true on the thread that called Enable, the only one that measures peaks
+	/// </summary>
+	static bool OnPeakThread() { return std::this_thread::get_id() == s_peakThreadId; }
+
+	// Called by the operator new and delete replacements; cbAlignment is nonzero for the std::align_val_t forms
+	static void OnAllocate(void* p, size_t cb, size_t cbAlignment = 0);
+	static void OnFree(void* p, size_t cbAlignment = 0);
+
+private:
+	static std::atomic<bool> s_bEnabled;
+	static std::atomic<uint64_t> s_nAllocations;
+	static std::atomic<uint64_t> s_nBytes;
+	static std::atomic<int64_t> s_liveBytes;
+	static std::atomic<int64_t> s_peakBytes;
+	static std::thread::id s_peakThreadId;
+};
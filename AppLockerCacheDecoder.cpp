@@ -0,0 +1,274 @@
+// Offline inspection of AppLocker's binary policy cache files (System32\AppLocker\*.AppLocker)
+
+#include <algorithm>
+#include <cstring>
+#include "AppLockerXmlParser.h"
+#include "AppLockerCacheDecoder.h"
+
+// Length of a GUID string without braces: 8-4-4-4-12 hex digits
+static const size_t cchGuid = 36;
+// Size of a binary GUID
+static const size_t cbGuid = 16;
+
+// Rule collection cache files and the corresponding rule collection types
+static const wchar_t* const szCacheFileSuffix = L".AppLocker";
+static const wchar_t* const szRuleCollectionTypes[] = { L"Exe", L"Dll", L"Msi", L"Script", L"Appx" };
+
+// Characters recognized as text: printable ASCII and Latin-1
+static inline bool IsTextChar(uint16_t ch)
+{
+	return (ch >= 0x20 && ch <= 0x7E) || (ch >= 0xA0 && ch <= 0xFF);
+}
+
+// Reads a little-endian 16-bit value from an arbitrarily aligned position
+static inline uint16_t ReadU16(const uint8_t* p)
+{
+	return uint16_t(p[0] | (p[1] << 8));
+}
+
+static inline bool IsHexDigit(wchar_t ch)
+{
+	return (ch >= L'0' && ch <= L'9') || (ch >= L'A' && ch <= L'F') || (ch >= L'a' && ch <= L'f');
+}
+
+static inline uint8_t HexValue(wchar_t ch)
+{
+	if (ch >= L'0' && ch <= L'9')
+		return uint8_t(ch - L'0');
+	if (ch >= L'A' && ch <= L'F')
+		return uint8_t(ch - L'A' + 10);
+	return uint8_t(ch - L'a' + 10);
+}
+
+// Upper-cases ASCII letters in place (GUIDs and SIDs are ASCII)
+static std::wstring& AsciiToUpper(std::wstring& str)
+{
+	for (std::wstring::iterator iter = str.begin(); iter != str.end(); ++iter)
+	{
+		if (*iter >= L'a' && *iter <= L'z')
+			*iter = wchar_t(*iter - (L'a' - L'A'));
+	}
+	return str;
+}
+
+// Determines whether the 36 characters at pch have the form of a GUID without braces
+static bool IsGuidText(const wchar_t* pch)
+{
+	for (size_t ix = 0; ix < cchGuid; ++ix)
+	{
+		if (8 == ix || 13 == ix || 18 == ix || 23 == ix)
+		{
+			if (L'-' != pch[ix])
+				return false;
+		}
+		else if (!IsHexDigit(pch[ix]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Normalizes a GUID string: removes surrounding braces and upper-cases it.
+// Returns false if it isn't a GUID.
+static bool NormalizeGuid(const std::wstring& sGuid, std::wstring& sNormalized)
+{
+	sNormalized = sGuid;
+	if (sNormalized.length() == cchGuid + 2 && L'{' == sNormalized.front() && L'}' == sNormalized.back())
+		sNormalized = sNormalized.substr(1, cchGuid);
+	if (sNormalized.length() != cchGuid || !IsGuidText(sNormalized.c_str()))
+		return false;
+	AsciiToUpper(sNormalized);
+	return true;
+}
+
+// Converts a normalized GUID string to its in-memory binary layout:
+// Data1 (32-bit), Data2 and Data3 (16-bit) little-endian, then Data4 as 8 bytes in order.
+static void GuidTextToBinary(const std::wstring& sGuid, uint8_t guidBytes[cbGuid])
+{
+	// Byte positions of each pair of hex digits in the string, in binary GUID order
+	static const size_t ixHexPairs[cbGuid] = { 6, 4, 2, 0, 11, 9, 16, 14, 19, 21, 24, 26, 28, 30, 32, 34 };
+	for (size_t ix = 0; ix < cbGuid; ++ix)
+	{
+		const size_t ixHex = ixHexPairs[ix];
+		guidBytes[ix] = uint8_t((HexValue(sGuid[ixHex]) << 4) | HexValue(sGuid[ixHex + 1]));
+	}
+}
+
+AppLockerCacheDecoder::AppLockerCacheDecoder(const uint8_t* pData, size_t cbData)
+	: m_pData(pData), m_cbData(pData ? cbData : 0)
+{
+	Decode();
+}
+
+std::wstring AppLockerCacheDecoder::RuleCollectionTypeFromFilename(const std::wstring& sFilename)
+{
+	const size_t cchSuffix = wcslen(szCacheFileSuffix);
+	if (sFilename.length() <= cchSuffix)
+		return std::wstring();
+	std::wstring sStem = sFilename.substr(0, sFilename.length() - cchSuffix);
+	std::wstring sSuffix = sFilename.substr(sStem.length());
+	std::wstring sExpectedSuffix(szCacheFileSuffix);
+	if (AsciiToUpper(sSuffix) != AsciiToUpper(sExpectedSuffix))
+		return std::wstring();
+	AsciiToUpper(sStem);
+	for (size_t ix = 0; ix < sizeof(szRuleCollectionTypes) / sizeof(szRuleCollectionTypes[0]); ++ix)
+	{
+		std::wstring sType(szRuleCollectionTypes[ix]);
+		std::wstring sTypeUpper(sType);
+		if (sStem == AsciiToUpper(sTypeUpper))
+			return sType;
+	}
+	return std::wstring();
+}
+
+std::wstring AppLockerCacheDecoder::Text(const CacheTextRun_t& textRun) const
+{
+	std::wstring sText;
+	if (textRun.offset + textRun.cch * 2 > m_cbData)
+		return sText;
+	sText.reserve(textRun.cch);
+	const uint8_t* p = m_pData + textRun.offset;
+	for (size_t ix = 0; ix < textRun.cch; ++ix, p += 2)
+	{
+		sText.push_back(wchar_t(ReadU16(p)));
+	}
+	return sText;
+}
+
+void AppLockerCacheDecoder::Decode()
+{
+	m_textRuns.clear();
+	m_textRuleIds.clear();
+	m_textSids.clear();
+	if (m_cbData < 2)
+		return;
+
+	// Find runs of text characters. Text isn't necessarily 2-byte aligned within the file, so a position
+	// that doesn't start a run of sufficient length is retried one byte later.
+	const size_t ixLast = m_cbData - 1;
+	size_t ixByte = 0;
+	while (ixByte < ixLast)
+	{
+		size_t ixEnd = ixByte;
+		while (ixEnd < ixLast && IsTextChar(ReadU16(m_pData + ixEnd)))
+			ixEnd += 2;
+		const size_t cch = (ixEnd - ixByte) / 2;
+		if (cch >= nMinTextRunChars)
+		{
+			CacheTextRun_t textRun = { ixByte, cch };
+			m_textRuns.push_back(textRun);
+			ixByte = ixEnd;
+		}
+		else
+		{
+			ixByte += 1;
+		}
+	}
+
+	// Look for GUIDs and SIDs within the text runs
+	for (CacheTextRunCollection_t::const_iterator iterRuns = m_textRuns.begin(); iterRuns != m_textRuns.end(); ++iterRuns)
+	{
+		const std::wstring sText = Text(*iterRuns);
+		for (size_t ixChar = 0; ixChar + cchGuid <= sText.length(); )
+		{
+			if (IsGuidText(sText.c_str() + ixChar))
+			{
+				std::wstring sGuid = sText.substr(ixChar, cchGuid);
+				m_textRuleIds.insert(AsciiToUpper(sGuid));
+				ixChar += cchGuid;
+			}
+			else
+			{
+				++ixChar;
+			}
+		}
+
+		size_t ixSid = 0;
+		while (std::wstring::npos != (ixSid = sText.find(L"S-1-", ixSid)))
+		{
+			// A SID is S-1- followed by digits and dashes, ending with a digit
+			size_t ixSidEnd = ixSid + 4;
+			while (ixSidEnd < sText.length() && ((sText[ixSidEnd] >= L'0' && sText[ixSidEnd] <= L'9') || L'-' == sText[ixSidEnd]))
+				++ixSidEnd;
+			while (ixSidEnd > ixSid + 4 && L'-' == sText[ixSidEnd - 1])
+				--ixSidEnd;
+			if (ixSidEnd > ixSid + 4)
+				m_textSids.insert(sText.substr(ixSid, ixSidEnd - ixSid));
+			ixSid = ixSidEnd;
+		}
+	}
+}
+
+bool AppLockerCacheDecoder::ContainsGuid(const std::wstring& sGuid) const
+{
+	std::wstring sNormalized;
+	if (!NormalizeGuid(sGuid, sNormalized))
+		return false;
+	if (m_textRuleIds.find(sNormalized) != m_textRuleIds.end())
+		return true;
+
+	if (m_cbData < cbGuid)
+		return false;
+	uint8_t guidBytes[cbGuid];
+	GuidTextToBinary(sNormalized, guidBytes);
+	const uint8_t* pEnd = m_pData + m_cbData;
+	return pEnd != std::search(m_pData, pEnd, guidBytes, guidBytes + cbGuid);
+}
+
+void AppLockerCacheDecoder::Compare(const std::set<std::wstring>& policyRuleIds, CacheComparison_t& comparison) const
+{
+	comparison.inBoth.clear();
+	comparison.policyOnly.clear();
+	comparison.cacheOnly.clear();
+
+	for (std::set<std::wstring>::const_iterator iterPolicy = policyRuleIds.begin(); iterPolicy != policyRuleIds.end(); ++iterPolicy)
+	{
+		if (ContainsGuid(*iterPolicy))
+			comparison.inBoth.push_back(*iterPolicy);
+		else
+			comparison.policyOnly.push_back(*iterPolicy);
+	}
+	for (std::set<std::wstring>::const_iterator iterCache = m_textRuleIds.begin(); iterCache != m_textRuleIds.end(); ++iterCache)
+	{
+		if (policyRuleIds.find(*iterCache) == policyRuleIds.end())
+			comparison.cacheOnly.push_back(*iterCache);
+	}
+}
+
+bool AppLockerCacheDecoder::GetPolicyRuleIds(const std::wstring& sPolicyXml, const std::wstring& sRuleCollectionType, std::set<std::wstring>& ruleIds)
+{
+	std::wstring sExePolicy, sDllPolicy, sMsiPolicy, sScriptPolicy, sAppxPolicy;
+	if (!AppLockerXmlParser::ParseRuleCollections(sPolicyXml, sExePolicy, sDllPolicy, sMsiPolicy, sScriptPolicy, sAppxPolicy))
+		return false;
+
+	const std::wstring* pRuleCollection = NULL;
+	if (L"Exe" == sRuleCollectionType)
+		pRuleCollection = &sExePolicy;
+	else if (L"Dll" == sRuleCollectionType)
+		pRuleCollection = &sDllPolicy;
+	else if (L"Msi" == sRuleCollectionType)
+		pRuleCollection = &sMsiPolicy;
+	else if (L"Script" == sRuleCollectionType)
+		pRuleCollection = &sScriptPolicy;
+	else if (L"Appx" == sRuleCollectionType)
+		pRuleCollection = &sAppxPolicy;
+	else
+		return false;
+
+	// Rule collection not present in the policy: no rules
+	if (pRuleCollection->empty())
+		return true;
+
+	unsigned long dwEnforcementMode = 0;
+	RuleInfoCollection_t rules;
+	if (!AppLockerXmlParser::ParseRuleCollection(*pRuleCollection, dwEnforcementMode, rules))
+		return false;
+	for (RuleInfoCollection_t::const_iterator iterRules = rules.begin(); iterRules != rules.end(); ++iterRules)
+	{
+		std::wstring sNormalized;
+		if (NormalizeGuid(iterRules->sGuid, sNormalized))
+			ruleIds.insert(sNormalized);
+	}
+	return true;
+}
@@ -0,0 +1,132 @@
+// Offline inspection of AppLocker's binary policy cache files (System32\AppLocker\*.AppLocker)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// A run of UTF-16LE text within a cache file: byte offset of the first character and length in characters.
+/// Refers to the decoder's data; no text is copied until requested.
+/// </summary>
+struct CacheTextRun_t
+{
+	size_t offset;
+	size_t cch;
+};
+typedef std::vector<CacheTextRun_t> CacheTextRunCollection_t;
+
+/// <summary>
+/// Results of comparing the rule IDs in a cache file against the rule IDs in a configured policy view (LGPO, GPO, CSP).
+/// Rule IDs are upper-case GUID strings without braces.
+/// </summary>
+struct CacheComparison_t
+{
+	// Policy rules whose IDs appear in the cache file
+	std::vector<std::wstring> inBoth;
+	// Policy rules whose IDs do not appear in the cache file
+	std::vector<std::wstring> policyOnly;
+	// Rule IDs that appear as text in the cache file but not in the policy
+	std::vector<std::wstring> cacheOnly;
+};
+
+/// <summary>
+/// Zero-copy decoder over the content of an AppLocker binary policy cache file (Exe.AppLocker, Dll.AppLocker, etc.),
+/// typically a MappedFile of the file or of a copy collected from another machine.
+///
+/// The format of these files is undocumented, so the decoder does not interpret their structure. Instead it recovers
+/// what can be identified reliably: the UTF-16LE text they contain (rule names, descriptions, paths, publisher names,
+/// SIDs, and GUID rule IDs), and whether a given rule ID is present, either as text or as a binary GUID.
+/// That is enough to compare cache content with the policy configured through LGPO, GPO, or CSP.
+///
+/// Platform-neutral; works on Linux against collected samples.
+/// The caller must keep the data valid for the lifetime of the decoder.
+/// </summary>
+class AppLockerCacheDecoder
+{
+public:
+	/// <summary>
+	/// Constructor: decodes the supplied file content.
+	/// </summary>
+	/// <param name="pData">Input: file content</param>
+	/// <param name="cbData">Input: size of the file content in bytes</param>
+	AppLockerCacheDecoder(const uint8_t* pData, size_t cbData);
+	// Destructor
+	~AppLockerCacheDecoder() = default;
+
+	/// <summary>
+	/// Maps a cache file name to the corresponding AppLocker rule collection type; e.g., "Exe.AppLocker" returns "Exe".
+	/// Returns an empty string if the file name isn't that of a rule collection cache file.
+	/// </summary>
+	static std::wstring RuleCollectionTypeFromFilename(const std::wstring& sFilename);
+
+	/// <summary>
+	/// Runs of UTF-16LE text of at least nMinTextRunChars characters found in the content, in file order.
+	/// Recognized characters are printable ASCII and Latin-1; text in other scripts appears split into separate runs.
+	/// </summary>
+	const CacheTextRunCollection_t& TextRuns() const { return m_textRuns; }
+
+	/// <summary>
+	/// Returns a copy of the text of a text run.
+	/// </summary>
+	std::wstring Text(const CacheTextRun_t& textRun) const;
+
+	/// <summary>
+	/// GUID rule IDs that appear as text in the content (upper case, without braces).
+	/// </summary>
+	const std::set<std::wstring>& TextRuleIds() const { return m_textRuleIds; }
+
+	/// <summary>
+	/// SIDs (S-1-...) that appear as text in the content.
+	/// </summary>
+	const std::set<std::wstring>& TextSids() const { return m_textSids; }
+
+	/// <summary>
+	/// Reports whether the GUID appears in the content, either as text (case-insensitive, with or without braces)
+	/// or in its 16-byte binary form.
+	/// </summary>
+	/// <param name="sGuid">Input: GUID string, with or without braces</param>
+	/// <returns>true if found</returns>
+	bool ContainsGuid(const std::wstring& sGuid) const;
+
+	/// <summary>
+	/// Compares the rule IDs in this cache file with a set of policy rule IDs.
+	/// </summary>
+	/// <param name="policyRuleIds">Input: rule IDs from a policy view, as returned by GetPolicyRuleIds</param>
+	/// <param name="comparison">Output: comparison results</param>
+	void Compare(const std::set<std::wstring>& policyRuleIds, CacheComparison_t& comparison) const;
+
+	/// <summary>
+	/// Gets the rule IDs for one rule collection of an AppLocker policy XML document and adds them to ruleIds.
+	/// Rule collections with enforcement mode NotConfigured contribute no rule IDs.
+	/// </summary>
+	/// <param name="sPolicyXml">Input: AppLocker policy XML</param>
+	/// <param name="sRuleCollectionType">Input: rule collection type; e.g., "Exe"</param>
+	/// <param name="ruleIds">Output: upper-case rule IDs, added to any already in the set</param>
+	/// <returns>true if successful, false if the policy can't be parsed</returns>
+	static bool GetPolicyRuleIds(const std::wstring& sPolicyXml, const std::wstring& sRuleCollectionType, std::set<std::wstring>& ruleIds);
+
+	/// <summary>
+	/// Minimum number of characters for a text run to be reported.
+	/// </summary>
+	static const size_t nMinTextRunChars = 4;
+
+private:
+	// Finds the text runs, rule IDs, and SIDs in the content
+	void Decode();
+
+private:
+	const uint8_t* m_pData;
+	size_t m_cbData;
+	CacheTextRunCollection_t m_textRuns;
+	std::set<std::wstring> m_textRuleIds;
+	std::set<std::wstring> m_textSids;
+
+private:
+	// Not implemented
+	AppLockerCacheDecoder(const AppLockerCacheDecoder&) = delete;
+	AppLockerCacheDecoder& operator = (const AppLockerCacheDecoder&) = delete;
+};
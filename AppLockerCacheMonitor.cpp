@@ -0,0 +1,281 @@
+// Integrity checking of the AppLocker policy cache directory (System32\AppLocker) against a baseline
+
+#include <Windows.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "AppLockerCacheMonitor.h"
+#include "AppLockerPolicy_LGPO.h"
+#include "DirWalker.h"
+#include "FileSystemUtils.h"
+#include "FileSystemUtils-Windows.h"
+#include "GetFilesAndSubdirectories.h"
+#include "Sha256Hash.h"
+#include "Stats.h"
+#include "StringUtils.h"
+#include "SysErrorMessage.h"
+#include "Utf8FileUtility.h"
+#include "WindowsDirectories.h"
+#include "Wow64FsRedirection.h"
+
+// First line of a baseline file. Version 2 added "X" lines for files that couldn't be hashed.
+static const wchar_t* const szBaselineHeader = L"AppLockerCacheBaseline\t2";
+static const wchar_t* const szBaselineHeaderV1 = L"AppLockerCacheBaseline\t1";
+
+// File paths are case-insensitive
+static bool RelativePathLess(const CacheFileState_t& a, const CacheFileState_t& b)
+{
+	return _wcsicmp(a.sRelativePath.c_str(), b.sRelativePath.c_str()) < 0;
+}
+
+std::wstring AppLockerCacheMonitor::DefaultBaselinePath()
+{
+	return WindowsDirectories::ProgramData() + L"\\AppLockerPolicyTool\\CacheBaseline\\CacheBaseline.txt";
+}
+
+bool AppLockerCacheMonitor::ReadBaseline(const std::wstring& sBaselinePath, CacheBaseline_t& baseline, bool& bFound, std::wstring& sErrorInfo)
+{
+	baseline.sPolicyHash.clear();
+	baseline.files.clear();
+	bFound = (INVALID_FILE_ATTRIBUTES != GetFileAttributesW(sBaselinePath.c_str()));
+	if (!bFound)
+		return true;
+
+	// A baseline that anyone else could have rewritten can't be used to detect changes.
+	std::wstring sCheckErrorInfo;
+	if (!VerifyAdminOnlyAccess(GetDirectoryNameFromFilePath(sBaselinePath), sCheckErrorInfo) ||
+		!VerifyAdminOnlyAccess(sBaselinePath, sCheckErrorInfo))
+	{
+		sErrorInfo = L"Baseline not used because it is not restricted to SYSTEM and Administrators: " + sCheckErrorInfo;
+		return false;
+	}
+
+	std::wstring sBaseline;
+	if (!Utf8FileUtility::ReadTextFile(sBaselinePath.c_str(), sBaseline, sErrorInfo))
+	{
+		sErrorInfo = L"Cannot open baseline " + sBaselinePath;
+		return false;
+	}
+	std::wistringstream fs(sBaseline);
+
+	// Header, then "P<tab>policy hash", then one line per file:
+	//   "F<tab>hash<tab>size<tab>last-write time<tab>relative path", or
+	//   "X<tab>reason the file couldn't be hashed<tab>size<tab>last-write time<tab>relative path"
+	std::wstring sLine;
+	bool bOK = std::getline(fs, sLine) && (sLine == szBaselineHeader || sLine == szBaselineHeaderV1);
+	while (bOK && std::getline(fs, sLine))
+	{
+		if (sLine.empty())
+			continue;
+		std::wstring_view fields[5];
+		const size_t nFields = WStringSplitter(sLine, L'\t').CopyTo(fields, 5);
+		CacheFileState_t fileState;
+		if (2 == nFields && L"P" == fields[0])
+		{
+			baseline.sPolicyHash = fields[1];
+		}
+		else if (5 == nFields && (L"F" == fields[0] || L"X" == fields[0]) &&
+			WStringViewToUInt64(fields[2], fileState.filesize) &&
+			WStringViewToUInt64(fields[3], fileState.ftLastWriteTime))
+		{
+			if (L"F" == fields[0])
+				fileState.sContentHash = fields[1];
+			else
+				fileState.sHashError = fields[1];
+			fileState.sRelativePath = fields[4];
+			baseline.files.push_back(fileState);
+		}
+		else
+		{
+			bOK = false;
+		}
+	}
+	if (!bOK)
+	{
+		sErrorInfo = L"Invalid baseline (delete it to start a new one): " + sBaselinePath;
+		baseline.files.clear();
+		return false;
+	}
+	std::sort(baseline.files.begin(), baseline.files.end(), RelativePathLess);
+	return true;
+}
+
+bool AppLockerCacheMonitor::WriteBaseline(const std::wstring& sBaselinePath, const CacheBaseline_t& baseline, std::wstring& sErrorInfo)
+{
+	const std::wstring sBaselineDir = GetDirectoryNameFromFilePath(sBaselinePath);
+	std::wstring sCheckErrorInfo;
+	if (!CreateAdminOnlyDirectory(sBaselineDir, sErrorInfo))
+		return false;
+	if (!VerifyAdminOnlyAccess(sBaselineDir, sCheckErrorInfo))
+	{
+		sErrorInfo = L"Baseline not written because its directory is not restricted to SYSTEM and Administrators: " + sCheckErrorInfo;
+		return false;
+	}
+
+	// Write to a temporary name and then replace the old baseline, so a reader never sees a partial file.
+	const std::wstring sTempPath = sBaselinePath + L".tmp";
+	std::wofstream fs(sTempPath);
+	if (fs.fail())
+	{
+		sErrorInfo = L"Cannot create " + sTempPath;
+		return false;
+	}
+	fs.imbue(Utf8FileUtility::LocaleForWritingUtf8File());
+	// Numbers are formatted with std::to_wstring so that the locale can't add digit grouping.
+	fs << szBaselineHeader << L"\n"
+		<< L"P\t" << baseline.sPolicyHash << L"\n";
+	for (CacheFileStateCollection_t::const_iterator iterFiles = baseline.files.begin(); iterFiles != baseline.files.end(); ++iterFiles)
+	{
+		if (iterFiles->sContentHash.empty())
+		{
+			// The reason is one field on one line.
+			std::wstring sHashError = iterFiles->sHashError.empty() ? std::wstring(L"not hashed") : iterFiles->sHashError;
+			std::replace_if(sHashError.begin(), sHashError.end(), [](wchar_t ch) { return L'\t' == ch || L'\r' == ch || L'\n' == ch; }, L' ');
+			fs << L"X\t" << sHashError << L"\t";
+		}
+		else
+		{
+			fs << L"F\t" << iterFiles->sContentHash << L"\t";
+		}
+		fs
+			<< std::to_wstring(iterFiles->filesize) << L"\t"
+			<< std::to_wstring(iterFiles->ftLastWriteTime) << L"\t"
+			<< iterFiles->sRelativePath << L"\n";
+	}
+	fs.close();
+	if (fs.fail())
+	{
+		sErrorInfo = L"Cannot write " + sTempPath;
+		DeleteFileW(sTempPath.c_str());
+		return false;
+	}
+	if (!MoveFileExW(sTempPath.c_str(), sBaselinePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		sErrorInfo = sBaselinePath + L": " + SysErrorMessage();
+		DeleteFileW(sTempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool AppLockerCacheMonitor::Scan(const std::wstring& sCacheDirectory, const CacheFileStateCollection_t& previous, CacheFileStateCollection_t& current, size_t& nFilesHashed, std::wstringstream& strErrorInfo)
+{
+	STATS_SCOPE("911.scan");
+	current.clear();
+	nFilesHashed = 0;
+
+	// The cache is under System32
+	Wow64FsRedirection wow64FSRedir(true);
+
+	DirWalker dirWalker;
+	if (!dirWalker.Initialize(sCacheDirectory.c_str(), strErrorInfo))
+		return false;
+
+	bool retval = true;
+	std::wstring sCurrDir;
+	while (dirWalker.GetCurrent(sCurrDir))
+	{
+		const std::wstring sRelativeDir = (sCurrDir.length() > sCacheDirectory.length()) ? sCurrDir.substr(sCacheDirectory.length() + 1) + L"\\" : std::wstring();
+		DirEntryCollection_t files, subdirectories;
+		if (!GetFilesAndSubdirectories(sCurrDir, files, subdirectories))
+		{
+			strErrorInfo << L"Cannot enumerate " << sCurrDir << std::endl;
+			retval = false;
+		}
+		for (DirEntryCollection_t::const_iterator iterFiles = files.begin(); iterFiles != files.end(); ++iterFiles)
+		{
+			CacheFileState_t fileState;
+			fileState.sRelativePath = sRelativeDir + iterFiles->sName;
+			fileState.filesize = iterFiles->filesize;
+			fileState.ftLastWriteTime = iterFiles->ftLastWriteTime;
+
+			// Reuse the previous hash if size and last-write time are unchanged.
+			CacheFileStateCollection_t::const_iterator iterPrevious = std::lower_bound(previous.begin(), previous.end(), fileState, RelativePathLess);
+			if (iterPrevious != previous.end() &&
+				0 == _wcsicmp(iterPrevious->sRelativePath.c_str(), fileState.sRelativePath.c_str()) &&
+				iterPrevious->filesize == fileState.filesize &&
+				iterPrevious->ftLastWriteTime == fileState.ftLastWriteTime &&
+				!iterPrevious->sContentHash.empty())
+			{
+				fileState.sContentHash = iterPrevious->sContentHash;
+			}
+			else
+			{
+				// A file that can't be read (e.g., one held open exclusively) is recorded with the reason and
+				// retried on the next scan, rather than failing the scan.
+				if (Sha256HashFile(sCurrDir + L"\\" + iterFiles->sName, fileState.sContentHash, fileState.sHashError))
+					++nFilesHashed;
+			}
+			current.push_back(fileState);
+		}
+		if (!dirWalker.DoneWithCurrent(subdirectories, strErrorInfo))
+			retval = false;
+	}
+
+	std::sort(current.begin(), current.end(), RelativePathLess);
+	return retval;
+}
+
+void AppLockerCacheMonitor::Compare(const CacheFileStateCollection_t& previous, const CacheFileStateCollection_t& current, CacheChangeCollection_t& changes)
+{
+	changes.clear();
+	// Merge the two sorted lists
+	CacheFileStateCollection_t::const_iterator iterPrevious = previous.begin(), iterCurrent = current.begin();
+	while (iterPrevious != previous.end() || iterCurrent != current.end())
+	{
+		int cmp;
+		if (iterPrevious == previous.end())
+			cmp = 1;
+		else if (iterCurrent == current.end())
+			cmp = -1;
+		else
+			cmp = _wcsicmp(iterPrevious->sRelativePath.c_str(), iterCurrent->sRelativePath.c_str());
+
+		CacheChange_t change;
+		if (cmp < 0)
+		{
+			change.changeType = CacheChange_t::Removed;
+			change.sRelativePath = iterPrevious->sRelativePath;
+			change.sOldHash = iterPrevious->sContentHash;
+			changes.push_back(change);
+			++iterPrevious;
+		}
+		else if (cmp > 0)
+		{
+			change.changeType = CacheChange_t::Added;
+			change.sRelativePath = iterCurrent->sRelativePath;
+			change.sNewHash = iterCurrent->sContentHash;
+			changes.push_back(change);
+			++iterCurrent;
+		}
+		else
+		{
+			if (iterPrevious->sContentHash != iterCurrent->sContentHash)
+			{
+				change.changeType = CacheChange_t::Modified;
+				change.sRelativePath = iterCurrent->sRelativePath;
+				change.sOldHash = iterPrevious->sContentHash;
+				change.sNewHash = iterCurrent->sContentHash;
+				changes.push_back(change);
+			}
+			++iterPrevious;
+			++iterCurrent;
+		}
+	}
+}
+
+bool AppLockerCacheMonitor::HashEffectivePolicy(std::wstring& sPolicyHash, std::wstring& sErrorInfo)
+{
+	STATS_SCOPE("911.hashEffectivePolicy");
+	sPolicyHash.clear();
+	std::wstring sPolicyXml;
+	if (!AppLockerPolicy_LGPO::GetEffectivePolicy(sPolicyXml, sErrorInfo))
+		return false;
+	Sha256Hash hash;
+	if (!hash.Update(sPolicyXml.c_str(), sPolicyXml.length() * sizeof(wchar_t)) || !hash.Finish(sPolicyHash))
+	{
+		sErrorInfo = L"Cannot compute hash of effective policy";
+		return false;
+	}
+	return true;
+}
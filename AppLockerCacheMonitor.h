@@ -0,0 +1,123 @@
+// Integrity checking of the AppLocker policy cache directory (System32\AppLocker) against a baseline
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+
+/// <summary>
+/// State of one file under System32\AppLocker.
+/// </summary>
+struct CacheFileState_t
+{
+	// Path relative to System32\AppLocker
+	std::wstring sRelativePath;
+	uint64_t filesize;
+	uint64_t ftLastWriteTime;
+	// Lower-case hex SHA-256 of the file content; empty if the content couldn't be read
+	std::wstring sContentHash;
+	// Why the content couldn't be hashed (e.g., the file is locked); empty if sContentHash is valid
+	std::wstring sHashError;
+
+	CacheFileState_t() : filesize(0), ftLastWriteTime(0) {}
+};
+typedef std::vector<CacheFileState_t> CacheFileStateCollection_t;
+
+/// <summary>
+/// Baseline for integrity checks: the state of every cache file, sorted by relative path,
+/// and the hash of the effective AppLocker policy when the baseline was recorded.
+/// </summary>
+struct CacheBaseline_t
+{
+	std::wstring sPolicyHash;
+	CacheFileStateCollection_t files;
+};
+
+/// <summary>
+/// A difference between the baseline and the current state of a cache file.
+/// </summary>
+struct CacheChange_t
+{
+	enum ChangeType_t { Added, Removed, Modified };
+	ChangeType_t changeType;
+	std::wstring sRelativePath;
+	// Content hashes before and after; empty if not applicable or if the file couldn't be hashed
+	std::wstring sOldHash, sNewHash;
+};
+typedef std::vector<CacheChange_t> CacheChangeCollection_t;
+
+/// <summary>
+/// Detects changes to the AppLocker policy cache, for monitoring agents that run frequently.
+///
+/// Each check enumerates System32\AppLocker and hashes only files whose size or last-write time
+/// differ from the baseline; unchanged files reuse the baseline hash, so a check of an unchanged
+/// cache reads no file content. The effective policy (AppLockerPolicy_LGPO::GetEffectivePolicy,
+/// read from the registry) is hashed on every check, so a change in the cache can be correlated
+/// with a change (or lack of change) in configured policy.
+///
+/// The baseline is a small UTF-8 text file: a header, the policy hash, and one line per cache file.
+/// A file that can't be hashed (e.g., one that is permanently locked) is recorded with the reason
+/// instead of a hash, so that one such file doesn't stop the baseline from being updated; it is
+/// hashed again on the next check.
+///
+/// A standard user who could rewrite the baseline could hide a change, so the baseline's directory
+/// is created with the same SYSTEM/Administrators-only DACL as the snapshot store, and the directory
+/// and file are checked (VerifyAdminOnlyAccess) before the baseline is read or written.
+/// </summary>
+class AppLockerCacheMonitor
+{
+public:
+	/// <summary>
+	/// Default baseline file: ProgramData\AppLockerPolicyTool\CacheBaseline\CacheBaseline.txt
+	/// </summary>
+	static std::wstring DefaultBaselinePath();
+
+	/// <summary>
+	/// Reads a baseline file, after verifying that only SYSTEM and Administrators can modify it.
+	/// </summary>
+	/// <param name="sBaselinePath">Input: baseline file</param>
+	/// <param name="baseline">Output: the baseline</param>
+	/// <param name="bFound">Output: false if there is no baseline file yet</param>
+	/// <param name="sErrorInfo">Output: error information</param>
+	/// <returns>true if the baseline was read or doesn't exist; false if it is invalid or could have been modified by others</returns>
+	static bool ReadBaseline(const std::wstring& sBaselinePath, CacheBaseline_t& baseline, bool& bFound, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Writes a baseline file, replacing any existing one. Its directory is created with a
+	/// SYSTEM/Administrators-only DACL if it doesn't exist, and must have one if it does.
+	/// </summary>
+	/// <param name="sBaselinePath">Input: baseline file</param>
+	/// <param name="baseline">Input: the baseline</param>
+	/// <param name="sErrorInfo">Output: error information</param>
+	/// <returns>true if successful, false otherwise</returns>
+	static bool WriteBaseline(const std::wstring& sBaselinePath, const CacheBaseline_t& baseline, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Gets the current state of the files under sCacheDirectory, hashing only files whose size or
+	/// last-write time differs from the previous state. A file that can't be hashed is still included,
+	/// with sHashError set instead of sContentHash.
+	/// </summary>
+	/// <param name="sCacheDirectory">Input: directory to scan; typically System32\AppLocker</param>
+	/// <param name="previous">Input: previous state (e.g., from a baseline file); may be empty</param>
+	/// <param name="current">Output: current state, sorted by relative path</param>
+	/// <param name="nFilesHashed">Output: number of files whose content was read</param>
+	/// <param name="strErrorInfo">Output: error information</param>
+	/// <returns>true if every directory was enumerated, false otherwise</returns>
+	static bool Scan(const std::wstring& sCacheDirectory, const CacheFileStateCollection_t& previous, CacheFileStateCollection_t& current, size_t& nFilesHashed, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Lists the differences between two states (each sorted by relative path). A file that couldn't be
+	/// hashed in both states is not reported as modified; one hashed in only one of them is.
+	/// </summary>
+	static void Compare(const CacheFileStateCollection_t& previous, const CacheFileStateCollection_t& current, CacheChangeCollection_t& changes);
+
+	/// <summary>
+	/// Hashes the effective AppLocker policy XML (UTF-16LE). An empty policy has a hash too.
+	/// </summary>
+	/// <param name="sPolicyHash">Output: 64 lower-case hex digits</param>
+	/// <param name="sErrorInfo">Output: error information</param>
+	/// <returns>true if successful, false otherwise</returns>
+	static bool HashEffectivePolicy(std::wstring& sPolicyHash, std::wstring& sErrorInfo);
+};
@@ -0,0 +1,633 @@
+// Snapshot and restore of the AppLocker policy cache directory (System32\AppLocker)
+
+#include <Windows.h>
+#include <compressapi.h>
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "AppLockerCacheSnapshot.h"
+#include "DirWalker.h"
+#include "FileSystemUtils.h"
+#include "FileSystemUtils-Windows.h"
+#include "GetFilesAndSubdirectories.h"
+#include "Sha256Hash.h"
+#include "Stats.h"
+#include "StringUtils.h"
+#include "SysErrorMessage.h"
+#include "Utf8FileUtility.h"
+#include "WindowsDirectories.h"
+#include "Wow64FsRedirection.h"
+
+#pragma comment(lib, "Cabinet.lib")
+
+// Files are processed in chunks of this size; it bounds the memory used for any one file.
+static const DWORD cbChunk = 1024 * 1024;
+// Identifies an object file in the snapshot store
+static const char szObjectFileMagic[4] = { 'A', 'L', 'C', '1' };
+// First line of a snapshot manifest
+static const wchar_t* const szManifestHeader = L"AppLockerCacheSnapshot\t1";
+static const wchar_t* const szManifestExtension = L".manifest";
+static const wchar_t* const szObjectsSubdir = L"\\objects";
+static const wchar_t* const szSnapshotsSubdir = L"\\snapshots";
+
+// --------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// Closes a file handle when it goes out of scope.
+/// </summary>
+class FileHandleCloser
+{
+public:
+	explicit FileHandleCloser(HANDLE hFile = INVALID_HANDLE_VALUE) : m_hFile(hFile) {}
+	~FileHandleCloser() { Close(); }
+	void Close()
+	{
+		if (INVALID_HANDLE_VALUE != m_hFile)
+			CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+private:
+	HANDLE m_hFile;
+	FileHandleCloser(const FileHandleCloser&) = delete;
+	FileHandleCloser& operator = (const FileHandleCloser&) = delete;
+};
+
+// Reads exactly cbData bytes unless end of file is reached; cbRead receives the number read.
+static bool ReadFully(HANDLE hFile, void* pData, DWORD cbData, DWORD& cbRead)
+{
+	cbRead = 0;
+	while (cbRead < cbData)
+	{
+		DWORD cbThisRead = 0;
+		if (!ReadFile(hFile, static_cast<uint8_t*>(pData) + cbRead, cbData - cbRead, &cbThisRead, NULL))
+			return false;
+		if (0 == cbThisRead)
+			break;
+		cbRead += cbThisRead;
+	}
+	return true;
+}
+
+static bool WriteFully(HANDLE hFile, const void* pData, DWORD cbData)
+{
+	DWORD cbWritten = 0;
+	return WriteFile(hFile, pData, cbData, &cbWritten, NULL) && cbWritten == cbData;
+}
+
+static inline uint64_t FileTimeToU64(const FILETIME& ft)
+{
+	return (uint64_t(ft.dwHighDateTime) << 32) | uint64_t(ft.dwLowDateTime);
+}
+
+// --------------------------------------------------------------------------------------------------------------
+
+AppLockerCacheSnapshot::AppLockerCacheSnapshot(const std::wstring& sStoreDirectory /*= std::wstring()*/)
+	: m_sStoreDirectory(sStoreDirectory.length() > 0 ? sStoreDirectory : DefaultStoreDirectory()),
+	m_nFilesStored(0), m_nFilesDeduplicated(0), m_cbRead(0), m_cbWritten(0)
+{
+}
+
+std::wstring AppLockerCacheSnapshot::DefaultStoreDirectory()
+{
+	return WindowsDirectories::ProgramData() + L"\\AppLockerPolicyTool\\CacheSnapshots";
+}
+
+std::wstring AppLockerCacheSnapshot::ObjectPath(const std::wstring& sContentHash) const
+{
+	return m_sStoreDirectory + szObjectsSubdir + L"\\" + sContentHash.substr(0, 2) + L"\\" + sContentHash;
+}
+
+std::wstring AppLockerCacheSnapshot::ManifestPath(const std::wstring& sSnapshotName) const
+{
+	return m_sStoreDirectory + szSnapshotsSubdir + L"\\" + sSnapshotName + szManifestExtension;
+}
+
+bool AppLockerCacheSnapshot::VerifyStoreSecurity(std::wstring& sErrorInfo) const
+{
+	// A store that standard users can write to (e.g., one created by an earlier version of this tool under
+	// ProgramData, or planted there) may contain manifests and objects that nobody here captured.
+	const std::wstring storeDirs[] = { m_sStoreDirectory, m_sStoreDirectory + szObjectsSubdir, m_sStoreDirectory + szSnapshotsSubdir };
+	for (size_t ixDir = 0; ixDir < sizeof(storeDirs) / sizeof(storeDirs[0]); ++ixDir)
+	{
+		std::wstring sCheckErrorInfo;
+		if (!VerifyAdminOnlyAccess(storeDirs[ixDir], sCheckErrorInfo))
+		{
+			sErrorInfo = L"Snapshot store not used because it is not restricted to SYSTEM and Administrators: " + sCheckErrorInfo;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AppLockerCacheSnapshot::Create(const std::wstring& sSourceDirectory, std::wstring& sSnapshotName, SnapshotEntryCollection_t& entries, std::wstringstream& strErrorInfo)
+{
+	STATS_SCOPE("911.snapshot");
+	// Initialize output parameters and statistics
+	sSnapshotName.clear();
+	entries.clear();
+	m_nFilesStored = m_nFilesDeduplicated = 0;
+	m_cbRead = m_cbWritten = 0;
+
+	// The subdirectories inherit the store directory's DACL.
+	std::wstring sErrorInfo;
+	if (!CreateAdminOnlyDirectory(m_sStoreDirectory, sErrorInfo) ||
+		!CreateDirectoryPath(m_sStoreDirectory + szObjectsSubdir, sErrorInfo) ||
+		!CreateDirectoryPath(m_sStoreDirectory + szSnapshotsSubdir, sErrorInfo) ||
+		!VerifyStoreSecurity(sErrorInfo))
+	{
+		strErrorInfo << sErrorInfo << std::endl;
+		return false;
+	}
+
+	// The cache is under System32
+	Wow64FsRedirection wow64FSRedir(true);
+
+	DirWalker dirWalker;
+	if (!dirWalker.Initialize(sSourceDirectory.c_str(), strErrorInfo))
+		return false;
+
+	bool bAllCaptured = true;
+	std::wstring sCurrDir;
+	while (dirWalker.GetCurrent(sCurrDir))
+	{
+		// Relative path of the current directory; empty for the root
+		const std::wstring sRelativeDir = (sCurrDir.length() > sSourceDirectory.length()) ? sCurrDir.substr(sSourceDirectory.length() + 1) : std::wstring();
+		if (sRelativeDir.length() > 0)
+		{
+			SnapshotEntry_t dirEntry;
+			dirEntry.sRelativePath = sRelativeDir;
+			dirEntry.bIsDirectory = true;
+			WIN32_FILE_ATTRIBUTE_DATA attrData = { 0 };
+			DWORD dwLastErr;
+			std::wstring sAltName;
+			if (GetFileAttributesEx_ExtendedPath(sCurrDir.c_str(), attrData, dwLastErr, sAltName))
+			{
+				dirEntry.dwAttributes = attrData.dwFileAttributes;
+				dirEntry.ftLastWriteTime = FileTimeToU64(attrData.ftLastWriteTime);
+			}
+			entries.push_back(dirEntry);
+		}
+
+		DirEntryCollection_t files, subdirectories;
+		if (!GetFilesAndSubdirectories(sCurrDir, files, subdirectories))
+		{
+			strErrorInfo << L"Cannot enumerate " << sCurrDir << std::endl;
+			bAllCaptured = false;
+		}
+		for (DirEntryCollection_t::const_iterator iterFiles = files.begin(); iterFiles != files.end(); ++iterFiles)
+		{
+			SnapshotEntry_t fileEntry;
+			fileEntry.sRelativePath = (sRelativeDir.length() > 0) ? sRelativeDir + L"\\" + iterFiles->sName : iterFiles->sName;
+			fileEntry.filesize = iterFiles->filesize;
+			fileEntry.ftLastWriteTime = iterFiles->ftLastWriteTime;
+			fileEntry.dwAttributes = iterFiles->dwAttributes;
+			if (StoreFileContent(sCurrDir + L"\\" + iterFiles->sName, fileEntry.sContentHash, sErrorInfo))
+			{
+				entries.push_back(fileEntry);
+			}
+			else
+			{
+				strErrorInfo << L"Not captured: " << sErrorInfo << std::endl;
+				bAllCaptured = false;
+			}
+		}
+		if (!dirWalker.DoneWithCurrent(subdirectories, strErrorInfo))
+			bAllCaptured = false;
+	}
+
+	// Snapshot names are UTC timestamps, so they sort chronologically.
+	const std::wstring sName = TimestampUTCforFilepath(true);
+	if (!WriteManifest(sName, entries, sErrorInfo))
+	{
+		strErrorInfo << sErrorInfo << std::endl;
+		return false;
+	}
+	sSnapshotName = sName;
+	return bAllCaptured;
+}
+
+bool AppLockerCacheSnapshot::StoreFileContent(const std::wstring& sFilePath, std::wstring& sContentHash, std::wstring& sErrorInfo)
+{
+	sContentHash.clear();
+	DWORD dwLastErr = 0;
+	std::wstring sAltName;
+	HANDLE hIn = OpenExistingFile_ExtendedPath(sFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, dwLastErr, sAltName);
+	if (INVALID_HANDLE_VALUE == hIn)
+	{
+		sErrorInfo = sFilePath + L": " + SysErrorMessage(dwLastErr);
+		return false;
+	}
+	FileHandleCloser inCloser(hIn);
+
+	// Write to a temporary file in the object store; its name isn't known until the content has been hashed.
+	const std::wstring sObjectsDir = m_sStoreDirectory + szObjectsSubdir;
+	wchar_t szTempFile[MAX_PATH] = { 0 };
+	if (0 == GetTempFileNameW(sObjectsDir.c_str(), L"tmp", 0, szTempFile))
+	{
+		sErrorInfo = L"Cannot create temporary file in " + sObjectsDir + L": " + SysErrorMessage();
+		return false;
+	}
+	HANDLE hOut = CreateFileW(szTempFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hOut)
+	{
+		sErrorInfo = std::wstring(szTempFile) + L": " + SysErrorMessage();
+		DeleteFileW(szTempFile);
+		return false;
+	}
+	FileHandleCloser outCloser(hOut);
+
+	Sha256Hash hash;
+	COMPRESSOR_HANDLE hCompressor = NULL;
+	if (!hash.OK() || !CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW, NULL, &hCompressor))
+	{
+		sErrorInfo = L"Cannot initialize hashing or compression: " + SysErrorMessage();
+		outCloser.Close();
+		DeleteFileW(szTempFile);
+		return false;
+	}
+
+	// Each chunk is written as a frame: original size, stored size, then the stored bytes.
+	// A chunk that doesn't compress to a smaller size is stored as-is (stored size == original size).
+	std::vector<uint8_t> inBuffer(cbChunk), outBuffer(cbChunk);
+	uint64_t cbFileWritten = sizeof(szObjectFileMagic);
+	bool bOK = WriteFully(hOut, szObjectFileMagic, sizeof(szObjectFileMagic));
+	while (bOK)
+	{
+		DWORD cbRead = 0;
+		if (!ReadFully(hIn, inBuffer.data(), cbChunk, cbRead))
+		{
+			sErrorInfo = sFilePath + L": " + SysErrorMessage();
+			bOK = false;
+			break;
+		}
+		if (0 == cbRead)
+			break;
+		m_cbRead += cbRead;
+		bOK = hash.Update(inBuffer.data(), cbRead);
+
+		SIZE_T cbCompressed = 0;
+		const uint8_t* pStored = inBuffer.data();
+		uint32_t frameHeader[2] = { cbRead, cbRead };
+		if (Compress(hCompressor, inBuffer.data(), cbRead, outBuffer.data(), cbRead, &cbCompressed) && cbCompressed < cbRead)
+		{
+			pStored = outBuffer.data();
+			frameHeader[1] = uint32_t(cbCompressed);
+		}
+		bOK = bOK &&
+			WriteFully(hOut, frameHeader, sizeof(frameHeader)) &&
+			WriteFully(hOut, pStored, frameHeader[1]);
+		cbFileWritten += sizeof(frameHeader) + frameHeader[1];
+		if (!bOK)
+			sErrorInfo = std::wstring(szTempFile) + L": " + SysErrorMessage();
+	}
+	CloseCompressor(hCompressor);
+	outCloser.Close();
+	inCloser.Close();
+
+	if (bOK && !hash.Finish(sContentHash))
+	{
+		sErrorInfo = L"Cannot compute hash of " + sFilePath;
+		bOK = false;
+	}
+	if (!bOK)
+	{
+		DeleteFileW(szTempFile);
+		return false;
+	}
+
+	// Identical content is already in the store: discard the new copy, but only if the existing object
+	// really holds that content. A damaged object is replaced.
+	const std::wstring sObjectPath = ObjectPath(sContentHash);
+	std::wstring sVerifyErrorInfo;
+	if (INVALID_FILE_ATTRIBUTES != GetFileAttributesW(sObjectPath.c_str()) && ReadObject(sContentHash, INVALID_HANDLE_VALUE, sVerifyErrorInfo))
+	{
+		DeleteFileW(szTempFile);
+		++m_nFilesDeduplicated;
+		return true;
+	}
+	if (!CreateDirectoryPath(GetDirectoryNameFromFilePath(sObjectPath), sErrorInfo))
+	{
+		DeleteFileW(szTempFile);
+		return false;
+	}
+	if (!MoveFileExW(szTempFile, sObjectPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		DWORD dwMoveErr = GetLastError();
+		DeleteFileW(szTempFile);
+		// Another snapshot may have just stored the same content.
+		if (ReadObject(sContentHash, INVALID_HANDLE_VALUE, sVerifyErrorInfo))
+		{
+			++m_nFilesDeduplicated;
+			return true;
+		}
+		sErrorInfo = sObjectPath + L": " + SysErrorMessage(dwMoveErr);
+		return false;
+	}
+	++m_nFilesStored;
+	m_cbWritten += cbFileWritten;
+	return true;
+}
+
+bool AppLockerCacheSnapshot::Restore(const std::wstring& sSnapshotName, const std::wstring& sTargetDirectory, std::wstringstream& strErrorInfo)
+{
+	STATS_SCOPE("911.restore");
+	SnapshotEntryCollection_t entries;
+	std::wstring sErrorInfo;
+	if (!ReadManifest(sSnapshotName, entries, sErrorInfo))
+	{
+		strErrorInfo << sErrorInfo << std::endl;
+		return false;
+	}
+
+	// Verify every object before changing anything in the target directory.
+	bool bAllVerified = true;
+	std::set<std::wstring> verifiedHashes;
+	for (SnapshotEntryCollection_t::const_iterator iterEntries = entries.begin(); iterEntries != entries.end(); ++iterEntries)
+	{
+		if (iterEntries->bIsDirectory || verifiedHashes.count(iterEntries->sContentHash) > 0)
+			continue;
+		if (ReadObject(iterEntries->sContentHash, INVALID_HANDLE_VALUE, sErrorInfo))
+		{
+			verifiedHashes.insert(iterEntries->sContentHash);
+		}
+		else
+		{
+			strErrorInfo << iterEntries->sRelativePath << L": " << sErrorInfo << std::endl;
+			bAllVerified = false;
+		}
+	}
+	if (!bAllVerified)
+	{
+		strErrorInfo << L"Nothing restored: snapshot " << sSnapshotName << L" refers to missing or damaged objects." << std::endl;
+		return false;
+	}
+
+	Wow64FsRedirection wow64FSRedir(true);
+	if (!CreateDirectoryPath(sTargetDirectory, sErrorInfo))
+	{
+		strErrorInfo << sErrorInfo << std::endl;
+		return false;
+	}
+
+	// Manifests list each directory before its contents.
+	bool bAllRestored = true;
+	for (SnapshotEntryCollection_t::const_iterator iterEntries = entries.begin(); iterEntries != entries.end(); ++iterEntries)
+	{
+		const std::wstring sTargetPath = sTargetDirectory + L"\\" + iterEntries->sRelativePath;
+		if (iterEntries->bIsDirectory)
+		{
+			if (!CreateDirectoryPath(sTargetPath, sErrorInfo))
+			{
+				strErrorInfo << sErrorInfo << std::endl;
+				bAllRestored = false;
+			}
+		}
+		else if (RestoreFileContent(iterEntries->sContentHash, sTargetPath, sErrorInfo))
+		{
+			// Put the original timestamp and attributes back
+			FILETIME ftLastWrite;
+			ftLastWrite.dwHighDateTime = DWORD(iterEntries->ftLastWriteTime >> 32);
+			ftLastWrite.dwLowDateTime = DWORD(iterEntries->ftLastWriteTime & 0xFFFFFFFF);
+			HANDLE hFile = CreateFileW(sTargetPath.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+			if (INVALID_HANDLE_VALUE != hFile)
+			{
+				SetFileTime(hFile, NULL, NULL, &ftLastWrite);
+				CloseHandle(hFile);
+			}
+			if (0 != iterEntries->dwAttributes)
+				SetFileAttributesW(sTargetPath.c_str(), iterEntries->dwAttributes);
+		}
+		else
+		{
+			strErrorInfo << L"Not restored: " << sErrorInfo << std::endl;
+			bAllRestored = false;
+		}
+	}
+	return bAllRestored;
+}
+
+bool AppLockerCacheSnapshot::RestoreFileContent(const std::wstring& sContentHash, const std::wstring& sFilePath, std::wstring& sErrorInfo) const
+{
+	// Restore to a temporary file next to the destination, and move it into place only after verifying it.
+	const std::wstring sTempFile = sFilePath + L".restore-tmp";
+	HANDLE hOut = CreateFileW(sTempFile.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hOut)
+	{
+		sErrorInfo = sTempFile + L": " + SysErrorMessage();
+		return false;
+	}
+	FileHandleCloser outCloser(hOut);
+	const bool bOK = ReadObject(sContentHash, hOut, sErrorInfo);
+	outCloser.Close();
+	if (!bOK)
+	{
+		sErrorInfo = sFilePath + L": " + sErrorInfo;
+		DeleteFileW(sTempFile.c_str());
+		return false;
+	}
+
+	// An existing read-only file can't be replaced.
+	const DWORD dwExistingAttributes = GetFileAttributesW(sFilePath.c_str());
+	if (INVALID_FILE_ATTRIBUTES != dwExistingAttributes && 0 != (dwExistingAttributes & FILE_ATTRIBUTE_READONLY))
+		SetFileAttributesW(sFilePath.c_str(), dwExistingAttributes & ~DWORD(FILE_ATTRIBUTE_READONLY));
+	if (!MoveFileExW(sTempFile.c_str(), sFilePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		sErrorInfo = sFilePath + L": " + SysErrorMessage();
+		DeleteFileW(sTempFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool AppLockerCacheSnapshot::ReadObject(const std::wstring& sContentHash, void* hOut, std::wstring& sErrorInfo) const
+{
+	const std::wstring sObjectPath = ObjectPath(sContentHash);
+	HANDLE hIn = CreateFileW(sObjectPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == hIn)
+	{
+		sErrorInfo = L"Cannot open " + sObjectPath + L": " + SysErrorMessage();
+		return false;
+	}
+	FileHandleCloser inCloser(hIn);
+
+	char magic[sizeof(szObjectFileMagic)] = { 0 };
+	DWORD cbRead = 0;
+	if (!ReadFully(hIn, magic, sizeof(magic), cbRead) || sizeof(magic) != cbRead || 0 != memcmp(magic, szObjectFileMagic, sizeof(magic)))
+	{
+		sErrorInfo = sObjectPath + L" is not a snapshot object";
+		return false;
+	}
+
+	Sha256Hash hash;
+	DECOMPRESSOR_HANDLE hDecompressor = NULL;
+	if (!hash.OK() || !CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW, NULL, &hDecompressor))
+	{
+		sErrorInfo = L"Cannot initialize hashing or decompression: " + SysErrorMessage();
+		return false;
+	}
+
+	std::vector<uint8_t> inBuffer(cbChunk), outBuffer(cbChunk);
+	bool bOK = true, bWriteFailed = false;
+	while (bOK)
+	{
+		uint32_t frameHeader[2] = { 0, 0 };
+		bOK = ReadFully(hIn, frameHeader, sizeof(frameHeader), cbRead);
+		if (!bOK || 0 == cbRead)
+			break;
+		const uint32_t cbOriginal = frameHeader[0], cbStored = frameHeader[1];
+		if (sizeof(frameHeader) != cbRead || cbOriginal > cbChunk || cbStored > cbOriginal ||
+			!ReadFully(hIn, inBuffer.data(), cbStored, cbRead) || cbStored != cbRead)
+		{
+			bOK = false;
+			break;
+		}
+		const uint8_t* pOriginal = inBuffer.data();
+		if (cbStored < cbOriginal)
+		{
+			SIZE_T cbDecompressed = 0;
+			if (!Decompress(hDecompressor, inBuffer.data(), cbStored, outBuffer.data(), cbOriginal, &cbDecompressed) || cbDecompressed != cbOriginal)
+			{
+				bOK = false;
+				break;
+			}
+			pOriginal = outBuffer.data();
+		}
+		bOK = hash.Update(pOriginal, cbOriginal);
+		if (bOK && INVALID_HANDLE_VALUE != hOut && !WriteFully(hOut, pOriginal, cbOriginal))
+		{
+			bOK = false;
+			bWriteFailed = true;
+		}
+	}
+	CloseDecompressor(hDecompressor);
+
+	std::wstring sObjectHash;
+	if (bWriteFailed)
+	{
+		sErrorInfo = L"Cannot write content of " + sObjectPath + L": " + SysErrorMessage();
+		return false;
+	}
+	if (!bOK || !hash.Finish(sObjectHash) || sObjectHash != sContentHash)
+	{
+		sErrorInfo = sObjectPath + L" is damaged or does not match its content hash";
+		return false;
+	}
+	return true;
+}
+
+bool AppLockerCacheSnapshot::WriteManifest(const std::wstring& sSnapshotName, const SnapshotEntryCollection_t& entries, std::wstring& sErrorInfo) const
+{
+	// Write to a temporary name and rename when complete, so a partial manifest is never listed.
+	const std::wstring sManifestPath = ManifestPath(sSnapshotName);
+	const std::wstring sTempPath = sManifestPath + L".tmp";
+	std::wofstream fs(sTempPath);
+	if (fs.fail())
+	{
+		sErrorInfo = L"Cannot create " + sTempPath;
+		return false;
+	}
+	fs.imbue(Utf8FileUtility::LocaleForWritingUtf8File());
+
+	// One entry per line: type (D or F), content hash, size, last-write time, attributes, relative path.
+	// Numbers are formatted with std::to_wstring rather than the stream so that the locale can't add digit grouping.
+	fs << szManifestHeader << L"\n";
+	for (SnapshotEntryCollection_t::const_iterator iterEntries = entries.begin(); iterEntries != entries.end(); ++iterEntries)
+	{
+		fs
+			<< (iterEntries->bIsDirectory ? L"D" : L"F") << L"\t"
+			<< (iterEntries->bIsDirectory ? L"-" : iterEntries->sContentHash) << L"\t"
+			<< std::to_wstring(iterEntries->filesize) << L"\t"
+			<< std::to_wstring(iterEntries->ftLastWriteTime) << L"\t"
+			<< std::to_wstring(iterEntries->dwAttributes) << L"\t"
+			<< iterEntries->sRelativePath << L"\n";
+	}
+	fs.close();
+	if (fs.fail())
+	{
+		sErrorInfo = L"Cannot write " + sTempPath;
+		DeleteFileW(sTempPath.c_str());
+		return false;
+	}
+	if (!MoveFileExW(sTempPath.c_str(), sManifestPath.c_str(), MOVEFILE_WRITE_THROUGH))
+	{
+		sErrorInfo = sManifestPath + L": " + SysErrorMessage();
+		DeleteFileW(sTempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool AppLockerCacheSnapshot::ReadManifest(const std::wstring& sSnapshotName, SnapshotEntryCollection_t& entries, std::wstring& sErrorInfo) const
+{
+	entries.clear();
+	if (!VerifyStoreSecurity(sErrorInfo))
+		return false;
+	const std::wstring sManifestPath = ManifestPath(sSnapshotName);
+	std::wstring sManifest;
+	if (!Utf8FileUtility::ReadTextFile(sManifestPath.c_str(), sManifest, sErrorInfo))
+	{
+		sErrorInfo = L"Cannot open snapshot " + sSnapshotName + L" (" + sManifestPath + L")";
+		return false;
+	}
+	std::wistringstream fs(sManifest);
+
+	std::wstring sLine;
+	bool bOK = std::getline(fs, sLine) && sLine == szManifestHeader;
+	while (bOK && std::getline(fs, sLine))
+	{
+		if (sLine.empty())
+			continue;
+		std::wstring_view fields[6];
+		uint64_t attributes = 0;
+		SnapshotEntry_t entry;
+		if (6 != WStringSplitter(sLine, L'\t').CopyTo(fields, 6) || (fields[0] != L"D" && fields[0] != L"F") ||
+			!WStringViewToUInt64(fields[2], entry.filesize) ||
+			!WStringViewToUInt64(fields[3], entry.ftLastWriteTime) ||
+			!WStringViewToUInt64(fields[4], attributes) || attributes > UINT32_MAX)
+		{
+			bOK = false;
+			break;
+		}
+		entry.bIsDirectory = (fields[0] == L"D");
+		if (!entry.bIsDirectory)
+			entry.sContentHash = fields[1];
+		entry.dwAttributes = uint32_t(attributes);
+		entry.sRelativePath = fields[5];
+		// Hashes name files in the store, and relative paths must stay within the target directory.
+		if ((!entry.bIsDirectory && (64 != entry.sContentHash.length() || std::wstring::npos != entry.sContentHash.find_first_not_of(L"0123456789abcdef"))) ||
+			entry.sRelativePath.empty() || L'\\' == entry.sRelativePath[0] ||
+			std::wstring::npos != entry.sRelativePath.find(L':') ||
+			std::wstring::npos != (L"\\" + entry.sRelativePath + L"\\").find(L"\\..\\"))
+		{
+			bOK = false;
+			break;
+		}
+		entries.push_back(entry);
+	}
+	if (!bOK)
+	{
+		sErrorInfo = L"Invalid snapshot manifest: " + sManifestPath;
+		entries.clear();
+	}
+	return bOK;
+}
+
+void AppLockerCacheSnapshot::List(std::vector<std::wstring>& snapshotNames) const
+{
+	snapshotNames.clear();
+	const std::wstring sSpec = m_sStoreDirectory + szSnapshotsSubdir + L"\\*" + szManifestExtension;
+	WIN32_FIND_DATAW findFileData = { 0 };
+	HANDLE hFind = FindFirstFileExW(sSpec.c_str(), FindExInfoBasic, &findFileData, FindExSearchNameMatch, NULL, 0);
+	if (INVALID_HANDLE_VALUE == hFind)
+		return;
+	const size_t cchExtension = wcslen(szManifestExtension);
+	do
+	{
+		const std::wstring sFilename = findFileData.cFileName;
+		if (0 == (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && sFilename.length() > cchExtension)
+			snapshotNames.push_back(sFilename.substr(0, sFilename.length() - cchExtension));
+	} while (FindNextFileW(hFind, &findFileData));
+	FindClose(hFind);
+	std::sort(snapshotNames.begin(), snapshotNames.end());
+}
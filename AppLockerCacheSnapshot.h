@@ -0,0 +1,157 @@
+// Snapshot and restore of the AppLocker policy cache directory (System32\AppLocker)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+
+/// <summary>
+/// A file or directory recorded in a snapshot.
+/// Paths are relative to the snapshot's source directory.
+/// </summary>
+struct SnapshotEntry_t
+{
+	std::wstring sRelativePath;
+	bool bIsDirectory;
+	// Lower-case hex SHA-256 of the file content; empty for directories
+	std::wstring sContentHash;
+	uint64_t filesize;
+	uint64_t ftLastWriteTime;
+	uint32_t dwAttributes;
+
+	SnapshotEntry_t() : bIsDirectory(false), filesize(0), ftLastWriteTime(0), dwAttributes(0)
+	{
+	}
+};
+typedef std::vector<SnapshotEntry_t> SnapshotEntryCollection_t;
+
+/// <summary>
+/// Compressed, content-addressed snapshots of a directory hierarchy, used to capture the AppLocker
+/// policy cache before emergency deletion so that it can be restored afterwards.
+///
+/// A snapshot store is a directory containing:
+///   objects\xx\[sha256]       : compressed file content, named by the SHA-256 of the uncompressed content
+///                               (xx = first two hex digits). Identical content is stored once, so repeated
+///                               snapshots of an unchanged cache add only a manifest.
+///   snapshots\[name].manifest : UTF-8 list of the directories and files in a snapshot, with each file's
+///                               content hash, size, last-write time, and attributes.
+///
+/// File content is read, hashed, compressed, and written in fixed-size chunks, and restored the same way,
+/// so memory use does not depend on file size. Content is compressed with the Windows compression API
+/// (XPRESS with Huffman); chunks that don't compress are stored as-is.
+///
+/// Restoring writes into System32\AppLocker, so the store must not be writable by standard users: it is
+/// created with an owner and DACL that allow access only by Local System and Administrators, and its owner
+/// and DACL are checked before anything is read from it. A store that fails the check is not used.
+/// Objects are verified against their content hashes whenever they are read, including when a new
+/// snapshot would reuse an existing object.
+///
+/// Usage:
+/// 	AppLockerCacheSnapshot snapshotStore;
+/// 	std::wstring sSnapshotName;
+/// 	SnapshotEntryCollection_t entries;
+/// 	std::wstringstream strErrorInfo;
+/// 	if (snapshotStore.Create(sSourceDir, sSnapshotName, entries, strErrorInfo))
+/// 	{
+/// 		...
+/// 		snapshotStore.Restore(sSnapshotName, sSourceDir, strErrorInfo);
+/// 	}
+/// </summary>
+class AppLockerCacheSnapshot
+{
+public:
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="sStoreDirectory">Input: snapshot store directory; if empty, DefaultStoreDirectory() is used</param>
+	explicit AppLockerCacheSnapshot(const std::wstring& sStoreDirectory = std::wstring());
+	// Destructor
+	~AppLockerCacheSnapshot() = default;
+
+	/// <summary>
+	/// Default snapshot store directory: ProgramData\AppLockerPolicyTool\CacheSnapshots
+	/// </summary>
+	static std::wstring DefaultStoreDirectory();
+
+	/// <summary>
+	/// Snapshot store directory used by this object.
+	/// </summary>
+	const std::wstring& StoreDirectory() const { return m_sStoreDirectory; }
+
+	/// <summary>
+	/// Captures a snapshot of all files and directories under sSourceDirectory.
+	/// Files that cannot be read are reported in strErrorInfo and omitted from the snapshot;
+	/// the snapshot is still written if the rest can be captured.
+	/// </summary>
+	/// <param name="sSourceDirectory">Input: directory to capture</param>
+	/// <param name="sSnapshotName">Output: name of the new snapshot</param>
+	/// <param name="entries">Output: directories and files captured in the snapshot</param>
+	/// <param name="strErrorInfo">Output: error information</param>
+	/// <returns>true if the snapshot was written and includes every file; false otherwise. If sSnapshotName is not empty, the snapshot was written.</returns>
+	bool Create(const std::wstring& sSourceDirectory, std::wstring& sSnapshotName, SnapshotEntryCollection_t& entries, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Restores the directories and files in a snapshot under sTargetDirectory.
+	/// Every object the snapshot refers to is verified against its content hash first; if any is missing
+	/// or doesn't match, nothing is restored. Each file is then written to a temporary file next to its
+	/// destination, verified again, and moved into place, replacing any existing file.
+	/// Files not in the snapshot are left alone.
+	/// </summary>
+	/// <param name="sSnapshotName">Input: name of the snapshot to restore</param>
+	/// <param name="sTargetDirectory">Input: directory to restore into</param>
+	/// <param name="strErrorInfo">Output: error information</param>
+	/// <returns>true if every directory and file was restored; false otherwise</returns>
+	bool Restore(const std::wstring& sSnapshotName, const std::wstring& sTargetDirectory, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Reads the list of entries in a snapshot.
+	/// </summary>
+	/// <param name="sSnapshotName">Input: name of the snapshot</param>
+	/// <param name="entries">Output: directories and files in the snapshot</param>
+	/// <param name="sErrorInfo">Output: error information</param>
+	/// <returns>true if successful, false otherwise</returns>
+	bool ReadManifest(const std::wstring& sSnapshotName, SnapshotEntryCollection_t& entries, std::wstring& sErrorInfo) const;
+
+	/// <summary>
+	/// Lists the names of the snapshots in the store, oldest first.
+	/// </summary>
+	void List(std::vector<std::wstring>& snapshotNames) const;
+
+	/// <summary>
+	/// Statistics from the most recent Create: files whose content was added to the store,
+	/// files whose content was already in the store, and bytes read and written.
+	/// </summary>
+	size_t FilesStored() const { return m_nFilesStored; }
+	size_t FilesDeduplicated() const { return m_nFilesDeduplicated; }
+	uint64_t BytesRead() const { return m_cbRead; }
+	uint64_t BytesWritten() const { return m_cbWritten; }
+
+private:
+	// Compresses one file into the object store, returning its content hash.
+	bool StoreFileContent(const std::wstring& sFilePath, std::wstring& sContentHash, std::wstring& sErrorInfo);
+	// Decompresses an object from the store into a file, verifying its content hash.
+	bool RestoreFileContent(const std::wstring& sContentHash, const std::wstring& sFilePath, std::wstring& sErrorInfo) const;
+	// Decompresses an object and verifies that its content matches its hash, writing the content to hOut
+	// unless hOut is INVALID_HANDLE_VALUE.
+	bool ReadObject(const std::wstring& sContentHash, void* hOut, std::wstring& sErrorInfo) const;
+	// Verifies that only Local System and Administrators can modify the store.
+	bool VerifyStoreSecurity(std::wstring& sErrorInfo) const;
+	// Path to an object in the store
+	std::wstring ObjectPath(const std::wstring& sContentHash) const;
+	// Path to a snapshot manifest in the store
+	std::wstring ManifestPath(const std::wstring& sSnapshotName) const;
+	// Writes a snapshot manifest
+	bool WriteManifest(const std::wstring& sSnapshotName, const SnapshotEntryCollection_t& entries, std::wstring& sErrorInfo) const;
+
+private:
+	std::wstring m_sStoreDirectory;
+	size_t m_nFilesStored, m_nFilesDeduplicated;
+	uint64_t m_cbRead, m_cbWritten;
+
+private:
+	// Not implemented
+	AppLockerCacheSnapshot(const AppLockerCacheSnapshot&) = delete;
+	AppLockerCacheSnapshot& operator = (const AppLockerCacheSnapshot&) = delete;
+};
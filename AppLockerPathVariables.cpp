@@ -0,0 +1,224 @@
+// Expansion and contraction of AppLocker path-rule variables
+
+#include <algorithm>
+#include "CaseFolding.h"
+#include "AppLockerPathVariables.h"
+#ifdef _WIN32
+#include "WindowsDirectories.h"
+#endif
+
+// Canonical variable names
+static const wchar_t* const szOsDrive = L"%OSDRIVE%";
+static const wchar_t* const szWinDir = L"%WINDIR%";
+static const wchar_t* const szSystem32 = L"%SYSTEM32%";
+static const wchar_t* const szProgramFiles = L"%PROGRAMFILES%";
+static const wchar_t* const szRemovable = L"%REMOVABLE%";
+static const wchar_t* const szHot = L"%HOT%";
+
+static const wchar_t* const allVariables[] = { szOsDrive, szWinDir, szSystem32, szProgramFiles, szRemovable, szHot };
+
+// Removes trailing backslashes; e.g., "C:\" becomes "C:".
+static std::wstring TrimTrailingBackslashes(const std::wstring& sDirectory)
+{
+	size_t cch = sDirectory.length();
+	while (cch > 0 && L'\\' == sDirectory[cch - 1])
+		--cch;
+	return sDirectory.substr(0, cch);
+}
+
+AppLockerPathVariables::AppLockerPathVariables(const PathVariableDirectories_t& directories)
+{
+	m_directories.sOsDrive = TrimTrailingBackslashes(directories.sOsDrive);
+	m_directories.sWindows = TrimTrailingBackslashes(directories.sWindows);
+	m_directories.sSystem32 = TrimTrailingBackslashes(directories.sSystem32);
+	m_directories.sSysWow64 = TrimTrailingBackslashes(directories.sSysWow64);
+	m_directories.sProgramFiles = TrimTrailingBackslashes(directories.sProgramFiles);
+	m_directories.sProgramFilesX86 = TrimTrailingBackslashes(directories.sProgramFilesX86);
+
+	const PrefixEntry_t prefixes[] = {
+		{ m_directories.sSystem32, szSystem32 },
+		{ m_directories.sSysWow64, szSystem32 },
+		{ m_directories.sWindows, szWinDir },
+		{ m_directories.sProgramFiles, szProgramFiles },
+		{ m_directories.sProgramFilesX86, szProgramFiles },
+		{ m_directories.sOsDrive, szOsDrive },
+	};
+	for (const PrefixEntry_t& prefix : prefixes)
+	{
+		if (!prefix.sDirectory.empty())
+			m_prefixes.push_back(prefix);
+	}
+	// Longest first; equal lengths keep the order above.
+	std::stable_sort(m_prefixes.begin(), m_prefixes.end(),
+		[](const PrefixEntry_t& a, const PrefixEntry_t& b) { return a.sDirectory.length() > b.sDirectory.length(); });
+}
+
+#ifdef _WIN32
+PathVariableDirectories_t AppLockerPathVariables::ThisComputerDirectories()
+{
+	PathVariableDirectories_t directories;
+	directories.sOsDrive = WindowsDirectories::SystemDriveDirectory();
+	directories.sWindows = WindowsDirectories::WindowsDirectory();
+	directories.sSystem32 = WindowsDirectories::System32Directory();
+	directories.sProgramFiles = WindowsDirectories::ProgramFiles();
+	directories.sProgramFilesX86 = WindowsDirectories::ProgramFilesX86();
+	// SysWOW64 exists only on 64-bit Windows, as does Program Files (x86).
+	if (!directories.sProgramFilesX86.empty())
+		directories.sSysWow64 = directories.sWindows + L"\\SysWOW64";
+	return directories;
+}
+
+const AppLockerPathVariables& AppLockerPathVariables::ThisComputer()
+{
+	static const AppLockerPathVariables instance(ThisComputerDirectories());
+	return instance;
+}
+#endif
+
+const wchar_t* AppLockerPathVariables::LeadingVariable(std::wstring_view sPath, size_t& cchVariable)
+{
+	cchVariable = 0;
+	if (sPath.empty() || L'%' != sPath[0])
+		return NULL;
+	const size_t ixClose = sPath.find(L'%', 1);
+	if (std::wstring_view::npos == ixClose)
+		return NULL;
+	const std::wstring_view sToken = sPath.substr(0, ixClose + 1);
+	for (const wchar_t* szVariable : allVariables)
+	{
+		if (CaseInsensitiveEqual()(sToken, szVariable))
+		{
+			cchVariable = sToken.length();
+			return szVariable;
+		}
+	}
+	return NULL;
+}
+
+bool AppLockerPathVariables::Expand(std::wstring_view sPath, std::vector<std::wstring>& paths) const
+{
+	paths.clear();
+	size_t cchVariable;
+	const wchar_t* szVariable = LeadingVariable(sPath, cchVariable);
+	if (NULL == szVariable)
+	{
+		// A leading percent sign that doesn't begin a known variable
+		if (!sPath.empty() && L'%' == sPath[0])
+			return false;
+		paths.emplace_back(sPath);
+		return true;
+	}
+
+	const std::wstring* pDirectory1 = NULL;
+	const std::wstring* pDirectory2 = NULL;
+	if (szOsDrive == szVariable)
+	{
+		pDirectory1 = &m_directories.sOsDrive;
+	}
+	else if (szWinDir == szVariable)
+	{
+		pDirectory1 = &m_directories.sWindows;
+	}
+	else if (szSystem32 == szVariable)
+	{
+		pDirectory1 = &m_directories.sSystem32;
+		pDirectory2 = &m_directories.sSysWow64;
+	}
+	else if (szProgramFiles == szVariable)
+	{
+		pDirectory1 = &m_directories.sProgramFiles;
+		pDirectory2 = &m_directories.sProgramFilesX86;
+	}
+	else
+	{
+		// %REMOVABLE% and %HOT% aren't directories.
+		return false;
+	}
+
+	const std::wstring_view sRemainder = sPath.substr(cchVariable);
+	if (!pDirectory1->empty())
+		paths.push_back(*pDirectory1 + std::wstring(sRemainder));
+	if (NULL != pDirectory2 && !pDirectory2->empty() && !CaseInsensitiveEqual()(*pDirectory1, *pDirectory2))
+		paths.push_back(*pDirectory2 + std::wstring(sRemainder));
+	return !paths.empty();
+}
+
+bool AppLockerPathVariables::Contract(std::wstring_view sPath, std::wstring& sContracted) const
+{
+	for (const PrefixEntry_t& prefix : m_prefixes)
+	{
+		const size_t cchPrefix = prefix.sDirectory.length();
+		if (sPath.length() < cchPrefix)
+			continue;
+		if (sPath.length() > cchPrefix && L'\\' != sPath[cchPrefix])
+			continue;
+		if (CaseInsensitiveEqual()(sPath.substr(0, cchPrefix), prefix.sDirectory))
+		{
+			sContracted = prefix.szVariable;
+			sContracted.append(sPath.substr(cchPrefix));
+			return true;
+		}
+	}
+	sContracted = sPath;
+	return false;
+}
+
+bool AppLockerPathVariables::Normalize(std::wstring_view sPath, std::wstring& sNormalized) const
+{
+	size_t cchVariable;
+	const wchar_t* szVariable = LeadingVariable(sPath, cchVariable);
+	if (NULL != szVariable)
+	{
+		sNormalized = szVariable;
+		sNormalized.append(sPath.substr(cchVariable));
+		return true;
+	}
+	if (!sPath.empty() && L'%' == sPath[0])
+	{
+		sNormalized = sPath;
+		return false;
+	}
+	Contract(sPath, sNormalized);
+	return true;
+}
+
+bool AppLockerPathVariables::Equivalents(std::wstring_view sPath, std::vector<std::wstring>& paths) const
+{
+	paths.clear();
+	std::wstring sNormalized;
+	if (!Normalize(sPath, sNormalized))
+	{
+		paths.emplace_back(sPath);
+		return false;
+	}
+	paths.push_back(sNormalized);
+
+	// %REMOVABLE% and %HOT% paths have no other form.
+	std::vector<std::wstring> absolutePaths;
+	if (!Expand(sNormalized, absolutePaths))
+		return true;
+	for (const std::wstring& sAbsolute : absolutePaths)
+	{
+		paths.push_back(sAbsolute);
+		for (const PrefixEntry_t& prefix : m_prefixes)
+		{
+			const size_t cchPrefix = prefix.sDirectory.length();
+			if (sAbsolute.length() >= cchPrefix &&
+				(sAbsolute.length() == cchPrefix || L'\\' == sAbsolute[cchPrefix]) &&
+				CaseInsensitiveEqual()(std::wstring_view(sAbsolute).substr(0, cchPrefix), prefix.sDirectory))
+			{
+				paths.push_back(prefix.szVariable + sAbsolute.substr(cchPrefix));
+			}
+		}
+	}
+
+	// Each form once, keeping the first occurrence
+	std::vector<std::wstring> uniquePaths;
+	for (const std::wstring& sForm : paths)
+	{
+		if (std::find(uniquePaths.begin(), uniquePaths.end(), sForm) == uniquePaths.end())
+			uniquePaths.push_back(sForm);
+	}
+	paths.swap(uniquePaths);
+	return true;
+}
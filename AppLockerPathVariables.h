@@ -0,0 +1,121 @@
+// Expansion and contraction of AppLocker path-rule variables
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// The directories that AppLocker path variables stand for. Values are absolute paths without trailing
+/// backslashes. Empty values are allowed for directories that don't exist (e.g., SysWOW64 and
+/// Program Files (x86) on 32-bit Windows).
+/// </summary>
+struct PathVariableDirectories_t
+{
+	// %OSDRIVE%; typically "C:"
+	std::wstring sOsDrive;
+	// %WINDIR%; typically "C:\Windows"
+	std::wstring sWindows;
+	// %SYSTEM32%; typically "C:\Windows\System32" and "C:\Windows\SysWOW64"
+	std::wstring sSystem32;
+	std::wstring sSysWow64;
+	// %PROGRAMFILES%; typically "C:\Program Files" and "C:\Program Files (x86)"
+	std::wstring sProgramFiles;
+	std::wstring sProgramFilesX86;
+};
+
+/// <summary>
+/// Converts AppLocker path-rule paths between variable form (e.g., "%PROGRAMFILES%\Contoso\*") and
+/// absolute form (e.g., "C:\Program Files\Contoso\*").
+///
+/// AppLocker recognizes these variables, case-insensitively, only at the beginning of a path:
+/// 	%OSDRIVE%, %WINDIR%, %SYSTEM32%, %PROGRAMFILES%, %REMOVABLE%, %HOT%
+/// %SYSTEM32% and %PROGRAMFILES% each stand for two directories on 64-bit Windows. %REMOVABLE%
+/// (CD/DVD) and %HOT% (USB and other hot-pluggable media) stand for device classes rather than
+/// directories, so they cannot be expanded and no absolute path contracts to them.
+///
+/// The directory values are supplied to the constructor, so that rules can be evaluated against
+/// another computer's (or a synthetic) layout; ThisComputer() uses WindowsDirectories. The longest-prefix
+/// table for contraction is built once in the constructor. All member functions are const, so an
+/// instance can be shared by any number of threads.
+/// </summary>
+class AppLockerPathVariables
+{
+public:
+	/// <summary>
+	/// Builds the expansion and contraction tables from the supplied directories.
+	/// Trailing backslashes are removed from the values.
+	/// </summary>
+	explicit AppLockerPathVariables(const PathVariableDirectories_t& directories);
+	// Default destructor
+	~AppLockerPathVariables() = default;
+
+#ifdef _WIN32
+	/// <summary>
+	/// The directories of the current computer, from WindowsDirectories.
+	/// </summary>
+	static PathVariableDirectories_t ThisComputerDirectories();
+
+	/// <summary>
+	/// Instance for the current computer's directories, created on first use.
+	/// </summary>
+	static const AppLockerPathVariables& ThisComputer();
+#endif
+
+	/// <summary>
+	/// Returns the absolute paths that a path can stand for.
+	/// A path that doesn't begin with a variable stands only for itself.
+	/// </summary>
+	/// <param name="sPath">Input: path, possibly beginning with a variable</param>
+	/// <param name="paths">Output: one or more absolute paths</param>
+	/// <returns>true if successful; false if the path begins with an unknown variable or with %REMOVABLE% or %HOT%</returns>
+	bool Expand(std::wstring_view sPath, std::vector<std::wstring>& paths) const;
+
+	/// <summary>
+	/// Replaces the longest leading directory of an absolute path that a variable stands for with that
+	/// variable; e.g., "C:\Windows\System32\cmd.exe" becomes "%SYSTEM32%\cmd.exe". Directories match
+	/// case-insensitively and only at a path-component boundary.
+	/// </summary>
+	/// <param name="sPath">Input: absolute path</param>
+	/// <param name="sContracted">Output: the path in variable form, or sPath if no variable applies</param>
+	/// <returns>true if a variable replaced part of the path, false otherwise</returns>
+	bool Contract(std::wstring_view sPath, std::wstring& sContracted) const;
+
+	/// <summary>
+	/// Puts a rule path into canonical form: a leading variable in upper case, or an absolute path
+	/// contracted to variable form.
+	/// </summary>
+	/// <param name="sPath">Input: path in variable or absolute form</param>
+	/// <param name="sNormalized">Output: canonical form of the path</param>
+	/// <returns>true if successful; false if the path begins with an unknown variable</returns>
+	bool Normalize(std::wstring_view sPath, std::wstring& sNormalized) const;
+
+	/// <summary>
+	/// Returns every form of a path that names the same file: the absolute paths it expands to, and
+	/// each of those with each variable whose directory begins it (longest directory first), not only
+	/// the longest; e.g., "%SYSTEM32%\cmd.exe" also as "%WINDIR%\System32\cmd.exe". Rules can be
+	/// written in any of these forms, so a lookup by path tries them all.
+	/// </summary>
+	/// <param name="sPath">Input: path in variable or absolute form</param>
+	/// <param name="paths">Output: the path's forms, each once; at least the path itself</param>
+	/// <returns>true if successful; false if the path begins with an unknown variable, in which case paths holds only sPath</returns>
+	bool Equivalents(std::wstring_view sPath, std::vector<std::wstring>& paths) const;
+
+	/// <summary>
+	/// If the path begins with an AppLocker variable, returns the variable's canonical (upper-case) name,
+	/// including the percent signs, and its length in the path. Returns NULL otherwise.
+	/// </summary>
+	static const wchar_t* LeadingVariable(std::wstring_view sPath, size_t& cchVariable);
+
+private:
+	// Directory that contracts to a variable
+	struct PrefixEntry_t
+	{
+		std::wstring sDirectory;
+		const wchar_t* szVariable;
+	};
+	// Sorted by decreasing directory length, so that the first match is the longest.
+	std::vector<PrefixEntry_t> m_prefixes;
+	PathVariableDirectories_t m_directories;
+};
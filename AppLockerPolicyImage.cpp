@@ -0,0 +1,1045 @@
+// Compiled binary image of an AppLocker policy, loadable without parsing
+
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include "AppLockerPathVariables.h"
+#include "AppLockerXmlParser.h"
+#include "CaseFolding.h"
+#include "SidStrings.h"
+#include "StringUtils.h"
+#include "UnicodeTranscoder.h"
+#include "Stats.h"
+#include "AppLockerPolicyImage.h"
+
+// ------------------------------------------------------------------------------------------
+// Image layout. All values are little-endian; all offsets are relative to the start of the image.
+// Every structure is a multiple of 4 bytes, and every section starts on a 4-byte boundary.
+
+static const char szImageMagic[8] = { 'A', 'L', 'P', 'I', 'M', 'A', 'G', 'E' };
+// Reads back as a different value on a host with the other byte order
+static const uint32_t nByteOrderMark = 0x01020304;
+// Marks a missing index
+static const uint32_t nNone = 0xFFFFFFFF;
+
+// Text in the string table: offset and length in UTF-16 code units
+struct StringRef_t
+{
+	uint32_t offset;
+	uint32_t cch;
+};
+
+// Location of a section: byte offset and number of entries
+struct SectionRef_t
+{
+	uint32_t offset;
+	uint32_t count;
+};
+
+enum Section_t
+{
+	StringsSection,         // char16_t code units
+	CollectionsSection,     // ImageCollection_t, one per rule collection type, in szCollectionTypes order
+	RulesSection,           // ImageRule_t, grouped by collection
+	SidsSection,            // ImageSid_t, sorted by code unit
+	SidRuleRefsSection,     // uint32_t rule indexes, referred to by SIDs
+	PathNodesSection,       // ImagePathNode_t; node 0 is the root, and each node's children are contiguous and sorted
+	PathRuleRefsSection,    // uint32_t rule indexes, referred to by path nodes
+	WildcardPathsSection,   // ImageWildcardPath_t, referred to by path nodes
+	PublishersSection,      // ImagePublisher_t, sorted by publisher
+	HashSlotsSection,       // ImageHashSlot_t; open addressing with linear probing, power-of-two size
+	nSections
+};
+
+struct ImageHeader_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrderMark;
+	uint32_t cbImage;
+	uint32_t sectionCount;
+	SectionRef_t sections[nSections];
+};
+
+struct ImageCollection_t
+{
+	uint32_t enforcementMode;   // EnforcementMode_t
+	uint32_t firstRule;
+	uint32_t nRules;
+	StringRef_t extensions;     // The RuleCollectionExtensions element's XML; empty if none
+};
+
+struct ImageRule_t
+{
+	uint8_t ruleType;           // PolicyImageRule_t::RuleType_t
+	uint8_t bDeny;
+	uint8_t collection;         // Index into szCollectionTypes
+	uint8_t reserved;
+	uint32_t sidIndex;          // Index into the SIDs section, or nNone
+	StringRef_t id;
+	StringRef_t name;
+	StringRef_t xml;
+};
+
+struct ImageSid_t
+{
+	StringRef_t sid;
+	uint32_t firstRuleRef;      // Rules that apply to the SID, in rule order
+	uint32_t nRuleRefs;
+};
+
+struct ImagePathNode_t
+{
+	StringRef_t segment;        // Case-folded path segment; empty for the root
+	uint32_t firstChild;
+	uint32_t nChildren;
+	uint32_t firstRuleRef;      // Rules whose condition ends at this node
+	uint32_t nRuleRefs;
+	uint32_t firstWildcard;     // Wildcard patterns whose leading literal segments end at this node
+	uint32_t nWildcards;
+};
+
+struct ImageWildcardPath_t
+{
+	StringRef_t pattern;        // Case-folded path pattern
+	uint32_t ruleIndex;
+	uint32_t reserved;
+};
+
+struct ImagePublisher_t
+{
+	StringRef_t publisher;      // Case-folded
+	StringRef_t product;        // Case-folded
+	StringRef_t binary;         // Case-folded
+	uint32_t ruleIndex;
+	uint32_t reserved;
+};
+
+struct ImageHashSlot_t
+{
+	StringRef_t hash;           // Case-folded
+	uint32_t keyHash;
+	uint32_t ruleIndex;         // nNone for an empty slot
+};
+
+// Entry sizes, in Section_t order
+static const size_t cbSectionEntries[nSections] = {
+	sizeof(char16_t),
+	sizeof(ImageCollection_t),
+	sizeof(ImageRule_t),
+	sizeof(ImageSid_t),
+	sizeof(uint32_t),
+	sizeof(ImagePathNode_t),
+	sizeof(uint32_t),
+	sizeof(ImageWildcardPath_t),
+	sizeof(ImagePublisher_t),
+	sizeof(ImageHashSlot_t),
+};
+
+enum EnforcementMode_t
+{
+	AuditOnly = 0,              // Same values as AppLockerXmlParser::ParseRuleCollection's dwEnforcementMode
+	Enabled = 1,
+	NotConfigured = 2,
+	NotPresent = 3              // No RuleCollection element
+};
+
+static const wchar_t* const szEnforcementModes[] = { L"AuditOnly", L"Enabled", L"NotConfigured" };
+static const wchar_t* const szCollectionTypes[] = { L"Exe", L"Dll", L"Msi", L"Script", L"Appx" };
+static const size_t nCollectionTypes = sizeof(szCollectionTypes) / sizeof(szCollectionTypes[0]);
+
+static const wchar_t* const sParseErrorText = L"Unable to parse AppLocker policy XML";
+
+// ------------------------------------------------------------------------------------------
+// Text helpers
+
+// Converts to UTF-16; false if the text has invalid code points
+static bool ToUtf16(const std::wstring& str, std::u16string& sUtf16)
+{
+	sUtf16.resize(str.length() * 2);
+	size_t cchRead = 0, cbWritten = 0;
+	if (Transcode_OK != WideToUtf16(str.data(), str.length(), false, reinterpret_cast<char*>(&sUtf16[0]), sUtf16.length() * sizeof(char16_t), cchRead, cbWritten))
+	{
+		sUtf16.clear();
+		return false;
+	}
+	sUtf16.resize(cbWritten / sizeof(char16_t));
+	return true;
+}
+
+// Case-folded UTF-16 form of an index key or query
+static std::u16string FoldedKey(const std::wstring& str)
+{
+	std::wstring sFolded(str.length(), L'\0');
+	FoldCase(str.data(), str.length(), &sFolded[0]);
+	std::u16string sKey;
+	ToUtf16(sFolded, sKey);
+	return sKey;
+}
+
+// FNV-1a over UTF-16 code units
+static uint32_t KeyHash(const char16_t* pch, size_t cch)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t ix = 0; ix < cch; ++ix)
+	{
+		hash = (hash ^ (pch[ix] & 0xFF)) * 16777619u;
+		hash = (hash ^ (pch[ix] >> 8)) * 16777619u;
+	}
+	return hash;
+}
+
+// Decodes the predefined and numeric XML entities in attribute text
+static std::wstring DecodeXmlText(std::wstring_view sv)
+{
+	std::wstring str;
+	str.reserve(sv.length());
+	for (size_t ix = 0; ix < sv.length(); ++ix)
+	{
+		if (L'&' == sv[ix])
+		{
+			const size_t ixSemi = sv.find(L';', ix);
+			if (std::wstring_view::npos != ixSemi)
+			{
+				const std::wstring_view sEntity = sv.substr(ix + 1, ixSemi - ix - 1);
+				uint32_t ch = 0;
+				if (L"amp" == sEntity) ch = L'&';
+				else if (L"lt" == sEntity) ch = L'<';
+				else if (L"gt" == sEntity) ch = L'>';
+				else if (L"quot" == sEntity) ch = L'"';
+				else if (L"apos" == sEntity) ch = L'\'';
+				else if (sEntity.length() > 1 && L'#' == sEntity[0])
+				{
+					const bool bHex = (L'x' == sEntity[1] || L'X' == sEntity[1]);
+					for (size_t ixDigit = bHex ? 2 : 1; ixDigit < sEntity.length() && ch <= 0x10FFFF; ++ixDigit)
+					{
+						const wchar_t digit = sEntity[ixDigit];
+						if (digit >= L'0' && digit <= L'9') ch = ch * (bHex ? 16 : 10) + uint32_t(digit - L'0');
+						else if (bHex && digit >= L'a' && digit <= L'f') ch = ch * 16 + uint32_t(digit - L'a' + 10);
+						else if (bHex && digit >= L'A' && digit <= L'F') ch = ch * 16 + uint32_t(digit - L'A' + 10);
+						else { ch = 0; break; }
+					}
+				}
+#if WCHAR_MAX <= 0xFFFF
+				// Supplementary characters take a surrogate pair where wchar_t is 16 bits
+				if (ch > 0xFFFF && ch <= 0x10FFFF)
+				{
+					str.push_back(wchar_t(0xD800 + ((ch - 0x10000) >> 10)));
+					str.push_back(wchar_t(0xDC00 + ((ch - 0x10000) & 0x3FF)));
+					ix = ixSemi;
+					continue;
+				}
+#endif
+				if (0 != ch && ch <= 0x10FFFF)
+				{
+					str.push_back(wchar_t(ch));
+					ix = ixSemi;
+					continue;
+				}
+			}
+		}
+		str.push_back(sv[ix]);
+	}
+	return str;
+}
+
+// Copies XML without its comments, and with its CDATA sections replaced by their escaped text, so that
+// the start-tag and attribute scanning below sees only markup; false if either is unterminated
+static bool StripCommentsAndCData(const std::wstring& sXml, std::wstring& sStripped)
+{
+	static const wchar_t szCommentStart[] = L"<!--", szCommentEnd[] = L"-->";
+	static const wchar_t szCDataStart[] = L"<![CDATA[", szCDataEnd[] = L"]]>";
+	sStripped.clear();
+	sStripped.reserve(sXml.length());
+	size_t ix = 0, ixMarkup;
+	while (std::wstring::npos != (ixMarkup = sXml.find(L"<!", ix)))
+	{
+		sStripped.append(sXml, ix, ixMarkup - ix);
+		if (0 == sXml.compare(ixMarkup, 4, szCommentStart))
+		{
+			const size_t ixEnd = sXml.find(szCommentEnd, ixMarkup + 4);
+			if (std::wstring::npos == ixEnd)
+				return false;
+			ix = ixEnd + 3;
+		}
+		else if (0 == sXml.compare(ixMarkup, 9, szCDataStart))
+		{
+			const size_t ixEnd = sXml.find(szCDataEnd, ixMarkup + 9);
+			if (std::wstring::npos == ixEnd)
+				return false;
+			for (size_t ixText = ixMarkup + 9; ixText < ixEnd; ++ixText)
+			{
+				switch (sXml[ixText])
+				{
+				case L'&': sStripped.append(L"&amp;"); break;
+				case L'<': sStripped.append(L"&lt;"); break;
+				case L'>': sStripped.append(L"&gt;"); break;
+				default: sStripped.push_back(sXml[ixText]); break;
+				}
+			}
+			ix = ixEnd + 3;
+		}
+		else
+		{
+			// Another declaration (e.g., DOCTYPE): keep it
+			sStripped.append(sXml, ixMarkup, 2);
+			ix = ixMarkup + 2;
+		}
+	}
+	sStripped.append(sXml, ix, std::wstring::npos);
+	return true;
+}
+
+// Gets an attribute's decoded value from an element's start tag; empty if absent
+static std::wstring GetAttribute(std::wstring_view sStartTag, const wchar_t* szName)
+{
+	const size_t cchName = wcslen(szName);
+	size_t ix = 0;
+	while (std::wstring_view::npos != (ix = sStartTag.find(szName, ix)))
+	{
+		const size_t ixAfterName = ix + cchName;
+		// Must be a whole attribute name: preceded by white space, followed by optional white space and "="
+		if (ix > 0 && iswspace(sStartTag[ix - 1]))
+		{
+			size_t ixEq = ixAfterName;
+			while (ixEq < sStartTag.length() && iswspace(sStartTag[ixEq]))
+				++ixEq;
+			if (ixEq < sStartTag.length() && L'=' == sStartTag[ixEq])
+			{
+				const size_t ixQuote = sStartTag.find_first_of(L"\"'", ixEq + 1);
+				if (std::wstring_view::npos == ixQuote)
+					return std::wstring();
+				const size_t ixEndQuote = sStartTag.find(sStartTag[ixQuote], ixQuote + 1);
+				if (std::wstring_view::npos == ixEndQuote)
+					return std::wstring();
+				return DecodeXmlText(sStartTag.substr(ixQuote + 1, ixEndQuote - ixQuote - 1));
+			}
+		}
+		ix = ixAfterName;
+	}
+	return std::wstring();
+}
+
+// Gets the start tag of the next element with the given name at or after ix; empty if none before ixEnd
+static std::wstring_view NextStartTag(std::wstring_view sXml, const wchar_t* szElement, size_t& ix, size_t ixEnd)
+{
+	const std::wstring sStart = std::wstring(L"<") + szElement;
+	while (std::wstring_view::npos != (ix = sXml.find(sStart, ix)) && ix < ixEnd)
+	{
+		const size_t ixAfterName = ix + sStart.length();
+		if (ixAfterName < sXml.length() && (iswspace(sXml[ixAfterName]) || L'>' == sXml[ixAfterName] || L'/' == sXml[ixAfterName]))
+		{
+			const size_t ixGT = sXml.find(L'>', ixAfterName);
+			if (std::wstring_view::npos == ixGT)
+				break;
+			const size_t ixTag = ix;
+			ix = ixGT + 1;
+			return sXml.substr(ixTag, ixGT + 1 - ixTag);
+		}
+		ix = ixAfterName;
+	}
+	ix = std::wstring_view::npos;
+	return std::wstring_view();
+}
+
+// Gets an element's XML, from its start tag through its end tag, or its empty-element tag; empty if absent
+static std::wstring_view ElementXml(std::wstring_view sXml, const wchar_t* szElement)
+{
+	size_t ix = 0;
+	const std::wstring_view sStartTag = NextStartTag(sXml, szElement, ix, sXml.length());
+	if (sStartTag.empty())
+		return std::wstring_view();
+	const size_t ixStart = ix - sStartTag.length();
+	if (sStartTag.length() >= 2 && L'/' == sStartTag[sStartTag.length() - 2])
+		return sStartTag;
+	const size_t ixEndTag = sXml.find(std::wstring(L"</") + szElement, ix);
+	const size_t ixEnd = (std::wstring_view::npos == ixEndTag) ? ixEndTag : sXml.find(L'>', ixEndTag);
+	if (std::wstring_view::npos == ixEnd)
+		return std::wstring_view();
+	return sXml.substr(ixStart, ixEnd + 1 - ixStart);
+}
+
+// Number of elements with the given name between ix and ixEnd
+static size_t CountElements(std::wstring_view sXml, const wchar_t* szElement, size_t ix, size_t ixEnd)
+{
+	size_t nElements = 0;
+	while (!NextStartTag(sXml, szElement, ix, ixEnd).empty())
+		++nElements;
+	return nElements;
+}
+
+// Splits a case-folded path into segments at backslashes and forward slashes
+static std::vector<std::u16string> PathSegments(const std::u16string& sPath)
+{
+	std::vector<std::u16string> segments;
+	size_t ixStart = 0;
+	for (size_t ix = 0; ix <= sPath.length(); ++ix)
+	{
+		if (ix == sPath.length() || u'\\' == sPath[ix] || u'/' == sPath[ix])
+		{
+			segments.push_back(sPath.substr(ixStart, ix - ixStart));
+			ixStart = ix + 1;
+		}
+	}
+	return segments;
+}
+
+// ------------------------------------------------------------------------------------------
+// Compilation
+
+// Builds the string table, storing each distinct string once
+class StringTableBuilder
+{
+public:
+	bool Add(const std::wstring& str, StringRef_t& stringRef)
+	{
+		std::u16string sUtf16;
+		if (!ToUtf16(str, sUtf16))
+			return false;
+		stringRef = Add(sUtf16);
+		return true;
+	}
+
+	StringRef_t Add(const std::u16string& sUtf16)
+	{
+		std::unordered_map<std::u16string, StringRef_t>::const_iterator iter = m_refs.find(sUtf16);
+		if (m_refs.end() != iter)
+			return iter->second;
+		const StringRef_t stringRef = { uint32_t(m_units.length()), uint32_t(sUtf16.length()) };
+		m_units += sUtf16;
+		m_refs.emplace(sUtf16, stringRef);
+		return stringRef;
+	}
+
+	const std::u16string& Units() const { return m_units; }
+
+private:
+	std::u16string m_units;
+	std::unordered_map<std::u16string, StringRef_t> m_refs;
+};
+
+// Path trie node while compiling
+struct PathTrieNode_t
+{
+	std::map<std::u16string, std::unique_ptr<PathTrieNode_t>> children;
+	std::vector<uint32_t> ruleIndexes;
+	std::vector<std::pair<std::u16string, uint32_t>> wildcards;   // Pattern and rule index
+};
+
+// Publisher index entry while compiling
+struct PublisherEntry_t
+{
+	std::u16string sPublisher, sProduct, sBinary;
+	uint32_t ruleIndex;
+};
+
+// Appends a section to the image, records its location, and pads to a 4-byte boundary
+static void AppendSection(std::vector<uint8_t>& image, Section_t section, const void* pEntries, size_t nEntries)
+{
+	ImageHeader_t* pHeader = reinterpret_cast<ImageHeader_t*>(image.data());
+	pHeader->sections[section].offset = uint32_t(image.size());
+	pHeader->sections[section].count = uint32_t(nEntries);
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pEntries);
+	image.insert(image.end(), pBytes, pBytes + nEntries * cbSectionEntries[section]);
+	image.resize((image.size() + 3) & ~size_t(3), 0);
+}
+
+//static
+bool AppLockerPolicyImage::Compile(const std::wstring& sPolicyXml, std::vector<uint8_t>& image, std::wstring& sErrorInfo)
+{
+	std::vector<std::wstring> warnings;
+	return Compile(sPolicyXml, image, warnings, sErrorInfo);
+}
+
+//static
+bool AppLockerPolicyImage::Compile(const std::wstring& sPolicyXml, std::vector<uint8_t>& image, std::vector<std::wstring>& warnings, std::wstring& sErrorInfo)
+{
+	STATS_SCOPE("image.compile");
+	image.clear();
+	warnings.clear();
+	sErrorInfo.clear();
+
+	// Neither AppLockerXmlParser nor the scanning here recognizes comments or CDATA sections.
+	std::wstring sStrippedXml;
+	std::wstring sCollectionXml[nCollectionTypes];
+	if (!StripCommentsAndCData(sPolicyXml, sStrippedXml) ||
+		!AppLockerXmlParser::ParseRuleCollections(sStrippedXml, sCollectionXml[0], sCollectionXml[1], sCollectionXml[2], sCollectionXml[3], sCollectionXml[4]))
+	{
+		sErrorInfo = sParseErrorText;
+		return false;
+	}
+
+	StringTableBuilder strings;
+	ImageCollection_t collections[nCollectionTypes] = {};
+	std::vector<ImageRule_t> rules;
+	std::vector<std::u16string> ruleSids;
+	PathTrieNode_t pathTrieRoot;
+	std::vector<PublisherEntry_t> publishers;
+	std::vector<std::pair<std::u16string, uint32_t>> hashes;
+
+	for (size_t ixCollection = 0; ixCollection < nCollectionTypes; ++ixCollection)
+	{
+		ImageCollection_t& collection = collections[ixCollection];
+		collection.firstRule = uint32_t(rules.size());
+		const std::wstring& sXml = sCollectionXml[ixCollection];
+		if (sXml.empty())
+		{
+			collection.enforcementMode = NotPresent;
+			continue;
+		}
+
+		unsigned long dwEnforcementMode = 0;
+		RuleInfoCollection_t ruleInfos;
+		if (!AppLockerXmlParser::ParseRuleCollection(sXml, dwEnforcementMode, ruleInfos))
+		{
+			sErrorInfo = std::wstring(sParseErrorText) + L": " + szCollectionTypes[ixCollection] + L" rule collection";
+			return false;
+		}
+		// ParseRuleCollection reports NotConfigured as AuditOnly with no rules; tell them apart by the start tag.
+		collection.enforcementMode = uint32_t(dwEnforcementMode);
+		if (ruleInfos.empty() && std::wstring::npos != GetAttribute(sXml.substr(0, sXml.find(L'>')), L"EnforcementMode").find(L"NotConfigured"))
+		{
+			collection.enforcementMode = NotConfigured;
+			const size_t nDiscarded =
+				CountElements(sXml, L"FilePathRule", 0, sXml.length()) +
+				CountElements(sXml, L"FilePublisherRule", 0, sXml.length()) +
+				CountElements(sXml, L"FileHashRule", 0, sXml.length());
+			if (nDiscarded > 0)
+				warnings.push_back(std::wstring(szCollectionTypes[ixCollection]) + L" rule collection is NotConfigured; its " + std::to_wstring(nDiscarded) + L" rules are not kept");
+		}
+		// Kept as is: e.g., the services enforcement mode (ThresholdExtensions) and system apps (RedstoneExtensions)
+		if (!strings.Add(std::wstring(ElementXml(sXml, L"RuleCollectionExtensions")), collection.extensions))
+		{
+			sErrorInfo = std::wstring(L"Invalid characters in the extensions of the ") + szCollectionTypes[ixCollection] + L" rule collection";
+			return false;
+		}
+
+		for (const RuleInfo_t& ruleInfo : ruleInfos)
+		{
+			const uint32_t ruleIndex = uint32_t(rules.size());
+			const std::wstring_view sRuleXml(ruleInfo.sXml);
+			size_t ix = 0;
+			ImageRule_t rule = {};
+			rule.collection = uint8_t(ixCollection);
+			rule.ruleType = uint8_t(
+				0 == sRuleXml.find(L"<FilePathRule") ? PolicyImageRule_t::PathRule :
+				0 == sRuleXml.find(L"<FilePublisherRule") ? PolicyImageRule_t::PublisherRule :
+				PolicyImageRule_t::HashRule);
+			const std::wstring_view sRuleStartTag = sRuleXml.substr(0, sRuleXml.find(L'>') + 1);
+			rule.bDeny = uint8_t(L"Deny" == GetAttribute(sRuleStartTag, L"Action") ? 1 : 0);
+			if (!strings.Add(ruleInfo.sGuid, rule.id) ||
+				!strings.Add(GetAttribute(sRuleStartTag, L"Name"), rule.name) ||
+				!strings.Add(ruleInfo.sXml, rule.xml))
+			{
+				sErrorInfo = L"Invalid characters in rule " + ruleInfo.sGuid;
+				return false;
+			}
+			const std::wstring sUserOrGroupSid = GetAttribute(sRuleStartTag, L"UserOrGroupSid");
+			if (!SidString::IsValid(sUserOrGroupSid.c_str()))
+				warnings.push_back(L"Rule " + ruleInfo.sGuid + L": UserOrGroupSid \"" + sUserOrGroupSid + L"\" is not a valid SID");
+			std::u16string sSid;
+			ToUtf16(sUserOrGroupSid, sSid);
+			ruleSids.push_back(sSid);
+
+			// The rule is kept whole, but lookups won't take its exceptions or version ranges into account.
+			const size_t ixExceptions = sRuleXml.find(L"<Exceptions>");
+			const size_t ixExceptionsEnd = sRuleXml.find(L"</Exceptions>");
+			if (std::wstring_view::npos != ixExceptions && std::wstring_view::npos != ixExceptionsEnd &&
+				sRuleXml.find(L'<', ixExceptions + 1) < ixExceptionsEnd)
+				warnings.push_back(L"Rule " + ruleInfo.sGuid + L": exceptions are not indexed");
+
+			// Index the primary conditions (not the exceptions)
+			size_t ixConditions = sRuleXml.find(L"<Conditions>");
+			const size_t ixConditionsEnd = sRuleXml.find(L"</Conditions>");
+			if (std::wstring_view::npos != ixConditions && std::wstring_view::npos != ixConditionsEnd)
+			{
+				switch (rule.ruleType)
+				{
+				case PolicyImageRule_t::PathRule:
+					for (ix = ixConditions; ;)
+					{
+						const std::wstring_view sTag = NextStartTag(sRuleXml, L"FilePathCondition", ix, ixConditionsEnd);
+						if (sTag.empty())
+							break;
+						const std::u16string sPath = FoldedKey(GetAttribute(sTag, L"Path"));
+						std::vector<std::u16string> segments = PathSegments(sPath);
+						// Exact paths and "...\*" patterns end at a trie node. Other wildcard patterns hang off the node
+						// for their leading literal segments, and are matched only when a lookup reaches that node.
+						size_t nLiteralSegments = 0;
+						while (nLiteralSegments < segments.size() && std::u16string::npos == segments[nLiteralSegments].find_first_of(u"*?"))
+							++nLiteralSegments;
+						const bool bTrie = (nLiteralSegments == segments.size()) ||
+							(nLiteralSegments + 1 == segments.size() && u"*" == segments.back());
+						PathTrieNode_t* pNode = &pathTrieRoot;
+						for (size_t ixSegment = 0; ixSegment < (bTrie ? segments.size() : nLiteralSegments); ++ixSegment)
+						{
+							std::unique_ptr<PathTrieNode_t>& pChild = pNode->children[segments[ixSegment]];
+							if (!pChild)
+								pChild.reset(new PathTrieNode_t);
+							pNode = pChild.get();
+						}
+						if (bTrie)
+							pNode->ruleIndexes.push_back(ruleIndex);
+						else
+							pNode->wildcards.push_back(std::make_pair(sPath, ruleIndex));
+					}
+					break;
+
+				case PolicyImageRule_t::PublisherRule:
+					for (ix = ixConditions; ;)
+					{
+						const std::wstring_view sTag = NextStartTag(sRuleXml, L"FilePublisherCondition", ix, ixConditionsEnd);
+						if (sTag.empty())
+							break;
+						publishers.push_back(PublisherEntry_t{
+							FoldedKey(GetAttribute(sTag, L"PublisherName")),
+							FoldedKey(GetAttribute(sTag, L"ProductName")),
+							FoldedKey(GetAttribute(sTag, L"BinaryName")),
+							ruleIndex });
+						size_t ixRange = ix;
+						const std::wstring_view sRangeTag = NextStartTag(sRuleXml, L"BinaryVersionRange", ixRange, ixConditionsEnd);
+						if (!sRangeTag.empty() && (L"*" != GetAttribute(sRangeTag, L"LowSection") || L"*" != GetAttribute(sRangeTag, L"HighSection")))
+							warnings.push_back(L"Rule " + ruleInfo.sGuid + L": publisher version range is not indexed");
+					}
+					break;
+
+				case PolicyImageRule_t::HashRule:
+					for (ix = ixConditions; ;)
+					{
+						const std::wstring_view sTag = NextStartTag(sRuleXml, L"FileHash", ix, ixConditionsEnd);
+						if (sTag.empty())
+							break;
+						hashes.push_back(std::make_pair(FoldedKey(GetAttribute(sTag, L"Data")), ruleIndex));
+					}
+					break;
+				}
+			}
+			rules.push_back(rule);
+		}
+		collection.nRules = uint32_t(rules.size()) - collection.firstRule;
+	}
+
+	// SID table: distinct SIDs, sorted; then point each rule at its SID, and each SID at its rules
+	std::vector<std::u16string> sids(ruleSids);
+	std::sort(sids.begin(), sids.end());
+	sids.erase(std::unique(sids.begin(), sids.end()), sids.end());
+	if (!sids.empty() && sids.front().empty())
+		sids.erase(sids.begin());
+	std::vector<std::vector<uint32_t>> sidRules(sids.size());
+	for (size_t ixRule = 0; ixRule < rules.size(); ++ixRule)
+	{
+		std::vector<std::u16string>::const_iterator iter = std::lower_bound(sids.begin(), sids.end(), ruleSids[ixRule]);
+		rules[ixRule].sidIndex = (sids.end() != iter && *iter == ruleSids[ixRule]) ? uint32_t(iter - sids.begin()) : nNone;
+		if (nNone != rules[ixRule].sidIndex)
+			sidRules[rules[ixRule].sidIndex].push_back(uint32_t(ixRule));
+	}
+	std::vector<ImageSid_t> sidEntries;
+	std::vector<uint32_t> sidRuleRefs;
+	for (size_t ixSid = 0; ixSid < sids.size(); ++ixSid)
+	{
+		sidEntries.push_back(ImageSid_t{ strings.Add(sids[ixSid]), uint32_t(sidRuleRefs.size()), uint32_t(sidRules[ixSid].size()) });
+		sidRuleRefs.insert(sidRuleRefs.end(), sidRules[ixSid].begin(), sidRules[ixSid].end());
+	}
+
+	// Path trie, breadth-first, so that each node's children are contiguous
+	std::vector<ImagePathNode_t> pathNodes;
+	std::vector<uint32_t> pathRuleRefs;
+	std::vector<ImageWildcardPath_t> wildcardPaths;
+	std::vector<const PathTrieNode_t*> pendingNodes(1, &pathTrieRoot);
+	pathNodes.push_back(ImagePathNode_t{ strings.Add(std::u16string()), 0, 0, 0, 0, 0, 0 });
+	for (size_t ixNode = 0; ixNode < pendingNodes.size(); ++ixNode)
+	{
+		const PathTrieNode_t* pNode = pendingNodes[ixNode];
+		pathNodes[ixNode].firstChild = uint32_t(pathNodes.size());
+		pathNodes[ixNode].nChildren = uint32_t(pNode->children.size());
+		pathNodes[ixNode].firstRuleRef = uint32_t(pathRuleRefs.size());
+		pathNodes[ixNode].nRuleRefs = uint32_t(pNode->ruleIndexes.size());
+		pathRuleRefs.insert(pathRuleRefs.end(), pNode->ruleIndexes.begin(), pNode->ruleIndexes.end());
+		pathNodes[ixNode].firstWildcard = uint32_t(wildcardPaths.size());
+		pathNodes[ixNode].nWildcards = uint32_t(pNode->wildcards.size());
+		for (const std::pair<std::u16string, uint32_t>& wildcard : pNode->wildcards)
+			wildcardPaths.push_back(ImageWildcardPath_t{ strings.Add(wildcard.first), wildcard.second, 0 });
+		for (const auto& child : pNode->children)
+		{
+			pathNodes.push_back(ImagePathNode_t{ strings.Add(child.first), 0, 0, 0, 0, 0, 0 });
+			pendingNodes.push_back(child.second.get());
+		}
+	}
+
+	// Publisher index, sorted by publisher
+	std::stable_sort(publishers.begin(), publishers.end(),
+		[](const PublisherEntry_t& a, const PublisherEntry_t& b) { return a.sPublisher < b.sPublisher; });
+	std::vector<ImagePublisher_t> publisherEntries;
+	for (const PublisherEntry_t& publisher : publishers)
+		publisherEntries.push_back(ImagePublisher_t{ strings.Add(publisher.sPublisher), strings.Add(publisher.sProduct), strings.Add(publisher.sBinary), publisher.ruleIndex, 0 });
+
+	// Hash table, at most half full
+	size_t nHashSlots = 0;
+	if (!hashes.empty())
+	{
+		nHashSlots = 2;
+		while (nHashSlots < hashes.size() * 2)
+			nHashSlots *= 2;
+	}
+	std::vector<ImageHashSlot_t> hashSlots(nHashSlots, ImageHashSlot_t{ { 0, 0 }, 0, nNone });
+	for (const std::pair<std::u16string, uint32_t>& hash : hashes)
+	{
+		const uint32_t keyHash = KeyHash(hash.first.data(), hash.first.length());
+		size_t ixSlot = keyHash & (nHashSlots - 1);
+		while (nNone != hashSlots[ixSlot].ruleIndex)
+			ixSlot = (ixSlot + 1) & (nHashSlots - 1);
+		hashSlots[ixSlot] = ImageHashSlot_t{ strings.Add(hash.first), keyHash, hash.second };
+	}
+
+	// Lay out the image; the string table goes last, since it's complete only now.
+	image.resize(sizeof(ImageHeader_t), 0);
+	AppendSection(image, CollectionsSection, collections, nCollectionTypes);
+	AppendSection(image, RulesSection, rules.data(), rules.size());
+	AppendSection(image, SidsSection, sidEntries.data(), sidEntries.size());
+	AppendSection(image, SidRuleRefsSection, sidRuleRefs.data(), sidRuleRefs.size());
+	AppendSection(image, PathNodesSection, pathNodes.data(), pathNodes.size());
+	AppendSection(image, PathRuleRefsSection, pathRuleRefs.data(), pathRuleRefs.size());
+	AppendSection(image, WildcardPathsSection, wildcardPaths.data(), wildcardPaths.size());
+	AppendSection(image, PublishersSection, publisherEntries.data(), publisherEntries.size());
+	AppendSection(image, HashSlotsSection, hashSlots.data(), hashSlots.size());
+	AppendSection(image, StringsSection, strings.Units().data(), strings.Units().length());
+	if (image.size() > UINT32_MAX)
+	{
+		image.clear();
+		sErrorInfo = L"Policy too large for a policy image";
+		return false;
+	}
+
+	ImageHeader_t* pHeader = reinterpret_cast<ImageHeader_t*>(image.data());
+	memcpy(pHeader->magic, szImageMagic, sizeof(pHeader->magic));
+	pHeader->version = nFormatVersion;
+	pHeader->byteOrderMark = nByteOrderMark;
+	pHeader->cbImage = uint32_t(image.size());
+	pHeader->sectionCount = nSections;
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------
+// Loading and queries
+
+AppLockerPolicyImage::AppLockerPolicyImage()
+	: m_pData(NULL), m_cbData(0), m_nRules(0)
+{
+}
+
+bool AppLockerPolicyImage::Load(const uint8_t* pData, size_t cbData, std::wstring& sErrorInfo)
+{
+	m_pData = NULL;
+	m_cbData = 0;
+	m_nRules = 0;
+	sErrorInfo.clear();
+
+	const ImageHeader_t* pHeader = reinterpret_cast<const ImageHeader_t*>(pData);
+	if (NULL == pData || cbData < sizeof(ImageHeader_t) || 0 != memcmp(pHeader->magic, szImageMagic, sizeof(szImageMagic)))
+	{
+		sErrorInfo = L"Not a policy image";
+		return false;
+	}
+	if (nFormatVersion != pHeader->version)
+	{
+		sErrorInfo = L"Unsupported policy image version " + std::to_wstring(pHeader->version);
+		return false;
+	}
+	if (nByteOrderMark != pHeader->byteOrderMark || nSections != pHeader->sectionCount || pHeader->cbImage > cbData || 0 != (reinterpret_cast<uintptr_t>(pData) & 3))
+	{
+		sErrorInfo = L"Invalid policy image header";
+		return false;
+	}
+	for (size_t ixSection = 0; ixSection < nSections; ++ixSection)
+	{
+		const SectionRef_t& section = pHeader->sections[ixSection];
+		if (0 != (section.offset & 3) || section.offset < sizeof(ImageHeader_t) ||
+			uint64_t(section.offset) + uint64_t(section.count) * cbSectionEntries[ixSection] > pHeader->cbImage)
+		{
+			sErrorInfo = L"Invalid policy image section " + std::to_wstring(ixSection);
+			return false;
+		}
+	}
+	if (nCollectionTypes != pHeader->sections[CollectionsSection].count || 0 == pHeader->sections[PathNodesSection].count)
+	{
+		sErrorInfo = L"Invalid policy image content";
+		return false;
+	}
+
+	m_pData = pData;
+	m_cbData = pHeader->cbImage;
+	m_nRules = pHeader->sections[RulesSection].count;
+	return true;
+}
+
+template<typename T>
+const T* AppLockerPolicyImage::Section(size_t ixSection, size_t& nEntries) const
+{
+	if (NULL == m_pData)
+	{
+		nEntries = 0;
+		return NULL;
+	}
+	const SectionRef_t& section = reinterpret_cast<const ImageHeader_t*>(m_pData)->sections[ixSection];
+	nEntries = section.count;
+	return reinterpret_cast<const T*>(m_pData + section.offset);
+}
+
+bool AppLockerPolicyImage::GetString(const void* pStringRef, std::wstring& str) const
+{
+	const StringRef_t& stringRef = *static_cast<const StringRef_t*>(pStringRef);
+	size_t nUnits;
+	const char16_t* pUnits = Section<char16_t>(StringsSection, nUnits);
+	if (uint64_t(stringRef.offset) + stringRef.cch > nUnits)
+	{
+		str.clear();
+		return false;
+	}
+	return Utf16ToWString(reinterpret_cast<const char*>(pUnits + stringRef.offset), stringRef.cch * sizeof(char16_t), false, str);
+}
+
+int AppLockerPolicyImage::CompareText(const void* pStringRef, const std::u16string& sText) const
+{
+	const StringRef_t& stringRef = *static_cast<const StringRef_t*>(pStringRef);
+	size_t nUnits;
+	const char16_t* pUnits = Section<char16_t>(StringsSection, nUnits);
+	// Treat an out-of-bounds reference as empty text
+	const size_t cch = (uint64_t(stringRef.offset) + stringRef.cch > nUnits) ? 0 : stringRef.cch;
+	const int result = std::char_traits<char16_t>::compare(pUnits + stringRef.offset, sText.data(), std::min(cch, sText.length()));
+	if (0 != result)
+		return result;
+	return (cch < sText.length()) ? -1 : (cch > sText.length() ? 1 : 0);
+}
+
+bool AppLockerPolicyImage::GetRule(size_t ixRule, PolicyImageRule_t& rule) const
+{
+	size_t nRules, nSids;
+	const ImageRule_t* pRules = Section<ImageRule_t>(RulesSection, nRules);
+	const ImageSid_t* pSids = Section<ImageSid_t>(SidsSection, nSids);
+	if (ixRule >= nRules || pRules[ixRule].collection >= nCollectionTypes || pRules[ixRule].ruleType > PolicyImageRule_t::HashRule)
+		return false;
+	const ImageRule_t& imageRule = pRules[ixRule];
+	rule.sCollectionType = szCollectionTypes[imageRule.collection];
+	rule.ruleType = PolicyImageRule_t::RuleType_t(imageRule.ruleType);
+	rule.bDeny = (0 != imageRule.bDeny);
+	rule.sUserOrGroupSid.clear();
+	if (nNone != imageRule.sidIndex && (imageRule.sidIndex >= nSids || !GetString(&pSids[imageRule.sidIndex].sid, rule.sUserOrGroupSid)))
+		return false;
+	return GetString(&imageRule.id, rule.sId) && GetString(&imageRule.name, rule.sName) && GetString(&imageRule.xml, rule.sXml);
+}
+
+void AppLockerPolicyImage::FindPathRules(const std::wstring& sPath, std::vector<uint32_t>& ruleIndexes) const
+{
+	ruleIndexes.clear();
+	size_t nNodes, nRuleRefs, nWildcardPaths;
+	const ImagePathNode_t* pNodes = Section<ImagePathNode_t>(PathNodesSection, nNodes);
+	const uint32_t* pRuleRefs = Section<uint32_t>(PathRuleRefsSection, nRuleRefs);
+	const ImageWildcardPath_t* pWildcardPaths = Section<ImageWildcardPath_t>(WildcardPathsSection, nWildcardPaths);
+	if (0 == nNodes)
+		return;
+
+	const std::u16string sFolded = FoldedKey(sPath);
+	const std::vector<std::u16string> segments = PathSegments(sFolded);
+	const std::u16string sStar(u"*");
+	std::wstring sFoldedPath, sPattern;
+	// Adds the rules attached to a node
+	auto addRules = [&](const ImagePathNode_t& node)
+	{
+		for (size_t ixRef = node.firstRuleRef; ixRef < uint64_t(node.firstRuleRef) + node.nRuleRefs && ixRef < nRuleRefs; ++ixRef)
+			ruleIndexes.push_back(pRuleRefs[ixRef]);
+	};
+	// Adds the rules whose wildcard pattern, anchored at a node, matches the path
+	auto addWildcardRules = [&](const ImagePathNode_t& node)
+	{
+		if (0 == node.nWildcards)
+			return;
+		if (sFoldedPath.empty())
+		{
+			Utf16ToWString(reinterpret_cast<const char*>(sFolded.data()), sFolded.length() * sizeof(char16_t), false, sFoldedPath);
+			// Patterns use backslashes; the trie accepts either separator, so the patterns should too.
+			std::replace(sFoldedPath.begin(), sFoldedPath.end(), L'/', L'\\');
+		}
+		for (size_t ixWildcard = node.firstWildcard; ixWildcard < uint64_t(node.firstWildcard) + node.nWildcards && ixWildcard < nWildcardPaths; ++ixWildcard)
+		{
+			if (GetString(&pWildcardPaths[ixWildcard].pattern, sPattern) && WildcardMatchCaseInsensitive(sPattern.c_str(), sFoldedPath.c_str()))
+				ruleIndexes.push_back(pWildcardPaths[ixWildcard].ruleIndex);
+		}
+	};
+	// Finds a node's child by segment (children are sorted); nNone if none
+	auto findChild = [&](const ImagePathNode_t& node, const std::u16string& sSegment) -> uint32_t
+	{
+		size_t ixLow = std::min(size_t(node.firstChild), nNodes);
+		size_t ixHigh = (node.nChildren > nNodes - ixLow) ? nNodes : ixLow + node.nChildren;
+		while (ixLow < ixHigh)
+		{
+			const size_t ixMid = ixLow + (ixHigh - ixLow) / 2;
+			const int result = CompareText(&pNodes[ixMid].segment, sSegment);
+			if (0 == result)
+				return uint32_t(ixMid);
+			if (result < 0)
+				ixLow = ixMid + 1;
+			else
+				ixHigh = ixMid;
+		}
+		return nNone;
+	};
+
+	size_t ixNode = 0;
+	for (const std::u16string& sSegment : segments)
+	{
+		addWildcardRules(pNodes[ixNode]);
+		// "...\*" at this level covers the rest of the path
+		const uint32_t ixStar = findChild(pNodes[ixNode], sStar);
+		if (nNone != ixStar)
+			addRules(pNodes[ixStar]);
+		const uint32_t ixChild = findChild(pNodes[ixNode], sSegment);
+		if (nNone == ixChild)
+		{
+			ixNode = nNone;
+			break;
+		}
+		ixNode = ixChild;
+	}
+	if (nNone != ixNode)
+	{
+		addRules(pNodes[ixNode]);
+		addWildcardRules(pNodes[ixNode]);
+	}
+	std::sort(ruleIndexes.begin(), ruleIndexes.end());
+	ruleIndexes.erase(std::unique(ruleIndexes.begin(), ruleIndexes.end()), ruleIndexes.end());
+}
+
+void AppLockerPolicyImage::FindPathRules(const std::wstring& sPath, const AppLockerPathVariables& pathVariables, std::vector<uint32_t>& ruleIndexes) const
+{
+	ruleIndexes.clear();
+	std::vector<std::wstring> paths;
+	pathVariables.Equivalents(sPath, paths);
+	std::vector<uint32_t> formRuleIndexes;
+	for (const std::wstring& sForm : paths)
+	{
+		FindPathRules(sForm, formRuleIndexes);
+		ruleIndexes.insert(ruleIndexes.end(), formRuleIndexes.begin(), formRuleIndexes.end());
+	}
+	std::sort(ruleIndexes.begin(), ruleIndexes.end());
+	ruleIndexes.erase(std::unique(ruleIndexes.begin(), ruleIndexes.end()), ruleIndexes.end());
+}
+
+void AppLockerPolicyImage::FindPublisherRules(const std::wstring& sPublisherName, const std::wstring& sProductName, const std::wstring& sBinaryName, std::vector<uint32_t>& ruleIndexes) const
+{
+	ruleIndexes.clear();
+	size_t nPublishers;
+	const ImagePublisher_t* pPublishers = Section<ImagePublisher_t>(PublishersSection, nPublishers);
+	const std::u16string sProduct = FoldedKey(sProductName), sBinary = FoldedKey(sBinaryName), sStar(u"*");
+	for (const std::u16string& sPublisher : { FoldedKey(sPublisherName), sStar })
+	{
+		// First entry not less than the publisher
+		size_t ixLow = 0, ixHigh = nPublishers;
+		while (ixLow < ixHigh)
+		{
+			const size_t ixMid = ixLow + (ixHigh - ixLow) / 2;
+			if (CompareText(&pPublishers[ixMid].publisher, sPublisher) < 0)
+				ixLow = ixMid + 1;
+			else
+				ixHigh = ixMid;
+		}
+		for (size_t ix = ixLow; ix < nPublishers && EqualsText(&pPublishers[ix].publisher, sPublisher); ++ix)
+		{
+			const ImagePublisher_t& publisher = pPublishers[ix];
+			if ((EqualsText(&publisher.product, sProduct) || EqualsText(&publisher.product, sStar)) &&
+				(EqualsText(&publisher.binary, sBinary) || EqualsText(&publisher.binary, sStar)))
+				ruleIndexes.push_back(publisher.ruleIndex);
+		}
+		if (sStar == sPublisher)
+			break;
+	}
+	std::sort(ruleIndexes.begin(), ruleIndexes.end());
+	ruleIndexes.erase(std::unique(ruleIndexes.begin(), ruleIndexes.end()), ruleIndexes.end());
+}
+
+void AppLockerPolicyImage::FindHashRules(const std::wstring& sHashData, std::vector<uint32_t>& ruleIndexes) const
+{
+	ruleIndexes.clear();
+	size_t nSlots;
+	const ImageHashSlot_t* pSlots = Section<ImageHashSlot_t>(HashSlotsSection, nSlots);
+	// The size is a power of two; an image with a full table would make the probe loop endless.
+	if (0 == nSlots || 0 != (nSlots & (nSlots - 1)))
+		return;
+	const std::u16string sKey = FoldedKey(sHashData);
+	const uint32_t keyHash = KeyHash(sKey.data(), sKey.length());
+	for (size_t ixSlot = keyHash & (nSlots - 1), nProbes = 0; nNone != pSlots[ixSlot].ruleIndex && nProbes < nSlots; ixSlot = (ixSlot + 1) & (nSlots - 1), ++nProbes)
+	{
+		if (keyHash == pSlots[ixSlot].keyHash && EqualsText(&pSlots[ixSlot].hash, sKey))
+			ruleIndexes.push_back(pSlots[ixSlot].ruleIndex);
+	}
+	// A rule can list the same hash more than once (e.g., for files with different names).
+	std::sort(ruleIndexes.begin(), ruleIndexes.end());
+	ruleIndexes.erase(std::unique(ruleIndexes.begin(), ruleIndexes.end()), ruleIndexes.end());
+}
+
+void AppLockerPolicyImage::FindSidRules(const std::wstring& sSid, std::vector<uint32_t>& ruleIndexes) const
+{
+	ruleIndexes.clear();
+	size_t nSids, nRuleRefs;
+	const ImageSid_t* pSids = Section<ImageSid_t>(SidsSection, nSids);
+	const uint32_t* pRuleRefs = Section<uint32_t>(SidRuleRefsSection, nRuleRefs);
+	std::u16string sKey;
+	if (!ToUtf16(sSid, sKey))
+		return;
+	size_t ixLow = 0, ixHigh = nSids;
+	while (ixLow < ixHigh)
+	{
+		const size_t ixMid = ixLow + (ixHigh - ixLow) / 2;
+		const int result = CompareText(&pSids[ixMid].sid, sKey);
+		if (0 == result)
+		{
+			for (size_t ixRef = pSids[ixMid].firstRuleRef; ixRef < uint64_t(pSids[ixMid].firstRuleRef) + pSids[ixMid].nRuleRefs && ixRef < nRuleRefs; ++ixRef)
+				ruleIndexes.push_back(pRuleRefs[ixRef]);
+			return;
+		}
+		if (result < 0)
+			ixLow = ixMid + 1;
+		else
+			ixHigh = ixMid;
+	}
+}
+
+bool AppLockerPolicyImage::ToXml(std::wstring& sPolicyXml) const
+{
+	STATS_SCOPE("image.toXml");
+	sPolicyXml.clear();
+	size_t nCollections, nRules;
+	const ImageCollection_t* pCollections = Section<ImageCollection_t>(CollectionsSection, nCollections);
+	const ImageRule_t* pRules = Section<ImageRule_t>(RulesSection, nRules);
+	if (nCollectionTypes != nCollections)
+		return false;
+
+	// Same layout as the policy read from local GPO
+	sPolicyXml = std::wstring(L"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<") + AppLockerXmlParser::szPolicyRootTagname + L" Version=\"1\">\n";
+	std::wstring sRuleXml;
+	for (size_t ixCollection = 0; ixCollection < nCollectionTypes; ++ixCollection)
+	{
+		const ImageCollection_t& collection = pCollections[ixCollection];
+		if (NotPresent == collection.enforcementMode)
+			continue;
+		if (collection.enforcementMode > NotConfigured || uint64_t(collection.firstRule) + collection.nRules > nRules)
+			return false;
+		sPolicyXml.append(L"<RuleCollection Type=\"").append(szCollectionTypes[ixCollection])
+			.append(L"\" EnforcementMode=\"").append(szEnforcementModes[collection.enforcementMode]).append(L"\">\n");
+		for (size_t ixRule = collection.firstRule; ixRule < collection.firstRule + collection.nRules; ++ixRule)
+		{
+			if (!GetString(&pRules[ixRule].xml, sRuleXml))
+				return false;
+			sPolicyXml.append(sRuleXml).append(L"\n");
+		}
+		if (!GetString(&collection.extensions, sRuleXml))
+			return false;
+		if (!sRuleXml.empty())
+			sPolicyXml.append(sRuleXml).append(L"\n");
+		sPolicyXml.append(L"</RuleCollection>\n");
+	}
+	sPolicyXml.append(L"</").append(AppLockerXmlParser::szPolicyRootTagname).append(L">");
+	return true;
+}
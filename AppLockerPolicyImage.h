@@ -0,0 +1,188 @@
+// Compiled binary image of an AppLocker policy, loadable without parsing
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class AppLockerPathVariables;
+
+/// <summary>
+/// One rule, as stored in an AppLockerPolicyImage
+/// </summary>
+struct PolicyImageRule_t
+{
+	enum RuleType_t { PathRule, PublisherRule, HashRule };
+
+	std::wstring sCollectionType;   // e.g., "Exe"
+	RuleType_t ruleType;
+	bool bDeny;                     // true for Action="Deny", false for Action="Allow"
+	std::wstring sId;               // Rule GUID
+	std::wstring sName;
+	std::wstring sUserOrGroupSid;
+	std::wstring sXml;              // The rule's complete XML element
+};
+
+/// <summary>
+/// A versioned, self-contained binary image of an AppLocker policy. Compile it once from policy XML,
+/// save it, and later map it (e.g., with MappedFile) and Load it in constant time: Load checks only
+/// the header and section bounds, and every query reads the image in place.
+///
+/// The image holds, at offsets relative to its start, so it can be mapped at any address:
+/// 	- a string table of UTF-16LE text, referred to by offset and length;
+/// 	- the rule collections (type, enforcement mode, range of rules, and RuleCollectionExtensions XML);
+/// 	- the rules (type, action, SID, ID, name, and XML);
+/// 	- a sorted table of the distinct user or group SIDs, each with the list of its rules;
+/// 	- a trie of path-rule conditions by path segment; conditions with other wildcards hang off the node
+/// 	  for their leading literal segments;
+/// 	- a publisher index sorted by publisher name;
+/// 	- an open-addressed hash table of file hashes.
+/// Index keys (paths, publisher, product and file names, hashes) are stored case-folded, with XML
+/// entities decoded. Lookups match the primary conditions of rules only; exceptions and publisher
+/// version ranges are not indexed, and Compile warns about rules that have them. Lookups return
+/// indexes of rules, for GetRule.
+///
+/// ToXml regenerates canonical policy XML: the rule collections in a fixed order (Exe, Dll, Msi, Script,
+/// Appx), each with its rules in the order AppLockerXmlParser returns them followed by its
+/// RuleCollectionExtensions element, without comments and with CDATA sections as escaped text. Rules in
+/// NotConfigured collections are not kept, as AppLockerXmlParser doesn't return them. Compiling
+/// canonical XML yields an identical image.
+///
+/// Images are little-endian, which all supported platforms are.
+///
+/// Usage:
+/// 	std::vector<uint8_t> image;
+/// 	if (AppLockerPolicyImage::Compile(sPolicyXml, image, sErrorInfo)) { /* save image */ }
+/// 	...
+/// 	MappedFile mappedFile;
+/// 	AppLockerPolicyImage policyImage;
+/// 	if (mappedFile.Open(szImageFile, sErrorInfo) && policyImage.Load(mappedFile.Data(), mappedFile.Size(), sErrorInfo))
+/// 		policyImage.FindPathRules(L"%PROGRAMFILES%\\App\\App.exe", ruleIndexes);
+/// </summary>
+class AppLockerPolicyImage
+{
+public:
+	/// <summary>
+	/// Image format version written by Compile and accepted by Load
+	/// </summary>
+	static const uint32_t nFormatVersion = 3;
+
+	/// <summary>
+	/// Compiles AppLocker policy XML into an image.
+	/// </summary>
+	/// <param name="sPolicyXml">Input: AppLocker policy XML</param>
+	/// <param name="image">Output: the image</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if successful, false if the policy can't be parsed or is too large for the format</returns>
+	static bool Compile(const std::wstring& sPolicyXml, std::vector<uint8_t>& image, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Compiles AppLocker policy XML into an image, and reports what the image leaves out: rules in
+	/// NotConfigured collections, which are discarded, and the exceptions and publisher version ranges
+	/// of rules, which are kept but not indexed. Also reports rules whose UserOrGroupSid isn't a valid
+	/// SID string (see SidString::Parse), which Windows would reject.
+	/// </summary>
+	/// <param name="sPolicyXml">Input: AppLocker policy XML</param>
+	/// <param name="image">Output: the image</param>
+	/// <param name="warnings">Output: one line for each collection or rule the image doesn't fully represent, or whose SID isn't valid</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if successful, false if the policy can't be parsed or is too large for the format</returns>
+	static bool Compile(const std::wstring& sPolicyXml, std::vector<uint8_t>& image, std::vector<std::wstring>& warnings, std::wstring& sErrorInfo);
+
+	// Constructor
+	AppLockerPolicyImage();
+	// Destructor
+	~AppLockerPolicyImage() = default;
+
+	/// <summary>
+	/// Attaches to an image, which the caller must keep valid and unchanged while this object uses it.
+	/// The data must be 4-byte aligned, as mapped files and vector data are.
+	/// </summary>
+	/// <param name="pData">Input: image content</param>
+	/// <param name="cbData">Input: size of the image content in bytes</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if the header is valid and all sections lie within the data</returns>
+	bool Load(const uint8_t* pData, size_t cbData, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Number of rules in the image
+	/// </summary>
+	size_t RuleCount() const { return m_nRules; }
+
+	/// <summary>
+	/// Gets a rule.
+	/// </summary>
+	/// <param name="ixRule">Input: rule index, less than RuleCount()</param>
+	/// <param name="rule">Output: the rule</param>
+	/// <returns>false if the index is out of range or the image is inconsistent</returns>
+	bool GetRule(size_t ixRule, PolicyImageRule_t& rule) const;
+
+	/// <summary>
+	/// Finds the path rules whose condition matches a path in AppLocker form (e.g., "%OSDRIVE%\Tools\x.exe"):
+	/// equal, a "\*" pattern covering it, or another wildcard pattern matching it; case-insensitive.
+	/// </summary>
+	/// <param name="sPath">Input: path to look up</param>
+	/// <param name="ruleIndexes">Output: indexes of matching rules, replacing any previous content</param>
+	void FindPathRules(const std::wstring& sPath, std::vector<uint32_t>& ruleIndexes) const;
+
+	/// <summary>
+	/// Finds the path rules that match a path in variable or absolute form (e.g., "C:\Windows\System32\x.exe"),
+	/// whichever form the rules are written in: looks up every form of the path from pathVariables.Equivalents.
+	/// </summary>
+	/// <param name="sPath">Input: path to look up</param>
+	/// <param name="pathVariables">Input: the directories the path variables stand for; e.g., AppLockerPathVariables::ThisComputer()</param>
+	/// <param name="ruleIndexes">Output: indexes of matching rules, replacing any previous content</param>
+	void FindPathRules(const std::wstring& sPath, const AppLockerPathVariables& pathVariables, std::vector<uint32_t>& ruleIndexes) const;
+
+	/// <summary>
+	/// Finds the publisher rules whose condition matches a publisher, product, and file name; each
+	/// condition field matches if equal (case-insensitive) or "*".
+	/// </summary>
+	/// <param name="sPublisherName">Input: publisher name; e.g., "O=MICROSOFT CORPORATION, L=REDMOND, S=WASHINGTON, C=US"</param>
+	/// <param name="sProductName">Input: product name</param>
+	/// <param name="sBinaryName">Input: file (binary) name</param>
+	/// <param name="ruleIndexes">Output: indexes of matching rules, replacing any previous content</param>
+	void FindPublisherRules(const std::wstring& sPublisherName, const std::wstring& sProductName, const std::wstring& sBinaryName, std::vector<uint32_t>& ruleIndexes) const;
+
+	/// <summary>
+	/// Finds the hash rules with a file hash, as it appears in policy XML (e.g., "0x3A6B..."); case-insensitive.
+	/// </summary>
+	/// <param name="sHashData">Input: file hash</param>
+	/// <param name="ruleIndexes">Output: indexes of matching rules, replacing any previous content</param>
+	void FindHashRules(const std::wstring& sHashData, std::vector<uint32_t>& ruleIndexes) const;
+
+	/// <summary>
+	/// Finds the rules that apply to a user or group SID.
+	/// </summary>
+	/// <param name="sSid">Input: SID string; e.g., "S-1-1-0"</param>
+	/// <param name="ruleIndexes">Output: indexes of matching rules, replacing any previous content</param>
+	void FindSidRules(const std::wstring& sSid, std::vector<uint32_t>& ruleIndexes) const;
+
+	/// <summary>
+	/// Writes the policy as canonical AppLocker policy XML.
+	/// </summary>
+	/// <param name="sPolicyXml">Output: policy XML</param>
+	/// <returns>false if the image is inconsistent</returns>
+	bool ToXml(std::wstring& sPolicyXml) const;
+
+private:
+	// Reads a string from the string table; false if the reference is out of bounds
+	bool GetString(const void* pStringRef, std::wstring& str) const;
+	// Compares a string-table string with UTF-16 text
+	int CompareText(const void* pStringRef, const std::u16string& sText) const;
+	bool EqualsText(const void* pStringRef, const std::u16string& sText) const { return 0 == CompareText(pStringRef, sText); }
+	// Pointer to a section's entries, and their number
+	template<typename T> const T* Section(size_t ixSection, size_t& nEntries) const;
+
+private:
+	const uint8_t* m_pData;
+	size_t m_cbData;
+	size_t m_nRules;
+
+private:
+	// Not implemented
+	AppLockerPolicyImage(const AppLockerPolicyImage&) = delete;
+	AppLockerPolicyImage& operator = (const AppLockerPolicyImage&) = delete;
+};
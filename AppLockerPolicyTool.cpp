@@ -11,11 +11,24 @@ Also provides an emergency interface directly into the AppLocker policy cache in
 #include <Windows.h>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <chrono>
 #include "AppLockerPolicy.h"
-#include "Utf8FileUtility.h"
+#include "Utf8OutputStream.h"
 #include "FileSystemUtils.h"
 #include "StringUtils.h"
 #include "WhoAmI.h"
+#include "MappedFile.h"
+#include "AppLockerCacheDecoder.h"
+#include "SysErrorMessage.h"
+#include "AppLockerCacheMonitor.h"
+#include "DirectoryListing.h"
+#include "WindowsDirectories.h"
+#include "Stats.h"
+#include "TraceEvents.h"
+#include "AllocationAccounting.h"
+#include "AppLockerPolicyImage.h"
+#include "Utf8FileUtility.h"
 
 /// <summary>
 /// Write command-line syntax to stderr and then exit.
@@ -49,7 +62,44 @@ void Usage(const wchar_t* szError, const wchar_t* argv0)
 		<< std::endl
 		<< L"  Last resort emergency operations:" << std::endl
 		<< std::endl
-		<< L"    " << sExe << L" -911 [-list | -deleteall]" << std::endl
+		<< L"    " << sExe << L" -911 -list [-format text|csv|json] [-ext extensions] [-minsize n] [-maxsize n]" << std::endl
+		<< L"                   [-after datetime] [-before datetime] [-sort path|size|time] [-out filename]" << std::endl
+		<< L"    " << sExe << L" -911 [-decode | -compare]" << std::endl
+		<< L"    " << sExe << L" -911 -check [-baseline filename]" << std::endl
+		<< L"    " << sExe << L" -911 [-snapshot | -snapshots | -restore name | -delete pattern | -deleteall] [-store directory]" << std::endl
+		<< std::endl
+		<< L"  Compiled policy image operations:" << std::endl
+		<< std::endl
+		<< L"    " << sExe << L" -image -compile filename -out imagefile" << std::endl
+		<< L"    " << sExe << L" -image -decompile imagefile [-out filename]" << std::endl
+		<< std::endl
+		<< L"    -list lists the files and directories under System32\\AppLocker as they are enumerated." << std::endl
+		<< L"      -ext (e.g., AppLocker,dat), -minsize, -maxsize (bytes), -after, and -before (UTC yyyy-MM-dd[ HH:mm[:ss]])" << std::endl
+		<< L"      list only files that match; -sort sorts the listing, using temporary files if it is large." << std::endl
+		<< L"    -decode dumps the strings (text, rule IDs, SIDs) found in each rule collection cache file; it does not decode the binary records." << std::endl
+		<< L"    -compare compares the rule IDs in each cache file with the LGPO, effective GPO, and CSP policies." << std::endl
+		<< L"      (CSP policies are compared only when running as Local System.)" << std::endl
+		<< L"    -snapshot captures a compressed snapshot of System32\\AppLocker; -snapshots lists snapshots." << std::endl
+		<< L"    -restore restores the named snapshot into System32\\AppLocker." << std::endl
+		<< L"    -delete and -deleteall take a snapshot first. -delete deletes only the files whose names or" << std::endl
+		<< L"      relative paths match the wildcard pattern; e.g., -delete *.AppLocker keeps AppCache.dat*." << std::endl
+		<< L"      -deleteall deletes everything even if some files (or the whole snapshot) can't be captured." << std::endl
+		<< L"    -check reports changes to System32\\AppLocker since the last check, with the hash of the effective" << std::endl
+		<< L"      policy, then updates the baseline. Exit code 0 = no changes, 1 = changes; negative = error." << std::endl
+		<< L"      Only files whose size or timestamp changed are hashed; files that can't be read are reported" << std::endl
+		<< L"      and retried on the next check. Default baseline file:" << std::endl
+		<< L"      " << AppLockerCacheMonitor::DefaultBaselinePath() << std::endl
+		<< L"    -store specifies the snapshot store directory; default:" << std::endl
+		<< L"      " << AppLockerCacheSnapshot::DefaultStoreDirectory() << std::endl
+		<< std::endl
+		<< L"    -compile compiles a policy XML file into a binary policy image, which loads without parsing." << std::endl
+		<< L"    -decompile writes a policy image as canonical policy XML." << std::endl
+		<< std::endl
+		<< L"  Any operation can add -timing to report startup and command times to stderr, and -stats to" << std::endl
+		<< L"  write a JSON summary of per-phase times and operation counts (registry, WMI, retries) to stderr." << std::endl
+		<< L"  -trace filename writes a timeline of the command's phases on each thread in Chrome trace-event" << std::endl
+		<< L"  format, for chrome://tracing or https://ui.perfetto.dev. -allocs adds heap allocation counts," << std::endl
+		<< L"  bytes, and peak live bytes per phase to the -stats summary (and implies -stats)." << std::endl
 		<< std::endl;
 	exit(-1);
 }
@@ -62,13 +112,152 @@ int ClearLgpoPolicy();
 int GetCspPolicies(const std::wstring& sOutputFile);
 int SetCspPolicy(const std::wstring& sFilename, const std::wstring& sGroupName);
 int DeleteAllCspPolicies();
-int Do911List();
-int Do911DeleteAll();
+int Do911List(ListingWriter::Format_t format, const ListingFilter_t& filter, bool bSort, ListingSorter::SortKey_t sortKey, const std::wstring& sOutputFile);
+int Do911Decode();
+int Do911Compare();
+int Do911Snapshot(const std::wstring& sStoreDirectory);
+int Do911ListSnapshots(const std::wstring& sStoreDirectory);
+int Do911Restore(const std::wstring& sSnapshotName, const std::wstring& sStoreDirectory);
+int Do911Delete(const std::wstring& sPattern, const std::wstring& sStoreDirectory);
+int Do911DeleteAll(const std::wstring& sStoreDirectory);
+int Do911Check(const std::wstring& sBaselinePath);
+int ImageCompile(const std::wstring& sPolicyFile, const std::wstring& sImageFile);
+int ImageDecompile(const std::wstring& sImageFile, const std::wstring& sOutputFile);
+
+// Microseconds from the creation of this process until now; zero if unavailable
+static uint64_t MicrosecondsSinceProcessCreation()
+{
+	FILETIME ftCreation, ftExit, ftKernel, ftUser, ftNow;
+	GetSystemTimePreciseAsFileTime(&ftNow);
+	if (!GetProcessTimes(GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser))
+		return 0;
+	const uint64_t creation = (uint64_t(ftCreation.dwHighDateTime) << 32) | ftCreation.dwLowDateTime;
+	const uint64_t now = (uint64_t(ftNow.dwHighDateTime) << 32) | ftNow.dwLowDateTime;
+	// FILETIME units are 100 nanoseconds
+	return (now > creation) ? (now - creation) / 10 : 0;
+}
+
+/// <summary>
+/// Reports to stderr, when destroyed, the time from process creation to its construction (mostly
+/// loading DLLs), the time from its construction to its destruction, and the WindowsDirectories
+/// values resolved in the meantime, if enabled (-timing).
+/// </summary>
+class TimingReport
+{
+public:
+	TimingReport() : m_bEnabled(false), m_start(std::chrono::steady_clock::now()), m_startupMicroseconds(MicrosecondsSinceProcessCreation())
+	{
+	}
+
+	~TimingReport()
+	{
+		if (!m_bEnabled)
+			return;
+		const uint64_t commandMicroseconds = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+		std::wcerr
+			<< std::endl
+			<< L"Timing (microseconds):" << std::endl
+			<< L"  Process creation to main: " << m_startupMicroseconds << std::endl
+			<< L"  Command:                  " << commandMicroseconds << std::endl;
+		const std::vector<WindowsDirectories::ResolveTiming_t> timings = WindowsDirectories::ResolveTimings();
+		std::wcerr << L"  Windows directories resolved: " << timings.size() << std::endl;
+		for (const WindowsDirectories::ResolveTiming_t& timing : timings)
+			std::wcerr << L"    " << std::left << std::setw(30) << timing.szName << std::right << timing.microseconds << std::endl;
+	}
+
+	void Enable() { m_bEnabled = true; }
+
+private:
+	bool m_bEnabled;
+	std::chrono::steady_clock::time_point m_start;
+	uint64_t m_startupMicroseconds;
+};
+
+/// <summary>
+/// Writes the TraceEvents timeline to a file when destroyed, if enabled (-trace).
+/// </summary>
+class TraceReport
+{
+public:
+	~TraceReport()
+	{
+		if (m_sTraceFile.empty())
+			return;
+		std::ofstream fs(m_sTraceFile, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+		if (fs)
+			TraceEvents::WriteJson(fs);
+		if (!fs)
+			std::wcerr << L"Cannot write trace file " << m_sTraceFile << std::endl;
+	}
+
+	void Enable(const std::wstring& sTraceFile)
+	{
+		m_sTraceFile = sTraceFile;
+		TraceEvents::Enable();
+	}
+
+private:
+	std::wstring m_sTraceFile;
+};
+
+/// <summary>
+/// Writes to stderr, when destroyed, the Stats counters and phase times as JSON, with the time from process
+/// creation to its construction and from its construction to its destruction, if enabled (-stats).
+/// The phase times include allocation counts if those are enabled too (-allocs).
+/// </summary>
+class StatsReport
+{
+public:
+	StatsReport() : m_bEnabled(false), m_start(std::chrono::steady_clock::now()), m_startupMicroseconds(MicrosecondsSinceProcessCreation())
+	{
+	}
+
+	~StatsReport()
+	{
+		if (!m_bEnabled)
+			return;
+		const uint64_t commandMicroseconds = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+		Stats::WriteJson(std::wcerr, m_startupMicroseconds, commandMicroseconds);
+	}
+
+	void Enable()
+	{
+		m_bEnabled = true;
+		Stats::Enable();
+	}
+
+	void EnableAllocations()
+	{
+		Enable();
+		AllocationAccounting::Enable();
+	}
+
+private:
+	bool m_bEnabled;
+	std::chrono::steady_clock::time_point m_start;
+	uint64_t m_startupMicroseconds;
+};
 
 int wmain(int argc, wchar_t** argv)
 {
-	bool bCspMode = false, bLgpoMode = false, bGpoEffectiveMode = false, b911Mode = false;
+	// Report when wmain returns, if enabled by -timing, -trace, or -stats
+	TimingReport timingReport;
+	StatsReport statsReport;
+	TraceReport traceReport;
+
+	bool bCspMode = false, bLgpoMode = false, bGpoEffectiveMode = false, b911Mode = false, bImageMode = false;
 	bool bGetPolicies = false, bOutToFile = false, bSetPolicies = false, bDeleteAll = false, bClear = false, bList = false;
+	bool bDecode = false, bCompare = false;
+	bool bSnapshot = false, bListSnapshots = false, bRestore = false, bDelete = false, bStore = false;
+	std::wstring sSnapshotName, sDeletePattern, sStoreDirectory;
+	bool bCheck = false, bBaseline = false;
+	std::wstring sBaselinePath;
+	bool bCompile = false, bDecompile = false;
+	std::wstring sImageInputFile;
+	bool bListOption = false, bSort = false;
+	ListingWriter::Format_t listingFormat = ListingWriter::Text;
+	ListingFilter_t listingFilter;
+	ListingSorter::SortKey_t sortKey = ListingSorter::Path;
 	std::wstring sPolicyFile, sOutputFile;
 	bool bGroupName = false;
 	std::wstring sGroupName;
@@ -93,6 +282,10 @@ int wmain(int argc, wchar_t** argv)
 		{
 			b911Mode = true;
 		}
+		else if (0 == _wcsicmp(L"-image", argv[ixArg]))
+		{
+			bImageMode = true;
+		}
 		else if (0 == _wcsicmp(L"-get", argv[ixArg]))
 		{
 			bGetPolicies = true;
@@ -119,10 +312,145 @@ int wmain(int argc, wchar_t** argv)
 		{
 			bList = true;
 		}
+		else if (0 == _wcsicmp(L"-decode", argv[ixArg]))
+		{
+			bDecode = true;
+		}
+		else if (0 == _wcsicmp(L"-compare", argv[ixArg]))
+		{
+			bCompare = true;
+		}
+		else if (0 == _wcsicmp(L"-snapshot", argv[ixArg]))
+		{
+			bSnapshot = true;
+		}
+		else if (0 == _wcsicmp(L"-snapshots", argv[ixArg]))
+		{
+			bListSnapshots = true;
+		}
+		else if (0 == _wcsicmp(L"-restore", argv[ixArg]))
+		{
+			bRestore = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -restore", argv[0]);
+			sSnapshotName = argv[ixArg];
+		}
+		else if (0 == _wcsicmp(L"-delete", argv[ixArg]))
+		{
+			bDelete = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -delete", argv[0]);
+			sDeletePattern = argv[ixArg];
+		}
+		else if (0 == _wcsicmp(L"-store", argv[ixArg]))
+		{
+			bStore = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -store", argv[0]);
+			sStoreDirectory = argv[ixArg];
+		}
+		else if (0 == _wcsicmp(L"-check", argv[ixArg]))
+		{
+			bCheck = true;
+		}
+		else if (0 == _wcsicmp(L"-baseline", argv[ixArg]))
+		{
+			bBaseline = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -baseline", argv[0]);
+			sBaselinePath = argv[ixArg];
+		}
+		else if (0 == _wcsicmp(L"-compile", argv[ixArg]) || 0 == _wcsicmp(L"-decompile", argv[ixArg]))
+		{
+			if (0 == _wcsicmp(L"-compile", argv[ixArg]))
+				bCompile = true;
+			else
+				bDecompile = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing filename arg", argv[0]);
+			sImageInputFile = argv[ixArg];
+		}
+		else if (0 == _wcsicmp(L"-format", argv[ixArg]))
+		{
+			bListOption = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -format", argv[0]);
+			if (!ListingWriter::FormatFromName(argv[ixArg], listingFormat))
+				Usage(L"Invalid arg for -format", argv[0]);
+		}
+		else if (0 == _wcsicmp(L"-ext", argv[ixArg]))
+		{
+			bListOption = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -ext", argv[0]);
+			listingFilter.SetExtensions(argv[ixArg]);
+		}
+		else if (0 == _wcsicmp(L"-minsize", argv[ixArg]) || 0 == _wcsicmp(L"-maxsize", argv[ixArg]))
+		{
+			bListOption = true;
+			const bool bMin = (0 == _wcsicmp(L"-minsize", argv[ixArg]));
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -minsize/-maxsize", argv[0]);
+			wchar_t* pEnd = NULL;
+			const uint64_t nSize = wcstoull(argv[ixArg], &pEnd, 10);
+			if (pEnd == argv[ixArg] || L'\0' != *pEnd)
+				Usage(L"Invalid arg for -minsize/-maxsize", argv[0]);
+			(bMin ? listingFilter.nMinSize : listingFilter.nMaxSize) = nSize;
+		}
+		else if (0 == _wcsicmp(L"-after", argv[ixArg]) || 0 == _wcsicmp(L"-before", argv[ixArg]))
+		{
+			bListOption = true;
+			const bool bAfter = (0 == _wcsicmp(L"-after", argv[ixArg]));
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -after/-before", argv[0]);
+			if (!WStringToFileTime(argv[ixArg], bAfter ? listingFilter.ftModifiedAfter : listingFilter.ftModifiedBefore))
+				Usage(L"Invalid date/time for -after/-before", argv[0]);
+		}
+		else if (0 == _wcsicmp(L"-sort", argv[ixArg]))
+		{
+			bListOption = bSort = true;
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -sort", argv[0]);
+			if (!ListingSorter::SortKeyFromName(argv[ixArg], sortKey))
+				Usage(L"Invalid arg for -sort", argv[0]);
+		}
 		else if (0 == _wcsicmp(L"-clear", argv[ixArg]))
 		{
 			bClear = true;
 		}
+		else if (0 == _wcsicmp(L"-timing", argv[ixArg]))
+		{
+			timingReport.Enable();
+		}
+		else if (0 == _wcsicmp(L"-stats", argv[ixArg]))
+		{
+#if STATS_ENABLED
+			statsReport.Enable();
+#else
+			// Without the STATS_* instrumentation, there would be nothing but zeros to report.
+			Usage(L"-stats is not available: this build was compiled with NO_STATS", argv[0]);
+#endif
+		}
+		else if (0 == _wcsicmp(L"-allocs", argv[ixArg]))
+		{
+#if STATS_ENABLED
+			statsReport.EnableAllocations();
+#else
+			// operator new and delete aren't replaced, so nothing would be counted.
+			Usage(L"-allocs is not available: this build was compiled with NO_STATS", argv[0]);
+#endif
+		}
+		else if (0 == _wcsicmp(L"-trace", argv[ixArg]))
+		{
+			if (++ixArg >= argc)
+				Usage(L"Missing arg for -trace", argv[0]);
+#if STATS_ENABLED
+			traceReport.Enable(argv[ixArg]);
+#else
+			// The timeline's spans are recorded by STATS_SCOPE, so it would be empty.
+			Usage(L"-trace is not available: this build was compiled with NO_STATS", argv[0]);
+#endif
+		}
 		else if (0 == _wcsicmp(L"-gn", argv[ixArg]))
 		{
 			bGroupName = true;
@@ -145,21 +473,39 @@ int wmain(int argc, wchar_t** argv)
 	if (bLgpoMode) nModeCount++;
 	if (bGpoEffectiveMode) nModeCount++;
 	if (b911Mode) nModeCount++;
+	if (bImageMode) nModeCount++;
 	// Count operations
 	if (bGetPolicies) nOperationCount++;
 	if (bSetPolicies) nOperationCount++;
 	if (bDeleteAll) nOperationCount++;
 	if (bClear) nOperationCount++;
 	if (bList) nOperationCount++;
+	if (bDecode) nOperationCount++;
+	if (bCompare) nOperationCount++;
+	if (bSnapshot) nOperationCount++;
+	if (bListSnapshots) nOperationCount++;
+	if (bRestore) nOperationCount++;
+	if (bDelete) nOperationCount++;
+	if (bCheck) nOperationCount++;
+	if (bCompile) nOperationCount++;
+	if (bDecompile) nOperationCount++;
 	if (1 != nModeCount || 1 != nOperationCount)
 	{
-		Usage(L"Need to specify one policy mode (CSP, LGPO, GPO, or 911) and one operation.", argv[0]);
+		Usage(L"Need to specify one policy mode (CSP, LGPO, GPO, 911, or image) and one operation.", argv[0]);
 	}
 	// Check some invalid combinations
 	if (
 		(bGroupName && !(bCspMode && bSetPolicies)) || // group name valid only when setting CSP/MDM policies
-		(bOutToFile && !bGetPolicies)               || // output file only for get-policy operation
-		(bGpoEffectiveMode && !bGetPolicies)           // -gpo must be used with -get
+		(bOutToFile && !(bGetPolicies || bList || bCompile || bDecompile)) || // output file only for get-policy, list, and image operations
+		(bListOption && !(b911Mode && bList))       || // listing options only with -911 -list
+		(bGpoEffectiveMode && !bGetPolicies)        || // -gpo must be used with -get
+		((bDecode || bCompare) && !b911Mode)        || // -decode and -compare only with -911
+		((bSnapshot || bListSnapshots || bRestore || bDelete) && !b911Mode) || // snapshot operations only with -911
+		(bStore && !(b911Mode && (bSnapshot || bListSnapshots || bRestore || bDelete || bDeleteAll))) || // -store only with snapshot operations
+		(bCheck && !b911Mode)                       || // -check only with -911
+		(bBaseline && !bCheck)                      || // -baseline only with -check
+		(bImageMode != (bCompile || bDecompile))    || // -compile and -decompile only with -image, and vice versa
+		(bCompile && !bOutToFile)                      // -compile writes only to a file
 		)
 	{ 
 		Usage(L"Unsupported mode/operation combination.", argv[0]);
@@ -219,11 +565,50 @@ int wmain(int argc, wchar_t** argv)
 	{
 		if (bList)
 		{
-			return Do911List();
+			return Do911List(listingFormat, listingFilter, bSort, sortKey, sOutputFile);
+		}
+		if (bDecode)
+		{
+			return Do911Decode();
+		}
+		if (bCompare)
+		{
+			return Do911Compare();
+		}
+		if (bSnapshot)
+		{
+			return Do911Snapshot(sStoreDirectory);
+		}
+		if (bListSnapshots)
+		{
+			return Do911ListSnapshots(sStoreDirectory);
+		}
+		if (bRestore)
+		{
+			return Do911Restore(sSnapshotName, sStoreDirectory);
+		}
+		if (bDelete)
+		{
+			return Do911Delete(sDeletePattern, sStoreDirectory);
 		}
 		if (bDeleteAll)
 		{
-			return Do911DeleteAll();
+			return Do911DeleteAll(sStoreDirectory);
+		}
+		if (bCheck)
+		{
+			return Do911Check(sBaselinePath);
+		}
+	}
+	else if (bImageMode)
+	{
+		if (bCompile)
+		{
+			return ImageCompile(sImageInputFile, sOutputFile);
+		}
+		if (bDecompile)
+		{
+			return ImageDecompile(sImageInputFile, sOutputFile);
 		}
 	}
 
@@ -233,60 +618,34 @@ int wmain(int argc, wchar_t** argv)
 // ------------------------------------------------------------------------------------------
 
 /// <summary>
-/// Class that wraps writing UTF-8 to an fstream or to stdout
+/// Writes text to the output file, or to stdout if no output file is specified.
 /// </summary>
-class wostreamWrapper
+/// <param name="sText">Input: text to write</param>
+/// <param name="sOutputFile">Input: file to write to (empty string for stdout)</param>
+/// <returns>0 if successful, -3 if the output cannot be written</returns>
+static int WriteOutput(const std::wstring& sText, const std::wstring& sOutputFile)
 {
-public:
-	/// <summary>
-	/// Constructor. Pass in a file name to write to the filename, or an empty string to write to stdout.
-	/// </summary>
-	/// <param name="sFilename">Filename to write to (empty string for stdout)</param>
-	wostreamWrapper(const std::wstring& sFilename)
-		: m_pStream(&std::wcout), m_bUsingFilestream(false)
-	{
-		if (sFilename.length() > 0)
-		{
-			m_FileStream.open(sFilename, std::ios_base::out);
-			if (!m_FileStream.fail())
-			{
-				m_pStream = &m_FileStream;
-				m_bUsingFilestream = true;
-			}
-		}
-		std::locale loc = Utf8FileUtility::LocaleForWritingUtf8File();
-		m_pStream->imbue(loc);
-	}
-	~wostreamWrapper()
-	{
-		// Close filestream if opened.
-		if (m_bUsingFilestream)
-			m_FileStream.close();
-	}
-	std::wostream& stream()
+	std::wstring sErrorInfo;
+	Utf8OutputStream os;
+	if (os.Open(sOutputFile, sErrorInfo))
 	{
-		return *m_pStream;
+		os << sText << L"\n";
+		if (os.Close(sErrorInfo))
+			return 0;
 	}
-private:
-	std::wostream* m_pStream;
-	std::wofstream m_FileStream;
-	bool m_bUsingFilestream;
-private:
-	// Not implemented
-	wostreamWrapper(const wostreamWrapper&) = delete;
-	wostreamWrapper& operator = (const wostreamWrapper&) = delete;
-};
+	std::wcerr << L"Cannot write output: " << sErrorInfo << std::endl;
+	return -3;
+}
 
 // ------------------------------------------------------------------------------------------
 
 int GetLgpoPolicy(const std::wstring& sOutputFile)
 {
+	STATS_SCOPE("command.lgpo.get");
 	std::wstring sAppLockerPolicyXml, sErrorInfo;
 	if (AppLockerPolicy_LGPO::GetLocalPolicy(sAppLockerPolicyXml, sErrorInfo))
 	{
-		wostreamWrapper os(sOutputFile);
-		os.stream() << sAppLockerPolicyXml << std::endl;
-		return 0;
+		return WriteOutput(sAppLockerPolicyXml, sOutputFile);
 	}
 	else
 	{
@@ -297,12 +656,11 @@ int GetLgpoPolicy(const std::wstring& sOutputFile)
 
 int GetGpoEffectivePolicy(const std::wstring& sOutputFile)
 {
+	STATS_SCOPE("command.gpo.get");
 	std::wstring sAppLockerPolicyXml, sErrorInfo;
 	if (AppLockerPolicy_LGPO::GetEffectivePolicy(sAppLockerPolicyXml, sErrorInfo))
 	{
-		wostreamWrapper os(sOutputFile);
-		os.stream() << sAppLockerPolicyXml << std::endl;
-		return 0;
+		return WriteOutput(sAppLockerPolicyXml, sOutputFile);
 	}
 	else
 	{
@@ -314,6 +672,7 @@ int GetGpoEffectivePolicy(const std::wstring& sOutputFile)
 
 int SetLgpoPolicy(const std::wstring& sFilename)
 {
+	STATS_SCOPE("command.lgpo.set");
 	std::wstring sErrorInfo;
 	if (AppLockerPolicy_LGPO::SetPolicyFromFile(sFilename, sErrorInfo))
 	{
@@ -329,6 +688,7 @@ int SetLgpoPolicy(const std::wstring& sFilename)
 
 int ClearLgpoPolicy()
 {
+	STATS_SCOPE("command.lgpo.clear");
 	std::wstring sErrorInfo;
 	if (AppLockerPolicy_LGPO::ClearPolicy(sErrorInfo))
 	{
@@ -353,6 +713,7 @@ bool CspStatusCheck(const AppLockerPolicy_CSP& csp)
 
 int GetCspPolicies(const std::wstring& sOutputFile)
 {
+	STATS_SCOPE("command.csp.get");
 	AppLockerPolicies_t policies;
 	AppLockerPolicy_CSP csp;
 	if (!CspStatusCheck(csp))
@@ -369,7 +730,13 @@ int GetCspPolicies(const std::wstring& sOutputFile)
 	// If there are multiple policies defined through CSP, write them each to file, preceded by policy name.
 	// If there's just one, just write it to the file without labeling.
 	//TODO: Output needs to be something more programmatically consumable when there's more than one CSP-configured policy. JSON and a different exit code? Something with more obvious delimiter characters?
-	wostreamWrapper os(sOutputFile);
+	std::wstring sErrorInfo;
+	Utf8OutputStream os;
+	if (!os.Open(sOutputFile, sErrorInfo))
+	{
+		std::wcerr << L"Cannot write output: " << sErrorInfo << std::endl;
+		return -3;
+	}
 	for (
 		AppLockerPolicies_t::const_iterator iterPolicies = policies.begin();
 		iterPolicies != policies.end();
@@ -378,12 +745,17 @@ int GetCspPolicies(const std::wstring& sOutputFile)
 	{
 		if (policies.size() > 1)
 		{
-			os.stream()
-				<< std::endl
-				<< L"Policy name: " << iterPolicies->first << std::endl
-				<< std::endl;
+			os
+				<< L"\n"
+				<< L"Policy name: " << iterPolicies->first << L"\n"
+				<< L"\n";
 		}
-		os.stream() << iterPolicies->second.Policy() << std::endl;
+		os << iterPolicies->second.Policy() << L"\n";
+	}
+	if (!os.Close(sErrorInfo))
+	{
+		std::wcerr << L"Cannot write output: " << sErrorInfo << std::endl;
+		return -3;
 	}
 
 	return 0;
@@ -391,6 +763,7 @@ int GetCspPolicies(const std::wstring& sOutputFile)
 
 int SetCspPolicy(const std::wstring& sFilename, const std::wstring& sGroupName)
 {
+	STATS_SCOPE("command.csp.set");
 	AppLockerPolicies_t policies;
 	AppLockerPolicy_CSP csp;
 	if (!CspStatusCheck(csp))
@@ -423,6 +796,7 @@ int SetCspPolicy(const std::wstring& sFilename, const std::wstring& sGroupName)
 
 int DeleteAllCspPolicies()
 {
+	STATS_SCOPE("command.csp.deleteall");
 	AppLockerPolicies_t policies;
 	AppLockerPolicy_CSP csp;
 	if (!CspStatusCheck(csp))
@@ -449,47 +823,504 @@ int DeleteAllCspPolicies()
 	return 0;
 }
 
-int Do911List()
+int Do911List(ListingWriter::Format_t format, const ListingFilter_t& filter, bool bSort, ListingSorter::SortKey_t sortKey, const std::wstring& sOutputFile)
 {
-	/*
-File creation time   File last written    Filesize  File path
-2021-01-07 06:08:20  2021-01-07 06:08:20      8192
-	*/
-	std::wcout << L"File creation time   File last written    Filesize  File path" << std::endl;
+	STATS_SCOPE("command.911.list");
+	std::wstring sErrorInfo;
+	Utf8OutputStream os;
+	if (!os.Open(sOutputFile, sErrorInfo))
+	{
+		std::wcerr << L"Cannot write output: " << sErrorInfo << std::endl;
+		return -3;
+	}
+	ListingWriter writer(format, os);
+	ListingSorter sorter(sortKey);
+	std::wstringstream strErrorInfo;
+	bool bSortOK = true;
+
+	// Without sorting, each entry is written as soon as it is enumerated, in walk order.
+	// With sorting, the walk order doesn't matter, so directories are enumerated in parallel.
+	writer.Begin();
+	bool ret = AppLocker_EmergencyClean::ListAppLockerBinaryFiles(
+		filter,
+		bSort,
+		[&](const FileInfo_t& fileInfo)
+		{
+			if (!bSort)
+				writer.Write(fileInfo);
+			else if (bSortOK)
+				bSortOK = sorter.Add(fileInfo, strErrorInfo);
+		},
+		strErrorInfo);
+	if (bSort && bSortOK)
+		bSortOK = sorter.Finish(writer, strErrorInfo);
+	writer.End();
+	if (!os.Close(sErrorInfo))
+		strErrorInfo << L"Cannot write output: " << sErrorInfo << std::endl;
+
+	// Errors go to stderr so they don't corrupt CSV or JSON output.
+	std::wcerr << strErrorInfo.str();
+	if (!sErrorInfo.empty())
+		return -3;
+	return (ret && bSortOK) ? 0 : -1;
+}
+
+/// <summary>
+/// Captures a snapshot of System32\AppLocker and reports the result.
+/// </summary>
+/// <param name="snapshotStore">Input: snapshot store</param>
+/// <param name="entries">Output: directories and files captured</param>
+/// <param name="bComplete">Output: true if every file was captured</param>
+/// <returns>true if the snapshot was written, even if some files could not be captured</returns>
+static bool TakeSnapshot(AppLockerCacheSnapshot& snapshotStore, SnapshotEntryCollection_t& entries, bool& bComplete)
+{
+	std::wstring sSnapshotName;
+	std::wstringstream strErrorInfo;
+	bComplete = snapshotStore.Create(AppLocker_EmergencyClean::AppLockerCacheDirectory(), sSnapshotName, entries, strErrorInfo);
+	std::wcout << strErrorInfo.str();
+	if (sSnapshotName.empty())
+	{
+		std::wcout << L"Failure: snapshot not created." << std::endl;
+		return false;
+	}
+	std::wcout
+		<< L"Snapshot " << sSnapshotName << L" created in " << snapshotStore.StoreDirectory() << std::endl
+		<< L"  " << entries.size() << L" entries; "
+		<< snapshotStore.FilesStored() << L" files stored, "
+		<< snapshotStore.FilesDeduplicated() << L" already in store; "
+		<< snapshotStore.BytesRead() << L" bytes read, "
+		<< snapshotStore.BytesWritten() << L" bytes written" << std::endl;
+	return true;
+}
+
+int Do911Snapshot(const std::wstring& sStoreDirectory)
+{
+	STATS_SCOPE("command.911.snapshot");
+	AppLockerCacheSnapshot snapshotStore(sStoreDirectory);
+	SnapshotEntryCollection_t entries;
+	bool bComplete;
+	return TakeSnapshot(snapshotStore, entries, bComplete) ? 0 : -1;
+}
+
+int Do911ListSnapshots(const std::wstring& sStoreDirectory)
+{
+	STATS_SCOPE("command.911.snapshots");
+	AppLockerCacheSnapshot snapshotStore(sStoreDirectory);
+	std::vector<std::wstring> snapshotNames;
+	snapshotStore.List(snapshotNames);
+	std::wcout << L"Snapshots in " << snapshotStore.StoreDirectory() << L":" << std::endl;
+	for (std::vector<std::wstring>::const_iterator iterNames = snapshotNames.begin(); iterNames != snapshotNames.end(); ++iterNames)
+	{
+		std::wcout << L"  " << *iterNames << std::endl;
+	}
+	return 0;
+}
+
+int Do911Restore(const std::wstring& sSnapshotName, const std::wstring& sStoreDirectory)
+{
+	STATS_SCOPE("command.911.restore");
+	AppLockerCacheSnapshot snapshotStore(sStoreDirectory);
+	std::wstringstream strErrorInfo;
+	if (snapshotStore.Restore(sSnapshotName, AppLocker_EmergencyClean::AppLockerCacheDirectory(), strErrorInfo))
+	{
+		std::wcout << L"Snapshot " << sSnapshotName << L" restored." << std::endl;
+		return 0;
+	}
+	else
+	{
+		std::wcout << L"Failure: snapshot " << sSnapshotName << L" not fully restored." << std::endl << strErrorInfo.str();
+		return -1;
+	}
+}
+
+int Do911Delete(const std::wstring& sPattern, const std::wstring& sStoreDirectory)
+{
+	STATS_SCOPE("command.911.delete");
+	AppLockerCacheSnapshot snapshotStore(sStoreDirectory);
+	SnapshotEntryCollection_t entries;
+	bool bComplete;
+	// Files that couldn't be captured aren't in the snapshot, so they won't be deleted.
+	if (!TakeSnapshot(snapshotStore, entries, bComplete))
+		return -1;
+
+	std::vector<std::wstring> deletedFiles;
+	std::wstringstream strErrorInfo;
+	bool ret = AppLocker_EmergencyClean::DeleteAppLockerBinaryFiles(sPattern, entries, deletedFiles, strErrorInfo);
+	std::wcout << deletedFiles.size() << L" files deleted:" << std::endl;
+	for (std::vector<std::wstring>::const_iterator iterFiles = deletedFiles.begin(); iterFiles != deletedFiles.end(); ++iterFiles)
+	{
+		std::wcout << L"  " << *iterFiles << std::endl;
+	}
+	if (!ret)
+	{
+		std::wcout << L"Failure: not all matching files deleted." << std::endl << strErrorInfo.str();
+		return -1;
+	}
+	return 0;
+}
+
+int Do911DeleteAll(const std::wstring& sStoreDirectory)
+{
+	STATS_SCOPE("command.911.deleteall");
+	// This is the emergency path: capture what can be captured, but don't let a failed or incomplete
+	// snapshot (a locked file, a full disk, an untrusted store) prevent the deletion.
+	AppLockerCacheSnapshot snapshotStore(sStoreDirectory);
+	SnapshotEntryCollection_t entries;
+	bool bComplete;
+	if (!TakeSnapshot(snapshotStore, entries, bComplete))
+	{
+		std::wcout << L"Warning: deleting without a snapshot; deleted files cannot be restored." << std::endl;
+	}
+	else if (!bComplete)
+	{
+		std::wcout << L"Warning: files reported above as not captured will be deleted and cannot be restored." << std::endl
+			<< L"(Use -delete with a pattern to delete only files that were captured.)" << std::endl;
+	}
+
+	NativeFileSystem fileSystem;
+	BulkDelete bulkDelete(fileSystem);
+	bool ret = AppLocker_EmergencyClean::DeleteAppLockerBinaryFiles(bulkDelete);
+	std::wcout
+		<< bulkDelete.FilesDeleted() << L" files deleted in " << bulkDelete.FileDeletionMicroseconds() / 1000 << L" ms; "
+		<< bulkDelete.DirectoriesRemoved() << L" directories removed in " << bulkDelete.DirectoryRemovalMicroseconds() / 1000 << L" ms" << std::endl;
+	if (ret)
+	{
+		std::wcout << L"AppLocker binary files deleted." << std::endl;
+		return 0;
+	}
+	else
+	{
+		std::wcout << L"Failure: AppLocker binary file deletion failed." << std::endl;
+		for (std::vector<std::wstring>::const_iterator iterDirs = bulkDelete.EnumerationFailures().begin(); iterDirs != bulkDelete.EnumerationFailures().end(); ++iterDirs)
+		{
+			std::wcout << L"  Cannot enumerate " << *iterDirs << std::endl;
+		}
+		for (DeleteResultCollection_t::const_iterator iterResults = bulkDelete.Results().begin(); iterResults != bulkDelete.Results().end(); ++iterResults)
+		{
+			if (0 != iterResults->dwError)
+				std::wcout << L"  " << bulkDelete.ResultPath(*iterResults) << L": " << SysError(iterResults->dwError) << std::endl;
+		}
+		std::wcout << std::endl;
+		Do911List(ListingWriter::Text, ListingFilter_t(), false, ListingSorter::Path, std::wstring());
+		return -1;
+	}
+}
+
+/// <summary>
+/// Rule collection cache file under System32\AppLocker and the rule collection type it corresponds to
+/// </summary>
+struct CacheFile_t
+{
+	std::wstring sFullPath;
+	std::wstring sRuleCollectionType;
+};
+typedef std::vector<CacheFile_t> CacheFileCollection_t;
+
+/// <summary>
+/// Gets the rule collection cache files (Exe.AppLocker, Dll.AppLocker, etc.) under System32\AppLocker
+/// </summary>
+/// <param name="cacheFiles">Output: the cache files found</param>
+/// <param name="strErrorInfo">Output: the directories that could not be enumerated</param>
+/// <returns>true if every directory was enumerated; false otherwise, in which case cacheFiles holds the files that could be found</returns>
+static bool GetRuleCollectionCacheFiles(CacheFileCollection_t& cacheFiles, std::wstringstream& strErrorInfo)
+{
+	cacheFiles.clear();
 	FileInfoCollection_t fileInfoCollection;
-	if (AppLocker_EmergencyClean::ListAppLockerBinaryFiles(fileInfoCollection))
+	const bool bListed = AppLocker_EmergencyClean::ListAppLockerBinaryFiles(fileInfoCollection, strErrorInfo);
+	for (
+		FileInfoCollection_t::const_iterator iterFI = fileInfoCollection.begin();
+		iterFI != fileInfoCollection.end();
+		++iterFI
+		)
+	{
+		if (iterFI->bIsDirectory)
+			continue;
+		CacheFile_t cacheFile;
+		cacheFile.sRuleCollectionType = AppLockerCacheDecoder::RuleCollectionTypeFromFilename(GetFileNameFromFilePath(iterFI->sFullPath));
+		if (cacheFile.sRuleCollectionType.length() > 0)
+		{
+			cacheFile.sFullPath = iterFI->sFullPath;
+			cacheFiles.push_back(cacheFile);
+		}
+	}
+	return bListed;
+}
+
+/// <summary>
+/// Gets the rule collection cache files for Do911Decode and Do911Compare, reporting directories that
+/// could not be enumerated. Returns false if there's nothing to process, with retval set to the exit code.
+/// </summary>
+static bool GetRuleCollectionCacheFilesToProcess(CacheFileCollection_t& cacheFiles, int& retval)
+{
+	std::wstringstream strErrorInfo;
+	const bool bListed = GetRuleCollectionCacheFiles(cacheFiles, strErrorInfo);
+	// Files in a directory that can't be enumerated would otherwise go unreported.
+	retval = bListed ? 0 : -1;
+	if (!bListed)
+		std::wcout << L"Cannot list all of " << AppLocker_EmergencyClean::AppLockerCacheDirectory() << L":" << std::endl << strErrorInfo.str() << std::endl;
+	if (cacheFiles.empty())
+	{
+		if (bListed)
+			std::wcout << L"No AppLocker rule collection cache files found." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Writes a list of rule IDs, one per line, with a heading
+/// </summary>
+static void ListRuleIds(const wchar_t* szHeading, const std::vector<std::wstring>& ruleIds)
+{
+	if (ruleIds.empty())
+		return;
+	std::wcout << L"    " << szHeading << std::endl;
+	for (std::vector<std::wstring>::const_iterator iterIds = ruleIds.begin(); iterIds != ruleIds.end(); ++iterIds)
+	{
+		std::wcout << L"      " << *iterIds << std::endl;
+	}
+}
+
+int Do911Decode()
+{
+	STATS_SCOPE("command.911.decode");
+	CacheFileCollection_t cacheFiles;
+	int retval = 0;
+	if (!GetRuleCollectionCacheFilesToProcess(cacheFiles, retval))
+		return retval;
+
+	for (CacheFileCollection_t::const_iterator iterFiles = cacheFiles.begin(); iterFiles != cacheFiles.end(); ++iterFiles)
+	{
+		MappedFile mappedFile;
+		std::wstring sErrorInfo;
+		if (!mappedFile.Open(iterFiles->sFullPath.c_str(), sErrorInfo))
+		{
+			std::wcout << iterFiles->sFullPath << L": " << sErrorInfo << std::endl << std::endl;
+			retval = -1;
+			continue;
+		}
+
+		AppLockerCacheDecoder decoder(mappedFile.Data(), mappedFile.Size());
+		std::wcout
+			<< iterFiles->sFullPath << L" (" << iterFiles->sRuleCollectionType << L" rules, " << mappedFile.Size() << L" bytes)" << std::endl
+			<< L"  Rule IDs: " << decoder.TextRuleIds().size() << std::endl;
+		for (std::set<std::wstring>::const_iterator iterIds = decoder.TextRuleIds().begin(); iterIds != decoder.TextRuleIds().end(); ++iterIds)
+		{
+			std::wcout << L"    " << *iterIds << std::endl;
+		}
+		std::wcout << L"  SIDs: " << decoder.TextSids().size() << std::endl;
+		for (std::set<std::wstring>::const_iterator iterSids = decoder.TextSids().begin(); iterSids != decoder.TextSids().end(); ++iterSids)
+		{
+			std::wcout << L"    " << *iterSids << std::endl;
+		}
+		std::wcout << L"  Strings (offset: text):" << std::endl;
+		for (CacheTextRunCollection_t::const_iterator iterRuns = decoder.TextRuns().begin(); iterRuns != decoder.TextRuns().end(); ++iterRuns)
+		{
+			std::wcout << L"    " << std::setw(8) << iterRuns->offset << L": " << decoder.Text(*iterRuns) << std::endl;
+		}
+		std::wcout << std::endl;
+	}
+	return retval;
+}
+
+int Do911Compare()
+{
+	STATS_SCOPE("command.911.compare");
+	CacheFileCollection_t cacheFiles;
+	int retval = 0;
+	if (!GetRuleCollectionCacheFilesToProcess(cacheFiles, retval))
+		return retval;
+
+	// Gather the policy views to compare against: view name and policy XML.
+	std::vector<std::pair<std::wstring, std::wstring>> policyViews;
+	std::wstring sPolicyXml, sErrorInfo;
+	if (AppLockerPolicy_LGPO::GetLocalPolicy(sPolicyXml, sErrorInfo))
+		policyViews.push_back(std::make_pair(std::wstring(L"LGPO"), sPolicyXml));
+	else
+		std::wcout << L"LGPO policy not available: " << sErrorInfo << std::endl;
+	if (AppLockerPolicy_LGPO::GetEffectivePolicy(sPolicyXml, sErrorInfo))
+		policyViews.push_back(std::make_pair(std::wstring(L"GPO (effective)"), sPolicyXml));
+	else
+		std::wcout << L"Effective GPO policy not available: " << sErrorInfo << std::endl;
+	// CSP interfaces are accessible only to System (see wmain).
+	WhoAmI whoAmI;
+	if (whoAmI.IsSystem())
 	{
-		for (
-			FileInfoCollection_t::const_iterator iterFI = fileInfoCollection.begin();
-			iterFI != fileInfoCollection.end();
-			++iterFI
-			)
+		AppLockerPolicies_t policies;
+		AppLockerPolicy_CSP csp;
+		if (CspStatusCheck(csp) && csp.GetPolicies(policies))
 		{
-			if (!iterFI->bIsDirectory)
+			for (AppLockerPolicies_t::const_iterator iterPolicies = policies.begin(); iterPolicies != policies.end(); ++iterPolicies)
 			{
-				std::wcout << iterFI->sCreateTime << L"  " << iterFI->sLastWriteTime << L"  " << std::setw(8) << iterFI->filesize.QuadPart << L"  " << iterFI->sFullPath << std::endl;
+				policyViews.push_back(std::make_pair(L"CSP (" + iterPolicies->first + L")", iterPolicies->second.Policy()));
 			}
-			else
+		}
+		else
+		{
+			std::wcout << L"CSP policies not available." << std::endl;
+		}
+	}
+	else
+	{
+		std::wcout << L"CSP policies not compared: CSP interfaces are accessible only to the Local System account." << std::endl;
+	}
+	std::wcout << std::endl;
+
+	for (CacheFileCollection_t::const_iterator iterFiles = cacheFiles.begin(); iterFiles != cacheFiles.end(); ++iterFiles)
+	{
+		MappedFile mappedFile;
+		if (!mappedFile.Open(iterFiles->sFullPath.c_str(), sErrorInfo))
+		{
+			std::wcout << iterFiles->sFullPath << L": " << sErrorInfo << std::endl << std::endl;
+			retval = -1;
+			continue;
+		}
+
+		AppLockerCacheDecoder decoder(mappedFile.Data(), mappedFile.Size());
+		std::wcout << iterFiles->sFullPath << L" (" << iterFiles->sRuleCollectionType << L" rules, " << mappedFile.Size() << L" bytes)" << std::endl;
+		for (std::vector<std::pair<std::wstring, std::wstring>>::const_iterator iterViews = policyViews.begin(); iterViews != policyViews.end(); ++iterViews)
+		{
+			std::set<std::wstring> policyRuleIds;
+			if (!AppLockerCacheDecoder::GetPolicyRuleIds(iterViews->second, iterFiles->sRuleCollectionType, policyRuleIds))
 			{
-				std::wcout << iterFI->sCreateTime << L"  " << iterFI->sLastWriteTime << L"  " << std::setw(8) << L"" << L"  " << iterFI->sFullPath << std::endl;
+				std::wcout << L"  " << iterViews->first << L": policy could not be parsed" << std::endl;
+				continue;
 			}
+			CacheComparison_t comparison;
+			decoder.Compare(policyRuleIds, comparison);
+			std::wcout << L"  " << iterViews->first << L": " << comparison.inBoth.size() << L" of " << policyRuleIds.size() << L" policy rules found in cache" << std::endl;
+			ListRuleIds(L"Policy rules not in cache:", comparison.policyOnly);
+			ListRuleIds(L"Cached rules not in policy:", comparison.cacheOnly);
 		}
+		std::wcout << std::endl;
 	}
-	return 0;
+	return retval;
 }
 
-int Do911DeleteAll()
+int Do911Check(const std::wstring& sBaselinePath)
 {
-	if (AppLocker_EmergencyClean::DeleteAppLockerBinaryFiles())
+	STATS_SCOPE("command.911.check");
+	const std::wstring sBaselineFile = sBaselinePath.length() > 0 ? sBaselinePath : AppLockerCacheMonitor::DefaultBaselinePath();
+
+	// No baseline (first run) is not an error; everything will be reported as added.
+	CacheBaseline_t baseline;
+	std::wstring sErrorInfo;
+	bool bHaveBaseline = false;
+	if (!AppLockerCacheMonitor::ReadBaseline(sBaselineFile, baseline, bHaveBaseline, sErrorInfo))
 	{
-		std::wcout << L"AppLocker binary files deleted." << std::endl;
+		std::wcout << L"Failure: " << sErrorInfo << std::endl;
+		return -1;
+	}
+
+	CacheBaseline_t current;
+	if (!AppLockerCacheMonitor::HashEffectivePolicy(current.sPolicyHash, sErrorInfo))
+	{
+		std::wcout << L"Failure: " << sErrorInfo << std::endl;
+		return -1;
+	}
+	size_t nFilesHashed = 0;
+	std::wstringstream strErrorInfo;
+	if (!AppLockerCacheMonitor::Scan(AppLocker_EmergencyClean::AppLockerCacheDirectory(), baseline.files, current.files, nFilesHashed, strErrorInfo))
+	{
+		std::wcout << L"Failure: " << strErrorInfo.str();
+		return -1;
+	}
+
+	CacheChangeCollection_t changes;
+	AppLockerCacheMonitor::Compare(baseline.files, current.files, changes);
+	const bool bPolicyChanged = bHaveBaseline && baseline.sPolicyHash != current.sPolicyHash;
+
+	std::wcout
+		<< L"Effective policy: " << current.sPolicyHash << (bPolicyChanged ? L" (changed)" : L"") << std::endl
+		<< L"Cache files: " << current.files.size() << L" (" << nFilesHashed << L" hashed)" << std::endl;
+	if (!bHaveBaseline)
+		std::wcout << L"No baseline; creating " << sBaselineFile << std::endl;
+	for (CacheChangeCollection_t::const_iterator iterChanges = changes.begin(); iterChanges != changes.end(); ++iterChanges)
+	{
+		switch (iterChanges->changeType)
+		{
+		case CacheChange_t::Added:
+			std::wcout << L"Added:    " << iterChanges->sRelativePath << L"  " << iterChanges->sNewHash << std::endl;
+			break;
+		case CacheChange_t::Removed:
+			std::wcout << L"Removed:  " << iterChanges->sRelativePath << L"  " << iterChanges->sOldHash << std::endl;
+			break;
+		case CacheChange_t::Modified:
+			std::wcout << L"Modified: " << iterChanges->sRelativePath << L"  "
+				<< (iterChanges->sOldHash.empty() ? L"(not hashed)" : iterChanges->sOldHash) << L" -> "
+				<< (iterChanges->sNewHash.empty() ? L"(not hashed)" : iterChanges->sNewHash) << std::endl;
+			break;
+		}
+	}
+	// Files that couldn't be read are recorded in the baseline and retried on the next check.
+	for (CacheFileStateCollection_t::const_iterator iterFiles = current.files.begin(); iterFiles != current.files.end(); ++iterFiles)
+	{
+		if (iterFiles->sContentHash.empty())
+			std::wcout << L"Not hashed: " << iterFiles->sRelativePath << L"  " << iterFiles->sHashError << std::endl;
+	}
+
+	if (!AppLockerCacheMonitor::WriteBaseline(sBaselineFile, current, sErrorInfo))
+	{
+		std::wcout << L"Failure: " << sErrorInfo << std::endl;
+		return -1;
+	}
+	if (!bHaveBaseline)
 		return 0;
+	return (bPolicyChanged || !changes.empty()) ? 1 : 0;
+}
+
+// ------------------------------------------------------------------------------------------
+
+int ImageCompile(const std::wstring& sPolicyFile, const std::wstring& sImageFile)
+{
+	STATS_SCOPE("command.image.compile");
+	std::wstring sPolicyXml, sErrorInfo;
+	if (!Utf8FileUtility::ReadTextFile(sPolicyFile.c_str(), sPolicyXml, sErrorInfo))
+	{
+		std::wcout << L"Cannot read policy file: " << sErrorInfo << std::endl;
+		return -1;
 	}
-	else
+	std::vector<uint8_t> image;
+	std::vector<std::wstring> warnings;
+	if (!AppLockerPolicyImage::Compile(sPolicyXml, image, warnings, sErrorInfo))
 	{
-		std::wcout << L"Failure: AppLocker binary file deletion failed." << std::endl;
-		std::wcout << std::endl;
-		Do911List();
+		std::wcout << L"Cannot compile policy: " << sErrorInfo << std::endl;
+		return -2;
+	}
+	for (const std::wstring& sWarning : warnings)
+		std::wcout << L"Warning: " << sWarning << std::endl;
+	// Written atomically, so that a failed write doesn't destroy an existing image
+	Utf8OutputBuffer output;
+	bool bWritten = output.OpenFile(sImageFile, true, false, sErrorInfo);
+	if (bWritten)
+	{
+		// A write error is reported by Close.
+		output.WriteBytes(image.data(), image.size());
+		bWritten = output.Close(sErrorInfo);
+	}
+	if (!bWritten)
+	{
+		std::wcerr << L"Cannot write output: " << sErrorInfo << std::endl;
+		return -3;
+	}
+	return 0;
+}
+
+int ImageDecompile(const std::wstring& sImageFile, const std::wstring& sOutputFile)
+{
+	STATS_SCOPE("command.image.decompile");
+	std::wstring sErrorInfo, sPolicyXml;
+	MappedFile mappedFile;
+	AppLockerPolicyImage policyImage;
+	if (!mappedFile.Open(sImageFile.c_str(), sErrorInfo) || !policyImage.Load(mappedFile.Data(), mappedFile.Size(), sErrorInfo))
+	{
+		std::wcout << L"Cannot load policy image: " << sErrorInfo << std::endl;
 		return -1;
 	}
-}
\ No newline at end of file
+	if (!policyImage.ToXml(sPolicyXml))
+	{
+		std::wcout << L"Policy image is corrupt: " << sImageFile << std::endl;
+		return -2;
+	}
+	return WriteOutput(sPolicyXml, sOutputFile);
+}
@@ -10,6 +10,7 @@
 #include "SysErrorMessage.h"
 #include "Wow64FsRedirection.h"
 #include "AppLockerXmlParser.h"
+#include "Stats.h"
 #include "AppLockerPolicy_CSP.h"
 #pragma comment(lib, "wbemuuid.lib")
 
@@ -131,6 +132,7 @@ bool AppLockerPolicy_CSP::GetPolicies(AppLockerPolicies_t& policies)
         return false;
 
     // Retrieve instances of each CSP/MDM AppLocker class in turn and retrieve policy info from them.
+    STATS_SCOPE("csp.getPolicies");
     GetPolicyProperties(szMdmClassExe, policies);
     GetPolicyProperties(szMdmClassDll, policies);
     GetPolicyProperties(szMdmClassMsi, policies);
@@ -196,6 +198,7 @@ bool AppLockerPolicy_CSP::SetPolicyFromString(const std::wstring& sPolicyXml, co
     }
 
     // Create an CSP/MDM AppLocker policy class instance for each rule collection.
+    STATS_SCOPE("csp.createInstances");
     bool retval = false;
     sErrorInfo.clear();
     std::wstringstream strError;
@@ -235,21 +238,14 @@ bool AppLockerPolicy_CSP::SetPolicyFromFile(const std::wstring& sXmlPolicyFile,
         return false;
     }
 
-    std::wifstream fs;
-    if (!Utf8FileUtility::OpenForReadingWithLocale(fs, sXmlPolicyFile.c_str()))
+    // Read the full content of the file into sPolicy
+    std::wstring sPolicy;
+    if (!Utf8FileUtility::ReadTextFile(sXmlPolicyFile.c_str(), sPolicy, sErrorInfo))
     {
-        sErrorInfo = L"Error - cannot open file ";
-        sErrorInfo += sXmlPolicyFile;
+        sErrorInfo = L"Error - " + sErrorInfo;
         return false;
     }
 
-    sErrorInfo.clear();
-
-    // Read the full content of the file into sPolicy
-    std::wstring sPolicy((std::istreambuf_iterator<wchar_t>(fs)), (std::istreambuf_iterator<wchar_t>()));
-    // Close the file
-    fs.close();
-
     // Set the policy from the retrieved data
     return SetPolicyFromString(sPolicy, sGroupName, sErrorInfo);
 }
@@ -275,6 +271,7 @@ bool AppLockerPolicy_CSP::DeleteAllPolicies(bool& bPoliciesDeleted, std::wstring
         return false;
 
     // Delete all instances of each CSP/MDM AppLocker class in turn.
+    STATS_SCOPE("csp.deleteInstances");
     std::wstringstream strErrorInfo;
     HRESULT hr1 = DeleteAllPolicyInstances(szMdmClassExe, bPoliciesDeleted, strErrorInfo);
     HRESULT hr2 = DeleteAllPolicyInstances(szMdmClassDll, bPoliciesDeleted, strErrorInfo);
@@ -335,6 +332,7 @@ void AppLockerPolicy_CSP::GetPolicyProperties(const wchar_t* szMdmClass, AppLock
     // WQL query to retrieve all instances of the input class
     std::wstring sQuery = std::wstring(L"SELECT * FROM ") + szMdmClass;
     IEnumWbemClassObject* pEnumerator = NULL;
+    STATS_ADD(WmiCalls, 1);
     HRESULT hr = m_pServices->ExecQuery(
         bstr_t(L"WQL"),
         bstr_t(sQuery.c_str()),
@@ -350,6 +348,7 @@ void AppLockerPolicy_CSP::GetPolicyProperties(const wchar_t* szMdmClass, AppLock
     // Retrieve and process class instances one at a time until no more to retrieve
     do {
         hr = pEnumerator->Next(WBEM_INFINITE, 1, &pClassObject, &uReturn);
+        STATS_ADD(WmiCalls, 1);
         if (uReturn > 0)
         {
             // Get the ParentId and Policy properties from this class instance.
@@ -360,10 +359,8 @@ void AppLockerPolicy_CSP::GetPolicyProperties(const wchar_t* szMdmClass, AppLock
             {
                 if (GetStringProperty(pClassObject, szPropPolicy, sPolicy))
                 {
-                    // Split the ParentId on '/' and get the substring following the last one - that's the policy name
-                    std::vector<std::wstring> sParentParts;
-                    SplitStringToVector(sParentId, L'/', sParentParts);
-                    sPolicyName = sParentParts[sParentParts.size() - 1];
+                    // The substring following the last '/' in the ParentId is the policy name
+                    sPolicyName = WStringSplitter(sParentId, L'/').Last();
                     // Does the collection already have anything under this policy name?
                     AppLockerPolicies_t::iterator pPolicy = policies.find(sPolicyName);
                     if (policies.end() == pPolicy)
@@ -407,6 +404,7 @@ HRESULT AppLockerPolicy_CSP::DeleteAllPolicyInstances(const wchar_t* szMdmClass,
     // WQL query to retrieve all instances of the input class
     std::wstring sQuery = std::wstring(L"SELECT * FROM ") + szMdmClass;
     IEnumWbemClassObject* pEnumerator = NULL;
+    STATS_ADD(WmiCalls, 1);
     HRESULT hr = m_pServices->ExecQuery(
         bstr_t(L"WQL"),
         bstr_t(sQuery.c_str()),
@@ -422,6 +420,7 @@ HRESULT AppLockerPolicy_CSP::DeleteAllPolicyInstances(const wchar_t* szMdmClass,
 
     do {
         hr = pEnumerator->Next(WBEM_INFINITE, 1, &pClassObject, &uReturn);
+        STATS_ADD(WmiCalls, 1);
         //strErrorInfo << L"pEnumerator->Next " << HEX(hr, 8, true, true) << L", uReturn " << uReturn << L"; ";
         if (uReturn > 0)
         {
@@ -439,6 +438,7 @@ HRESULT AppLockerPolicy_CSP::DeleteAllPolicyInstances(const wchar_t* szMdmClass,
             if (GetStringProperty(pClassObject, szPropSysPath, sInstancePath))
             {
                 _bstr_t bstrInstancePath(sInstancePath.c_str());
+                STATS_ADD(WmiCalls, 1);
                 hr = m_pServices->DeleteInstance(bstrInstancePath, 0, NULL, NULL);
                 // strErrorInfo << L"m_pServices->DeleteInstance " << HEX(hr, 8, true, true) << L": " << sInstancePath << std::endl;
                 if (SUCCEEDED(hr))
@@ -473,6 +473,7 @@ HRESULT AppLockerPolicy_CSP::CreatePolicyInstance(const wchar_t* szMdmClass, con
     IWbemClassObject* pClassDefinition = 0;
 
     // Retrieve the class definition.
+    STATS_ADD(WmiCalls, 1);
     HRESULT hr = m_pServices->GetObject(_bstr_t(szMdmClass), 0, NULL, &pClassDefinition, NULL);
     if (FAILED(hr))
     {
@@ -513,6 +514,7 @@ HRESULT AppLockerPolicy_CSP::CreatePolicyInstance(const wchar_t* szMdmClass, con
         // Other properties acquire the 'default' value specified
         // in the class definition unless otherwise modified here.
         // Write the instance to WMI. 
+        STATS_ADD(WmiCalls, 1);
         hr = m_pServices->PutInstance(pNewInstance, WBEM_FLAG_CREATE_OR_UPDATE, NULL, NULL);
         if (FAILED(hr))
         {
@@ -535,6 +537,7 @@ HRESULT AppLockerPolicy_CSP::CreatePolicyInstance(const wchar_t* szMdmClass, con
 /// <returns>true if successful, false otherwise.</returns>
 bool AppLockerPolicy_CSP::Initialize()
 {
+    STATS_SCOPE("csp.connect");
     bool retval = false;
     // Initialize COM. Doesn't matter whether apartment-threaded or multithreaded.
     m_hrInit = CoInitAnyThreaded();
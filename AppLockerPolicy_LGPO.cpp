@@ -9,6 +9,7 @@
 #include "SysErrorMessage.h"
 #include "Wow64FsRedirection.h"
 #include "LocalGPO.h"
+#include "Stats.h"
 #include "AppLockerXmlParser.h"
 #include "AppLockerPolicy_LGPO.h"
 
@@ -73,6 +74,7 @@ static bool GetPolicy(
         ;
 
     // Get rule collection information one rule collection at a time; streaming each into strPolicy.
+    STATS_SCOPE("lgpo.readPolicy");
     if (
         !IngestRuleCollection(hKey, szExe, strPolicy, sErrorInfo) ||
         !IngestRuleCollection(hKey, szDll, strPolicy, sErrorInfo) ||
@@ -156,7 +158,12 @@ bool AppLockerPolicy_LGPO::ClearPolicy(std::wstring& sErrorInfo)
     }
 
     // Delete the top key where AppLocker policy is placed into the registry and everything below it.
-    LSTATUS regStatus = RegDeleteTreeW(lgpo.ComputerKey(), sKeyPathBase.c_str());
+    LSTATUS regStatus;
+    {
+        STATS_SCOPE("lgpo.deleteTree");
+        STATS_ADD(RegistryWrites, 1);
+        regStatus = RegDeleteTreeW(lgpo.ComputerKey(), sKeyPathBase.c_str());
+    }
 
     // If registry key not found, there's no AppLocker policy in Local GPO. Still return success.
     if (ERROR_FILE_NOT_FOUND == regStatus)
@@ -220,6 +227,7 @@ bool AppLockerPolicy_LGPO::SetPolicyFromString(const std::wstring& sPolicyXml, s
     HKEY hKey = lgpo.ComputerKey();
 
     // Create policy for each rule collection in turn
+    STATS_SCOPE("lgpo.applyRuleCollections");
     if (
         !ApplyRuleCollection(hKey, szExe, sExePolicy, sErrorInfo) ||
         !ApplyRuleCollection(hKey, szDll, sDllPolicy, sErrorInfo) ||
@@ -249,21 +257,14 @@ bool AppLockerPolicy_LGPO::SetPolicyFromString(const std::wstring& sPolicyXml, s
 /// <returns>true if successful, false otherwise</returns>
 bool AppLockerPolicy_LGPO::SetPolicyFromFile(const std::wstring& sXmlPolicyFile, std::wstring& sErrorInfo)
 {
-    std::wifstream fs;
-    if (!Utf8FileUtility::OpenForReadingWithLocale(fs, sXmlPolicyFile.c_str()))
+    // Read the full content of the file into sPolicy
+    std::wstring sPolicy;
+    if (!Utf8FileUtility::ReadTextFile(sXmlPolicyFile.c_str(), sPolicy, sErrorInfo))
     {
-        sErrorInfo = L"Error - cannot open file ";
-        sErrorInfo += sXmlPolicyFile;
+        sErrorInfo = L"Error - " + sErrorInfo;
         return false;
     }
 
-    sErrorInfo.clear();
-
-    // Read the full content of the file into sPolicy
-    std::wstring sPolicy((std::istreambuf_iterator<wchar_t>(fs)), (std::istreambuf_iterator<wchar_t>()));
-    // Close the file
-    fs.close();
-
     // Set the policy from the retrieved data
     return SetPolicyFromString(sPolicy, sErrorInfo);
 }
@@ -293,6 +294,7 @@ static bool IngestRuleCollection(
     HKEY hSubkey = NULL;
     LSTATUS regStatus;
     regStatus = RegOpenKeyExW(hGpoKey, sKeyPath.c_str(), 0, KEY_READ, &hSubkey);
+    STATS_ADD(RegistryReads, 1);
     if (ERROR_SUCCESS == regStatus)
     {
         // Key exists for this rule collection, so start creating a RuleCollection element and child elements.
@@ -301,6 +303,7 @@ static bool IngestRuleCollection(
         // Absence of EnforcementMode value means "NotConfigured"; otherwise AuditOnly or Enabled. (Invalid value treated here as NotConfigured.)
         DWORD dwType = 0, dwEnforcementMode = 0, cbEnforcementMode = sizeof(dwEnforcementMode);
         regStatus = RegQueryValueExW(hSubkey, szEnforcementMode, 0, &dwType, (BYTE*)&dwEnforcementMode, &cbEnforcementMode);
+        STATS_ADD(RegistryReads, 1);
         const wchar_t* szMode = L"NotConfigured";
         if (ERROR_SUCCESS == regStatus)
         {
@@ -324,20 +327,24 @@ static bool IngestRuleCollection(
             wchar_t szGuidSubkeyName[64] = { 0 };
             DWORD cchGuidSubkeyName = sizeof(szGuidSubkeyName) / sizeof(szGuidSubkeyName[0]);
             regStatus = RegEnumKeyExW(hSubkey, dwIx++, szGuidSubkeyName, &cchGuidSubkeyName, NULL, NULL, NULL, NULL);
+            STATS_ADD(RegistryReads, 1);
             if (ERROR_SUCCESS == regStatus)
             {
                 // And open each of them...
                 HKEY hRuleKey = NULL;
                 regStatus = RegOpenKeyExW(hSubkey, szGuidSubkeyName, 0, KEY_READ, &hRuleKey);
+                STATS_ADD(RegistryReads, 1);
                 if (ERROR_SUCCESS == regStatus)
                 {
                     // And read the "Value" value, containing the XML for a specific rule.
                     DWORD cbData = 0;
                     regStatus = RegQueryValueExW(hRuleKey, szValue, NULL, &dwType, NULL, &cbData);
+                    STATS_ADD(RegistryReads, 1);
                     if ((ERROR_SUCCESS == regStatus || ERROR_MORE_DATA == regStatus) && cbData > 0 && REG_SZ == dwType)
                     {
                         byte* pBuffer = new byte[cbData];
                         regStatus = RegQueryValueExW(hRuleKey, szValue, NULL, &dwType, pBuffer, &cbData);
+                        STATS_ADD(RegistryReads, 1);
                         if (ERROR_SUCCESS == regStatus)
                         {
                             // And append it to the output stream
@@ -395,15 +402,18 @@ static bool ApplyRuleCollection(
     DWORD dwDisposition = 0;
     LSTATUS regStatus;
     regStatus = RegCreateKeyExW(hGpoKey, sKeyPath.c_str(), 0, NULL, 0, KEY_SET_VALUE, NULL, &hSubkey, &dwDisposition);
+    STATS_ADD(RegistryWrites, 1);
     if (ERROR_SUCCESS == regStatus)
     {
         // Write the EnforcementMode value into this key
         regStatus = RegSetValueExW(hSubkey, szEnforcementMode, 0, REG_DWORD, (const BYTE*)&dwEnforcementMode, sizeof(dwEnforcementMode));
+        STATS_ADD(RegistryWrites, 1);
         if (ERROR_SUCCESS == regStatus)
         {
             // Write the "AllowWindows" value into this key - set to 0
             DWORD zero = 0;
             regStatus = RegSetValueExW(hSubkey, szAllowWindows, 0, REG_DWORD, (const BYTE*)&zero, sizeof(zero));
+            STATS_ADD(RegistryWrites, 1);
             if (ERROR_SUCCESS == regStatus)
             {
                 // Go through each rule in the rule collection one by one...
@@ -416,11 +426,13 @@ static bool ApplyRuleCollection(
                     // Create the GUID subkey for this rule...
                     HKEY hRuleKey = NULL;
                     regStatus = RegCreateKeyExW(hSubkey, iterRules->sGuid.c_str(), 0, NULL, 0, KEY_SET_VALUE, NULL, &hRuleKey, &dwDisposition);
+                    STATS_ADD(RegistryWrites, 1);
                     if (ERROR_SUCCESS == regStatus)
                     {
                         // ... and create the "Value" value and set it to the rule's XML
                         DWORD cbRuleText = (DWORD)((iterRules->sXml.length() + 1) * sizeof(wchar_t));
                         regStatus = RegSetValueExW(hRuleKey, szValue, 0, REG_SZ, (const BYTE*)iterRules->sXml.c_str(), cbRuleText);
+                        STATS_ADD(RegistryWrites, 1);
                         RegCloseKey(hRuleKey);
                     }
                 }
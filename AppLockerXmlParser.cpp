@@ -1,3 +1,4 @@
+#include "Stats.h"
 #include "AppLockerXmlParser.h"
 
 /// L"AppLockerPolicy" - the root element of an AppLocker policy XML document 
@@ -17,6 +18,8 @@ const wchar_t* const AppLockerXmlParser::szPolicyRootTagname = L"AppLockerPolicy
 bool AppLockerXmlParser::ParseRuleCollections(const std::wstring& sPolicyXml, std::wstring& sExePolicy, std::wstring& sDllPolicy, std::wstring& sMsiPolicy, std::wstring& sScriptPolicy, std::wstring& sAppxPolicy)
 {
     // NOT a robust XML parse here; mostly assumes well-formed AppLocker policy XML.
+    STATS_SCOPE("parse.policy");
+    STATS_ADD(BytesParsed, sPolicyXml.length());
     sExePolicy.clear();
     sDllPolicy.clear();
     sMsiPolicy.clear();
@@ -78,6 +81,8 @@ bool AppLockerXmlParser::ParseRuleCollections(const std::wstring& sPolicyXml, st
                         else {
                             bParseOK = false;
                         }
+                        if (bParseOK)
+                            STATS_ADD(RuleCollections, 1);
                         // Move up to begin search for next rule collection.
                         ixRC += substrLen;
                     }
@@ -100,6 +105,7 @@ bool AppLockerXmlParser::ParseRuleCollections(const std::wstring& sPolicyXml, st
 bool AppLockerXmlParser::ParseRuleCollection(const std::wstring& sRuleCollectionXml, unsigned long& dwEnforcementMode, RuleInfoCollection_t& rules)
 {
     // Initialize output parameters
+    STATS_SCOPE("parse.ruleCollection");
     dwEnforcementMode = 0;
     rules.clear();
 
@@ -134,6 +140,7 @@ bool AppLockerXmlParser::ParseRuleCollection(const std::wstring& sRuleCollection
     if (!ParseRules(sRuleCollectionXml, L"FileHashRule", rules))
         return false;
 
+    STATS_ADD(Rules, rules.size());
     return true;
 }
 
@@ -2,101 +2,82 @@
 
 #include "HEX.h"
 #include "StringUtils.h"
-#include "DirWalker.h"
+#include "FileSystemUtils.h"
 #include "FileSystemUtils-Windows.h"
-#include "GetFilesAndSubdirectories.h"
 #include "SysErrorMessage.h"
 #include "WindowsDirectories.h"
 #include "Wow64FsRedirection.h"
+#include "Stats.h"
 #include "AppLocker_EmergencyClean.h"
 
 
-// Helper function that gets information about a file or directory and adds it to fileInfoCollection.
-static void AddFSObjectToCollection(const std::wstring& sObjName, bool bIsDirectory, FileInfoCollection_t& fileInfoCollection)
+std::wstring AppLocker_EmergencyClean::AppLockerCacheDirectory()
 {
-	FileInfo_t fileInfo;
-	fileInfo.bIsDirectory = bIsDirectory;
-	fileInfo.sFullPath = sObjName;
-
-	DWORD dwFlags = (bIsDirectory ? FILE_FLAG_BACKUP_SEMANTICS : 0);
-	Wow64FsRedirection wow64FSRedir(true);
-	HANDLE hFile = CreateFileW(sObjName.c_str(), 0, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, dwFlags, NULL);
-	wow64FSRedir.Revert();
-	if (INVALID_HANDLE_VALUE != hFile)
-	{
-		FILETIME ftCreateTime, ftLastAccessTime, ftLastWriteTime;
-		if (GetFileTime(hFile, &ftCreateTime, &ftLastAccessTime, &ftLastWriteTime))
-		{
-			fileInfo.sCreateTime = FileTimeToWString(ftCreateTime, false);
-			fileInfo.sLastWriteTime = FileTimeToWString(ftLastWriteTime, false);
-		}
-		if (!bIsDirectory)
-		{
-			GetFileSizeEx(hFile, &fileInfo.filesize);
-		}
-		CloseHandle(hFile);
-	}
-	fileInfoCollection.push_back(fileInfo);
-}
-
-// Populates a FileInfoCollection_t with information about all files/directories under a directory.
-static bool RecursiveFileList(const std::wstring& sDirectory, FileInfoCollection_t& fileInfoCollection)
-{
-	DirWalker dirWalker;
-	std::wstringstream strErrorInfo;
-	if (!dirWalker.Initialize(sDirectory.c_str(), strErrorInfo))
-		return false;
-
-	std::wstring sCurrDir;
-	while (dirWalker.GetCurrent(sCurrDir))
-	{
-		// Add the current directory to the collection
-		AddFSObjectToCollection(sCurrDir, true, fileInfoCollection);
-
-		// Add all the files in the current directory to the collection
-		std::vector<std::wstring> files, subdirectories;
-		if (GetFiles(sCurrDir, files, false))
-		{
-			for (
-				std::vector<std::wstring>::const_iterator iterFiles = files.begin();
-				iterFiles != files.end();
-				++iterFiles
-				)
-			{
-				AddFSObjectToCollection(*iterFiles, false, fileInfoCollection);
-			}
-		}
-
-		dirWalker.DoneWithCurrent();
-	}
-
-	return true;
+	return WindowsDirectories::System32Directory() + L"\\AppLocker";
 }
 
 /// <summary>
 /// Returns a listing of all files/directories under System32\AppLocker.
 /// </summary>
 /// <param name="fileInfoCollection">Output: the collection object to populate with file/directory information</param>
-/// <returns></returns>
-bool AppLocker_EmergencyClean::ListAppLockerBinaryFiles(FileInfoCollection_t& fileInfoCollection)
+/// <param name="strErrorInfo">Output: the directories that could not be enumerated</param>
+/// <returns>true if every directory was enumerated; false otherwise, in which case fileInfoCollection holds the entries that could be listed</returns>
+bool AppLocker_EmergencyClean::ListAppLockerBinaryFiles(FileInfoCollection_t& fileInfoCollection, std::wstringstream& strErrorInfo)
 {
 	fileInfoCollection.clear();
-	const std::wstring sRootDir = WindowsDirectories::System32Directory() + L"\\AppLocker";
-	return RecursiveFileList(sRootDir, fileInfoCollection);
+	return ListAppLockerBinaryFiles(
+		ListingFilter_t(),
+		false,
+		[&fileInfoCollection](const FileInfo_t& fileInfo) { fileInfoCollection.push_back(fileInfo); },
+		strErrorInfo);
+}
+
+bool AppLocker_EmergencyClean::ListAppLockerBinaryFiles(const ListingFilter_t& filter, bool bParallel, const FileInfoCallback_t& callback, std::wstringstream& strErrorInfo)
+{
+	return ListDirectoryHierarchy(AppLockerCacheDirectory(), filter, bParallel, callback, strErrorInfo);
+}
+
+bool AppLocker_EmergencyClean::DeleteAppLockerBinaryFiles(BulkDelete& bulkDelete)
+{
+	// To keep AppCache.dat, AppCache.dat.LOG1, AppCache.dat.LOG2, use the pattern-based overload instead.
+	// Deletes the directory's contents but not the directory itself.
+	return bulkDelete.DeleteContents(AppLockerCacheDirectory(), false);
 }
 
-bool AppLocker_EmergencyClean::DeleteAppLockerBinaryFiles()
+bool AppLocker_EmergencyClean::DeleteAppLockerBinaryFiles(const std::wstring& sPattern, const SnapshotEntryCollection_t& snapshotEntries, std::vector<std::wstring>& deletedFiles, std::wstringstream& strErrorInfo)
 {
-	//TODO: consider reimplementing and not deleting AppCache.dat, AppCache.dat.LOG1, AppCache.dat.LOG2. (Does this matter? Would this be better?)
-	SHFILEOPSTRUCTW fileop = { 0 };
-	// Ensure that the path is double-NUL-terminated
-	wchar_t szPathSpec[MAX_PATH] = { 0 };
-	const std::wstring sRootDir = WindowsDirectories::System32Directory() + L"\\AppLocker\\*";
-	wcscpy_s(szPathSpec, sRootDir.c_str());
-	fileop.pFrom = szPathSpec;
-	fileop.wFunc = FO_DELETE;
-	fileop.fFlags = FOF_NO_UI;
+	STATS_SCOPE("911.deleteMatching");
+	deletedFiles.clear();
+	const std::wstring sRootDir = AppLockerCacheDirectory();
+	bool retval = true;
 	Wow64FsRedirection wow64FSRedir(true);
-	int shfoRet = SHFileOperationW(&fileop);
-	return (0 == shfoRet && FALSE == fileop.fAnyOperationsAborted);
+	for (
+		SnapshotEntryCollection_t::const_iterator iterEntries = snapshotEntries.begin();
+		iterEntries != snapshotEntries.end();
+		++iterEntries
+		)
+	{
+		if (iterEntries->bIsDirectory)
+			continue;
+		if (!WildcardMatchCaseInsensitive(sPattern.c_str(), GetFileNameFromFilePath(iterEntries->sRelativePath).c_str()) &&
+			!WildcardMatchCaseInsensitive(sPattern.c_str(), iterEntries->sRelativePath.c_str()))
+			continue;
+
+		const std::wstring sFullPath = sRootDir + L"\\" + iterEntries->sRelativePath;
+		// Clear the read-only attribute, which would otherwise block deletion
+		if (0 != (iterEntries->dwAttributes & FILE_ATTRIBUTE_READONLY))
+			SetFileAttributesW(sFullPath.c_str(), iterEntries->dwAttributes & ~DWORD(FILE_ATTRIBUTE_READONLY));
+		if (DeleteFileW(sFullPath.c_str()))
+		{
+			deletedFiles.push_back(iterEntries->sRelativePath);
+			STATS_ADD(FilesDeleted, 1);
+		}
+		else
+		{
+			strErrorInfo << L"Cannot delete " << sFullPath << L": " << SysError::Last() << std::endl;
+			STATS_ADD(DeleteFailures, 1);
+			retval = false;
+		}
+	}
+	return retval;
 }
@@ -2,22 +2,11 @@
 
 #include <string>
 #include <vector>
-
-/// <summary>
-/// File information to report
-/// </summary>
-struct FileInfo_t
-{
-	std::wstring sFullPath, sLastWriteTime, sCreateTime;
-	LARGE_INTEGER filesize;
-	bool bIsDirectory;
-
-	FileInfo_t() : bIsDirectory(false)
-	{
-		filesize = { 0 };
-	}
-};
-typedef std::vector<FileInfo_t> FileInfoCollection_t;
+#include <cstdint>
+#include <sstream>
+#include "AppLockerCacheSnapshot.h"
+#include "BulkDelete.h"
+#include "DirectoryListing.h"
 
 
 // As a last resort, it might be necessary to clear the contents of the directory
@@ -38,17 +27,49 @@ typedef std::vector<FileInfo_t> FileInfoCollection_t;
 class AppLocker_EmergencyClean
 {
 public:
+	/// <summary>
+	/// Full path to the AppLocker policy cache directory; typically "C:\Windows\System32\AppLocker"
+	/// </summary>
+	static std::wstring AppLockerCacheDirectory();
+
 	/// <summary>
 	/// Returns a listing of all files/directories under System32\AppLocker.
 	/// </summary>
 	/// <param name="fileInfoCollection">Output: the collection object to populate with file/directory information</param>
-	/// <returns></returns>
-	static bool ListAppLockerBinaryFiles(FileInfoCollection_t& fileInfoCollection);
+	/// <param name="strErrorInfo">Output: the directories that could not be enumerated</param>
+	/// <returns>true if every directory was enumerated; false otherwise, in which case fileInfoCollection holds the entries that could be listed</returns>
+	static bool ListAppLockerBinaryFiles(FileInfoCollection_t& fileInfoCollection, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Reports files/directories under System32\AppLocker that match a filter, as each is enumerated,
+	/// without collecting a listing of the whole directory (see ListDirectoryHierarchy).
+	/// </summary>
+	/// <param name="filter">Input: criteria selecting the entries to report</param>
+	/// <param name="bParallel">Input: true to enumerate directories in parallel, reporting entries in no particular order</param>
+	/// <param name="callback">Input: function to invoke for each entry</param>
+	/// <param name="strErrorInfo">Output: error information</param>
+	/// <returns>true if every directory was enumerated, false otherwise</returns>
+	static bool ListAppLockerBinaryFiles(const ListingFilter_t& filter, bool bParallel, const FileInfoCallback_t& callback, std::wstringstream& strErrorInfo);
 
 	/// <summary>
 	/// Delete all files and directories under System32\AppLocker.
+	/// Per-file results, failures, and timings are available from bulkDelete afterwards.
 	/// </summary>
+	/// <param name="bulkDelete">Input/output: the delete engine to use (e.g., constructed with a NativeFileSystem)</param>
 	/// <returns>true if successful, false otherwise</returns>
-	static bool DeleteAppLockerBinaryFiles();
+	static bool DeleteAppLockerBinaryFiles(BulkDelete& bulkDelete);
+
+	/// <summary>
+	/// Delete selected files under System32\AppLocker: those captured in a snapshot whose names or
+	/// relative paths match a wildcard pattern (case-insensitive); e.g., "*.AppLocker" deletes the
+	/// rule collection caches but keeps AppCache.dat*. Only files in the snapshot are deleted, so
+	/// every deleted file can be restored from it. Directories are not deleted.
+	/// </summary>
+	/// <param name="sPattern">Input: wildcard pattern, matched against each file's name and its path relative to System32\AppLocker</param>
+	/// <param name="snapshotEntries">Input: entries of the snapshot taken just before deletion</param>
+	/// <param name="deletedFiles">Output: relative paths of the files deleted</param>
+	/// <param name="strErrorInfo">Output: information about files that could not be deleted</param>
+	/// <returns>true if all matching files were deleted, false otherwise</returns>
+	static bool DeleteAppLockerBinaryFiles(const std::wstring& sPattern, const SnapshotEntryCollection_t& snapshotEntries, std::vector<std::wstring>& deletedFiles, std::wstringstream& strErrorInfo);
 };
 
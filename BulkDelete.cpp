@@ -0,0 +1,175 @@
+// Parallel deletion of directory hierarchies
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <algorithm>
+#include "Stats.h"
+#include "BulkDelete.h"
+
+// Microseconds elapsed since a steady_clock time point
+static uint64_t MicrosecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+BulkDelete::BulkDelete(IFileSystem& fileSystem)
+	: m_fileSystem(fileSystem), m_nThreads(0),
+	m_nFilesDeleted(0), m_nDirsRemoved(0), m_nFailures(0),
+	m_nEnumMicroseconds(0), m_nFileMicroseconds(0), m_nDirMicroseconds(0)
+{
+}
+
+bool BulkDelete::DeleteContents(const std::wstring& sRootDirectory, bool bIncludeRoot /*= false*/)
+{
+	STATS_SCOPE("911.bulkDelete");
+	// Reset state, in case this class instance has been used before
+	m_results.clear();
+	m_enumFailures.clear();
+	m_paths.Clear();
+	m_nFilesDeleted = m_nDirsRemoved = m_nFailures = 0;
+	m_nEnumMicroseconds = m_nFileMicroseconds = m_nDirMicroseconds = 0;
+
+	// Attributes from enumeration, parallel to m_results
+	std::vector<uint32_t> attributes;
+
+	// A directory to remove, with its depth below the root
+	struct DirToRemove_t
+	{
+		PathStore::PathId_t pathId;
+		uint32_t dwAttributes;
+		size_t nDepth;
+	};
+	std::vector<DirToRemove_t> dirsToRemove;
+
+	// Phase 1: enumerate each directory once, breadth first.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::deque<DirToRemove_t> pendingDirs;
+	DirToRemove_t rootDir = { m_paths.AddRoot(sRootDirectory), 0, 0 };
+	pendingDirs.push_back(rootDir);
+	std::wstring sCurrDir;
+	while (!pendingDirs.empty())
+	{
+		const DirToRemove_t currDir = pendingDirs.front();
+		pendingDirs.pop_front();
+		m_paths.FullPath(currDir.pathId, sCurrDir);
+		DirEntryCollection_t files, subdirectories;
+		if (!m_fileSystem.Enumerate(sCurrDir, files, subdirectories))
+		{
+			m_enumFailures.push_back(sCurrDir);
+			continue;
+		}
+		for (DirEntryCollection_t::const_iterator iterFiles = files.begin(); iterFiles != files.end(); ++iterFiles)
+		{
+			DeleteResult_t result;
+			result.pathId = m_paths.Add(currDir.pathId, iterFiles->sName);
+			m_results.push_back(result);
+			attributes.push_back(iterFiles->dwAttributes);
+		}
+		for (DirEntryCollection_t::const_iterator iterSubdirs = subdirectories.begin(); iterSubdirs != subdirectories.end(); ++iterSubdirs)
+		{
+			DirToRemove_t subdir = { m_paths.Add(currDir.pathId, iterSubdirs->sName), iterSubdirs->dwAttributes, currDir.nDepth + 1 };
+			pendingDirs.push_back(subdir);
+			dirsToRemove.push_back(subdir);
+		}
+	}
+	m_nEnumMicroseconds = MicrosecondsSince(start);
+	// Nothing to do if the root directory itself couldn't be enumerated.
+	if (!m_enumFailures.empty() && m_enumFailures.front() == sRootDirectory)
+		return false;
+
+	// Phase 2: delete all the files.
+	start = std::chrono::steady_clock::now();
+	const size_t nFiles = m_results.size();
+	ParallelDelete(0, nFiles, attributes);
+	m_nFileMicroseconds = MicrosecondsSince(start);
+
+	// Phase 3: remove directories deepest first, one depth at a time, so that each directory's
+	// subdirectories are gone before it is removed. Breadth-first enumeration already lists
+	// directories in order of increasing depth, so reversing that order suffices.
+	start = std::chrono::steady_clock::now();
+	std::reverse(dirsToRemove.begin(), dirsToRemove.end());
+	if (bIncludeRoot)
+		dirsToRemove.push_back(rootDir);
+	for (std::vector<DirToRemove_t>::const_iterator iterDirs = dirsToRemove.begin(); iterDirs != dirsToRemove.end(); ++iterDirs)
+	{
+		DeleteResult_t result;
+		result.pathId = iterDirs->pathId;
+		result.bIsDirectory = true;
+		m_results.push_back(result);
+		attributes.push_back(iterDirs->dwAttributes);
+	}
+	size_t ixLevelBegin = nFiles;
+	while (ixLevelBegin < m_results.size())
+	{
+		const size_t nDepth = dirsToRemove[ixLevelBegin - nFiles].nDepth;
+		size_t ixLevelEnd = ixLevelBegin + 1;
+		while (ixLevelEnd < m_results.size() && dirsToRemove[ixLevelEnd - nFiles].nDepth == nDepth)
+			++ixLevelEnd;
+		ParallelDelete(ixLevelBegin, ixLevelEnd, attributes);
+		ixLevelBegin = ixLevelEnd;
+	}
+	m_nDirMicroseconds = MicrosecondsSince(start);
+
+	for (DeleteResultCollection_t::const_iterator iterResults = m_results.begin(); iterResults != m_results.end(); ++iterResults)
+	{
+		if (0 != iterResults->dwError)
+			++m_nFailures;
+		else if (iterResults->bIsDirectory)
+			++m_nDirsRemoved;
+		else
+			++m_nFilesDeleted;
+	}
+	STATS_ADD(FilesDeleted, m_nFilesDeleted);
+	STATS_ADD(DirsRemoved, m_nDirsRemoved);
+	STATS_ADD(DeleteFailures, m_nFailures);
+	return 0 == m_nFailures && m_enumFailures.empty();
+}
+
+void BulkDelete::ParallelDelete(size_t ixBegin, size_t ixEnd, const std::vector<uint32_t>& attributes)
+{
+	if (ixEnd <= ixBegin)
+		return;
+
+	// Workers take the next item by atomic increment; each writes only its own items' results.
+	// The path store is only read during this phase, so workers can build paths concurrently.
+	std::atomic<size_t> ixNext(ixBegin);
+	auto workerProc = [&]()
+	{
+		STATS_SCOPE("911.bulkDelete.worker");
+		std::wstring sPath;
+		size_t ix;
+		while ((ix = ixNext++) < ixEnd)
+		{
+			DeleteResult_t& result = m_results[ix];
+			m_paths.FullPath(result.pathId, sPath);
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			result.dwError = result.bIsDirectory ?
+				m_fileSystem.RemoveDirectoryObject(sPath, attributes[ix]) :
+				m_fileSystem.DeleteFileObject(sPath, attributes[ix]);
+			result.nMicroseconds = MicrosecondsSince(start);
+		}
+	};
+
+	size_t nThreads = m_nThreads;
+	if (0 == nThreads)
+	{
+		nThreads = std::thread::hardware_concurrency();
+		if (0 == nThreads)
+			nThreads = 1;
+	}
+	nThreads = std::min(nThreads, ixEnd - ixBegin);
+
+	// This thread is one of the workers.
+	std::vector<std::thread> threads;
+	for (size_t ixThread = 1; ixThread < nThreads; ++ixThread)
+	{
+		threads.push_back(std::thread(workerProc));
+	}
+	workerProc();
+	for (std::vector<std::thread>::iterator iterThreads = threads.begin(); iterThreads != threads.end(); ++iterThreads)
+	{
+		iterThreads->join();
+	}
+}
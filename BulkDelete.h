@@ -0,0 +1,164 @@
+// Parallel deletion of directory hierarchies
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "GetFilesAndSubdirectories.h"
+#include "PathStore.h"
+
+/// <summary>
+/// File system operations used by BulkDelete. NativeFileSystem implements them with direct
+/// platform calls; tests and tools can substitute another implementation.
+/// Implementations must be safe to call from multiple threads at once.
+/// Error codes are Win32 error codes on Windows and errno values elsewhere; 0 means success.
+/// </summary>
+class IFileSystem
+{
+public:
+	virtual ~IFileSystem() {}
+
+	/// <summary>
+	/// Enumerates a directory's files and subdirectories (see GetFilesAndSubdirectories). Everything that isn't
+	/// a subdirectory to descend into, including reparse points and offline files, must be reported as a file,
+	/// so that it is deleted rather than left behind.
+	/// </summary>
+	virtual bool Enumerate(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories) = 0;
+
+	/// <summary>
+	/// Deletes a file, or any other entry reported as a file by Enumerate. dwAttributes is the entry's attributes
+	/// from enumeration (e.g., to clear read-only first, or to remove a directory reparse point without following it).
+	/// </summary>
+	/// <returns>0 if successful, otherwise an error code</returns>
+	virtual uint32_t DeleteFileObject(const std::wstring& sFilePath, uint32_t dwAttributes) = 0;
+
+	/// <summary>
+	/// Removes an empty directory. dwAttributes is the directory's attributes from enumeration.
+	/// </summary>
+	/// <returns>0 if successful, otherwise an error code</returns>
+	virtual uint32_t RemoveDirectoryObject(const std::wstring& sDirectoryPath, uint32_t dwAttributes) = 0;
+};
+
+/// <summary>
+/// IFileSystem implementation with direct platform calls:
+/// FindFirstFileEx/DeleteFileW/RemoveDirectoryW on Windows, readdir/unlink/rmdir elsewhere.
+/// Read-only files and directories have the read-only attribute cleared before deletion.
+/// Reparse points (junctions, symbolic links) and offline files are deleted like files; links are
+/// removed, never followed.
+/// On Windows, WOW64 file system redirection is disabled for each call, because that setting
+/// applies only to the calling thread.
+/// </summary>
+class NativeFileSystem : public IFileSystem
+{
+public:
+	bool Enumerate(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories) override;
+	uint32_t DeleteFileObject(const std::wstring& sFilePath, uint32_t dwAttributes) override;
+	uint32_t RemoveDirectoryObject(const std::wstring& sDirectoryPath, uint32_t dwAttributes) override;
+};
+
+/// <summary>
+/// Outcome of deleting one file or removing one directory.
+/// The path is a node in the BulkDelete object's PathStore; see BulkDelete::ResultPath.
+/// </summary>
+struct DeleteResult_t
+{
+	PathStore::PathId_t pathId;
+	bool bIsDirectory;
+	// 0 on success; otherwise a Win32 error code (Windows) or errno value
+	uint32_t dwError;
+	// Time taken by the delete operation
+	uint64_t nMicroseconds;
+
+	DeleteResult_t() : pathId(PathStore::InvalidId), bIsDirectory(false), dwError(0), nMicroseconds(0) {}
+};
+typedef std::vector<DeleteResult_t> DeleteResultCollection_t;
+
+/// <summary>
+/// Deletes the contents of a directory hierarchy in three phases:
+/// 1. Enumerates each directory once, collecting all files and subdirectories.
+/// 2. Deletes all files, in parallel across worker threads.
+/// 3. Removes the subdirectories deepest first; directories at the same depth are removed in parallel.
+/// Every delete operation is timed, and failures are recorded per file or directory rather than
+/// ending the operation. A directory whose contents could not all be deleted fails to be removed
+/// (e.g., "directory not empty"), and that is recorded as well.
+/// Paths are held in a PathStore rather than as full-path strings, so memory use stays low for
+/// hierarchies with millions of files; a full path is built only when an operation needs it.
+///
+/// Usage:
+/// 	NativeFileSystem fileSystem;
+/// 	BulkDelete bulkDelete(fileSystem);
+/// 	if (!bulkDelete.DeleteContents(sDirectory))
+/// 	{
+/// 		for (const DeleteResult_t& result : bulkDelete.Results())
+/// 			if (0 != result.dwError) ... bulkDelete.ResultPath(result) ...
+/// 	}
+/// </summary>
+class BulkDelete
+{
+public:
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="fileSystem">Input: file system implementation; must outlive this object</param>
+	explicit BulkDelete(IFileSystem& fileSystem);
+	// Destructor
+	~BulkDelete() = default;
+
+	/// <summary>
+	/// Sets the number of worker threads. 0 (the default) means one per hardware thread.
+	/// </summary>
+	void SetConcurrency(size_t nThreads) { m_nThreads = nThreads; }
+
+	/// <summary>
+	/// Deletes everything under sRootDirectory, and sRootDirectory itself if bIncludeRoot is true.
+	/// </summary>
+	/// <param name="sRootDirectory">Input: directory whose contents are to be deleted</param>
+	/// <param name="bIncludeRoot">Input: true to remove sRootDirectory after its contents</param>
+	/// <returns>true if everything was enumerated and deleted; false if anything failed</returns>
+	bool DeleteContents(const std::wstring& sRootDirectory, bool bIncludeRoot = false);
+
+	/// <summary>
+	/// Results for each file and directory from the most recent DeleteContents: files first, then directories
+	/// in the order they were removed.
+	/// </summary>
+	const DeleteResultCollection_t& Results() const { return m_results; }
+
+	/// <summary>
+	/// Full path of the file or directory a result refers to.
+	/// </summary>
+	std::wstring ResultPath(const DeleteResult_t& result) const { return m_paths.FullPath(result.pathId); }
+
+	/// <summary>
+	/// Directories that could not be enumerated during the most recent DeleteContents.
+	/// </summary>
+	const std::vector<std::wstring>& EnumerationFailures() const { return m_enumFailures; }
+
+	/// <summary>
+	/// Counts and elapsed times for the phases of the most recent DeleteContents.
+	/// </summary>
+	size_t FilesDeleted() const { return m_nFilesDeleted; }
+	size_t DirectoriesRemoved() const { return m_nDirsRemoved; }
+	size_t Failures() const { return m_nFailures; }
+	uint64_t EnumerationMicroseconds() const { return m_nEnumMicroseconds; }
+	uint64_t FileDeletionMicroseconds() const { return m_nFileMicroseconds; }
+	uint64_t DirectoryRemovalMicroseconds() const { return m_nDirMicroseconds; }
+
+private:
+	// Performs the delete operations for results[ixBegin, ixEnd) across the worker threads.
+	void ParallelDelete(size_t ixBegin, size_t ixEnd, const std::vector<uint32_t>& attributes);
+
+private:
+	IFileSystem& m_fileSystem;
+	size_t m_nThreads;
+	PathStore m_paths;
+	DeleteResultCollection_t m_results;
+	std::vector<std::wstring> m_enumFailures;
+	size_t m_nFilesDeleted, m_nDirsRemoved, m_nFailures;
+	uint64_t m_nEnumMicroseconds, m_nFileMicroseconds, m_nDirMicroseconds;
+
+private:
+	// Not implemented
+	BulkDelete(const BulkDelete&) = delete;
+	BulkDelete& operator = (const BulkDelete&) = delete;
+};
@@ -1,6 +1,7 @@
 #include <Windows.h>
 #include <sddl.h>
 #include "MachineSid.h"
+#include "SidNameResolver.h"
 #include "CSid.h"
 
 
@@ -178,16 +179,12 @@ bool CSid::Lookup(std::wstring& sDomainName, std::wstring& sUserName) const
 	sUserName.clear();
 	if (m_pBuf)
 	{
-		const DWORD cchMaxName = 256;
-		WCHAR UserName[cchMaxName];
-		WCHAR DomainName[cchMaxName];
-		DWORD cchUserSize = cchMaxName;
-		DWORD cchDomainSize = cchMaxName;
-		SID_NAME_USE eNameUse;
-		if (LookupAccountSidW(NULL, psid(), UserName, &cchUserSize, DomainName, &cchDomainSize, &eNameUse))
+		// Resolve through the process-wide cache, which batches LSA lookups and remembers results.
+		SidName_t name;
+		if (SidNameResolver::Default().Lookup(toSidString(), name))
 		{
-			sDomainName = DomainName;
-			sUserName = UserName;
+			sDomainName = name.sDomainName;
+			sUserName = name.sUserName;
 			return true;
 		}
 	}
@@ -0,0 +1,75 @@
+// Unicode simple case folding and uppercasing, and case-insensitive hashing and comparison built on them
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/*
+Case-insensitive comparisons fold both strings to a common case, so that strings that differ only in
+case compare equal, without allocating upper-cased copies.
+
+Folding follows the Unicode simple case folding (CaseFolding.txt, statuses C and S): each code point maps
+to at most one code point, so folded strings keep their length. ASCII letters are folded 8 (or 4, where
+wchar_t is 32 bits) at a time with SSE2 instructions where available; other characters are looked up
+in a table of ranges. Where wchar_t is UTF-16, surrogate code units are left unchanged, so supplementary
+characters compare case-sensitively.
+
+Uppercasing is independent of the user's locale. On Windows it is Windows' own invariant uppercase mapping
+(LCMapStringEx with LOCALE_NAME_INVARIANT and LCMAP_UPPERCASE), read into a table of all UTF-16 code units
+on first use, so results match the paths and names Windows itself upper-cases. Windows' casing table
+predates current Unicode and maps fewer characters, so the Unicode 14.0 simple uppercase mapping
+(UnicodeData.txt) is used only where LCMapStringEx isn't available; it agrees on ASCII (and on U+0131,
+dotless i, which is not mapped to ASCII 'I') but also maps letters Windows leaves unchanged.
+tests/CaseMappingTests.cpp compares the two on Windows.
+*/
+
+/// <summary>
+/// Returns the simple case folding of a character.
+/// </summary>
+wchar_t FoldCaseChar(wchar_t ch);
+
+/// <summary>
+/// Writes the simple case folding of cch characters from pSrc to pDst. pSrc and pDst can be the same.
+/// </summary>
+void FoldCase(const wchar_t* pSrc, size_t cch, wchar_t* pDst);
+
+/// <summary>
+/// Returns the simple uppercase mapping of a character.
+/// </summary>
+wchar_t UpperCaseChar(wchar_t ch);
+
+/// <summary>
+/// Writes the simple uppercase mapping of cch characters from pSrc to pDst. pSrc and pDst can be the same.
+/// </summary>
+void UpperCase(const wchar_t* pSrc, size_t cch, wchar_t* pDst);
+
+/*
+CaseInsensitiveHash and CaseInsensitiveEqual compare by Unicode simple case folding, not by the Windows
+invariant uppercasing that WString_To_Upper (UpperCase) applies and that NTFS uses for names on disk.
+The two disagree on some characters: U+212A KELVIN SIGN folds to "k", so CaseInsensitiveEqual treats
+L"\x212A" and L"k" as equal, but Windows leaves U+212A unchanged when uppercasing, so NTFS treats them as
+different names. Lookups built on these functors, such as WindowsDirectories::IsDefaultRootDirName and the
+AppLockerPathVariables prefix matching, can therefore match a name that is a different file on disk.
+tests/CaseMappingTests.cpp pins the difference.
+*/
+
+/// <summary>
+/// Case-insensitive hash functor. Strings that CaseInsensitiveEqual considers equal hash the same.
+/// Transparent, so that it can hash std::wstring, std::wstring_view, and C strings without conversions.
+/// </summary>
+struct CaseInsensitiveHash
+{
+	typedef void is_transparent;
+	size_t operator()(std::wstring_view sv) const;
+};
+
+/// <summary>
+/// Case-insensitive equality functor, comparing the strings' simple case foldings. Transparent.
+/// </summary>
+struct CaseInsensitiveEqual
+{
+	typedef void is_transparent;
+	bool operator()(std::wstring_view sv1, std::wstring_view sv2) const;
+};
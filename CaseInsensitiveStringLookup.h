@@ -1,22 +1,44 @@
 #pragma once
 
 #include <unordered_set>
+#include <deque>
 #include <string>
-#include "StringUtils.h"
+#include <string_view>
+#include "CaseFolding.h"
 
 /// <summary>
 /// Fast case-insensitive hash-table lookup to determine whether a string is already in the set.
 /// Add strings to the set one by one, from a NULL-terminated array, or a counted array.
 /// Query the collection with "IsInSet".
+///
+/// Strings are compared by their Unicode simple case folding, which matches a few strings that NTFS,
+/// comparing uppercased names, considers different (see CaseFolding.h). Lookups don't allocate
+/// memory: the set holds views of the added strings, which the object owns, and hashes and compares
+/// views case-insensitively.
 /// </summary>
-class CaseInsensitiveStringLookup : public std::unordered_set<std::wstring>
+class CaseInsensitiveStringLookup
 {
 public:
-	// Default implementation of constructor, destructor, copy constructor, and assignment operator
+	// Default implementation of constructor and destructor
 	CaseInsensitiveStringLookup() = default;
 	~CaseInsensitiveStringLookup() = default;
-	CaseInsensitiveStringLookup(const CaseInsensitiveStringLookup&) = default;
-	CaseInsensitiveStringLookup& operator = (const CaseInsensitiveStringLookup&) = default;
+
+	// Copy constructor and assignment operator: the copy's set must refer to the copy's strings.
+	CaseInsensitiveStringLookup(const CaseInsensitiveStringLookup& other)
+	{
+		for (const std::wstring& sString : other.m_strings)
+			Add(sString);
+	}
+	CaseInsensitiveStringLookup& operator = (const CaseInsensitiveStringLookup& other)
+	{
+		if (this != &other)
+		{
+			clear();
+			for (const std::wstring& sString : other.m_strings)
+				Add(sString);
+		}
+		return *this;
+	}
 
 	/// <summary>
 	/// Initialize from an array of strings that ends with a NULL pointer
@@ -47,29 +69,35 @@ public:
 	/// Add a string if it's not already in the collection
 	/// </summary>
 	/// <param name="szString"></param>
-	/// <returns></returns>
+	/// <returns>true if the string was added; false if it was already in the collection</returns>
 	bool Add(const wchar_t* szString)
 	{
 		if (NULL == szString)
 			return false;
-		std::wstring sCandidate(szString);
-		WString_To_Upper(sCandidate);
-		if (0 == this->count(sCandidate))
-		{
-			this->insert(sCandidate);
-			return true;
-		}
-		return false;
+		return Add(std::wstring_view(szString));
+	}
+
+	/// <summary>
+	/// Add a string if it's not already in the collection
+	/// </summary>
+	/// <param name="sCandidate"></param>
+	/// <returns>true if the string was added; false if it was already in the collection</returns>
+	bool Add(std::wstring_view sCandidate)
+	{
+		if (0 != m_set.count(sCandidate))
+			return false;
+		// Elements of a deque don't move when more are added, so the views stay valid.
+		m_strings.emplace_back(sCandidate);
+		m_set.insert(std::wstring_view(m_strings.back()));
+		return true;
 	}
 
 	/// <summary>
 	/// Add a string if it's not already in the collection
 	/// </summary>
-	/// <param name="szString"></param>
-	/// <returns></returns>
 	bool Add(const std::wstring& sCandidate)
 	{
-		return Add(sCandidate.c_str());
+		return Add(std::wstring_view(sCandidate));
 	}
 
 	/// <summary>
@@ -81,19 +109,47 @@ public:
 	{
 		if (NULL == szString)
 			return false;
-		std::wstring sCandidate(szString);
-		WString_To_Upper(sCandidate);
-		return (0 != this->count(sCandidate));
+		return IsInSet(std::wstring_view(szString));
+	}
+
+	/// <summary>
+	/// Returns true if the string is in the collection
+	/// </summary>
+	bool IsInSet(std::wstring_view sString) const
+	{
+		return (0 != m_set.count(sString));
 	}
 
 	/// <summary>
 	/// Returns true if the string is in the collection
 	/// </summary>
-	/// <param name="szString"></param>
-	/// <returns></returns>
 	bool IsInSet(const std::wstring& sString) const
 	{
-		return IsInSet(sString.c_str());
+		return IsInSet(std::wstring_view(sString));
+	}
+
+	/// <summary>
+	/// Number of strings in the collection
+	/// </summary>
+	size_t size() const { return m_set.size(); }
+
+	/// <summary>
+	/// Returns true if the collection is empty
+	/// </summary>
+	bool empty() const { return m_set.empty(); }
+
+	/// <summary>
+	/// Removes all strings from the collection
+	/// </summary>
+	void clear()
+	{
+		m_set.clear();
+		m_strings.clear();
 	}
-};
 
+private:
+	// Views of the strings in m_strings
+	std::unordered_set<std::wstring_view, CaseInsensitiveHash, CaseInsensitiveEqual> m_set;
+	// The added strings, as first added
+	std::deque<std::wstring> m_strings;
+};
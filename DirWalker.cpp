@@ -4,6 +4,7 @@
 /// {
 /// 	DirWalker dirWalker;
 /// 	std::wstringstream strErrorInfo;
+/// 	bool bSucceeded = true;
 /// 	if (dirWalker.Initialize(szRootDir, strErrorInfo))
 /// 	{
 /// 		std::wstring sCurrDir;
@@ -12,22 +13,29 @@
 /// 			// Do things in sCurrDir - inspect files, etc.
 /// 			// ...
 /// 
-/// 			dirWalker.DoneWithCurrent();
+/// 			if (!dirWalker.DoneWithCurrent(true, strErrorInfo))
+/// 				bSucceeded = false;
 /// 		}
 /// 	}
 /// }
 
+#include <algorithm>
 #include "DirWalker.h"
 #include "GetFilesAndSubdirectories.h"
 #include "FileSystemUtils-Windows.h"
 #include "SysErrorMessage.h"
 #include "Wow64FsRedirection.h"
 
+// Minimum number of nodes in the path store before processed directories are released
+static const size_t nMinNodesToCompact = 4096;
+
 
 bool DirWalker::Initialize(const wchar_t* szRootDir, std::wstringstream& strErrorInfo)
 {
-	// Clear the deque, in case this class instance has been used before
+	// Clear the deque and the paths, in case this class instance has been used before
 	m_dirsToProcess.clear();
+	m_paths.Clear();
+	m_nCompactAt = nMinNodesToCompact;
 
 	// Ignore completely invalid input
 	if (NULL == szRootDir || 0 == szRootDir[0])
@@ -53,7 +61,10 @@ bool DirWalker::Initialize(const wchar_t* szRootDir, std::wstringstream& strErro
 	}
 
 	// Add starting directory to the collection of directories to process.
-	m_dirsToProcess.push_back(szRootDir);
+	const PathStore::PathId_t rootId = m_paths.AddRoot(szRootDir);
+	if (PathStore::InvalidId == rootId)
+		return FailWalk(szRootDir, strErrorInfo);
+	m_dirsToProcess.push_back(rootId);
 	return true;
 }
 
@@ -68,12 +79,17 @@ bool DirWalker::GetCurrent(std::wstring& sCurrDir) const
 	else
 	{
 		// Return the directory at the front of the queue
-		sCurrDir = m_dirsToProcess.front();
+		m_paths.FullPath(m_dirsToProcess.front(), sCurrDir);
 		return true;
 	}
 }
 
-void DirWalker::DoneWithCurrent(bool bGetSubdirectories /*= true*/)
+PathStore::PathId_t DirWalker::CurrentId() const
+{
+	return m_dirsToProcess.empty() ? PathStore::InvalidId : m_dirsToProcess.front();
+}
+
+bool DirWalker::DoneWithCurrent(bool bGetSubdirectories, std::wstringstream& strErrorInfo)
 {
 	// Nothing to do if the queue is empty
 	if (!m_dirsToProcess.empty())
@@ -82,14 +98,67 @@ void DirWalker::DoneWithCurrent(bool bGetSubdirectories /*= true*/)
 		if (bGetSubdirectories)
 		{
 			// Add all of the current directory's subdirectories to the queue
-			std::vector<std::wstring> vSubdirs;
-			GetSubdirectories(m_dirsToProcess.front(), vSubdirs);
+			std::vector<PathStore::PathId_t> vSubdirs;
+			if (!GetSubdirectories(m_paths, m_dirsToProcess.front(), vSubdirs) &&
+				std::find(vSubdirs.begin(), vSubdirs.end(), PathStore::InvalidId) != vSubdirs.end())
+			{
+				return FailWalk(m_paths.FullPath(m_dirsToProcess.front()), strErrorInfo);
+			}
 			m_dirsToProcess.insert(m_dirsToProcess.end(), vSubdirs.begin(), vSubdirs.end());
 		}
 
 		// Remove the item at the front of the queue.
-		m_dirsToProcess.pop_front();
+		PopCurrent();
 	}
+	return true;
+}
+
+bool DirWalker::DoneWithCurrent(const DirEntryCollection_t& subdirectories, std::wstringstream& strErrorInfo)
+{
+	// Nothing to do if the queue is empty
+	if (!m_dirsToProcess.empty())
+	{
+		// Add the caller-supplied subdirectories of the current directory to the queue, as children of the current directory
+		const PathStore::PathId_t currDirId = m_dirsToProcess.front();
+		for (
+			DirEntryCollection_t::const_iterator iterSubdirs = subdirectories.begin();
+			iterSubdirs != subdirectories.end();
+			++iterSubdirs
+			)
+		{
+			const PathStore::PathId_t subdirId = m_paths.Add(currDirId, iterSubdirs->sName);
+			if (PathStore::InvalidId == subdirId)
+				return FailWalk(m_paths.FullPath(currDirId) + L"\\" + iterSubdirs->sName, strErrorInfo);
+			m_dirsToProcess.push_back(subdirId);
+		}
+
+		// Remove the item at the front of the queue.
+		PopCurrent();
+	}
+	return true;
+}
+
+void DirWalker::PopCurrent()
+{
+	m_dirsToProcess.pop_front();
+
+	// The processed directories' nodes are needed only as ancestors of queued directories. Once the store
+	// holds twice as many nodes as the last compaction kept, release the rest, so the cost is amortized.
+	if (m_paths.Count() >= m_nCompactAt)
+	{
+		std::vector<PathStore::PathId_t> queuedIds(m_dirsToProcess.begin(), m_dirsToProcess.end());
+		m_paths.Compact(queuedIds);
+		m_dirsToProcess.assign(queuedIds.begin(), queuedIds.end());
+		m_nCompactAt = (std::max)(m_paths.Count() * 2, nMinNodesToCompact);
+	}
+}
+
+bool DirWalker::FailWalk(const std::wstring& sCurrDir, std::wstringstream& strErrorInfo)
+{
+	strErrorInfo << L"Cannot store the path of " << sCurrDir << L": too many directories" << std::endl;
+	m_dirsToProcess.clear();
+	m_paths.Clear();
+	return false;
 }
 
 bool DirWalker::Done() const
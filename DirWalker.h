@@ -4,14 +4,21 @@
 
 #include <deque>
 #include <sstream>
+#include "GetFilesAndSubdirectories.h"
+#include "PathStore.h"
 
 /// <summary>
 /// Class to process entire directory hierarchies without recursive calls that can lead to stack exhaustion.
+/// Directory paths are held in a PathStore (each directory as its parent's ID plus its name), so the queue
+/// of directories to process is a queue of IDs, and a full path is built only for the current directory.
+/// The paths of directories that have been processed are released as the walk proceeds, so memory use
+/// follows the number of directories still queued rather than the size of the whole hierarchy.
 /// Usage:
 /// void SampleFn(const wchar_t* szRootDir)
 /// {
 /// 	DirWalker dirWalker;
 /// 	std::wstringstream strErrorInfo;
+/// 	bool bSucceeded = true;
 /// 	if (dirWalker.Initialize(szRootDir, strErrorInfo))
 /// 	{
 /// 		std::wstring sCurrDir;
@@ -20,7 +27,9 @@
 /// 			// Do things in sCurrDir - inspect files, etc.
 /// 			// ...
 /// 
-/// 			dirWalker.DoneWithCurrent();
+/// 			// Ends the walk (and returns false) if a subdirectory's path can't be stored
+/// 			if (!dirWalker.DoneWithCurrent(true, strErrorInfo))
+/// 				bSucceeded = false;
 /// 		}
 /// 	}
 /// }
@@ -48,13 +57,38 @@ public:
 	/// <returns>true if directory name returned, false if no more to process</returns>
 	bool GetCurrent(std::wstring& sCurrDir) const;
 
+	/// <summary>
+	/// Returns the ID in Paths() of the current directory to process, or PathStore::InvalidId if no more to process.
+	/// The ID remains valid until the next call to DoneWithCurrent.
+	/// </summary>
+	PathStore::PathId_t CurrentId() const;
+
+	/// <summary>
+	/// The store holding the paths of the queued directories (and their ancestors).
+	/// DoneWithCurrent can release the nodes of processed directories and renumber the rest.
+	/// </summary>
+	const PathStore& Paths() const { return m_paths; }
+
 	/// <summary>
 	/// Call this method when done processing the current directory to remove the current
 	/// directory from the collection of directories to process and (optionally) to add the current
 	/// directory's subdirectories to the collection.
 	/// </summary>
 	/// <param name="bGetSubdirectories">Input: whether to add subdirectories of current directory to the collection to process</param>
-	void DoneWithCurrent(bool bGetSubdirectories = true);
+	/// <param name="strErrorInfo">Output: error info, if the subdirectories can't be queued</param>
+	/// <returns>false if the subdirectories can't be queued, in which case the walk ends (Done returns true)</returns>
+	bool DoneWithCurrent(bool bGetSubdirectories, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Alternative to DoneWithCurrent(bool) for callers that have already enumerated the current directory
+	/// with GetFilesAndSubdirectories: removes the current directory from the collection of directories to
+	/// process and adds the supplied subdirectories (names relative to the current directory) to the collection,
+	/// without enumerating the current directory a second time.
+	/// </summary>
+	/// <param name="subdirectories">Input: the current directory's subdirectories, as returned by GetFilesAndSubdirectories</param>
+	/// <param name="strErrorInfo">Output: error info, if the subdirectories can't be queued</param>
+	/// <returns>false if the subdirectories can't be queued, in which case the walk ends (Done returns true)</returns>
+	bool DoneWithCurrent(const DirEntryCollection_t& subdirectories, std::wstringstream& strErrorInfo);
 
 	/// <summary>
 	/// Indicates whether all directories in the hierarchy have been processed.
@@ -66,7 +100,16 @@ private:
 	// Collection of directories to process implemented as a queue in which items
 	// are processed from the front of the queue and then removed, while new items
 	// are added to the back of the queue.
-	std::deque<std::wstring> m_dirsToProcess;
+	std::deque<PathStore::PathId_t> m_dirsToProcess;
+	// Paths of the queued directories and their ancestors; may also hold processed directories not yet released
+	PathStore m_paths;
+	// Number of nodes in m_paths at which to release the nodes of processed directories
+	size_t m_nCompactAt = 0;
+
+	// Removes the current directory from the queue and releases processed directories' paths when enough accumulate
+	void PopCurrent();
+	// Ends the walk after a path can't be stored
+	bool FailWalk(const std::wstring& sCurrDir, std::wstringstream& strErrorInfo);
 
 private:
 	// Not implemented
@@ -0,0 +1,510 @@
+// Streaming listings of directory hierarchies: filtering, sorting, and text/CSV/JSON output
+
+#include <Windows.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <queue>
+#include "DirectoryListing.h"
+#include "DirWalker.h"
+#include "ParallelDirWalker.h"
+#include "FileSystemUtils.h"
+#include "FileSystemUtils-Windows.h"
+#include "GetFilesAndSubdirectories.h"
+#include "StringUtils.h"
+#include "SysErrorMessage.h"
+#include "Wow64FsRedirection.h"
+
+// ------------------------------------------------------------------------------------------
+// ListingFilter_t
+
+bool ListingFilter_t::IsEmpty() const
+{
+	return extensions.empty() && 0 == nMinSize && UINT64_MAX == nMaxSize && 0 == ftModifiedAfter && 0 == ftModifiedBefore;
+}
+
+bool ListingFilter_t::Matches(const FileInfo_t& fileInfo) const
+{
+	if (IsEmpty())
+		return true;
+	if (fileInfo.bIsDirectory)
+		return false;
+	if (fileInfo.filesize < nMinSize || fileInfo.filesize > nMaxSize)
+		return false;
+	if (0 != ftModifiedAfter && fileInfo.ftLastWriteTime < ftModifiedAfter)
+		return false;
+	if (0 != ftModifiedBefore && fileInfo.ftLastWriteTime >= ftModifiedBefore)
+		return false;
+	if (!extensions.empty())
+	{
+		// Extension of the file name, not of a parent directory name
+		const size_t ixLastPathSep = fileInfo.sFullPath.find_last_of(L"/\\");
+		const size_t ixDot = fileInfo.sFullPath.find_last_of(L'.');
+		if (std::wstring::npos == ixDot || (std::wstring::npos != ixLastPathSep && ixDot < ixLastPathSep))
+			return false;
+		const wchar_t* szExtension = fileInfo.sFullPath.c_str() + ixDot;
+		bool bMatch = false;
+		for (std::vector<std::wstring>::const_iterator iterExt = extensions.begin(); !bMatch && iterExt != extensions.end(); ++iterExt)
+		{
+			bMatch = (0 == _wcsicmp(szExtension, iterExt->c_str()));
+		}
+		if (!bMatch)
+			return false;
+	}
+	return true;
+}
+
+void ListingFilter_t::SetExtensions(const std::wstring& sExtensionList)
+{
+	extensions.clear();
+	std::wstring sList = sExtensionList;
+	std::replace(sList.begin(), sList.end(), L';', L',');
+	std::vector<std::wstring> items;
+	SplitStringToVector(sList, L',', items);
+	for (std::vector<std::wstring>::const_iterator iterItems = items.begin(); iterItems != items.end(); ++iterItems)
+	{
+		if (iterItems->empty())
+			continue;
+		if (L'.' == (*iterItems)[0])
+			extensions.push_back(*iterItems);
+		else
+			extensions.push_back(L"." + *iterItems);
+	}
+}
+
+// ------------------------------------------------------------------------------------------
+// ListDirectoryHierarchy
+
+// Gets information about a directory by path. Used for the directories the walker visits, which are
+// reported when they are processed rather than when their parent is enumerated.
+// GetFileAttributesEx returns attributes, size and times without opening a handle.
+static void GetDirectoryInfo(const std::wstring& sDirectory, FileInfo_t& fileInfo)
+{
+	fileInfo = FileInfo_t();
+	fileInfo.sFullPath = sDirectory;
+	fileInfo.bIsDirectory = true;
+	WIN32_FILE_ATTRIBUTE_DATA attrData = { 0 };
+	DWORD dwLastErr;
+	std::wstring sAltName;
+	Wow64FsRedirection wow64FSRedir(true);
+	if (GetFileAttributesEx_ExtendedPath(sDirectory.c_str(), attrData, dwLastErr, sAltName))
+	{
+		fileInfo.ftCreateTime = (uint64_t(attrData.ftCreationTime.dwHighDateTime) << 32) | uint64_t(attrData.ftCreationTime.dwLowDateTime);
+		fileInfo.ftLastWriteTime = (uint64_t(attrData.ftLastWriteTime.dwHighDateTime) << 32) | uint64_t(attrData.ftLastWriteTime.dwLowDateTime);
+	}
+	wow64FSRedir.Revert();
+}
+
+// Reports a directory (if bListDirectories) and then its files that match the filter.
+// Each file is reported from the enumeration data; no handle is opened to it.
+static void ReportDirectory(const std::wstring& sDirectory, const DirEntryCollection_t& files, bool bListDirectories, const ListingFilter_t& filter, const FileInfoCallback_t& callback, FileInfo_t& fileInfo)
+{
+	if (bListDirectories)
+	{
+		GetDirectoryInfo(sDirectory, fileInfo);
+		callback(fileInfo);
+	}
+	for (DirEntryCollection_t::const_iterator iterFiles = files.begin(); iterFiles != files.end(); ++iterFiles)
+	{
+		fileInfo.sFullPath = sDirectory + L"\\" + iterFiles->sName;
+		fileInfo.bIsDirectory = false;
+		fileInfo.filesize = iterFiles->filesize;
+		fileInfo.ftCreateTime = iterFiles->ftCreateTime;
+		fileInfo.ftLastWriteTime = iterFiles->ftLastWriteTime;
+		if (filter.Matches(fileInfo))
+			callback(fileInfo);
+	}
+}
+
+bool ListDirectoryHierarchy(const std::wstring& sRootDirectory, const ListingFilter_t& filter, bool bParallel, const FileInfoCallback_t& callback, std::wstringstream& strErrorInfo)
+{
+	// Directories are never selected by a non-empty filter, so don't bother inspecting them.
+	const bool bListDirectories = filter.IsEmpty();
+	FileInfo_t fileInfo;
+
+	if (bParallel)
+	{
+		// ParallelDirWalker serializes the callbacks, so fileInfo can be shared.
+		ParallelDirWalker dirWalker;
+		const bool bRootOK = dirWalker.Walk(
+			sRootDirectory.c_str(),
+			[&](const std::wstring& sDirectory, size_t, const DirEntryCollection_t& files, const DirEntryCollection_t&)
+			{
+				ReportDirectory(sDirectory, files, bListDirectories, filter, callback, fileInfo);
+			},
+			strErrorInfo);
+		return bRootOK && 0 == dirWalker.EnumerationFailures();
+	}
+
+	DirWalker dirWalker;
+	if (!dirWalker.Initialize(sRootDirectory.c_str(), strErrorInfo))
+		return false;
+
+	bool retval = true;
+	std::wstring sCurrDir;
+	while (dirWalker.GetCurrent(sCurrDir))
+	{
+		// Enumerate the current directory once, getting both its files and its subdirectories.
+		DirEntryCollection_t files, subdirectories;
+		if (!GetFilesAndSubdirectories(sCurrDir, files, subdirectories))
+		{
+			strErrorInfo << L"Cannot enumerate " << sCurrDir << std::endl;
+			retval = false;
+		}
+		ReportDirectory(sCurrDir, files, bListDirectories, filter, callback, fileInfo);
+
+		// Pass the subdirectories to the walker so it doesn't enumerate the directory again.
+		if (!dirWalker.DoneWithCurrent(subdirectories, strErrorInfo))
+			retval = false;
+	}
+
+	return retval;
+}
+
+// ------------------------------------------------------------------------------------------
+// ListingWriter
+
+ListingWriter::ListingWriter(Format_t format, std::wostream& os)
+	: m_format(format), m_os(os), m_nEntries(0)
+{
+}
+
+bool ListingWriter::FormatFromName(const std::wstring& sName, Format_t& format)
+{
+	if (EqualCaseInsensitive(sName, L"text"))
+		format = Text;
+	else if (EqualCaseInsensitive(sName, L"csv"))
+		format = Csv;
+	else if (EqualCaseInsensitive(sName, L"json"))
+		format = Json;
+	else
+		return false;
+	return true;
+}
+
+void ListingWriter::Begin()
+{
+	m_nEntries = 0;
+	switch (m_format)
+	{
+	case Text:
+		/*
+File creation time   File last written    Filesize  File path
+2021-01-07 06:08:20  2021-01-07 06:08:20      8192
+		*/
+		m_os << L"File creation time   File last written    Filesize  File path" << L"\n";
+		break;
+	case Csv:
+		m_os << L"Type,Path,Size,Created,LastWritten" << L"\n";
+		break;
+	case Json:
+		m_os << L"[";
+		break;
+	}
+}
+
+void ListingWriter::Write(const FileInfo_t& fileInfo)
+{
+	// Timestamps are formatted into fixed-size buffers; entries end with "\n" rather than std::endl,
+	// so the stream is not flushed after every entry.
+	wchar_t szCreateTime[cchTimestampBuffer], szLastWriteTime[cchTimestampBuffer];
+	const bool bIncludeMilliseconds = (Text != m_format);
+	FileTimeToWChars(fileInfo.ftCreateTime, bIncludeMilliseconds, szCreateTime);
+	FileTimeToWChars(fileInfo.ftLastWriteTime, bIncludeMilliseconds, szLastWriteTime);
+
+	switch (m_format)
+	{
+	case Text:
+		if (!fileInfo.bIsDirectory)
+			m_os << szCreateTime << L"  " << szLastWriteTime << L"  " << std::setw(8) << fileInfo.filesize << L"  " << fileInfo.sFullPath << L"\n";
+		else
+			m_os << szCreateTime << L"  " << szLastWriteTime << L"  " << std::setw(8) << L"" << L"  " << fileInfo.sFullPath << L"\n";
+		break;
+
+	case Csv:
+		m_os << (fileInfo.bIsDirectory ? L"Directory," : L"File,");
+		WriteCsvField(fileInfo.sFullPath);
+		m_os << L",";
+		if (!fileInfo.bIsDirectory)
+			m_os << std::to_wstring(fileInfo.filesize);
+		m_os << L"," << szCreateTime << L"," << szLastWriteTime << L"\n";
+		break;
+
+	case Json:
+		m_os << (0 == m_nEntries ? L"\n" : L",\n")
+			<< L"  {\"type\":" << (fileInfo.bIsDirectory ? L"\"directory\"" : L"\"file\"")
+			<< L",\"path\":";
+		WriteJsonString(fileInfo.sFullPath);
+		m_os << L",\"size\":";
+		if (fileInfo.bIsDirectory)
+			m_os << L"null";
+		else
+			m_os << std::to_wstring(fileInfo.filesize);
+		m_os << L",\"created\":\"" << szCreateTime << L"\",\"lastWritten\":\"" << szLastWriteTime << L"\"}";
+		break;
+	}
+	++m_nEntries;
+}
+
+void ListingWriter::End()
+{
+	if (Json == m_format)
+		m_os << (0 == m_nEntries ? L"]" : L"\n]") << L"\n";
+	m_os.flush();
+}
+
+void ListingWriter::WriteCsvField(const std::wstring& str)
+{
+	if (std::wstring::npos == str.find_first_of(L",\"\r\n"))
+	{
+		m_os << str;
+		return;
+	}
+	// Quote the field and double any embedded quotes
+	m_os << L"\"" << replaceStringAll(str, L"\"", L"\"\"") << L"\"";
+}
+
+void ListingWriter::WriteJsonString(const std::wstring& str)
+{
+	static const wchar_t szHexDigits[] = L"0123456789abcdef";
+	m_os << L"\"";
+	// Write runs of characters that need no escaping in one operation
+	size_t ixRunStart = 0;
+	for (size_t ix = 0; ix < str.length(); ++ix)
+	{
+		const wchar_t c = str[ix];
+		if (c >= 0x20 && c != L'\"' && c != L'\\')
+			continue;
+		m_os.write(str.c_str() + ixRunStart, std::streamsize(ix - ixRunStart));
+		ixRunStart = ix + 1;
+		switch (c)
+		{
+		case L'\"': m_os << L"\\\""; break;
+		case L'\\': m_os << L"\\\\"; break;
+		case L'\n': m_os << L"\\n"; break;
+		case L'\r': m_os << L"\\r"; break;
+		case L'\t': m_os << L"\\t"; break;
+		default:
+			{
+				const wchar_t szEscape[] = { L'\\', L'u', L'0', L'0', szHexDigits[(c >> 4) & 0xF], szHexDigits[c & 0xF], L'\0' };
+				m_os << szEscape;
+			}
+			break;
+		}
+	}
+	m_os.write(str.c_str() + ixRunStart, std::streamsize(str.length() - ixRunStart));
+	m_os << L"\"";
+}
+
+// ------------------------------------------------------------------------------------------
+// ListingSorter
+
+// Run file record: last-write time, creation time, size (each 64 bits), directory flag (8 bits),
+// path length in characters (32 bits), then the path's characters. Run files are read back only by
+// the process that wrote them, so native byte order and wchar_t size are fine.
+
+static void WriteRunRecord(std::ofstream& fs, const FileInfo_t& fileInfo)
+{
+	const uint8_t bIsDirectory = fileInfo.bIsDirectory ? 1 : 0;
+	const uint32_t cchPath = uint32_t(fileInfo.sFullPath.length());
+	fs.write(reinterpret_cast<const char*>(&fileInfo.ftLastWriteTime), sizeof(fileInfo.ftLastWriteTime));
+	fs.write(reinterpret_cast<const char*>(&fileInfo.ftCreateTime), sizeof(fileInfo.ftCreateTime));
+	fs.write(reinterpret_cast<const char*>(&fileInfo.filesize), sizeof(fileInfo.filesize));
+	fs.write(reinterpret_cast<const char*>(&bIsDirectory), sizeof(bIsDirectory));
+	fs.write(reinterpret_cast<const char*>(&cchPath), sizeof(cchPath));
+	fs.write(reinterpret_cast<const char*>(fileInfo.sFullPath.c_str()), std::streamsize(cchPath * sizeof(wchar_t)));
+}
+
+// Longest path a run record can hold; Windows paths, even in extended form, are limited to 32,767 characters.
+static const uint32_t cchMaxRunRecordPath = 32768;
+
+enum RunRecordResult_t { RunRecord_OK, RunRecord_EndOfRun, RunRecord_Invalid };
+
+// Reads the next record. End of run is only at a record boundary; a partial or implausible record is invalid.
+static RunRecordResult_t ReadRunRecord(std::ifstream& fs, FileInfo_t& fileInfo)
+{
+	if (std::ifstream::traits_type::eof() == fs.peek())
+		return fs.eof() ? RunRecord_EndOfRun : RunRecord_Invalid;
+	uint8_t bIsDirectory = 0;
+	uint32_t cchPath = 0;
+	fs.read(reinterpret_cast<char*>(&fileInfo.ftLastWriteTime), sizeof(fileInfo.ftLastWriteTime));
+	fs.read(reinterpret_cast<char*>(&fileInfo.ftCreateTime), sizeof(fileInfo.ftCreateTime));
+	fs.read(reinterpret_cast<char*>(&fileInfo.filesize), sizeof(fileInfo.filesize));
+	fs.read(reinterpret_cast<char*>(&bIsDirectory), sizeof(bIsDirectory));
+	fs.read(reinterpret_cast<char*>(&cchPath), sizeof(cchPath));
+	if (!fs || bIsDirectory > 1 || cchPath > cchMaxRunRecordPath)
+		return RunRecord_Invalid;
+	fileInfo.bIsDirectory = (0 != bIsDirectory);
+	fileInfo.sFullPath.resize(cchPath);
+	if (cchPath > 0)
+		fs.read(reinterpret_cast<char*>(&fileInfo.sFullPath[0]), std::streamsize(cchPath * sizeof(wchar_t)));
+	return fs ? RunRecord_OK : RunRecord_Invalid;
+}
+
+ListingSorter::ListingSorter(SortKey_t sortKey, size_t nMaxEntriesInMemory /*= 65536*/)
+	: m_sortKey(sortKey), m_nMaxEntriesInMemory(std::max(nMaxEntriesInMemory, size_t(1)))
+{
+}
+
+ListingSorter::~ListingSorter()
+{
+	DeleteRuns();
+}
+
+bool ListingSorter::SortKeyFromName(const std::wstring& sName, SortKey_t& sortKey)
+{
+	if (EqualCaseInsensitive(sName, L"path"))
+		sortKey = Path;
+	else if (EqualCaseInsensitive(sName, L"size"))
+		sortKey = Size;
+	else if (EqualCaseInsensitive(sName, L"time"))
+		sortKey = LastWriteTime;
+	else
+		return false;
+	return true;
+}
+
+bool ListingSorter::Less(const FileInfo_t& a, const FileInfo_t& b) const
+{
+	switch (m_sortKey)
+	{
+	case Size:
+		if (a.filesize != b.filesize)
+			return a.filesize < b.filesize;
+		break;
+	case LastWriteTime:
+		if (a.ftLastWriteTime != b.ftLastWriteTime)
+			return a.ftLastWriteTime < b.ftLastWriteTime;
+		break;
+	case Path:
+		break;
+	}
+	return _wcsicmp(a.sFullPath.c_str(), b.sFullPath.c_str()) < 0;
+}
+
+bool ListingSorter::Add(const FileInfo_t& fileInfo, std::wstringstream& strErrorInfo)
+{
+	m_entries.push_back(fileInfo);
+	if (m_entries.size() < m_nMaxEntriesInMemory)
+		return true;
+	return WriteRun(strErrorInfo);
+}
+
+bool ListingSorter::WriteRun(std::wstringstream& strErrorInfo)
+{
+	wchar_t szTempDir[MAX_PATH + 1] = { 0 }, szTempFile[MAX_PATH + 1] = { 0 };
+	if (0 == GetTempPathW(MAX_PATH + 1, szTempDir) || 0 == GetTempFileNameW(szTempDir, L"lst", 0, szTempFile))
+	{
+		strErrorInfo << L"Cannot create temporary file for sorting: " << SysErrorMessage() << std::endl;
+		return false;
+	}
+	// GetTempFileName created the file; record it so it is deleted even if writing fails.
+	m_runFiles.push_back(szTempFile);
+	m_runEntryCounts.push_back(m_entries.size());
+
+	std::sort(m_entries.begin(), m_entries.end(), [this](const FileInfo_t& a, const FileInfo_t& b) { return Less(a, b); });
+	std::ofstream fs(szTempFile, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	for (FileInfoCollection_t::const_iterator iterEntries = m_entries.begin(); fs && iterEntries != m_entries.end(); ++iterEntries)
+	{
+		WriteRunRecord(fs, *iterEntries);
+	}
+	fs.close();
+	if (fs.fail())
+	{
+		strErrorInfo << L"Cannot write temporary file " << szTempFile << std::endl;
+		return false;
+	}
+	m_entries.clear();
+	return true;
+}
+
+bool ListingSorter::Finish(ListingWriter& writer, std::wstringstream& strErrorInfo)
+{
+	const auto less = [this](const FileInfo_t& a, const FileInfo_t& b) { return Less(a, b); };
+
+	// Everything fit in memory
+	if (m_runFiles.empty())
+	{
+		std::sort(m_entries.begin(), m_entries.end(), less);
+		for (FileInfoCollection_t::const_iterator iterEntries = m_entries.begin(); iterEntries != m_entries.end(); ++iterEntries)
+		{
+			writer.Write(*iterEntries);
+		}
+		m_entries.clear();
+		return true;
+	}
+
+	// Write out the remaining entries, then merge all the runs. With the default run size, even a
+	// hierarchy of millions of files needs only a few dozen runs, so a single merge pass suffices.
+	if (!m_entries.empty() && !WriteRun(strErrorInfo))
+	{
+		DeleteRuns();
+		return false;
+	}
+	const size_t nRuns = m_runFiles.size();
+	std::vector<std::ifstream> runs(nRuns);
+	FileInfoCollection_t heads(nRuns);
+	bool retval = true;
+	// Entries read from each run, checked against the number written when the run ends
+	std::vector<size_t> entriesRead(nRuns, 0);
+	// Reads a run's next entry into heads; false at the end of the run or on error (retval then false).
+	const auto readNext = [&](size_t ixRun) -> bool
+	{
+		switch (ReadRunRecord(runs[ixRun], heads[ixRun]))
+		{
+		case RunRecord_OK:
+			++entriesRead[ixRun];
+			return true;
+		case RunRecord_EndOfRun:
+			if (entriesRead[ixRun] == m_runEntryCounts[ixRun])
+				return false;
+			break;
+		case RunRecord_Invalid:
+			break;
+		}
+		strErrorInfo << L"Temporary file " << m_runFiles[ixRun] << L" is truncated or damaged after "
+			<< entriesRead[ixRun] << L" of " << m_runEntryCounts[ixRun] << L" entries" << std::endl;
+		retval = false;
+		return false;
+	};
+	// Min-heap of run indices, ordered by each run's current (head) entry
+	const auto greater = [&](size_t ixA, size_t ixB) { return less(heads[ixB], heads[ixA]); };
+	std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+	for (size_t ixRun = 0; ixRun < nRuns; ++ixRun)
+	{
+		runs[ixRun].open(m_runFiles[ixRun].c_str(), std::ios_base::in | std::ios_base::binary);
+		if (runs[ixRun].fail())
+		{
+			strErrorInfo << L"Cannot open temporary file " << m_runFiles[ixRun] << std::endl;
+			retval = false;
+		}
+		else if (readNext(ixRun))
+		{
+			heap.push(ixRun);
+		}
+	}
+	while (retval && !heap.empty())
+	{
+		const size_t ixRun = heap.top();
+		heap.pop();
+		writer.Write(heads[ixRun]);
+		if (readNext(ixRun))
+			heap.push(ixRun);
+	}
+	for (size_t ixRun = 0; ixRun < nRuns; ++ixRun)
+	{
+		runs[ixRun].close();
+	}
+	DeleteRuns();
+	return retval;
+}
+
+void ListingSorter::DeleteRuns()
+{
+	for (std::vector<std::wstring>::const_iterator iterRuns = m_runFiles.begin(); iterRuns != m_runFiles.end(); ++iterRuns)
+	{
+		DeleteFileW(iterRuns->c_str());
+	}
+	m_runFiles.clear();
+	m_runEntryCounts.clear();
+}
@@ -0,0 +1,219 @@
+// Streaming listings of directory hierarchies: filtering, sorting, and text/CSV/JSON output
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sstream>
+#include <functional>
+
+/// <summary>
+/// File information to report.
+/// Timestamps are raw 64-bit FILETIME values, formatted only for output (e.g., with FileTimeToWChars).
+/// </summary>
+struct FileInfo_t
+{
+	std::wstring sFullPath;
+	uint64_t ftLastWriteTime, ftCreateTime;
+	uint64_t filesize;
+	bool bIsDirectory;
+
+	FileInfo_t() : ftLastWriteTime(0), ftCreateTime(0), filesize(0), bIsDirectory(false)
+	{
+	}
+};
+typedef std::vector<FileInfo_t> FileInfoCollection_t;
+
+/// <summary>
+/// Callback invoked for each file or directory as it is enumerated.
+/// </summary>
+typedef std::function<void(const FileInfo_t& fileInfo)> FileInfoCallback_t;
+
+/// <summary>
+/// Criteria selecting the entries to list, applied as each entry is enumerated.
+/// When any criterion is set, only files are listed; directories are not.
+/// </summary>
+struct ListingFilter_t
+{
+	// File name extensions including the dot (e.g., ".AppLocker"), case-insensitive; empty = any extension
+	std::vector<std::wstring> extensions;
+	// Inclusive file size limits
+	uint64_t nMinSize, nMaxSize;
+	// Last-write time limits as FILETIME values: listed if ftModifiedAfter <= time < ftModifiedBefore; 0 = no limit
+	uint64_t ftModifiedAfter, ftModifiedBefore;
+
+	ListingFilter_t() : nMinSize(0), nMaxSize(UINT64_MAX), ftModifiedAfter(0), ftModifiedBefore(0) {}
+
+	/// <summary>
+	/// Returns true if no criteria are set.
+	/// </summary>
+	bool IsEmpty() const;
+
+	/// <summary>
+	/// Returns true if the entry meets all the criteria.
+	/// </summary>
+	bool Matches(const FileInfo_t& fileInfo) const;
+
+	/// <summary>
+	/// Sets the extensions from a comma- or semicolon-separated list (e.g., "AppLocker,.dat").
+	/// A leading dot is added to each extension that doesn't have one.
+	/// </summary>
+	void SetExtensions(const std::wstring& sExtensionList);
+};
+
+/// <summary>
+/// Enumerates a directory hierarchy, invoking the callback for each directory and file that matches the
+/// filter as soon as it is enumerated, so no listing of the whole hierarchy is held in memory.
+/// Each directory is reported just before its files. With DirWalker (bParallel false), directories are
+/// reported in breadth-first order. With ParallelDirWalker (bParallel true), directories are enumerated
+/// by several threads and reported in no particular order, for callers that sort the entries anyway;
+/// callback invocations are still serialized.
+/// Disables WOW64 file system redirection while inspecting files and directories (Windows).
+/// </summary>
+/// <param name="sRootDirectory">Input: root directory of the hierarchy to list; it is listed too</param>
+/// <param name="filter">Input: criteria selecting the entries to report</param>
+/// <param name="bParallel">Input: true to enumerate with ParallelDirWalker, in no particular order</param>
+/// <param name="callback">Input: function to invoke for each entry</param>
+/// <param name="strErrorInfo">Output: error information (e.g., directories that could not be enumerated)</param>
+/// <returns>true if every directory was enumerated, false otherwise</returns>
+bool ListDirectoryHierarchy(const std::wstring& sRootDirectory, const ListingFilter_t& filter, bool bParallel, const FileInfoCallback_t& callback, std::wstringstream& strErrorInfo);
+
+/// <summary>
+/// Writes listing entries to a stream, one at a time, in one of several formats:
+///   Text: fixed-width columns for the console (creation time, last-write time, size, path)
+///   Csv:  RFC 4180 CSV with a header row: Type,Path,Size,Created,LastWritten
+///   Json: an array of objects: {"type":"file","path":"...","size":123,"created":"...","lastWritten":"..."}
+/// Timestamps are UTC, yyyy-MM-dd HH:mm:ss (text) or yyyy-MM-dd HH:mm:ss.fff (CSV and JSON).
+/// Call Begin once, Write for each entry, then End once.
+/// </summary>
+class ListingWriter
+{
+public:
+	enum Format_t { Text, Csv, Json };
+
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="format">Input: output format</param>
+	/// <param name="os">Input: stream to write to; must outlive this object</param>
+	ListingWriter(Format_t format, std::wostream& os);
+	// Destructor
+	~ListingWriter() = default;
+
+	/// <summary>
+	/// Parses a format name (text, csv, or json; case-insensitive).
+	/// </summary>
+	/// <returns>true if the name is recognized, false otherwise</returns>
+	static bool FormatFromName(const std::wstring& sName, Format_t& format);
+
+	/// <summary>
+	/// Writes the header row or opening bracket, if the format has one.
+	/// </summary>
+	void Begin();
+
+	/// <summary>
+	/// Writes one entry.
+	/// </summary>
+	void Write(const FileInfo_t& fileInfo);
+
+	/// <summary>
+	/// Writes the closing bracket, if the format has one.
+	/// </summary>
+	void End();
+
+	/// <summary>
+	/// Number of entries written since Begin.
+	/// </summary>
+	size_t EntriesWritten() const { return m_nEntries; }
+
+private:
+	// Writes a string as a CSV field, quoted only if necessary
+	void WriteCsvField(const std::wstring& str);
+	// Writes a string as a JSON string literal, including the quotes
+	void WriteJsonString(const std::wstring& str);
+
+private:
+	const Format_t m_format;
+	std::wostream& m_os;
+	size_t m_nEntries;
+
+private:
+	// Not implemented
+	ListingWriter(const ListingWriter&) = delete;
+	ListingWriter& operator = (const ListingWriter&) = delete;
+};
+
+/// <summary>
+/// Sorts listing entries that might not fit in memory (external merge sort).
+/// Entries are collected in memory up to a limit; each full batch is sorted and written to a temporary
+/// "run" file. Finish merges the runs (and any entries still in memory) into the output, holding only one
+/// entry per run in memory. If no run was written, Finish just sorts in memory.
+/// Path comparisons are case-insensitive; entries with equal sort keys are ordered by path.
+/// A run file that can't be read back completely (truncated, damaged, or shorter than the number of
+/// entries written to it) makes Finish fail rather than silently drop entries.
+/// Temporary files are deleted by Finish or by the destructor.
+/// </summary>
+class ListingSorter
+{
+public:
+	enum SortKey_t { Path, Size, LastWriteTime };
+
+	/// <summary>
+	/// Constructor
+	/// </summary>
+	/// <param name="sortKey">Input: the key to sort by</param>
+	/// <param name="nMaxEntriesInMemory">Input: number of entries to collect before writing a run file</param>
+	explicit ListingSorter(SortKey_t sortKey, size_t nMaxEntriesInMemory = 65536);
+	// Destructor
+	~ListingSorter();
+
+	/// <summary>
+	/// Parses a sort key name (path, size, or time; case-insensitive).
+	/// </summary>
+	/// <returns>true if the name is recognized, false otherwise</returns>
+	static bool SortKeyFromName(const std::wstring& sName, SortKey_t& sortKey);
+
+	/// <summary>
+	/// Adds an entry. Writes a run file when the in-memory limit is reached.
+	/// </summary>
+	/// <param name="fileInfo">Input: entry to add</param>
+	/// <param name="strErrorInfo">Output: error information</param>
+	/// <returns>true if successful, false if a run file could not be written</returns>
+	bool Add(const FileInfo_t& fileInfo, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Writes all entries added so far to the writer in sorted order, then deletes the run files.
+	/// Does not call the writer's Begin or End.
+	/// </summary>
+	/// <param name="writer">Input/output: destination for the sorted entries</param>
+	/// <param name="strErrorInfo">Output: error information</param>
+	/// <returns>true if successful, false otherwise</returns>
+	bool Finish(ListingWriter& writer, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Number of run files written.
+	/// </summary>
+	size_t RunCount() const { return m_runFiles.size(); }
+
+private:
+	// Strict weak ordering for the selected sort key
+	bool Less(const FileInfo_t& a, const FileInfo_t& b) const;
+	// Sorts the in-memory entries and writes them to a new run file
+	bool WriteRun(std::wstringstream& strErrorInfo);
+	// Deletes all run files
+	void DeleteRuns();
+
+private:
+	const SortKey_t m_sortKey;
+	const size_t m_nMaxEntriesInMemory;
+	FileInfoCollection_t m_entries;
+	std::vector<std::wstring> m_runFiles;
+	// Number of entries written to each run file, parallel to m_runFiles
+	std::vector<size_t> m_runEntryCounts;
+
+private:
+	// Not implemented
+	ListingSorter(const ListingSorter&) = delete;
+	ListingSorter& operator = (const ListingSorter&) = delete;
+};
@@ -0,0 +1,66 @@
+// POSIX file system utility functions. Not part of the Windows build.
+
+#ifndef _WIN32
+
+#include <cstdint>
+#include <cstring>
+#include "UnicodeTranscoder.h"
+#include "FileSystemUtils-Posix.h"
+
+// A byte that isn't part of valid UTF-8 is represented by a low surrogate from U+DC80 to U+DCFF, which
+// valid UTF-8 can't produce ("surrogateescape"), so that the byte can be restored.
+static inline bool IsEscapedByte(uint32_t c)
+{
+	return c >= 0xDC80 && c <= 0xDCFF;
+}
+
+/// <summary>
+/// Converts a wide-character path to a UTF-8 path for POSIX APIs.
+/// Backslashes are converted to forward slashes, so paths built with Windows path separators work unchanged.
+/// </summary>
+std::string PosixPathFromWString(const std::wstring& sPath)
+{
+	std::string sRet;
+	sRet.reserve(sPath.length());
+	// Convert the runs between backslashes and escaped bytes.
+	size_t ixRun = 0;
+	for (size_t ix = 0; ix < sPath.length(); ++ix)
+	{
+		const uint32_t c = static_cast<uint32_t>(sPath[ix]);
+		if (L'\\' != sPath[ix] && !IsEscapedByte(c))
+			continue;
+		AppendWStringAsUtf8(sPath.data() + ixRun, ix - ixRun, sRet);
+		sRet += (L'\\' == sPath[ix]) ? '/' : char(c & 0xFF);
+		ixRun = ix + 1;
+	}
+	AppendWStringAsUtf8(sPath.data() + ixRun, sPath.length() - ixRun, sRet);
+	return sRet;
+}
+
+/// <summary>
+/// Converts a UTF-8 file name returned by a POSIX API to a wide-character string.
+/// Invalid bytes are escaped, so that PosixPathFromWString restores them.
+/// </summary>
+std::wstring WStringFromPosixName(const char* szName)
+{
+	const size_t cbName = strlen(szName);
+	// Never more characters than bytes
+	std::wstring sRet(cbName, L'\0');
+	size_t cbDone = 0, cchDone = 0;
+	while (cbDone < cbName)
+	{
+		size_t cbRead = 0, cchWritten = 0;
+		const TranscodeStatus_t status = Utf8ToWide(szName + cbDone, cbName - cbDone, &sRet[cchDone], sRet.length() - cchDone, cbRead, cchWritten);
+		cbDone += cbRead;
+		cchDone += cchWritten;
+		if (Transcode_OK == status)
+			break;
+		// An invalid or truncated sequence: escape its first byte, and go on from the next one.
+		sRet[cchDone++] = wchar_t(0xDC00 | static_cast<unsigned char>(szName[cbDone]));
+		++cbDone;
+	}
+	sRet.resize(cchDone);
+	return sRet;
+}
+
+#endif // _WIN32
@@ -0,0 +1,27 @@
+// POSIX file system utility functions, for building platform-neutral code on Linux.
+// Not part of the Windows build.
+
+#pragma once
+#include <string>
+
+
+/// <summary>
+/// Converts a wide-character path to a UTF-8 path for POSIX APIs.
+/// Backslashes are converted to forward slashes, so paths built with Windows path separators work unchanged.
+/// Characters U+DC80 to U+DCFF, which stand for bytes that aren't valid UTF-8 (see WStringFromPosixName),
+/// are converted back to those bytes; other unpaired surrogates become U+FFFD.
+/// (wchar_t is UTF-32 on Linux.)
+/// </summary>
+/// <param name="sPath">Input: path to convert</param>
+/// <returns>UTF-8 path</returns>
+std::string PosixPathFromWString(const std::wstring& sPath);
+
+/// <summary>
+/// Converts a UTF-8 file name returned by a POSIX API to a wide-character string.
+/// POSIX names are byte strings that need not be valid UTF-8. Each byte that isn't part of a valid
+/// sequence (including overlong forms and encoded surrogates) becomes U+DC00 plus the byte's value, as
+/// with Python's surrogateescape, so that PosixPathFromWString converts the name back to the same bytes.
+/// </summary>
+/// <param name="szName">Input: NUL-terminated UTF-8 name</param>
+/// <returns>Wide-character name</returns>
+std::wstring WStringFromPosixName(const char* szName);
@@ -1,5 +1,10 @@
 #include "FileSystemUtils-Windows.h"
 #include "StringUtils.h"
+#include "SysErrorMessage.h"
+#include "FileSystemUtils.h"
+#include <ShlObj.h>
+#include <sddl.h>
+#include <AclAPI.h>
 #include <sstream>
 
 // --------------------------------------------------------------------------------------------------------------
@@ -136,6 +141,42 @@ DWORD GetFileAttributes_ExtendedPath(
 }
 
 
+/// <summary>
+/// Wrapper around GetFileAttributesExW API (GetFileExInfoStandard) that automatically handles case where an
+/// extended-path specifier is needed to inspect the file system object.
+/// Returns attributes, size, and timestamps without opening a handle to the object.
+/// </summary>
+/// <param name="lpFileNameFullPath">Input: full path to the file system object to inspect</param>
+/// <param name="attrData">Output: attribute data for the file system object</param>
+/// <param name="dwLastError">Output: GetLastError() value if object cannot be inspected.</param>
+/// <param name="sAltName">Output: extended-path version of the file system object, if needed to inspect it. Input value not modified otherwise.</param>
+/// <returns>true if successful, false otherwise</returns>
+bool GetFileAttributesEx_ExtendedPath(
+	LPCWSTR lpFileNameFullPath,
+	WIN32_FILE_ATTRIBUTE_DATA& attrData,
+	DWORD& dwLastError,
+	std::wstring& sAltName
+)
+{
+	SetLastError(0);
+	// Do not modify sAltName parameter unless an extended-path spec is attempted.
+	BOOL ret = GetFileAttributesExW(lpFileNameFullPath, GetFileExInfoStandard, &attrData);
+	dwLastError = GetLastError();
+	// For some failures, try again with extended path spec (unless already extended path spec)
+	if (!ret &&
+		ERROR_PATH_NOT_FOUND == dwLastError &&
+		!IsExtendedPathSpec(lpFileNameFullPath))
+	{
+		sAltName = PathToExtendedPath(lpFileNameFullPath);
+		SetLastError(0);
+		ret = GetFileAttributesExW(sAltName.c_str(), GetFileExInfoStandard, &attrData);
+		dwLastError = GetLastError();
+	}
+
+	return (FALSE != ret);
+}
+
+
 /// <summary>
 /// Wrapper around FindFirstFileExW API that automatically handles case where an extended path
 /// specifier is needed to succeed.
@@ -173,4 +214,131 @@ HANDLE FindFirstFileEx_ExtendedPath(
 	}
 
 	return hFileSearch;
-}
\ No newline at end of file
+}
+
+// --------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// Creates a directory and any missing parent directories. Succeeds if the directory already exists.
+/// </summary>
+/// <param name="sDirectory">Input: full path of the directory to create</param>
+/// <param name="sErrorInfo">Output: error information on failure</param>
+/// <returns>true if the directory exists on return, false otherwise</returns>
+bool CreateDirectoryPath(const std::wstring& sDirectory, std::wstring& sErrorInfo)
+{
+	int ret = SHCreateDirectoryExW(NULL, sDirectory.c_str(), NULL);
+	if (ERROR_SUCCESS == ret || ERROR_ALREADY_EXISTS == ret || ERROR_FILE_EXISTS == ret)
+		return true;
+	sErrorInfo = L"Cannot create directory " + sDirectory + L": " + SysErrorMessage(DWORD(ret));
+	return false;
+}
+
+// --------------------------------------------------------------------------------------------------------------
+
+// Owner: Administrators. Protected DACL: full control for Local System and Administrators, inherited by
+// subdirectories and files.
+static const wchar_t* const szAdminOnlyDirectorySddl = L"O:BAD:PAI(A;OICI;FA;;;SY)(A;OICI;FA;;;BA)";
+
+// Rights that allow changing an object, its security, or the contents of a directory
+static const DWORD dwModifyRights =
+	FILE_WRITE_DATA | FILE_APPEND_DATA | FILE_WRITE_EA | FILE_WRITE_ATTRIBUTES | FILE_DELETE_CHILD |
+	DELETE | WRITE_DAC | WRITE_OWNER | GENERIC_WRITE | GENERIC_ALL;
+
+static bool IsSystemOrAdministratorsSid(PSID pSid)
+{
+	return NULL != pSid && (IsWellKnownSid(pSid, WinLocalSystemSid) || IsWellKnownSid(pSid, WinBuiltinAdministratorsSid));
+}
+
+static std::wstring SidToString(PSID pSid)
+{
+	std::wstring sSid = L"(unknown)";
+	LPWSTR szSid = NULL;
+	if (NULL != pSid && ConvertSidToStringSidW(pSid, &szSid))
+	{
+		sSid = szSid;
+		LocalFree(szSid);
+	}
+	return sSid;
+}
+
+/// <summary>
+/// Creates a directory, and any missing parent directories, owned by the Administrators group and with a
+/// protected DACL that grants access only to Local System and Administrators.
+/// </summary>
+bool CreateAdminOnlyDirectory(const std::wstring& sDirectory, std::wstring& sErrorInfo)
+{
+	const std::wstring sParent = GetDirectoryNameFromFilePath(sDirectory);
+	if (sParent.length() > 0 && INVALID_FILE_ATTRIBUTES == GetFileAttributesW(sParent.c_str()) && !CreateDirectoryPath(sParent, sErrorInfo))
+		return false;
+
+	SECURITY_ATTRIBUTES secAttr = { 0 };
+	secAttr.nLength = sizeof(secAttr);
+	if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(szAdminOnlyDirectorySddl, SDDL_REVISION_1, &secAttr.lpSecurityDescriptor, NULL))
+	{
+		sErrorInfo = L"Cannot create security descriptor for " + sDirectory + L": " + SysErrorMessage();
+		return false;
+	}
+	const BOOL ret = CreateDirectoryW(sDirectory.c_str(), &secAttr);
+	const DWORD dwLastErr = GetLastError();
+	LocalFree(secAttr.lpSecurityDescriptor);
+	if (ret || ERROR_ALREADY_EXISTS == dwLastErr)
+		return true;
+	sErrorInfo = L"Cannot create directory " + sDirectory + L": " + SysErrorMessage(dwLastErr);
+	return false;
+}
+
+/// <summary>
+/// Verifies that only Local System and Administrators own or can modify a file or directory.
+/// </summary>
+bool VerifyAdminOnlyAccess(const std::wstring& sPath, std::wstring& sErrorInfo)
+{
+	PSID pOwner = NULL;
+	PACL pDacl = NULL;
+	PSECURITY_DESCRIPTOR pSD = NULL;
+	const DWORD dwRet = GetNamedSecurityInfoW(sPath.c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION, &pOwner, NULL, &pDacl, NULL, &pSD);
+	if (ERROR_SUCCESS != dwRet)
+	{
+		sErrorInfo = L"Cannot read the security of " + sPath + L": " + SysErrorMessage(dwRet);
+		return false;
+	}
+
+	bool bOK = true;
+	if (!IsSystemOrAdministratorsSid(pOwner))
+	{
+		sErrorInfo = sPath + L" is owned by " + SidToString(pOwner) + L", not by SYSTEM or Administrators";
+		bOK = false;
+	}
+	else if (NULL == pDacl)
+	{
+		sErrorInfo = sPath + L" has no DACL, which grants everyone full access";
+		bOK = false;
+	}
+	// Inherit-only entries are checked too: they apply to files and subdirectories created later.
+	for (WORD ixAce = 0; bOK && ixAce < pDacl->AceCount; ++ixAce)
+	{
+		ACE_HEADER* pAceHeader = NULL;
+		if (!GetAce(pDacl, ixAce, reinterpret_cast<LPVOID*>(&pAceHeader)))
+		{
+			sErrorInfo = L"Cannot read the DACL of " + sPath + L": " + SysErrorMessage();
+			bOK = false;
+		}
+		else if (ACCESS_ALLOWED_ACE_TYPE == pAceHeader->AceType)
+		{
+			const ACCESS_ALLOWED_ACE* pAce = reinterpret_cast<const ACCESS_ALLOWED_ACE*>(pAceHeader);
+			PSID pAceSid = const_cast<DWORD*>(&pAce->SidStart);
+			if (0 != (pAce->Mask & dwModifyRights) && !IsSystemOrAdministratorsSid(pAceSid))
+			{
+				sErrorInfo = sPath + L" grants write access to " + SidToString(pAceSid);
+				bOK = false;
+			}
+		}
+		else if (ACCESS_DENIED_ACE_TYPE != pAceHeader->AceType)
+		{
+			// Conditional (callback) and object entries aren't expected on these directories.
+			sErrorInfo = sPath + L" has an unexpected type of access control entry";
+			bOK = false;
+		}
+	}
+	LocalFree(pSD);
+	return bOK;
+}
@@ -96,6 +96,23 @@ DWORD GetFileAttributes_ExtendedPath(
 	std::wstring& sAltName
 );
 
+/// <summary>
+/// Wrapper around GetFileAttributesExW API (GetFileExInfoStandard) that automatically handles case where an
+/// extended-path specifier is needed to inspect the file system object.
+/// Returns attributes, size, and timestamps without opening a handle to the object.
+/// </summary>
+/// <param name="lpFileNameFullPath">Input: full path to the file system object to inspect</param>
+/// <param name="attrData">Output: attribute data for the file system object</param>
+/// <param name="dwLastError">Output: GetLastError() value if object cannot be inspected.</param>
+/// <param name="sAltName">Output: extended-path version of the file system object, if needed to inspect it. Input value not modified otherwise.</param>
+/// <returns>true if successful, false otherwise</returns>
+bool GetFileAttributesEx_ExtendedPath(
+	LPCWSTR lpFileNameFullPath,
+	WIN32_FILE_ATTRIBUTE_DATA& attrData,
+	DWORD& dwLastError,
+	std::wstring& sAltName
+);
+
 /// <summary>
 /// Wrapper around FindFirstFileExW API that automatically handles case where an extended path
 /// specifier is needed to succeed.
@@ -109,3 +126,38 @@ HANDLE FindFirstFileEx_ExtendedPath(
 	_In_ FINDEX_SEARCH_OPS fSearchOp,
 	_In_ DWORD dwAdditionalFlags
 );
+
+
+// --------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// Creates a directory and any missing parent directories. Succeeds if the directory already exists.
+/// </summary>
+/// <param name="sDirectory">Input: full path of the directory to create</param>
+/// <param name="sErrorInfo">Output: error information on failure</param>
+/// <returns>true if the directory exists on return, false otherwise</returns>
+bool CreateDirectoryPath(const std::wstring& sDirectory, std::wstring& sErrorInfo);
+
+// --------------------------------------------------------------------------------------------------------------
+// Directories holding content that an administrator later copies into protected locations (e.g., snapshots of
+// System32\AppLocker). Standard users must not be able to plant or alter anything in them.
+
+/// <summary>
+/// Creates a directory, and any missing parent directories, owned by the Administrators group and with a
+/// protected DACL (not inherited from its parent) that grants access only to Local System and Administrators.
+/// Files and subdirectories created in it inherit that DACL. Parent directories get default security.
+/// Succeeds without changing anything if the directory already exists; check it with VerifyAdminOnlyAccess.
+/// </summary>
+/// <param name="sDirectory">Input: full path of the directory to create</param>
+/// <param name="sErrorInfo">Output: error information on failure</param>
+/// <returns>true if the directory exists on return, false otherwise</returns>
+bool CreateAdminOnlyDirectory(const std::wstring& sDirectory, std::wstring& sErrorInfo);
+
+/// <summary>
+/// Verifies that a file or directory is owned by Local System or Administrators, and that its DACL grants
+/// no other user or group any right to modify it, its security, or (for a directory) its contents.
+/// </summary>
+/// <param name="sPath">Input: full path of the file or directory to check</param>
+/// <param name="sErrorInfo">Output: the reason the check failed</param>
+/// <returns>true if only Local System and Administrators can modify the object, false otherwise</returns>
+bool VerifyAdminOnlyAccess(const std::wstring& sPath, std::wstring& sErrorInfo);
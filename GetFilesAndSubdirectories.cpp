@@ -6,6 +6,15 @@
 #include "Wow64FsRedirection.h"
 #include "GetFilesAndSubdirectories.h"
 
+// Attributes that disqualify a directory entry from being treated as a file: subdirectories, reparse points
+// (junctions, directory symbolic links, file symbolic links), offline files, files requiring download to access, etc.
+static const DWORD dwUngoodFileAttributes =
+	FILE_ATTRIBUTE_DIRECTORY |
+	FILE_ATTRIBUTE_REPARSE_POINT |
+	FILE_ATTRIBUTE_OFFLINE |
+	FILE_ATTRIBUTE_RECALL_ON_OPEN |
+	FILE_ATTRIBUTE_RECALL_ON_DATA_ACCESS;
+
 
 bool GetFiles(const std::wstring& sDirectoryPath, std::vector<std::wstring>& files, bool bNamesOnly)
 {
@@ -13,16 +22,14 @@ bool GetFiles(const std::wstring& sDirectoryPath, std::vector<std::wstring>& fil
 	return GetFiles(sDirectoryPath, L"*", files, bNamesOnly);
 }
 
-bool GetFiles(const std::wstring& sDirectoryPath, const std::wstring& sSpec, std::vector<std::wstring>& files, bool bNamesOnly)
+// Enumerates the entries in a directory that match a search specification, invoking fn(FindFileData)
+// for each file (bSubdirectories false) or each non-reparse-point subdirectory (bSubdirectories true).
+// The caller disables WOW64 file system redirection.
+template <class Fn_t>
+static bool ForEachEntry(const std::wstring& sDirectoryPath, const std::wstring& sSpec, bool bSubdirectories, Fn_t fn)
 {
-	// Initialize return value and output parameter
 	bool retval = false;
-	files.clear();
 
-	// Disable WOW64 file system redirection. Reverts to previous state when this variable goes out of scope (function exit).
-	Wow64FsRedirection fsredir(true);
-
-	// Identify all files and add them to the collection.
 	// Search specification is current directory + "\" + search spec (e.g., "*.exe")
 	std::wstring sSearchSpec = sDirectoryPath + L"\\" + sSpec;
 	WIN32_FIND_DATAW FindFileData = { 0 };
@@ -30,35 +37,25 @@ bool GetFiles(const std::wstring& sDirectoryPath, const std::wstring& sSpec, std
 		sSearchSpec.c_str(),
 		FINDEX_INFO_LEVELS::FindExInfoBasic, // Optimize - no need to get short names
 		&FindFileData,
-		FINDEX_SEARCH_OPS::FindExSearchNameMatch,
+		bSubdirectories ? FINDEX_SEARCH_OPS::FindExSearchLimitToDirectories : FINDEX_SEARCH_OPS::FindExSearchNameMatch,
 		FIND_FIRST_EX_LARGE_FETCH); // optimization, according to the documentation
 	if (INVALID_HANDLE_VALUE != hFileSearch)
 	{
 		retval = true;
 		do {
-			// If the returned name is not a subdirectory, a reparse point (junction, directory symbolic link, file symbolic link),
-			// offline, requiring download to access, etc., then add it to the collection.
-			const DWORD dwUngoodFileAttributes =
-				FILE_ATTRIBUTE_DIRECTORY |
-				FILE_ATTRIBUTE_REPARSE_POINT |
-				FILE_ATTRIBUTE_OFFLINE |
-				FILE_ATTRIBUTE_RECALL_ON_OPEN |
-				FILE_ATTRIBUTE_RECALL_ON_DATA_ACCESS;
-			// If any "ungood" attributes, treat it as not a file.
-			if (0 == (FindFileData.dwFileAttributes & dwUngoodFileAttributes))
+			if (bSubdirectories)
+			{
+				// If the returned name is a real subdirectory (not "." or ".." or a reparse point -- i.e., isn't a junction or directory symbolic link -- report it.
+				if (IsSubdirectory(FindFileData))
+					fn(FindFileData);
+			}
+			else
 			{
-				if (bNamesOnly)
-				{
-					// file name only
-					files.push_back(FindFileData.cFileName);
-				}
-				else
-				{
-					// Full path
-					files.push_back(
-						sDirectoryPath + L"\\" + FindFileData.cFileName
-					);
-				}
+				// If the returned name is not a subdirectory, a reparse point (junction, directory symbolic link, file symbolic link),
+				// offline, requiring download to access, etc., then report it.
+				// If any "ungood" attributes, treat it as not a file.
+				if (0 == (FindFileData.dwFileAttributes & dwUngoodFileAttributes))
+					fn(FindFileData);
 			}
 			// Get the next one
 		} while (FindNextFileW(hFileSearch, &FindFileData));
@@ -68,57 +65,146 @@ bool GetFiles(const std::wstring& sDirectoryPath, const std::wstring& sSpec, std
 	return retval;
 }
 
-/// <summary>
-/// Get the names or full paths to a directory's non-reparse-point subdirectories.
-/// Disables WOW64 file system redirection for the duration of the function.
-/// </summary>
-/// <param name="sDirectoryPath">Input: the path of the directory to inspect</param>
-/// <param name="subdirectories">Output: a collection of names or full paths of the directory's subdirectories</param>
-/// <param name="bNamesOnly">Input: if true, returns only the names of the subdirectories; if false (default) returns full paths</param>
-/// <returns>true if successful, false on error</returns>
-bool GetSubdirectories(const std::wstring& sDirectoryPath, std::vector<std::wstring>& subdirectories, bool bNamesOnly)
+bool GetFiles(const std::wstring& sDirectoryPath, const std::wstring& sSpec, std::vector<std::wstring>& files, bool bNamesOnly)
 {
-	// Initialize return value and output parameter
+	files.clear();
+
+	// Disable WOW64 file system redirection. Reverts to previous state when this variable goes out of scope (function exit).
+	Wow64FsRedirection fsredir(true);
+
+	return ForEachEntry(sDirectoryPath, sSpec, false,
+		[&](const WIN32_FIND_DATAW& FindFileData)
+		{
+			if (bNamesOnly)
+			{
+				// file name only
+				files.push_back(FindFileData.cFileName);
+			}
+			else
+			{
+				// Full path
+				files.push_back(
+					sDirectoryPath + L"\\" + FindFileData.cFileName
+				);
+			}
+		});
+}
+
+bool GetFiles(PathStore& pathStore, PathStore::PathId_t directoryId, std::vector<PathStore::PathId_t>& files)
+{
+	files.clear();
+	Wow64FsRedirection fsredir(true);
+	bool bAllAdded = true;
+	const bool bEnumerated = ForEachEntry(pathStore.FullPath(directoryId), L"*", false,
+		[&](const WIN32_FIND_DATAW& FindFileData)
+		{
+			files.push_back(pathStore.Add(directoryId, FindFileData.cFileName, wcslen(FindFileData.cFileName)));
+			if (PathStore::InvalidId == files.back())
+				bAllAdded = false;
+		});
+	return bEnumerated && bAllAdded;
+}
+
+// Combine the two DWORD halves of a 64-bit value
+static inline uint64_t MakeU64(DWORD dwHigh, DWORD dwLow)
+{
+	return (uint64_t(dwHigh) << 32) | uint64_t(dwLow);
+}
+
+bool GetFilesAndSubdirectories(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories, bool bIncludeOtherEntries)
+{
+	// Initialize return value and output parameters
 	bool retval = false;
+	files.clear();
 	subdirectories.clear();
 
 	// Disable WOW64 file system redirection. Reverts to previous state when this variable goes out of scope (function exit).
 	Wow64FsRedirection fsredir(true);
 
-	// Identify non-junction/non-symbolic-link subdirectories and add them to the collection.
-	// Search specification is current directory + "\*"
+	// One enumeration of everything in the directory; each entry is sorted into files or subdirectories.
 	std::wstring sSearchSpec = sDirectoryPath + L"\\*";
 	WIN32_FIND_DATAW FindFileData = { 0 };
 	HANDLE hFileSearch = FindFirstFileEx_ExtendedPath(
 		sSearchSpec.c_str(),
 		FINDEX_INFO_LEVELS::FindExInfoBasic, // Optimize - no need to get short names
 		&FindFileData,
-		FINDEX_SEARCH_OPS::FindExSearchLimitToDirectories, // does this do anything?
+		FINDEX_SEARCH_OPS::FindExSearchNameMatch,
 		FIND_FIRST_EX_LARGE_FETCH); // optimization, according to the documentation
 	if (INVALID_HANDLE_VALUE != hFileSearch)
 	{
 		retval = true;
 		do {
-			// If the returned name is a real subdirectory (not "." or ".." or a reparse point -- i.e., isn't a junction or directory symbolic link -- add it to the collection.
+			DirEntryCollection_t* pTarget = NULL;
 			if (IsSubdirectory(FindFileData))
+				pTarget = &subdirectories;
+			else if (0 == (FindFileData.dwFileAttributes & dwUngoodFileAttributes))
+				pTarget = &files;
+			else if (bIncludeOtherEntries && 0 != wcscmp(L".", FindFileData.cFileName) && 0 != wcscmp(L"..", FindFileData.cFileName))
+				pTarget = &files;
+
+			if (NULL != pTarget)
 			{
-				if (bNamesOnly)
-				{
-					// Subdirectory name only
-					subdirectories.push_back(FindFileData.cFileName);
-				}
-				else
-				{
-					// Full path
-					subdirectories.push_back(
-						sDirectoryPath + L"\\" + FindFileData.cFileName
-					);
-				}
+				// Everything needed is already in the find data; no need to open the file.
+				pTarget->push_back(DirEntry_t());
+				DirEntry_t& entry = pTarget->back();
+				entry.sName = FindFileData.cFileName;
+				entry.dwAttributes = FindFileData.dwFileAttributes;
+				entry.filesize = MakeU64(FindFileData.nFileSizeHigh, FindFileData.nFileSizeLow);
+				entry.ftCreateTime = MakeU64(FindFileData.ftCreationTime.dwHighDateTime, FindFileData.ftCreationTime.dwLowDateTime);
+				entry.ftLastWriteTime = MakeU64(FindFileData.ftLastWriteTime.dwHighDateTime, FindFileData.ftLastWriteTime.dwLowDateTime);
 			}
-		// Get the next one
+			// Get the next one
 		} while (FindNextFileW(hFileSearch, &FindFileData));
 		// Search complete, close the handle.
 		FindClose(hFileSearch);
 	}
 	return retval;
 }
+
+/// <summary>
+/// Get the names or full paths to a directory's non-reparse-point subdirectories.
+/// Disables WOW64 file system redirection for the duration of the function.
+/// </summary>
+/// <param name="sDirectoryPath">Input: the path of the directory to inspect</param>
+/// <param name="subdirectories">Output: a collection of names or full paths of the directory's subdirectories</param>
+/// <param name="bNamesOnly">Input: if true, returns only the names of the subdirectories; if false (default) returns full paths</param>
+/// <returns>true if successful, false on error</returns>
+bool GetSubdirectories(const std::wstring& sDirectoryPath, std::vector<std::wstring>& subdirectories, bool bNamesOnly)
+{
+	subdirectories.clear();
+
+	// Disable WOW64 file system redirection. Reverts to previous state when this variable goes out of scope (function exit).
+	Wow64FsRedirection fsredir(true);
+
+	return ForEachEntry(sDirectoryPath, L"*", true,
+		[&](const WIN32_FIND_DATAW& FindFileData)
+		{
+			if (bNamesOnly)
+			{
+				// Subdirectory name only
+				subdirectories.push_back(FindFileData.cFileName);
+			}
+			else
+			{
+				// Full path
+				subdirectories.push_back(
+					sDirectoryPath + L"\\" + FindFileData.cFileName
+				);
+			}
+		});
+}
+
+bool GetSubdirectories(PathStore& pathStore, PathStore::PathId_t directoryId, std::vector<PathStore::PathId_t>& subdirectories)
+{
+	subdirectories.clear();
+	Wow64FsRedirection fsredir(true);
+	bool bAllAdded = true;
+	const bool bEnumerated = ForEachEntry(pathStore.FullPath(directoryId), L"*", true,
+		[&](const WIN32_FIND_DATAW& FindFileData)
+		{
+			subdirectories.push_back(pathStore.Add(directoryId, FindFileData.cFileName, wcslen(FindFileData.cFileName)));
+			if (PathStore::InvalidId == subdirectories.back())
+				bAllAdded = false;
+		});
+	return bEnumerated && bAllAdded;
+}
@@ -4,6 +4,43 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include "PathStore.h"
+
+
+/// <summary>
+/// Information about one file or subdirectory, as returned from a directory enumeration.
+/// Attribute values are Windows FILE_ATTRIBUTE_* flags; timestamps are FILETIME values
+/// (100-nanosecond intervals since January 1, 1601 UTC) stored as 64-bit integers.
+/// </summary>
+struct DirEntry_t
+{
+	std::wstring sName;
+	uint32_t dwAttributes;
+	uint64_t filesize;
+	uint64_t ftCreateTime, ftLastWriteTime;
+
+	DirEntry_t() : dwAttributes(0), filesize(0), ftCreateTime(0), ftLastWriteTime(0) {}
+};
+typedef std::vector<DirEntry_t> DirEntryCollection_t;
+
+
+/// <summary>
+/// Get a directory's files and non-reparse-point subdirectories, with their attributes, sizes, and timestamps,
+/// from a single enumeration of the directory.
+/// Files are selected with the same criteria as GetFiles, and subdirectories with the same criteria as GetSubdirectories.
+/// Entries contain names only; callers append them to sDirectoryPath to get full paths.
+/// Disables WOW64 file system redirection for the duration of the function (Windows).
+/// </summary>
+/// <param name="sDirectoryPath">Input: the path of the directory to inspect</param>
+/// <param name="files">Output: the directory's files</param>
+/// <param name="subdirectories">Output: the directory's subdirectories</param>
+/// <param name="bIncludeOtherEntries">Input: if true, entries that are neither (reparse points such as junctions and
+/// symbolic links, offline and recall-on-access files; on POSIX, symbolic links and special files) are reported
+/// in files too, with their attributes, so that a caller deleting a hierarchy can remove them rather than leave
+/// them behind. Reparse points are not followed.</param>
+/// <returns>true if successful, false on error</returns>
+bool GetFilesAndSubdirectories(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories, bool bIncludeOtherEntries = false);
 
 
 /// <summary>
@@ -29,6 +66,17 @@ bool GetFiles(const std::wstring& sDirectoryPath, std::vector<std::wstring>& fil
 bool GetFiles(const std::wstring& sDirectoryPath, const std::wstring& sSpec, std::vector<std::wstring>& files, bool bNamesOnly = false);
 
 
+/// <summary>
+/// Get a directory's files as nodes in a PathStore, without building a full path for each file.
+/// Disables WOW64 file system redirection for the duration of the function.
+/// </summary>
+/// <param name="pathStore">Input/output: the store that holds the directory's node; a node is added for each file</param>
+/// <param name="directoryId">Input: the directory's node in pathStore</param>
+/// <param name="files">Output: IDs of the nodes added for the directory's files; PathStore::InvalidId for a file whose node can't be added</param>
+/// <returns>true if successful, false on error (including a node that can't be added)</returns>
+bool GetFiles(PathStore& pathStore, PathStore::PathId_t directoryId, std::vector<PathStore::PathId_t>& files);
+
+
 /// <summary>
 /// Get the names or full paths to a directory's non-reparse-point subdirectories.
 /// Disables WOW64 file system redirection for the duration of the function.
@@ -38,3 +86,14 @@ bool GetFiles(const std::wstring& sDirectoryPath, const std::wstring& sSpec, std
 /// <param name="bNamesOnly">Input: if true, returns only the names of the subdirectories; if false (default) returns full paths</param>
 /// <returns>true if successful, false on error</returns>
 bool GetSubdirectories(const std::wstring& sDirectoryPath, std::vector<std::wstring>& subdirectories, bool bNamesOnly = false);
+
+
+/// <summary>
+/// Get a directory's non-reparse-point subdirectories as nodes in a PathStore, without building a full path for each one.
+/// Disables WOW64 file system redirection for the duration of the function.
+/// </summary>
+/// <param name="pathStore">Input/output: the store that holds the directory's node; a node is added for each subdirectory</param>
+/// <param name="directoryId">Input: the directory's node in pathStore</param>
+/// <param name="subdirectories">Output: IDs of the nodes added for the directory's subdirectories; PathStore::InvalidId for a subdirectory whose node can't be added</param>
+/// <returns>true if successful, false on error (including a node that can't be added)</returns>
+bool GetSubdirectories(PathStore& pathStore, PathStore::PathId_t directoryId, std::vector<PathStore::PathId_t>& subdirectories);
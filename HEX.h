@@ -1,10 +1,10 @@
-// HEX.h: 
+// HEX.h:
 // Convert any numeric value into a zero-filled hex-formatted string.
 
 #pragma once
-#include <iostream>
-#include <iomanip>
-#include <sstream>
+#include <cstdint>
+#include <cstddef>
+#include <string>
 
 template <typename T>
 inline uint64_t HEXHelperFn_ToU64ForHEX(T num)
@@ -23,24 +23,70 @@ inline uint64_t HEXHelperFn_ToU64ForHEX(T num)
 	}
 }
 
+/// <summary>
+/// Writes a value in hex, zero-filled to at least nMinDigits digits, into a caller-supplied buffer,
+/// in the manner of std::to_chars: no allocation, no stream, and no NUL terminator.
+/// </summary>
+/// <param name="pFirst">Output: buffer of at least max(nMinDigits, 16) characters</param>
+/// <param name="value">Input: value to write</param>
+/// <param name="nMinDigits">Input: minimum number of digits; more are written if the value needs them</param>
+/// <param name="bUpcase">Input: true for A-F, false for a-f</param>
+/// <returns>Pointer one past the last character written</returns>
+template <typename CharT>
+inline CharT* HexToChars(CharT* pFirst, uint64_t value, size_t nMinDigits, bool bUpcase = false)
+{
+	static const char lowerDigits[] = "0123456789abcdef";
+	static const char upperDigits[] = "0123456789ABCDEF";
+	const char* const digits = bUpcase ? upperDigits : lowerDigits;
+
+	// Number of significant digits (at least one), by halving the width still to examine
+	size_t nDigits = 1;
+	uint64_t rest = value;
+	if (0 != (rest >> 32)) { nDigits += 8; rest >>= 32; }
+	if (0 != (rest >> 16)) { nDigits += 4; rest >>= 16; }
+	if (0 != (rest >> 8)) { nDigits += 2; rest >>= 8; }
+	if (0 != (rest >> 4)) { nDigits += 1; }
+
+	// Zero fill, then the digits; each digit depends only on the value, not on the previous digit.
+	CharT* p = pFirst;
+	for (size_t ix = nDigits; ix < nMinDigits; ++ix)
+		*p++ = CharT('0');
+	for (size_t ix = nDigits; ix > 0; --ix)
+		*p++ = CharT(digits[(value >> (4 * (ix - 1))) & 0xF]);
+	return p;
+}
+
+// Formats a value for HEXW and HEXA. Any field width is honored, as it was with std::setw: zeros beyond
+// the 16 digits a 64-bit value can need are added in the string rather than in the digit buffer.
+template <typename CharT>
+inline std::basic_string<CharT> HEXHelperFn_Format(uint64_t value, unsigned long fieldwidth, bool bUpcase, bool b0xPrefix)
+{
+	CharT digits[16];
+	const CharT* const pEnd = HexToChars(digits, value, (fieldwidth < 16) ? size_t(fieldwidth) : size_t(16), bUpcase);
+	const size_t nDigits = size_t(pEnd - digits);
+	std::basic_string<CharT> str;
+	str.reserve((b0xPrefix ? 2 : 0) + ((fieldwidth > nDigits) ? size_t(fieldwidth) : nDigits));
+	if (b0xPrefix)
+	{
+		str += CharT('0');
+		str += CharT('x');
+	}
+	if (fieldwidth > nDigits)
+		str.append(size_t(fieldwidth) - nDigits, CharT('0'));
+	str.append(digits, nDigits);
+	return str;
+}
+
 template <typename T>
 std::wstring HEXW(T num, unsigned long fieldwidth = sizeof(T) * 2, bool bUpcase = false, bool b0xPrefix = false)
 {
-	std::wstringstream str;
-	str.fill(L'0');
-	str << (b0xPrefix ? L"0x" : L"") << std::hex << (bUpcase ? std::uppercase : std::nouppercase) << std::setw(fieldwidth);
-	str << HEXHelperFn_ToU64ForHEX(num);
-	return str.str();
+	return HEXHelperFn_Format<wchar_t>(HEXHelperFn_ToU64ForHEX(num), fieldwidth, bUpcase, b0xPrefix);
 }
 
 template <typename T>
 std::string HEXA(T num, unsigned long fieldwidth = sizeof(T) * 2, bool bUpcase = false, bool b0xPrefix = false)
 {
-	std::stringstream str;
-	str.fill('0');
-	str << (b0xPrefix ? "0x" : "") << std::hex << (bUpcase ? std::uppercase : std::nouppercase) << std::setw(fieldwidth);
-	str << HEXHelperFn_ToU64ForHEX(num);
-	return str.str();
+	return HEXHelperFn_Format<char>(HEXHelperFn_ToU64ForHEX(num), fieldwidth, bUpcase, b0xPrefix);
 }
 
 #ifdef UNICODE
@@ -49,4 +95,3 @@ std::string HEXA(T num, unsigned long fieldwidth = sizeof(T) * 2, bool bUpcase =
 #define HEX HEXA
 #endif // UNICODE
 
-
@@ -1,5 +1,6 @@
 #include <windows.h>
 #include <GPEdit.h>
+#include "Stats.h"
 #include "LocalGPO.h"
 
 // Class to encapsulate group policy processing.
@@ -17,6 +18,7 @@ LocalGPO::LocalGPO()
 // Initialization
 HRESULT LocalGPO::Init(bool bReadOnly /*= false*/)
 {
+	STATS_SCOPE("lgpo.open");
 	// Initialize COM
 	// Note: this MUST be apartment threaded. COINIT_MULTITHREADED increases likelihood of crashing.
 	HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
@@ -75,6 +77,7 @@ HRESULT LocalGPO::Save()
 	if (!m_pLGPO)
 		return E_POINTER;
 
+	STATS_SCOPE("lgpo.save");
 	HRESULT hrComputer = S_OK, hrUser = S_OK;
 
 	// Save machine and user config with standard extension GUID
@@ -126,6 +129,7 @@ HRESULT LocalGPO::SaveWithRetries(BOOL bComputer, GUID* pGuidExtension)
 		for (int retry = 0; retry < retries; ++retry)
 		{
 			Sleep(retryDelay_ms);
+			STATS_ADD(Retries, 1);
 			hr = m_pLGPO->Save(bComputer, TRUE, pGuidExtension, &ThisAdminToolGuid);
 			if (hrSharingViolation != hr)
 				break;
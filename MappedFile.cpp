@@ -0,0 +1,152 @@
+// Read-only memory-mapped file
+
+#ifdef _WIN32
+#include <Windows.h>
+#include "SysErrorMessage.h"
+#include "Wow64FsRedirection.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "FileSystemUtils-Posix.h"
+#endif
+#include "MappedFile.h"
+
+MappedFile::MappedFile()
+	: m_pData(NULL), m_cbData(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const wchar_t* szFilename, std::wstring& sErrorInfo)
+{
+	Close();
+	sErrorInfo.clear();
+
+	// Disable WOW64 file system redirection so System32 paths are not redirected to SysWOW64.
+	Wow64FsRedirection fsredir(true);
+	HANDLE hFile = CreateFileW(szFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		sErrorInfo = std::wstring(L"Cannot open ") + szFilename + L": " + SysErrorMessage();
+		return false;
+	}
+
+	bool retval = false;
+	LARGE_INTEGER fileSize = { 0 };
+	if (!GetFileSizeEx(hFile, &fileSize))
+	{
+		sErrorInfo = std::wstring(L"Cannot get size of ") + szFilename + L": " + SysErrorMessage();
+	}
+	else if (0 == fileSize.QuadPart)
+	{
+		// Can't map a zero-length file; nothing to map anyway.
+		retval = true;
+	}
+	else if (uint64_t(fileSize.QuadPart) > uint64_t(SIZE_MAX))
+	{
+		sErrorInfo = std::wstring(L"File too large to map: ") + szFilename;
+	}
+	else
+	{
+		HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL == hMapping)
+		{
+			sErrorInfo = std::wstring(L"Cannot create file mapping for ") + szFilename + L": " + SysErrorMessage();
+		}
+		else
+		{
+			// The view keeps the mapping object alive after its handle is closed.
+			void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (NULL == pView)
+			{
+				sErrorInfo = std::wstring(L"Cannot map view of ") + szFilename + L": " + SysErrorMessage();
+			}
+			else
+			{
+				m_pData = static_cast<const uint8_t*>(pView);
+				m_cbData = size_t(fileSize.QuadPart);
+				retval = true;
+			}
+			CloseHandle(hMapping);
+		}
+	}
+	CloseHandle(hFile);
+	return retval;
+}
+
+void MappedFile::Close()
+{
+	if (NULL != m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	m_pData = NULL;
+	m_cbData = 0;
+}
+
+#else
+
+bool MappedFile::Open(const wchar_t* szFilename, std::wstring& sErrorInfo)
+{
+	Close();
+	sErrorInfo.clear();
+
+	const std::string sPath = PosixPathFromWString(szFilename);
+	int fd = open(sPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		sErrorInfo = std::wstring(L"Cannot open ") + szFilename + L": " + WStringFromPosixName(strerror(errno));
+		return false;
+	}
+
+	bool retval = false;
+	struct stat st;
+	if (0 != fstat(fd, &st))
+	{
+		sErrorInfo = std::wstring(L"Cannot get size of ") + szFilename + L": " + WStringFromPosixName(strerror(errno));
+	}
+	else if (0 == st.st_size)
+	{
+		// Can't map a zero-length file; nothing to map anyway.
+		retval = true;
+	}
+	else
+	{
+		// The mapping stays valid after the descriptor is closed.
+		void* pView = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (MAP_FAILED == pView)
+		{
+			sErrorInfo = std::wstring(L"Cannot map ") + szFilename + L": " + WStringFromPosixName(strerror(errno));
+		}
+		else
+		{
+			m_pData = static_cast<const uint8_t*>(pView);
+			m_cbData = size_t(st.st_size);
+			retval = true;
+		}
+	}
+	close(fd);
+	return retval;
+}
+
+void MappedFile::Close()
+{
+	if (NULL != m_pData)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_cbData);
+	}
+	m_pData = NULL;
+	m_cbData = 0;
+}
+
+#endif
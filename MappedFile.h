@@ -0,0 +1,62 @@
+// Read-only memory-mapped file
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// Maps an entire file read-only into memory, for zero-copy inspection of file content.
+/// The mapping is released on Close() or when the object is destroyed.
+/// Windows implementation uses file mapping objects; elsewhere, mmap.
+/// 
+/// Usage:
+/// 	MappedFile mappedFile;
+/// 	std::wstring sErrorInfo;
+/// 	if (mappedFile.Open(szFilename, sErrorInfo))
+/// 	{
+/// 		Inspect(mappedFile.Data(), mappedFile.Size());
+/// 	}
+/// </summary>
+class MappedFile
+{
+public:
+	// Constructor
+	MappedFile();
+	// Destructor
+	~MappedFile();
+
+	/// <summary>
+	/// Opens and maps the file. Any previously mapped file is closed first.
+	/// A zero-length file opens successfully, with Data() returning NULL and Size() returning 0.
+	/// </summary>
+	/// <param name="szFilename">Input: path to the file to map</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if successful, false otherwise</returns>
+	bool Open(const wchar_t* szFilename, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Unmaps and closes the file, if open.
+	/// </summary>
+	void Close();
+
+	/// <summary>
+	/// Pointer to the start of the mapped file content; NULL if not mapped.
+	/// </summary>
+	const uint8_t* Data() const { return m_pData; }
+
+	/// <summary>
+	/// Size of the mapped file content, in bytes.
+	/// </summary>
+	size_t Size() const { return m_cbData; }
+
+private:
+	const uint8_t* m_pData;
+	size_t m_cbData;
+
+private:
+	// Not implemented
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+};
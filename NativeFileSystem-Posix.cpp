@@ -0,0 +1,34 @@
+// POSIX implementation of NativeFileSystem (see BulkDelete.h), so that bulk deletion can be
+// built and exercised against temporary trees on Linux. Not part of the Windows build.
+//
+// Read-only attributes need no special handling: unlink and rmdir depend on the permissions
+// of the containing directory, not those of the object being removed. unlink removes a symbolic
+// link itself, never its target.
+
+#ifndef _WIN32
+
+#include <unistd.h>
+#include <cerrno>
+#include "FileSystemUtils-Posix.h"
+#include "BulkDelete.h"
+
+bool NativeFileSystem::Enumerate(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories)
+{
+	return GetFilesAndSubdirectories(sDirectoryPath, files, subdirectories, true);
+}
+
+uint32_t NativeFileSystem::DeleteFileObject(const std::wstring& sFilePath, uint32_t /*dwAttributes*/)
+{
+	if (0 == unlink(PosixPathFromWString(sFilePath).c_str()))
+		return 0;
+	return uint32_t(errno);
+}
+
+uint32_t NativeFileSystem::RemoveDirectoryObject(const std::wstring& sDirectoryPath, uint32_t /*dwAttributes*/)
+{
+	if (0 == rmdir(PosixPathFromWString(sDirectoryPath).c_str()))
+		return 0;
+	return uint32_t(errno);
+}
+
+#endif // _WIN32
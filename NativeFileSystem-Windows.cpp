@@ -0,0 +1,47 @@
+// Windows implementation of NativeFileSystem (see BulkDelete.h)
+
+#include <Windows.h>
+#include "FileSystemUtils-Windows.h"
+#include "Wow64FsRedirection.h"
+#include "BulkDelete.h"
+
+// Paths at or beyond MAX_PATH need the extended-path form for DeleteFileW and RemoveDirectoryW.
+static std::wstring PathForApi(const std::wstring& sPath)
+{
+	if (sPath.length() < MAX_PATH || IsExtendedPathSpec(sPath.c_str()))
+		return sPath;
+	return PathToExtendedPath(sPath.c_str());
+}
+
+bool NativeFileSystem::Enumerate(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories)
+{
+	// GetFilesAndSubdirectories disables WOW64 file system redirection itself. Reparse points and offline
+	// files are included so that they are deleted, as the shell's delete did.
+	return GetFilesAndSubdirectories(sDirectoryPath, files, subdirectories, true);
+}
+
+uint32_t NativeFileSystem::DeleteFileObject(const std::wstring& sFilePath, uint32_t dwAttributes)
+{
+	// WOW64 redirection is a per-thread setting, and this can be called on any worker thread.
+	Wow64FsRedirection wow64FSRedir(true);
+	const std::wstring sPath = PathForApi(sFilePath);
+	// DeleteFileW fails on read-only files.
+	if (0 != (dwAttributes & FILE_ATTRIBUTE_READONLY))
+		SetFileAttributesW(sPath.c_str(), dwAttributes & ~DWORD(FILE_ATTRIBUTE_READONLY));
+	// A junction or directory symbolic link is removed as a directory; its target is left alone.
+	const BOOL bDeleted = (0 != (dwAttributes & FILE_ATTRIBUTE_DIRECTORY)) ? RemoveDirectoryW(sPath.c_str()) : DeleteFileW(sPath.c_str());
+	if (bDeleted)
+		return 0;
+	return GetLastError();
+}
+
+uint32_t NativeFileSystem::RemoveDirectoryObject(const std::wstring& sDirectoryPath, uint32_t dwAttributes)
+{
+	Wow64FsRedirection wow64FSRedir(true);
+	const std::wstring sPath = PathForApi(sDirectoryPath);
+	if (0 != (dwAttributes & FILE_ATTRIBUTE_READONLY))
+		SetFileAttributesW(sPath.c_str(), dwAttributes & ~DWORD(FILE_ATTRIBUTE_READONLY));
+	if (RemoveDirectoryW(sPath.c_str()))
+		return 0;
+	return GetLastError();
+}
@@ -0,0 +1,247 @@
+// Multithreaded directory hierarchy walker
+
+#include <thread>
+#include <algorithm>
+#include "CaseFolding.h"
+#include "Stats.h"
+#include "ParallelDirWalker.h"
+
+// Orders directory entries by name for deterministic output, as NTFS orders directory entries:
+// ordinal comparison of the upper-cased names. Names that differ only in case (possible on POSIX
+// file systems) are then ordered ordinally, so the order is still total.
+static bool DirEntryNameLess(const DirEntry_t& a, const DirEntry_t& b)
+{
+	const size_t cchCommon = std::min(a.sName.length(), b.sName.length());
+	for (size_t ix = 0; ix < cchCommon; ++ix)
+	{
+		const wchar_t chA = UpperCaseChar(a.sName[ix]), chB = UpperCaseChar(b.sName[ix]);
+		if (chA != chB)
+			return chA < chB;
+	}
+	if (a.sName.length() != b.sName.length())
+		return a.sName.length() < b.sName.length();
+	return a.sName < b.sName;
+}
+
+ParallelDirWalker::ParallelDirWalker()
+	: m_nThreads(0), m_nMaxDepth(UnlimitedDepth), m_bDeterministic(false),
+	m_pCallback(NULL), m_nOutstanding(0), m_nQueued(0), m_nDirsProcessed(0), m_nEnumFailures(0)
+{
+}
+
+bool ParallelDirWalker::Walk(const wchar_t* szRootDir, const Callback_t& callback, std::wstringstream& strErrorInfo)
+{
+	// Reset state, in case this class instance has been used before
+	m_nDirsProcessed = 0;
+	m_nEnumFailures = 0;
+	m_nQueued = 0;
+	m_results.clear();
+	m_failedDirs.clear();
+
+	// Ignore completely invalid input
+	if (NULL == szRootDir || 0 == szRootDir[0])
+	{
+		return false;
+	}
+
+	size_t nThreads = m_nThreads;
+	if (0 == nThreads)
+	{
+		nThreads = std::thread::hardware_concurrency();
+		if (0 == nThreads)
+			nThreads = 1;
+	}
+	std::vector<WorkerQueue_t>(nThreads).swap(m_queues);
+	m_pCallback = &callback;
+
+	// Process the root directory on this thread; that seeds the first worker's deque with its subdirectories.
+	PendingDir_t rootDir;
+	rootDir.sPath = szRootDir;
+	rootDir.nDepth = 0;
+	m_nOutstanding = 1;
+	ProcessDirectory(0, rootDir);
+	if (0 != m_nEnumFailures)
+	{
+		strErrorInfo << L"Cannot enumerate directory " << szRootDir << std::endl;
+		m_queues.clear();
+		m_failedDirs.clear();
+		m_pCallback = NULL;
+		return false;
+	}
+
+	// Worker 0 runs on this thread.
+	std::vector<std::thread> threads;
+	for (size_t ixWorker = 1; ixWorker < nThreads; ++ixWorker)
+	{
+		threads.push_back(std::thread(&ParallelDirWalker::WorkerProc, this, ixWorker));
+	}
+	WorkerProc(0);
+	for (std::vector<std::thread>::iterator iterThreads = threads.begin(); iterThreads != threads.end(); ++iterThreads)
+	{
+		iterThreads->join();
+	}
+
+	std::sort(m_failedDirs.begin(), m_failedDirs.end());
+	for (std::vector<std::wstring>::const_iterator iterFailed = m_failedDirs.begin(); iterFailed != m_failedDirs.end(); ++iterFailed)
+	{
+		strErrorInfo << L"Cannot enumerate " << *iterFailed << std::endl;
+	}
+	m_failedDirs.clear();
+
+	if (m_bDeterministic)
+	{
+		// Breadth-first order: shallower directories first; at the same depth, in order of the
+		// (name-sorted) positions along the path from the root.
+		std::sort(m_results.begin(), m_results.end(),
+			[](const DirResult_t& a, const DirResult_t& b)
+			{
+				if (a.nDepth != b.nDepth)
+					return a.nDepth < b.nDepth;
+				return a.sortKey < b.sortKey;
+			});
+		for (std::vector<DirResult_t>::const_iterator iterResults = m_results.begin(); iterResults != m_results.end(); ++iterResults)
+		{
+			callback(iterResults->sPath, iterResults->nDepth, iterResults->files, iterResults->subdirectories);
+		}
+		m_results.clear();
+	}
+
+	m_queues.clear();
+	m_pCallback = NULL;
+	return true;
+}
+
+void ParallelDirWalker::WorkerProc(size_t ixWorker)
+{
+	STATS_SCOPE("walk.worker");
+	PendingDir_t pendingDir;
+	// Keep going until no directories are queued or being processed anywhere.
+	while (0 != m_nOutstanding)
+	{
+		if (GetWork(ixWorker, pendingDir))
+		{
+			ProcessDirectory(ixWorker, pendingDir);
+		}
+		else
+		{
+			// Nothing available right now, but other workers may still produce subdirectories.
+			std::unique_lock<std::mutex> lock(m_idleLock);
+			m_workAvailable.wait(lock, [this]() { return 0 != m_nQueued || 0 == m_nOutstanding; });
+		}
+	}
+}
+
+void ParallelDirWalker::NotifyIdleWorkers()
+{
+	// Taking the lock orders this notification after any waiter's check of the condition,
+	// so the wakeup can't be lost between the check and the wait.
+	{
+		std::lock_guard<std::mutex> guard(m_idleLock);
+	}
+	m_workAvailable.notify_all();
+}
+
+bool ParallelDirWalker::GetWork(size_t ixWorker, PendingDir_t& pendingDir)
+{
+	// Own deque first, from the back (depth-first locally, which keeps the deque short).
+	{
+		WorkerQueue_t& ownQueue = m_queues[ixWorker];
+		std::lock_guard<std::mutex> guard(ownQueue.lock);
+		if (!ownQueue.dirs.empty())
+		{
+			pendingDir = std::move(ownQueue.dirs.back());
+			ownQueue.dirs.pop_back();
+			--m_nQueued;
+			return true;
+		}
+	}
+
+	// Steal from the front of other workers' deques, starting with the next worker.
+	const size_t nQueues = m_queues.size();
+	for (size_t ixOffset = 1; ixOffset < nQueues; ++ixOffset)
+	{
+		WorkerQueue_t& victimQueue = m_queues[(ixWorker + ixOffset) % nQueues];
+		std::lock_guard<std::mutex> guard(victimQueue.lock);
+		if (!victimQueue.dirs.empty())
+		{
+			pendingDir = std::move(victimQueue.dirs.front());
+			victimQueue.dirs.pop_front();
+			--m_nQueued;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ParallelDirWalker::ProcessDirectory(size_t ixWorker, PendingDir_t& pendingDir)
+{
+	// Enumerate the directory once for both files and subdirectories.
+	DirEntryCollection_t files, subdirectories;
+	if (!GetFilesAndSubdirectories(pendingDir.sPath, files, subdirectories))
+	{
+		++m_nEnumFailures;
+		// Nothing to report for an invalid root directory; Walk returns false.
+		if (0 == pendingDir.nDepth)
+		{
+			--m_nOutstanding;
+			return;
+		}
+		std::lock_guard<std::mutex> guard(m_resultsLock);
+		m_failedDirs.push_back(pendingDir.sPath);
+	}
+
+	if (m_bDeterministic)
+	{
+		std::sort(files.begin(), files.end(), DirEntryNameLess);
+		std::sort(subdirectories.begin(), subdirectories.end(), DirEntryNameLess);
+	}
+
+	// Queue subdirectories onto this worker's own deque, unless they'd exceed the depth limit.
+	// Count them as outstanding before this directory is counted as done, so the count can't
+	// drop to zero while work remains.
+	if (pendingDir.nDepth < m_nMaxDepth && !subdirectories.empty())
+	{
+		m_nOutstanding += subdirectories.size();
+		{
+			WorkerQueue_t& ownQueue = m_queues[ixWorker];
+			std::lock_guard<std::mutex> guard(ownQueue.lock);
+			for (size_t ixSubdir = 0; ixSubdir < subdirectories.size(); ++ixSubdir)
+			{
+				PendingDir_t subdir;
+				subdir.sPath = pendingDir.sPath + L"\\" + subdirectories[ixSubdir].sName;
+				subdir.nDepth = pendingDir.nDepth + 1;
+				if (m_bDeterministic)
+				{
+					subdir.sortKey = pendingDir.sortKey;
+					subdir.sortKey.push_back(uint32_t(ixSubdir));
+				}
+				ownQueue.dirs.push_back(std::move(subdir));
+			}
+			m_nQueued += subdirectories.size();
+		}
+		NotifyIdleWorkers();
+	}
+
+	// Deliver the results, or retain them for sorting.
+	{
+		std::lock_guard<std::mutex> guard(m_resultsLock);
+		if (m_bDeterministic)
+		{
+			m_results.push_back(DirResult_t());
+			DirResult_t& result = m_results.back();
+			result.sPath = std::move(pendingDir.sPath);
+			result.nDepth = pendingDir.nDepth;
+			result.sortKey = std::move(pendingDir.sortKey);
+			result.files.swap(files);
+			result.subdirectories.swap(subdirectories);
+		}
+		else
+		{
+			(*m_pCallback)(pendingDir.sPath, pendingDir.nDepth, files, subdirectories);
+		}
+	}
+
+	++m_nDirsProcessed;
+	if (0 == --m_nOutstanding)
+		NotifyIdleWorkers();
+}
@@ -0,0 +1,166 @@
+// Multithreaded directory hierarchy walker
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include "GetFilesAndSubdirectories.h"
+
+/// <summary>
+/// Class to process entire directory hierarchies with multiple worker threads, for large scans where
+/// the single-threaded DirWalker is bound by I/O latency.
+///
+/// Each worker thread has its own deque of directories to process. A worker enumerates a directory once
+/// (GetFilesAndSubdirectories), pushes the subdirectories onto its own deque, and takes its next directory
+/// from the back of its own deque. A worker whose deque is empty steals from the front of another worker's
+/// deque, which hands out the oldest (and typically largest) pending subtrees. A worker that finds no work
+/// anywhere waits on a condition variable until another worker queues subdirectories or the walk completes.
+///
+/// For each directory processed, the callback receives the directory's full path, depth (the root is depth 0),
+/// and its files and subdirectories. Callback invocations are serialized, so the callback does not need to be
+/// thread-safe, but it should return quickly.
+///
+/// With deterministic ordering requested, the callback is instead invoked from the Walk caller's thread after
+/// all workers finish, in breadth-first order like DirWalker, with files and subdirectories sorted by name
+/// the way NTFS enumerates them (ordinal comparison of upper-cased names), so the order matches a DirWalker
+/// walk of an NTFS volume. This holds the results for the entire hierarchy in memory until the walk completes.
+///
+/// ListDirectoryHierarchy uses this class when the caller doesn't need entries in walk order (-911 -list -sort).
+///
+/// Usage:
+/// void SampleFn(const wchar_t* szRootDir)
+/// {
+/// 	ParallelDirWalker dirWalker;
+/// 	dirWalker.SetConcurrency(8);
+/// 	std::wstringstream strErrorInfo;
+/// 	dirWalker.Walk(szRootDir,
+/// 		[](const std::wstring& sDir, size_t nDepth, const DirEntryCollection_t& files, const DirEntryCollection_t& subdirs)
+/// 		{
+/// 			// Do things with sDir's files...
+/// 		},
+/// 		strErrorInfo);
+/// }
+/// </summary>
+class ParallelDirWalker
+{
+public:
+	/// <summary>
+	/// Callback invoked once for each directory processed.
+	/// </summary>
+	typedef std::function<void(const std::wstring& sDirectory, size_t nDepth, const DirEntryCollection_t& files, const DirEntryCollection_t& subdirectories)> Callback_t;
+
+	/// <summary>
+	/// Value for SetMaxDepth indicating no depth limit.
+	/// </summary>
+	static const size_t UnlimitedDepth = size_t(-1);
+
+	// Constructor
+	ParallelDirWalker();
+	// Destructor
+	~ParallelDirWalker() = default;
+
+	/// <summary>
+	/// Sets the number of worker threads. 0 (the default) means one per hardware thread.
+	/// </summary>
+	void SetConcurrency(size_t nThreads) { m_nThreads = nThreads; }
+
+	/// <summary>
+	/// Sets the maximum depth of directories to process, where the root directory is depth 0
+	/// and its subdirectories are depth 1. Default is UnlimitedDepth.
+	/// </summary>
+	void SetMaxDepth(size_t nMaxDepth) { m_nMaxDepth = nMaxDepth; }
+
+	/// <summary>
+	/// Requests callback invocation in deterministic (DirWalker breadth-first, name-sorted) order.
+	/// </summary>
+	void SetDeterministicOrder(bool bDeterministic) { m_bDeterministic = bDeterministic; }
+
+	/// <summary>
+	/// Walks the directory hierarchy under szRootDir, invoking the callback for each directory.
+	/// Returns when all directories have been processed.
+	/// </summary>
+	/// <param name="szRootDir">Input: root directory of hierarchy to scan</param>
+	/// <param name="callback">Input: function to invoke for each directory</param>
+	/// <param name="strErrorInfo">Output: error info (e.g., if invalid input directory), including each directory that could not be enumerated</param>
+	/// <returns>true if the root directory could be enumerated; false otherwise</returns>
+	bool Walk(const wchar_t* szRootDir, const Callback_t& callback, std::wstringstream& strErrorInfo);
+
+	/// <summary>
+	/// Number of directories processed by the most recent Walk.
+	/// </summary>
+	size_t DirectoriesProcessed() const { return m_nDirsProcessed; }
+
+	/// <summary>
+	/// Number of directories that could not be enumerated during the most recent Walk.
+	/// </summary>
+	size_t EnumerationFailures() const { return m_nEnumFailures; }
+
+private:
+	// A directory waiting to be processed. The sort key is the sequence of child positions from the root
+	// and is used only for deterministic ordering.
+	struct PendingDir_t
+	{
+		std::wstring sPath;
+		size_t nDepth;
+		std::vector<uint32_t> sortKey;
+	};
+
+	// A processed directory, retained only for deterministic ordering.
+	struct DirResult_t
+	{
+		std::wstring sPath;
+		size_t nDepth;
+		std::vector<uint32_t> sortKey;
+		DirEntryCollection_t files, subdirectories;
+	};
+
+	// Per-worker deque of pending directories, with the lock that guards it.
+	struct WorkerQueue_t
+	{
+		std::mutex lock;
+		std::deque<PendingDir_t> dirs;
+	};
+
+	// Worker thread body
+	void WorkerProc(size_t ixWorker);
+	// Gets the next directory for a worker: from the back of its own deque, else stolen from the front of another's.
+	bool GetWork(size_t ixWorker, PendingDir_t& pendingDir);
+	// Enumerates one directory, queues its subdirectories, and delivers or retains its results.
+	void ProcessDirectory(size_t ixWorker, PendingDir_t& pendingDir);
+	// Wakes idle workers after directories are queued or the walk completes
+	void NotifyIdleWorkers();
+
+private:
+	size_t m_nThreads;
+	size_t m_nMaxDepth;
+	bool m_bDeterministic;
+
+	// State for the current walk
+	const Callback_t* m_pCallback;
+	std::vector<WorkerQueue_t> m_queues;
+	// Directories queued or being processed; the walk is complete when this reaches zero.
+	std::atomic<size_t> m_nOutstanding;
+	// Directories queued and not yet taken by a worker
+	std::atomic<size_t> m_nQueued;
+	// Idle workers wait on m_workAvailable until m_nQueued is nonzero or m_nOutstanding is zero.
+	std::mutex m_idleLock;
+	std::condition_variable m_workAvailable;
+	std::atomic<size_t> m_nDirsProcessed;
+	std::atomic<size_t> m_nEnumFailures;
+	// Serializes callbacks (or additions to m_results for deterministic ordering)
+	std::mutex m_resultsLock;
+	std::vector<DirResult_t> m_results;
+	// Directories that could not be enumerated; guarded by m_resultsLock
+	std::vector<std::wstring> m_failedDirs;
+
+private:
+	// Not implemented
+	ParallelDirWalker(const ParallelDirWalker&) = delete;
+	ParallelDirWalker& operator = (const ParallelDirWalker&) = delete;
+};
@@ -0,0 +1,119 @@
+// Compact storage for the paths of the files and directories in a directory hierarchy
+
+#include <algorithm>
+#include <cstddef>
+#include "PathStore.h"
+
+PathStore::PathId_t PathStore::AddRoot(const std::wstring& sRootPath)
+{
+	return Add(InvalidId, sRootPath.c_str(), sRootPath.length());
+}
+
+PathStore::PathId_t PathStore::Add(PathId_t parentId, const wchar_t* szName, size_t cchName)
+{
+	// IDs are 32 bits; InvalidId is reserved.
+	if ((InvalidId != parentId && parentId >= m_nodes.size()) || m_nodes.size() >= size_t(InvalidId) || cchName > UINT32_MAX)
+		return InvalidId;
+
+	Node_t node;
+	node.ixName = m_names.size();
+	node.cchName = uint32_t(cchName);
+	node.parentId = parentId;
+	m_names.insert(m_names.end(), szName, szName + cchName);
+	m_nodes.push_back(node);
+	return PathId_t(m_nodes.size() - 1);
+}
+
+std::wstring PathStore::FullPath(PathId_t id) const
+{
+	std::wstring sPath;
+	FullPath(id, sPath);
+	return sPath;
+}
+
+void PathStore::FullPath(PathId_t id, std::wstring& sPath) const
+{
+	sPath.clear();
+	if (id >= m_nodes.size())
+		return;
+
+	// First pass up the parent chain gets the total length, so the path can be built with one allocation.
+	size_t cchPath = 0;
+	for (PathId_t ixNode = id; InvalidId != ixNode; ixNode = m_nodes[ixNode].parentId)
+	{
+		cchPath += m_nodes[ixNode].cchName;
+		if (InvalidId != m_nodes[ixNode].parentId)
+			++cchPath; // separator
+	}
+
+	// Second pass fills in the names from the end of the path back to the start.
+	sPath.resize(cchPath);
+	size_t ixEnd = cchPath;
+	for (PathId_t ixNode = id; InvalidId != ixNode; ixNode = m_nodes[ixNode].parentId)
+	{
+		const Node_t& node = m_nodes[ixNode];
+		ixEnd -= node.cchName;
+		if (node.cchName > 0)
+			sPath.replace(ixEnd, node.cchName, &m_names[node.ixName], node.cchName);
+		if (InvalidId != node.parentId)
+			sPath[--ixEnd] = L'\\';
+	}
+}
+
+std::wstring PathStore::Name(PathId_t id) const
+{
+	if (id >= m_nodes.size() || 0 == m_nodes[id].cchName)
+		return std::wstring();
+	const Node_t& node = m_nodes[id];
+	return std::wstring(&m_names[node.ixName], node.cchName);
+}
+
+void PathStore::Clear()
+{
+	m_nodes.clear();
+	m_names.clear();
+}
+
+void PathStore::Compact(std::vector<PathId_t>& ids)
+{
+	// Mark the nodes to keep. A parent is always added before its children, so parents keep lower IDs.
+	std::vector<PathId_t> newIds(m_nodes.size(), InvalidId);
+	const PathId_t keep = 0;
+	for (std::vector<PathId_t>::const_iterator iterIds = ids.begin(); iterIds != ids.end(); ++iterIds)
+	{
+		for (PathId_t ixNode = *iterIds; InvalidId != ixNode && ixNode < m_nodes.size() && InvalidId == newIds[ixNode]; ixNode = m_nodes[ixNode].parentId)
+			newIds[ixNode] = keep;
+	}
+
+	// Move the kept nodes and their names down, in ID order, so each parent is moved before its children.
+	size_t nKept = 0, cchKept = 0;
+	for (size_t ixNode = 0; ixNode < m_nodes.size(); ++ixNode)
+	{
+		if (InvalidId == newIds[ixNode])
+			continue;
+		Node_t node = m_nodes[ixNode];
+		if (node.cchName > 0)
+			std::copy(m_names.begin() + std::ptrdiff_t(node.ixName), m_names.begin() + std::ptrdiff_t(node.ixName + node.cchName), m_names.begin() + std::ptrdiff_t(cchKept));
+		node.ixName = cchKept;
+		if (InvalidId != node.parentId)
+			node.parentId = newIds[node.parentId];
+		cchKept += node.cchName;
+		newIds[ixNode] = PathId_t(nKept);
+		m_nodes[nKept++] = node;
+	}
+	m_nodes.resize(nKept);
+	m_names.resize(cchKept);
+	m_nodes.shrink_to_fit();
+	m_names.shrink_to_fit();
+
+	for (std::vector<PathId_t>::iterator iterIds = ids.begin(); iterIds != ids.end(); ++iterIds)
+	{
+		*iterIds = (*iterIds < newIds.size()) ? newIds[*iterIds] : InvalidId;
+	}
+}
+
+void PathStore::Reserve(size_t nNodes, size_t cchNames)
+{
+	m_nodes.reserve(nNodes);
+	m_names.reserve(cchNames);
+}
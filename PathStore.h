@@ -0,0 +1,122 @@
+// Compact storage for the paths of the files and directories in a directory hierarchy
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// Stores a hierarchy of paths compactly, for walks that must retain many paths at once.
+///
+/// Each path is a node that refers to its parent directory's node by ID, plus the path's last
+/// component (its name). The names' characters are appended to a single arena, so a node has
+/// no per-path heap allocation, and each directory's path is stored only once no matter how many
+/// entries it contains. A root node holds an entire path (e.g., "C:\Windows\System32\AppLocker")
+/// as its name and has no parent.
+///
+/// Full paths are built only on request: FullPath joins the names from the root down with
+/// backslashes. Node IDs remain valid until Clear or Compact is called.
+///
+/// Adding nodes is not thread-safe. Once the nodes are added, any number of threads can read the store
+/// at the same time.
+/// </summary>
+class PathStore
+{
+public:
+	typedef uint32_t PathId_t;
+
+	/// <summary>
+	/// Parent ID of root nodes, and the ID returned when a node cannot be added.
+	/// </summary>
+	static const PathId_t InvalidId = UINT32_MAX;
+
+	// Constructor
+	PathStore() = default;
+	// Destructor
+	~PathStore() = default;
+
+	/// <summary>
+	/// Adds a root node: a complete path with no parent in the store.
+	/// </summary>
+	/// <returns>The new node's ID</returns>
+	PathId_t AddRoot(const std::wstring& sRootPath);
+
+	/// <summary>
+	/// Adds a node for an entry in the directory identified by parentId.
+	/// </summary>
+	/// <param name="parentId">Input: ID of the parent directory's node</param>
+	/// <param name="szName">Input: the entry's name (not NUL-terminated)</param>
+	/// <param name="cchName">Input: number of characters in the name</param>
+	/// <returns>The new node's ID, or InvalidId if parentId is not valid</returns>
+	PathId_t Add(PathId_t parentId, const wchar_t* szName, size_t cchName);
+
+	/// <summary>
+	/// Adds a node for an entry in the directory identified by parentId.
+	/// </summary>
+	PathId_t Add(PathId_t parentId, const std::wstring& sName) { return Add(parentId, sName.c_str(), sName.length()); }
+
+	/// <summary>
+	/// Returns the full path of a node.
+	/// </summary>
+	std::wstring FullPath(PathId_t id) const;
+
+	/// <summary>
+	/// Writes the full path of a node into sPath, reusing sPath's buffer.
+	/// </summary>
+	void FullPath(PathId_t id, std::wstring& sPath) const;
+
+	/// <summary>
+	/// Returns a node's name: the last component of its path, or the whole path of a root node.
+	/// </summary>
+	std::wstring Name(PathId_t id) const;
+
+	/// <summary>
+	/// Returns the ID of a node's parent, or InvalidId for a root node.
+	/// </summary>
+	PathId_t Parent(PathId_t id) const { return m_nodes[id].parentId; }
+
+	/// <summary>
+	/// Number of nodes in the store.
+	/// </summary>
+	size_t Count() const { return m_nodes.size(); }
+
+	/// <summary>
+	/// Approximate number of bytes of memory the store occupies.
+	/// </summary>
+	size_t MemoryUsage() const { return m_nodes.capacity() * sizeof(Node_t) + m_names.capacity() * sizeof(wchar_t); }
+
+	/// <summary>
+	/// Removes all nodes.
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// Releases the nodes that are no longer needed: keeps only the nodes in ids and their ancestors, and
+	/// replaces each ID in ids with the node's new ID. All other IDs become invalid.
+	/// </summary>
+	/// <param name="ids">Input/output: IDs of the nodes to keep; on return, their new IDs</param>
+	void Compact(std::vector<PathId_t>& ids);
+
+	/// <summary>
+	/// Reserves space for an expected number of nodes and name characters.
+	/// </summary>
+	void Reserve(size_t nNodes, size_t cchNames);
+
+private:
+	struct Node_t
+	{
+		// Offset of the name's first character in m_names
+		size_t ixName;
+		uint32_t cchName;
+		PathId_t parentId;
+	};
+	std::vector<Node_t> m_nodes;
+	// Characters of all the names, without separators or terminators
+	std::vector<wchar_t> m_names;
+
+private:
+	// Not implemented
+	PathStore(const PathStore&) = delete;
+	PathStore& operator = (const PathStore&) = delete;
+};
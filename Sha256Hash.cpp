@@ -0,0 +1,106 @@
+// SHA-256 hashing with CNG
+
+#include <vector>
+#include "Sha256Hash.h"
+#include "FileSystemUtils-Windows.h"
+#include "SysErrorMessage.h"
+
+#pragma comment(lib, "bcrypt.lib")
+
+// Size of the buffer used for reading files
+static const DWORD cbFileChunk = 64 * 1024;
+
+Sha256Hash::Sha256Hash()
+	: m_hAlg(NULL), m_hHash(NULL)
+{
+	if (BCryptOpenAlgorithmProvider(&m_hAlg, BCRYPT_SHA256_ALGORITHM, NULL, 0) >= 0)
+	{
+		if (BCryptCreateHash(m_hAlg, &m_hHash, NULL, 0, NULL, 0, 0) < 0)
+			m_hHash = NULL;
+	}
+	else
+	{
+		m_hAlg = NULL;
+	}
+}
+
+Sha256Hash::~Sha256Hash()
+{
+	if (NULL != m_hHash)
+		BCryptDestroyHash(m_hHash);
+	if (NULL != m_hAlg)
+		BCryptCloseAlgorithmProvider(m_hAlg, 0);
+}
+
+bool Sha256Hash::Update(const void* pData, size_t cbData)
+{
+	if (NULL == m_hHash)
+		return false;
+	// BCryptHashData takes a 32-bit length
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	while (cbData > 0)
+	{
+		const ULONG cbThis = (cbData > 0x40000000) ? 0x40000000 : ULONG(cbData);
+		if (BCryptHashData(m_hHash, const_cast<PUCHAR>(pBytes), cbThis, 0) < 0)
+			return false;
+		pBytes += cbThis;
+		cbData -= cbThis;
+	}
+	return true;
+}
+
+bool Sha256Hash::Finish(std::wstring& sHash)
+{
+	static const wchar_t szHexDigits[] = L"0123456789abcdef";
+	uint8_t hash[32];
+	sHash.clear();
+	if (NULL == m_hHash || BCryptFinishHash(m_hHash, hash, sizeof(hash), 0) < 0)
+		return false;
+	for (size_t ix = 0; ix < sizeof(hash); ++ix)
+	{
+		sHash.push_back(szHexDigits[hash[ix] >> 4]);
+		sHash.push_back(szHexDigits[hash[ix] & 0x0F]);
+	}
+	return true;
+}
+
+bool Sha256HashFile(const std::wstring& sFilePath, std::wstring& sHash, std::wstring& sErrorInfo)
+{
+	sHash.clear();
+	DWORD dwLastErr = 0;
+	std::wstring sAltName;
+	HANDLE hFile = OpenExistingFile_ExtendedPath(sFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, dwLastErr, sAltName);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		sErrorInfo = sFilePath + L": " + SysErrorMessage(dwLastErr);
+		return false;
+	}
+
+	Sha256Hash hash;
+	std::vector<uint8_t> buffer(cbFileChunk);
+	bool bOK = hash.OK();
+	while (bOK)
+	{
+		DWORD cbRead = 0;
+		if (!ReadFile(hFile, buffer.data(), cbFileChunk, &cbRead, NULL))
+		{
+			sErrorInfo = sFilePath + L": " + SysErrorMessage();
+			bOK = false;
+		}
+		else if (0 == cbRead)
+		{
+			break;
+		}
+		else
+		{
+			bOK = hash.Update(buffer.data(), cbRead);
+		}
+	}
+	CloseHandle(hFile);
+
+	if (bOK && !hash.Finish(sHash))
+		bOK = false;
+	if (!bOK && sErrorInfo.empty())
+		sErrorInfo = L"Cannot compute hash of " + sFilePath;
+	return bOK;
+}
@@ -0,0 +1,59 @@
+// SHA-256 hashing with CNG
+
+#pragma once
+
+#include <Windows.h>
+#include <bcrypt.h>
+#include <string>
+#include <cstdint>
+
+/// <summary>
+/// Incremental SHA-256 using CNG (BCrypt).
+///
+/// Usage:
+/// 	Sha256Hash hash;
+/// 	if (hash.OK() && hash.Update(pData, cbData) && hash.Finish(sHash)) ...
+/// </summary>
+class Sha256Hash
+{
+public:
+	// Constructor
+	Sha256Hash();
+	// Destructor
+	~Sha256Hash();
+
+	/// <summary>
+	/// true if the hash object was created successfully.
+	/// </summary>
+	bool OK() const { return NULL != m_hHash; }
+
+	/// <summary>
+	/// Adds data to the hash.
+	/// </summary>
+	bool Update(const void* pData, size_t cbData);
+
+	/// <summary>
+	/// Finishes the hash and returns it as 64 lower-case hex digits.
+	/// The object can't be updated after this.
+	/// </summary>
+	bool Finish(std::wstring& sHash);
+
+private:
+	BCRYPT_ALG_HANDLE m_hAlg;
+	BCRYPT_HASH_HANDLE m_hHash;
+
+private:
+	// Not implemented
+	Sha256Hash(const Sha256Hash&) = delete;
+	Sha256Hash& operator = (const Sha256Hash&) = delete;
+};
+
+/// <summary>
+/// Computes the SHA-256 hash of a file's content, reading it in fixed-size chunks.
+/// Handles paths that need the extended-path form.
+/// </summary>
+/// <param name="sFilePath">Input: full path to the file</param>
+/// <param name="sHash">Output: 64 lower-case hex digits</param>
+/// <param name="sErrorInfo">Output: error information on failure</param>
+/// <returns>true if successful, false otherwise</returns>
+bool Sha256HashFile(const std::wstring& sFilePath, std::wstring& sHash, std::wstring& sErrorInfo);
@@ -0,0 +1,250 @@
+// SID-to-name resolution with batching and caching
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <sddl.h>
+#include <ntsecapi.h>
+#endif
+#include <unordered_set>
+#include "SidStrings.h"
+#include "SidNameResolver.h"
+
+// ------------------------------------------------------------------------------------------
+// LsaSidLookup
+
+#ifdef _WIN32
+// Converts an LSA counted string, which isn't necessarily NUL-terminated.
+static std::wstring FromLsaUnicodeString(const LSA_UNICODE_STRING& lsaString)
+{
+	if (NULL == lsaString.Buffer)
+		return std::wstring();
+	return std::wstring(lsaString.Buffer, lsaString.Length / sizeof(WCHAR));
+}
+
+bool LsaSidLookup::LookupSids(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names)
+{
+	names.assign(sids.size(), SidName_t());
+
+	// Convert the valid SID strings; remember which input each converted SID came from.
+	std::vector<PSID> psids;
+	std::vector<size_t> inputIndexes;
+	psids.reserve(sids.size());
+	inputIndexes.reserve(sids.size());
+	for (size_t ixSid = 0; ixSid < sids.size(); ++ixSid)
+	{
+		PSID pSid = NULL;
+		if (ConvertStringSidToSidW(sids[ixSid].c_str(), &pSid))
+		{
+			psids.push_back(pSid);
+			inputIndexes.push_back(ixSid);
+		}
+	}
+
+	// Invalid SID strings can't be resolved, but that isn't a failure of the lookup.
+	bool retval = true;
+	LSA_OBJECT_ATTRIBUTES objectAttributes = { 0 };
+	LSA_HANDLE hPolicy = NULL;
+	if (!psids.empty() && 0 > LsaOpenPolicy(NULL, &objectAttributes, POLICY_LOOKUP_NAMES, &hPolicy))
+	{
+		retval = false;
+	}
+	else if (!psids.empty())
+	{
+		PLSA_REFERENCED_DOMAIN_LIST pDomains = NULL;
+		PLSA_TRANSLATED_NAME pNames = NULL;
+		// Success codes include STATUS_SOME_NOT_MAPPED. STATUS_NONE_MAPPED means the lookup was made but
+		// resolved nothing; other negative codes mean it failed.
+		const NTSTATUS status = LsaLookupSids2(hPolicy, 0, ULONG(psids.size()), psids.data(), &pDomains, &pNames);
+		const NTSTATUS statusNoneMapped = NTSTATUS(0xC0000073L);
+		if (0 > status && statusNoneMapped != status)
+			retval = false;
+		if (0 <= status && NULL != pNames)
+		{
+			for (size_t ixPsid = 0; ixPsid < psids.size(); ++ixPsid)
+			{
+				const LSA_TRANSLATED_NAME& translated = pNames[ixPsid];
+				if (SidTypeUnknown == translated.Use || SidTypeInvalid == translated.Use)
+					continue;
+				SidName_t& name = names[inputIndexes[ixPsid]];
+				name.bResolved = true;
+				name.sUserName = FromLsaUnicodeString(translated.Name);
+				if (NULL != pDomains && 0 <= translated.DomainIndex && ULONG(translated.DomainIndex) < pDomains->Entries)
+					name.sDomainName = FromLsaUnicodeString(pDomains->Domains[translated.DomainIndex].Name);
+			}
+		}
+		if (NULL != pDomains)
+			LsaFreeMemory(pDomains);
+		if (NULL != pNames)
+			LsaFreeMemory(pNames);
+		LsaClose(hPolicy);
+	}
+
+	for (PSID pSid : psids)
+		LocalFree(pSid);
+	return retval;
+}
+#endif
+
+// ------------------------------------------------------------------------------------------
+// MapSidLookup
+
+void MapSidLookup::Add(const std::wstring& sSid, const std::wstring& sDomainName, const std::wstring& sUserName)
+{
+	SidName_t& name = m_names[sSid];
+	name.bResolved = true;
+	name.sDomainName = sDomainName;
+	name.sUserName = sUserName;
+}
+
+bool MapSidLookup::LookupSids(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names)
+{
+	++m_nCalls;
+	m_nSids += sids.size();
+	{
+		std::lock_guard<std::mutex> guard(m_lastSidsLock);
+		m_lastSids = sids;
+	}
+	names.assign(sids.size(), SidName_t());
+	if (m_bFailing)
+		return false;
+	for (size_t ixSid = 0; ixSid < sids.size(); ++ixSid)
+	{
+		const auto iter = m_names.find(sids[ixSid]);
+		if (m_names.end() != iter)
+			names[ixSid] = iter->second;
+	}
+	return true;
+}
+
+std::vector<std::wstring> MapSidLookup::LastSids() const
+{
+	std::lock_guard<std::mutex> guard(m_lastSidsLock);
+	return m_lastSids;
+}
+
+// ------------------------------------------------------------------------------------------
+// SidNameResolver
+
+SidNameResolver::SidNameResolver(ISidLookup& lookup, uint32_t nTtlSeconds, uint32_t nUnresolvedTtlSeconds)
+	: m_lookup(lookup),
+	m_ttl(std::chrono::duration_cast<Clock_t::duration>(std::chrono::seconds(nTtlSeconds))),
+	m_unresolvedTtl(std::chrono::duration_cast<Clock_t::duration>(std::chrono::seconds(nUnresolvedTtlSeconds))),
+	m_bWellKnownLoaded(false),
+	m_bWellKnownLoading(false)
+{
+}
+
+#ifdef _WIN32
+SidNameResolver& SidNameResolver::Default()
+{
+	static LsaSidLookup lsaLookup;
+	static SidNameResolver resolver(lsaLookup);
+	return resolver;
+}
+#endif
+
+bool SidNameResolver::Lookup(const std::wstring& sSid, SidName_t& name)
+{
+	std::vector<SidName_t> names;
+	LookupBatch(std::vector<std::wstring>(1, sSid), names);
+	name = names[0];
+	return name.bResolved;
+}
+
+bool SidNameResolver::LookupInBatches(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names)
+{
+	names.clear();
+	names.reserve(sids.size());
+	for (size_t ixStart = 0; ixStart < sids.size(); ixStart += nMaxBatch)
+	{
+		const size_t nCount = (sids.size() - ixStart < nMaxBatch) ? sids.size() - ixStart : nMaxBatch;
+		const std::vector<std::wstring> batch(sids.begin() + ptrdiff_t(ixStart), sids.begin() + ptrdiff_t(ixStart + nCount));
+		std::vector<SidName_t> batchNames;
+		if (!m_lookup.LookupSids(batch, batchNames))
+			return false;
+		batchNames.resize(nCount);
+		names.insert(names.end(), batchNames.begin(), batchNames.end());
+	}
+	return true;
+}
+
+void SidNameResolver::LoadWellKnown()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if (m_bWellKnownLoaded || m_bWellKnownLoading)
+			return;
+		m_bWellKnownLoading = true;
+	}
+
+	const std::vector<std::wstring> wellKnown(SidString::AllWellKnown, SidString::AllWellKnown + SidString::nAllWellKnown);
+	std::vector<SidName_t> resolved;
+	const bool bLookedUp = LookupInBatches(wellKnown, resolved);
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_bWellKnownLoading = false;
+	if (!bLookedUp)
+		return;
+	m_bWellKnownLoaded = true;
+	const Clock_t::time_point now = Clock_t::now();
+	for (size_t ixWellKnown = 0; ixWellKnown < wellKnown.size(); ++ixWellKnown)
+	{
+		Entry_t& entry = m_cache[wellKnown[ixWellKnown]];
+		entry.name = resolved[ixWellKnown];
+		entry.expires = entry.name.bResolved ? Clock_t::time_point::max() : now + m_unresolvedTtl;
+	}
+}
+
+void SidNameResolver::LookupBatch(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names)
+{
+	names.assign(sids.size(), SidName_t());
+	LoadWellKnown();
+
+	// Serve what the cache has; collect the distinct SIDs it doesn't.
+	std::vector<std::wstring> toLookUp;
+	std::vector<size_t> missing;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		const Clock_t::time_point now = Clock_t::now();
+		std::unordered_set<std::wstring> queued;
+		for (size_t ixSid = 0; ixSid < sids.size(); ++ixSid)
+		{
+			const auto iter = m_cache.find(sids[ixSid]);
+			if (m_cache.end() != iter && now < iter->second.expires)
+			{
+				names[ixSid] = iter->second.name;
+				continue;
+			}
+			missing.push_back(ixSid);
+			if (queued.insert(sids[ixSid]).second)
+				toLookUp.push_back(sids[ixSid]);
+		}
+	}
+	if (toLookUp.empty())
+		return;
+
+	// Look up without holding the lock. If the lookup fails, the SIDs are reported unresolved and not cached.
+	std::vector<SidName_t> resolved;
+	if (!LookupInBatches(toLookUp, resolved))
+		return;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	const Clock_t::time_point now = Clock_t::now();
+	std::unordered_map<std::wstring, const SidName_t*> byString;
+	for (size_t ixLookedUp = 0; ixLookedUp < toLookUp.size(); ++ixLookedUp)
+	{
+		Entry_t& entry = m_cache[toLookUp[ixLookedUp]];
+		entry.name = resolved[ixLookedUp];
+		entry.expires = now + (entry.name.bResolved ? m_ttl : m_unresolvedTtl);
+		byString[toLookUp[ixLookedUp]] = &entry.name;
+	}
+	for (size_t ixSid : missing)
+		names[ixSid] = *byString[sids[ixSid]];
+}
+
+void SidNameResolver::Clear()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_cache.clear();
+	m_bWellKnownLoaded = false;
+}
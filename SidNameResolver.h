@@ -0,0 +1,206 @@
+// SID-to-name resolution with batching and caching
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+/// <summary>
+/// Result of resolving one SID to an account name.
+/// </summary>
+struct SidName_t
+{
+	bool bResolved;
+	std::wstring sDomainName;
+	std::wstring sUserName;
+
+	SidName_t() : bResolved(false) {}
+
+	/// <summary>
+	/// "DOMAIN\USERNAME", or just "USERNAME" if there's no domain (e.g., "Everyone");
+	/// empty string if not resolved.
+	/// </summary>
+	std::wstring DomainAndUsername() const
+	{
+		if (!bResolved)
+			return std::wstring();
+		return sDomainName.empty() ? sUserName : sDomainName + L"\\" + sUserName;
+	}
+};
+
+/// <summary>
+/// Resolves SIDs (in string form, e.g., "S-1-5-32-544") to account names, many per call.
+/// LsaSidLookup resolves them through the LSA on Windows; tests and tools can substitute another
+/// implementation, such as MapSidLookup.
+/// Implementations must be safe to call from multiple threads at once.
+/// </summary>
+class ISidLookup
+{
+public:
+	virtual ~ISidLookup() {}
+
+	/// <summary>
+	/// Resolves the SIDs. On return, names has one entry per SID, in the same order.
+	/// </summary>
+	/// <returns>true if the lookup was made, even if some or all SIDs weren't resolved; false if it couldn't be made (e.g., the LSA is unavailable)</returns>
+	virtual bool LookupSids(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names) = 0;
+};
+
+#ifdef _WIN32
+/// <summary>
+/// ISidLookup implementation with LsaLookupSids2: one LSA call per batch instead of one
+/// LookupAccountSidW call (and, on domain-joined computers, possibly one domain controller round
+/// trip) per SID.
+/// </summary>
+class LsaSidLookup : public ISidLookup
+{
+public:
+	bool LookupSids(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names) override;
+};
+#endif
+
+/// <summary>
+/// ISidLookup implementation from a fixed table of names, for tests and for platforms without an LSA.
+/// Counts calls and SIDs looked up, and can be made to fail, as an unavailable LSA would.
+/// Add must not be called concurrently with LookupSids.
+/// </summary>
+class MapSidLookup : public ISidLookup
+{
+public:
+	/// <summary>
+	/// Adds a SID and its name to the table.
+	/// </summary>
+	void Add(const std::wstring& sSid, const std::wstring& sDomainName, const std::wstring& sUserName);
+
+	bool LookupSids(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names) override;
+
+	/// <summary>
+	/// Makes subsequent LookupSids calls fail (resolving nothing and returning false), or succeed again.
+	/// </summary>
+	void SetFailing(bool bFailing) { m_bFailing = bFailing; }
+
+	/// <summary>
+	/// SIDs passed to the most recent LookupSids call
+	/// </summary>
+	std::vector<std::wstring> LastSids() const;
+
+	/// <summary>
+	/// Number of LookupSids calls so far
+	/// </summary>
+	size_t Calls() const { return m_nCalls; }
+
+	/// <summary>
+	/// Number of SIDs looked up so far
+	/// </summary>
+	size_t SidsLookedUp() const { return m_nSids; }
+
+private:
+	std::unordered_map<std::wstring, SidName_t> m_names;
+	std::atomic<size_t> m_nCalls{ 0 };
+	std::atomic<size_t> m_nSids{ 0 };
+	std::atomic<bool> m_bFailing{ false };
+	mutable std::mutex m_lastSidsLock;
+	std::vector<std::wstring> m_lastSids;
+};
+
+/// <summary>
+/// Caches SID-to-name resolution from an ISidLookup.
+///
+/// Lookup resolves one SID; LookupBatch resolves many, looking up only the distinct SIDs that aren't
+/// cached, in a single call to the ISidLookup (or a few, for very large batches).
+/// Resolved names are cached for a time-to-live, after which they are looked up again (e.g., an account
+/// might have been renamed). SIDs that the ISidLookup looked up but couldn't resolve are cached for a
+/// shorter time (e.g., an account might be created). Nothing is cached from a failed ISidLookup call, so
+/// the next request tries again.
+///
+/// The well-known SIDs in SidString::AllWellKnown are looked up in a call of their own before the first
+/// batch, and those resolved are cached without expiration, so they never cost another call. If that call
+/// fails, it is retried before the next batch. They are resolved by the ISidLookup rather than from a
+/// built-in table so that their names are localized as the system has them.
+///
+/// Safe to use from multiple threads; calls to the ISidLookup are made without holding the cache lock.
+/// </summary>
+class SidNameResolver
+{
+public:
+	/// <summary>
+	/// Default time-to-live for cached results
+	/// </summary>
+	static const uint32_t nDefaultTtlSeconds = 600;
+
+	/// <summary>
+	/// Default time-to-live for cached SIDs that couldn't be resolved
+	/// </summary>
+	static const uint32_t nDefaultUnresolvedTtlSeconds = 30;
+
+	/// <summary>
+	/// Maximum number of SIDs passed to the ISidLookup in one call
+	/// </summary>
+	static const size_t nMaxBatch = 1000;
+
+	// Constructor
+	explicit SidNameResolver(ISidLookup& lookup, uint32_t nTtlSeconds = nDefaultTtlSeconds, uint32_t nUnresolvedTtlSeconds = nDefaultUnresolvedTtlSeconds);
+	// Default destructor
+	~SidNameResolver() = default;
+
+#ifdef _WIN32
+	/// <summary>
+	/// Process-wide resolver that uses LsaSidLookup, created on first use.
+	/// </summary>
+	static SidNameResolver& Default();
+#endif
+
+	/// <summary>
+	/// Resolves one SID.
+	/// </summary>
+	/// <param name="sSid">Input: SID in string form</param>
+	/// <param name="name">Output: resolution result</param>
+	/// <returns>true if the SID was resolved</returns>
+	bool Lookup(const std::wstring& sSid, SidName_t& name);
+
+	/// <summary>
+	/// Resolves many SIDs. Duplicates are looked up only once.
+	/// </summary>
+	/// <param name="sids">Input: SIDs in string form</param>
+	/// <param name="names">Output: one result per SID, in the same order</param>
+	void LookupBatch(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names);
+
+	/// <summary>
+	/// Discards all cached results.
+	/// </summary>
+	void Clear();
+
+private:
+	typedef std::chrono::steady_clock Clock_t;
+	struct Entry_t
+	{
+		SidName_t name;
+		// Clock_t::time_point::max() for well-known SIDs
+		Clock_t::time_point expires;
+	};
+
+	ISidLookup& m_lookup;
+	Clock_t::duration m_ttl;
+	Clock_t::duration m_unresolvedTtl;
+	std::mutex m_lock;
+	std::unordered_map<std::wstring, Entry_t> m_cache;
+	// Set once the well-known SIDs have been looked up successfully
+	bool m_bWellKnownLoaded;
+	// Set while one thread looks them up, so others don't look them up at the same time
+	bool m_bWellKnownLoading;
+
+	// Looks up the well-known SIDs, unless they're loaded or another thread is loading them.
+	void LoadWellKnown();
+	// Looks up SIDs in batches of at most nMaxBatch; false if any call fails
+	bool LookupInBatches(const std::vector<std::wstring>& sids, std::vector<SidName_t>& names);
+
+private:
+	// Not implemented
+	SidNameResolver(const SidNameResolver&) = delete;
+	SidNameResolver& operator = (const SidNameResolver&) = delete;
+};
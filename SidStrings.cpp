@@ -1,3 +1,4 @@
+#include "HEX.h"
 #include "SidStrings.h"
 
 const wchar_t* const SidString::Everyone                   = L"S-1-1-0";             // Everyone
@@ -24,3 +25,140 @@ const wchar_t* const SidString::NtAuthService              = L"S-1-5-6";
 const wchar_t* const SidString::NtSvcTrustedInstaller      = L"S-1-5-80-956008885-3418522649-1831038044-1853292631-2271478464";  // NT SERVICE\TrustedInstaller
 const wchar_t* const SidString::NtVMVirtualMachines        = L"S-1-5-83-0";          // NT VIRTUAL MACHINE\Virtual Machines
 const wchar_t* const SidString::NtAuthUserModeDrivers      = L"S-1-5-84-0-0-0-0-0";  // NT AUTHORITY\USER MODE DRIVERS
+
+const wchar_t* const SidString::AllWellKnown[] = {
+	SidString::Everyone,
+	SidString::AppContainerSid_Unknown1,
+	SidString::AppContainerSid_Unknown2,
+	SidString::VmWorkerProcessCapability,
+	SidString::CreatorOwner,
+	SidString::OwnerRights,
+	SidString::NtAuthSystem,
+	SidString::NtAuthLocalService,
+	SidString::NtAuthNetworkService,
+	SidString::NtAuthBatch,
+	SidString::BuiltinAdministrators,
+	SidString::BuiltinUsers,
+	SidString::BuiltinAccountOperators,
+	SidString::BuiltinServerOperators,
+	SidString::BuiltinPrintOperators,
+	SidString::BuiltinBackupOperators,
+	SidString::BuiltinNetworkCfgOperators,
+	SidString::BuiltinPerfLogUsers,
+	SidString::BuiltinIISIUsers,
+	SidString::BuiltinRdsMgtServers,
+	SidString::NtAuthService,
+	SidString::NtSvcTrustedInstaller,
+	SidString::NtVMVirtualMachines,
+	SidString::NtAuthUserModeDrivers,
+};
+const size_t SidString::nAllWellKnown = sizeof(SidString::AllWellKnown) / sizeof(SidString::AllWellKnown[0]);
+
+// Size of a SID's fixed part: revision, subauthority count, and identifier authority
+static const size_t cbSidHeader = 8;
+
+// Reads a decimal or "0x" hex number of at most maxValue; advances the pointer past it
+static bool ParseSidNumber(const wchar_t*& p, uint64_t maxValue, uint64_t& value)
+{
+	value = 0;
+	const bool bHex = (L'0' == p[0] && (L'x' == p[1] || L'X' == p[1]));
+	const uint64_t base = bHex ? 16 : 10;
+	if (bHex)
+		p += 2;
+	const wchar_t* pDigits = p;
+	for (;; ++p)
+	{
+		uint64_t digit;
+		if (*p >= L'0' && *p <= L'9')
+			digit = uint64_t(*p - L'0');
+		else if (bHex && *p >= L'a' && *p <= L'f')
+			digit = uint64_t(*p - L'a' + 10);
+		else if (bHex && *p >= L'A' && *p <= L'F')
+			digit = uint64_t(*p - L'A' + 10);
+		else
+			break;
+		if (value > (maxValue - digit) / base)
+			return false;
+		value = value * base + digit;
+	}
+	return p != pDigits;
+}
+
+bool SidString::Parse(const wchar_t* szSid, std::vector<uint8_t>& sid)
+{
+	sid.clear();
+	if (nullptr == szSid || (L'S' != szSid[0] && L's' != szSid[0]) || L'-' != szSid[1])
+		return false;
+	const wchar_t* p = szSid + 2;
+	uint64_t revision, authority;
+	if (!ParseSidNumber(p, 0xFF, revision) || 1 != revision || L'-' != *p++ || !ParseSidNumber(p, 0xFFFFFFFFFFFFULL, authority))
+		return false;
+
+	sid.resize(cbSidHeader);
+	sid[0] = uint8_t(revision);
+	for (size_t ix = 0; ix < 6; ++ix)
+		sid[2 + ix] = uint8_t(authority >> (8 * (5 - ix)));
+	size_t nSubAuthorities = 0;
+	while (L'-' == *p)
+	{
+		++p;
+		uint64_t subAuthority;
+		if (nSubAuthorities == nMaxSubAuthorities || !ParseSidNumber(p, 0xFFFFFFFF, subAuthority))
+		{
+			sid.clear();
+			return false;
+		}
+		for (size_t ix = 0; ix < 4; ++ix)
+			sid.push_back(uint8_t(subAuthority >> (8 * ix)));
+		++nSubAuthorities;
+	}
+	if (L'\0' != *p)
+	{
+		sid.clear();
+		return false;
+	}
+	sid[1] = uint8_t(nSubAuthorities);
+	return true;
+}
+
+bool SidString::IsValid(const wchar_t* szSid)
+{
+	std::vector<uint8_t> sid;
+	return Parse(szSid, sid);
+}
+
+std::wstring SidString::Format(const uint8_t* pSid, size_t cbSid)
+{
+	if (nullptr == pSid || cbSid < cbSidHeader || 1 != pSid[0] || pSid[1] > nMaxSubAuthorities || cbSid < cbSidHeader + 4 * size_t(pSid[1]))
+		return std::wstring();
+
+	uint64_t authority = 0;
+	for (size_t ix = 0; ix < 6; ++ix)
+		authority = (authority << 8) | pSid[2 + ix];
+	std::wstring sSid(L"S-1-");
+	if (authority <= 0xFFFFFFFF)
+	{
+		sSid += std::to_wstring(authority);
+	}
+	else
+	{
+		wchar_t szHex[16];
+		sSid += L"0x";
+		sSid.append(szHex, HexToChars(szHex, authority, 12, false));
+	}
+	for (size_t ixSub = 0; ixSub < pSid[1]; ++ixSub)
+	{
+		const uint8_t* pSub = pSid + cbSidHeader + 4 * ixSub;
+		sSid += L'-';
+		sSid += std::to_wstring(uint32_t(pSub[0]) | (uint32_t(pSub[1]) << 8) | (uint32_t(pSub[2]) << 16) | (uint32_t(pSub[3]) << 24));
+	}
+	return sSid;
+}
+
+std::wstring SidString::Canonical(const wchar_t* szSid)
+{
+	std::vector<uint8_t> sid;
+	if (!Parse(szSid, sid))
+		return std::wstring();
+	return Format(sid.data(), sid.size());
+}
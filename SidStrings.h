@@ -1,5 +1,11 @@
 // SidStrings.h
 
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace SidString
 {
 	extern const wchar_t* const Everyone                   ; // L"S-1-1-0";
@@ -26,4 +32,45 @@ namespace SidString
 	extern const wchar_t* const NtSvcTrustedInstaller      ; // L"S-1-5-80-956008885-3418522649-1831038044-1853292631-2271478464";  // NT SERVICE\TrustedInstaller
 	extern const wchar_t* const NtVMVirtualMachines        ; // L"S-1-5-83-0";          // NT VIRTUAL MACHINE\Virtual Machines
 	extern const wchar_t* const NtAuthUserModeDrivers      ; // L"S-1-5-84-0-0-0-0-0";  // NT AUTHORITY\USER MODE DRIVERS
+
+	// All of the above, in the order above
+	extern const wchar_t* const AllWellKnown[];
+	extern const size_t nAllWellKnown;
+
+	/// <summary>
+	/// Maximum number of subauthorities in a SID (SID_MAX_SUB_AUTHORITIES)
+	/// </summary>
+	const size_t nMaxSubAuthorities = 15;
+
+	/// <summary>
+	/// Converts a SID string to the binary layout of a SID structure, without Windows APIs: revision,
+	/// subauthority count, six-byte big-endian identifier authority, then little-endian 32-bit subauthorities.
+	/// Accepts what ConvertStringSidToSid accepts for S-R-I-S... strings: an upper- or lower-case "S",
+	/// revision 1, an identifier authority of up to 48 bits, and up to 15 subauthorities of up to 32 bits,
+	/// each number in decimal or as "0x" hex. SDDL abbreviations such as "BA" aren't accepted.
+	/// </summary>
+	/// <param name="szSid">Input: SID string</param>
+	/// <param name="sid">Output: binary SID; cleared on failure</param>
+	/// <returns>true if the string is a valid SID string, false otherwise</returns>
+	bool Parse(const wchar_t* szSid, std::vector<uint8_t>& sid);
+
+	/// <summary>
+	/// Reports whether a string is a valid SID string (see Parse).
+	/// </summary>
+	bool IsValid(const wchar_t* szSid);
+
+	/// <summary>
+	/// Converts a binary SID to its canonical string form, as ConvertSidToStringSid does: decimal numbers,
+	/// except for an identifier authority of 2^32 or more, written as "0x" and 12 lower-case hex digits.
+	/// </summary>
+	/// <param name="pSid">Input: binary SID</param>
+	/// <param name="cbSid">Input: size of the buffer pSid points to</param>
+	/// <returns>SID string, or an empty string if the buffer doesn't hold a valid SID</returns>
+	std::wstring Format(const uint8_t* pSid, size_t cbSid);
+
+	/// <summary>
+	/// Returns the canonical form of a SID string (see Format); e.g., "s-1-5-032-0x220" returns "S-1-5-32-544".
+	/// Returns an empty string if the string isn't a valid SID string.
+	/// </summary>
+	std::wstring Canonical(const wchar_t* szSid);
 };
\ No newline at end of file
@@ -0,0 +1,127 @@
+// Per-phase timers and operation counters, reported with -stats
+
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include "Stats.h"
+
+std::atomic<bool> Stats::s_bEnabled(false);
+std::atomic<uint64_t> Stats::s_counters[Stats::nCounters];
+
+// JSON names of the counters, in Counter_t order
+static const wchar_t* const szCounterNames[Stats::nCounters] = {
+	L"bytesParsed",
+	L"ruleCollections",
+	L"rules",
+	L"registryReads",
+	L"registryWrites",
+	L"wmiCalls",
+	L"retries",
+	L"filesDeleted",
+	L"dirsRemoved",
+	L"deleteFailures",
+};
+
+// Accumulated times of one phase
+struct PhaseTime_t
+{
+	const char* szPhase;
+	uint64_t count;
+	uint64_t totalMicroseconds;
+	uint64_t maxMicroseconds;
+	// Allocations, summed over occurrences; the peak is the highest of any occurrence that measured one
+	uint64_t nAllocations;
+	uint64_t nAllocatedBytes;
+	int64_t peakLiveBytes;
+	bool bPeakMeasured;
+};
+
+// Phases are few and timed only around coarse operations, so a locked vector in first-seen order is enough.
+static std::mutex phaseLock;
+static std::vector<PhaseTime_t> phaseTimes;
+
+void Stats::Enable()
+{
+	s_bEnabled.store(true, std::memory_order_relaxed);
+}
+
+void Stats::AddPhaseTime(const char* szPhase, uint64_t microseconds, const PhaseAllocations_t* pAllocations)
+{
+	if (!Enabled())
+		return;
+	std::lock_guard<std::mutex> guard(phaseLock);
+	PhaseTime_t* pPhaseTime = nullptr;
+	for (PhaseTime_t& phaseTime : phaseTimes)
+	{
+		if (0 == strcmp(phaseTime.szPhase, szPhase))
+		{
+			pPhaseTime = &phaseTime;
+			break;
+		}
+	}
+	if (nullptr == pPhaseTime)
+	{
+		phaseTimes.push_back(PhaseTime_t{ szPhase, 0, 0, 0, 0, 0, 0, false });
+		pPhaseTime = &phaseTimes.back();
+	}
+	++pPhaseTime->count;
+	pPhaseTime->totalMicroseconds += microseconds;
+	if (microseconds > pPhaseTime->maxMicroseconds)
+		pPhaseTime->maxMicroseconds = microseconds;
+	if (nullptr != pAllocations)
+	{
+		pPhaseTime->nAllocations += pAllocations->nAllocations;
+		pPhaseTime->nAllocatedBytes += pAllocations->nBytes;
+		if (pAllocations->bPeakMeasured && (!pPhaseTime->bPeakMeasured || pAllocations->peakLiveBytes > pPhaseTime->peakLiveBytes))
+		{
+			pPhaseTime->peakLiveBytes = pAllocations->peakLiveBytes;
+			pPhaseTime->bPeakMeasured = true;
+		}
+	}
+}
+
+void Stats::WriteJson(std::wostream& os, uint64_t startupMicroseconds, uint64_t commandMicroseconds)
+{
+	os << L"{\n"
+		<< L"  \"startupMicroseconds\": " << startupMicroseconds << L",\n"
+		<< L"  \"commandMicroseconds\": " << commandMicroseconds << L",\n"
+		<< L"  \"counters\": {";
+	for (size_t ixCounter = 0; ixCounter < nCounters; ++ixCounter)
+	{
+		os << (0 == ixCounter ? L"\n" : L",\n")
+			<< L"    \"" << szCounterNames[ixCounter] << L"\": " << Get(Counter_t(ixCounter));
+	}
+	os << L"\n  },\n";
+
+	const bool bAllocations = AllocationAccounting::Enabled();
+	if (bAllocations)
+	{
+		const AllocationAccounting::Snapshot_t allocations = AllocationAccounting::Current();
+		os << L"  \"allocations\": { \"count\": " << allocations.nAllocations
+			<< L", \"bytes\": " << allocations.nBytes
+			<< L", \"liveBytes\": " << allocations.liveBytes
+			<< L", \"peakLiveBytes\": " << AllocationAccounting::Peak() << L" },\n";
+	}
+	os << L"  \"phases\": {";
+
+	std::lock_guard<std::mutex> guard(phaseLock);
+	for (size_t ixPhase = 0; ixPhase < phaseTimes.size(); ++ixPhase)
+	{
+		const PhaseTime_t& phaseTime = phaseTimes[ixPhase];
+		// Phase names are ASCII literals, so no JSON escaping or transcoding is needed.
+		os << (0 == ixPhase ? L"\n" : L",\n")
+			<< L"    \"" << phaseTime.szPhase << L"\": { \"count\": " << phaseTime.count
+			<< L", \"microseconds\": " << phaseTime.totalMicroseconds
+			<< L", \"maxMicroseconds\": " << phaseTime.maxMicroseconds;
+		if (bAllocations)
+		{
+			os << L", \"allocations\": " << phaseTime.nAllocations
+				<< L", \"allocatedBytes\": " << phaseTime.nAllocatedBytes;
+			// Phases that ran only on worker threads have no peak.
+			if (phaseTime.bPeakMeasured)
+				os << L", \"peakLiveBytes\": " << phaseTime.peakLiveBytes;
+		}
+		os << L" }";
+	}
+	os << (phaseTimes.empty() ? L"}\n" : L"\n  }\n") << L"}\n";
+}
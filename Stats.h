@@ -0,0 +1,179 @@
+// Per-phase timers and operation counters, reported with -stats
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include "TraceEvents.h"
+#include "AllocationAccounting.h"
+
+// Define NO_STATS to compile the STATS_* macros below to nothing.
+#ifndef NO_STATS
+#define STATS_ENABLED 1
+#else
+#define STATS_ENABLED 0
+#endif
+
+/// <summary>
+/// Process-wide instrumentation: counters of operations (e.g., registry writes, WMI calls) and
+/// accumulated times of named phases (e.g., "lgpo.save"), written as a JSON summary.
+///
+/// Collection is off until Enable is called; until then, each STATS_* site costs one or two relaxed
+/// atomic loads. Code is instrumented through the STATS_* macros, which compile to nothing if NO_STATS
+/// is defined. STATS_SCOPE also records a TraceEvents span when tracing is on, and counts the phase's
+/// heap allocations when AllocationAccounting is on.
+///
+/// Usage:
+/// 	STATS_SCOPE("lgpo.save");             // times the rest of the enclosing block
+/// 	STATS_ADD(RegistryWrites, 1);
+/// </summary>
+class Stats
+{
+public:
+	/// <summary>
+	/// Counters; keep szCounterNames in Stats.cpp in the same order.
+	/// </summary>
+	enum Counter_t
+	{
+		BytesParsed,        // Characters of policy XML parsed
+		RuleCollections,    // Rule collections parsed
+		Rules,              // Rules parsed
+		RegistryReads,      // Registry keys opened or enumerated, and values queried
+		RegistryWrites,     // Registry keys created or deleted, and values set
+		WmiCalls,           // WMI round trips (queries, enumerator steps, object gets/puts/deletes)
+		Retries,            // Operations retried after a transient failure
+		FilesDeleted,       // Files deleted by emergency operations
+		DirsRemoved,        // Directories removed by emergency operations
+		DeleteFailures,     // Files or directories that emergency operations could not delete
+		nCounters
+	};
+
+	/// <summary>
+	/// Turns on collection.
+	/// </summary>
+	static void Enable();
+
+	/// <summary>
+	/// true if collection is on
+	/// </summary>
+	static bool Enabled() { return s_bEnabled.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Adds to a counter, if collection is on.
+	/// </summary>
+	static void Add(Counter_t counter, uint64_t n)
+	{
+		if (Enabled())
+			s_counters[counter].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Current value of a counter
+	/// </summary>
+	static uint64_t Get(Counter_t counter) { return s_counters[counter].load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Heap allocations made during one occurrence of a phase
+	/// </summary>
+	struct PhaseAllocations_t
+	{
+		uint64_t nAllocations;
+		uint64_t nBytes;
+		int64_t peakLiveBytes;   // Highest live bytes during the phase, above those live when it began
+		bool bPeakMeasured;      // false if the phase ran off AllocationAccounting's peak thread; peakLiveBytes is then 0
+	};
+
+	/// <summary>
+	/// Adds one timed occurrence of a phase, if collection is on.
+	/// </summary>
+	/// <param name="szPhase">Input: phase name; must be a string literal or otherwise outlive the process's use of Stats</param>
+	/// <param name="microseconds">Input: the occurrence's duration</param>
+	/// <param name="pAllocations">Input: the occurrence's allocations, or nullptr if not counted</param>
+	static void AddPhaseTime(const char* szPhase, uint64_t microseconds, const PhaseAllocations_t* pAllocations = nullptr);
+
+	/// <summary>
+	/// Writes all counters and phase times as a JSON object.
+	/// </summary>
+	/// <param name="os">Output: stream to write to</param>
+	/// <param name="startupMicroseconds">Input: time from process creation to main, reported as-is</param>
+	/// <param name="commandMicroseconds">Input: time spent in the command, reported as-is</param>
+	static void WriteJson(std::wostream& os, uint64_t startupMicroseconds, uint64_t commandMicroseconds);
+
+	/// <summary>
+	/// Times the scope it's declared in, and adds the time to a phase when destroyed; if tracing is on,
+	/// also records the scope as a TraceEvents span, and if AllocationAccounting is on, also adds the
+	/// scope's allocations to the phase. Peaks are measured only on AllocationAccounting's peak thread
+	/// (the command's), so that worker threads' scopes can't reset the peak under the command's scopes.
+	/// Use STATS_SCOPE.
+	/// </summary>
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(const char* szPhase)
+			: m_szPhase(szPhase), m_bTime(Stats::Enabled()), m_bTrace(TraceEvents::Enabled()),
+			m_bCountAllocations(m_bTime && AllocationAccounting::Enabled()),
+			m_bMeasurePeak(m_bCountAllocations && AllocationAccounting::OnPeakThread())
+		{
+			if (m_bTrace)
+				TraceEvents::Begin(m_szPhase);
+			if (m_bTime)
+				m_start = std::chrono::steady_clock::now();
+			if (m_bCountAllocations)
+			{
+				m_allocationsAtStart = AllocationAccounting::Current();
+				if (m_bMeasurePeak)
+					m_previousPeak = AllocationAccounting::ResetPeak();
+			}
+		}
+		~ScopedTimer()
+		{
+			if (m_bCountAllocations)
+			{
+				const AllocationAccounting::Snapshot_t allocationsAtEnd = AllocationAccounting::Current();
+				const PhaseAllocations_t allocations = {
+					allocationsAtEnd.nAllocations - m_allocationsAtStart.nAllocations,
+					allocationsAtEnd.nBytes - m_allocationsAtStart.nBytes,
+					m_bMeasurePeak ? AllocationAccounting::Peak() - m_allocationsAtStart.liveBytes : 0,
+					m_bMeasurePeak
+				};
+				if (m_bMeasurePeak)
+					AllocationAccounting::RestorePeak(m_previousPeak);
+				Stats::AddPhaseTime(m_szPhase, ElapsedMicroseconds(), &allocations);
+			}
+			else if (m_bTime)
+			{
+				Stats::AddPhaseTime(m_szPhase, ElapsedMicroseconds());
+			}
+			if (m_bTrace)
+				TraceEvents::End(m_szPhase);
+		}
+	private:
+		uint64_t ElapsedMicroseconds() const
+		{
+			return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+		}
+		const char* m_szPhase;
+		bool m_bTime, m_bTrace, m_bCountAllocations, m_bMeasurePeak;
+		std::chrono::steady_clock::time_point m_start;
+		AllocationAccounting::Snapshot_t m_allocationsAtStart = {};
+		int64_t m_previousPeak = 0;
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator = (const ScopedTimer&) = delete;
+	};
+
+private:
+	static std::atomic<bool> s_bEnabled;
+	static std::atomic<uint64_t> s_counters[nCounters];
+};
+
+#if STATS_ENABLED
+#define STATS_CONCAT_INNER(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_INNER(a, b)
+#define STATS_SCOPE(szPhase) Stats::ScopedTimer STATS_CONCAT(statsScopedTimer, __LINE__)(szPhase)
+#define STATS_ADD(counter, n) Stats::Add(Stats::counter, (n))
+#else
+#define STATS_SCOPE(szPhase) ((void)0)
+#define STATS_ADD(counter, n) ((void)0)
+#endif
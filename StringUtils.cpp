@@ -1,10 +1,14 @@
 // String utilities
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <sstream>
-#include <locale>
+#include <chrono>
 
 #include "StringUtils.h"
+#include "HEX.h"
+#include "CaseFolding.h"
 
 /// <summary>
 /// Similar to .NET's string split method, returns a vector of substrings of the input string based
@@ -17,45 +21,268 @@ void SplitStringToVector(const std::wstring& strInput, wchar_t delim, std::vecto
 {
 	elems.clear();
 	// If input string is zero length, return a zero-length vector.
-	if (strInput.length() == 0)
-		return;
-	std::wstringstream ss(strInput);
-	std::wstring item;
-	// Get everything up to EOF. Problem with testing operator bool() on getline's return value is that
-	// if the string ends with a delimiter, the last field ends up getting dropped. This technique
-	// fixes that.
-	do {
-		std::getline(ss, item, delim);
-		elems.push_back(item);
-	} while (!ss.eof());
+	// A trailing delimiter yields a trailing empty element.
+	for (std::wstring_view segment : WStringSplitter(strInput, delim))
+		elems.emplace_back(segment);
+}
+
+bool WStringViewToUInt64(std::wstring_view sv, uint64_t& value)
+{
+	value = 0;
+	if (sv.empty())
+		return false;
+	for (wchar_t ch : sv)
+	{
+		if (ch < L'0' || ch > L'9')
+			return false;
+		const uint64_t digit = uint64_t(ch - L'0');
+		if (value > (UINT64_MAX - digit) / 10)
+			return false;
+		value = value * 10 + digit;
+	}
+	return true;
 }
 
 // ------------------------------------------------------------------------------------------
 /// <summary>
-/// Convert a wstring in place to locale-sensitive upper-case
+/// Convert a wstring in place to upper-case (invariant uppercase mapping, not locale-sensitive; see CaseFolding.h)
 /// </summary>
 /// <param name="str"></param>
 /// <returns></returns>
 std::wstring& WString_To_Upper(std::wstring& str)
 {
-	// Note my test results against all wchar_t values 0x0000 to 0xFFFF:
-	// ::toupper(c) and ::tolower(c) each change 26 characters out of 65536
-	// std::toupper(c, loc) and std::tolower(c, loc) where loc is initialized with "" each change
-	//    973 characters out of 65536.
-	// std::toupper(c, loc) and std::tolower(c, loc) where loc is std::locale::empty change
-	//    943 and 942 characters, respectively.
-	std::locale loc("");
-	size_t len = str.length();
-	for (size_t ix = 0; ix < len; ++ix)
-	{
-		str[ix] = std::toupper(str[ix], loc);
-	}
+	UpperCase(str.data(), str.length(), str.data());
+	return str;
+}
+
+/// <summary>
+/// Returns an upper-case copy of a string (invariant uppercase mapping, not locale-sensitive; see CaseFolding.h)
+/// </summary>
+std::wstring WString_Upper(std::wstring_view sv)
+{
+	std::wstring str(sv.length(), L'\0');
+	UpperCase(sv.data(), sv.length(), str.data());
 	return str;
 }
 
 // ----------------------------------------------------------------------------------------------------
 // Date/time-related string manipulation
 
+// "00" through "99", for writing decimal digits two at a time
+static const char szDigitPairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+// Writes a zero-filled two-digit decimal number (0-99) and advances the pointer
+static inline void Put2Digits(wchar_t*& p, unsigned int value)
+{
+	p[0] = wchar_t(szDigitPairs[2 * value]);
+	p[1] = wchar_t(szDigitPairs[2 * value + 1]);
+	p += 2;
+}
+
+// Writes a zero-filled decimal number of a fixed number of digits and advances the pointer
+static inline void PutDigits(wchar_t*& p, unsigned int value, size_t nDigits)
+{
+	switch (nDigits)
+	{
+	case 2:
+		Put2Digits(p, value % 100);
+		return;
+	case 3:
+		*p++ = wchar_t(L'0' + value / 100 % 10);
+		Put2Digits(p, value % 100);
+		return;
+	case 4:
+		Put2Digits(p, value / 100 % 100);
+		Put2Digits(p, value % 100);
+		return;
+	}
+	for (size_t ix = nDigits; ix > 0; --ix)
+	{
+		p[ix - 1] = wchar_t(L'0' + (value % 10));
+		value /= 10;
+	}
+	p += nDigits;
+}
+
+// Broken-down UTC date/time; the portable counterpart of SYSTEMTIME, without the day of the week
+struct DateTime_t
+{
+	unsigned int year, month, day, hour, minute, second, milliseconds;
+};
+
+// 100-nanosecond intervals per day
+static const uint64_t ftPerDay = 864000000000ULL;
+// Days from 0000-03-01 (the start of civil_from_days' era 0) to 1601-01-01 (FILETIME zero)
+static const uint64_t daysTo1601 = 584694;
+
+// Writes a DateTime_t in the SystemTimeToWString formats
+static size_t DateTimeToWChars(const DateTime_t& dt, bool bIncludeMilliseconds, bool bForFileSystem, wchar_t* pBuf)
+{
+	// yyyy-MM-dd HH:mm:ss.fff or yyyyMMdd_HHmmss_fff; FILETIME values reach year 30828, which takes five digits
+	wchar_t* p = pBuf;
+	PutDigits(p, dt.year, dt.year > 9999 ? 5 : 4);
+	if (!bForFileSystem) *p++ = L'-';
+	PutDigits(p, dt.month, 2);
+	if (!bForFileSystem) *p++ = L'-';
+	PutDigits(p, dt.day, 2);
+	*p++ = bForFileSystem ? L'_' : L' ';
+	PutDigits(p, dt.hour, 2);
+	if (!bForFileSystem) *p++ = L':';
+	PutDigits(p, dt.minute, 2);
+	if (!bForFileSystem) *p++ = L':';
+	PutDigits(p, dt.second, 2);
+	if (bIncludeMilliseconds)
+	{
+		*p++ = bForFileSystem ? L'_' : L'.';
+		PutDigits(p, dt.milliseconds, 3);
+	}
+	*p = L'\0';
+	return size_t(p - pBuf);
+}
+
+// Converts a FILETIME value to a civil date arithmetically (H. Hinnant's civil_from_days, on a
+// proleptic Gregorian calendar with 400-year eras starting March 1), rather than calling
+// FileTimeToSystemTime.
+static DateTime_t DateTimeFromFileTime(uint64_t ft)
+{
+	const uint64_t totalMs = ft / 10000;
+	const uint64_t totalSeconds = totalMs / 1000;
+	const uint32_t secondOfDay = uint32_t(totalSeconds % 86400);
+	const uint64_t dayNumber = totalSeconds / 86400 + daysTo1601;
+	const uint64_t era = dayNumber / 146097;
+	const uint32_t dayOfEra = uint32_t(dayNumber - era * 146097);  // [0, 146096]
+	const uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;  // [0, 399]
+	const uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);  // [0, 365], from March 1
+	const uint32_t monthFromMarch = (5 * dayOfYear + 2) / 153;  // [0, 11]
+	const uint32_t month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+
+	DateTime_t dt;
+	dt.year = unsigned(era * 400 + yearOfEra + (month <= 2 ? 1 : 0));
+	dt.month = month;
+	dt.day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+	dt.hour = secondOfDay / 3600;
+	dt.minute = secondOfDay / 60 % 60;
+	dt.second = secondOfDay % 60;
+	dt.milliseconds = unsigned(totalMs % 1000);
+	return dt;
+}
+
+// Converts a civil date to a FILETIME value (H. Hinnant's days_from_civil). Validates the fields
+// as SystemTimeToFileTime does: years 1601 through 30827, and days that exist in the month.
+static bool FileTimeFromDateTime(const DateTime_t& dt, uint64_t& ft)
+{
+	static const unsigned int daysInMonth[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	if (dt.year < 1601 || dt.year > 30827 || dt.month < 1 || dt.month > 12 || dt.day < 1 || dt.day > daysInMonth[dt.month - 1] ||
+		dt.hour > 23 || dt.minute > 59 || dt.second > 59 || dt.milliseconds > 999)
+		return false;
+	const bool bLeapYear = (0 == dt.year % 4 && 0 != dt.year % 100) || 0 == dt.year % 400;
+	if (2 == dt.month && 29 == dt.day && !bLeapYear)
+		return false;
+
+	const unsigned int year = dt.year - (dt.month <= 2 ? 1 : 0);
+	const unsigned int era = year / 400;
+	const unsigned int yearOfEra = year - era * 400;  // [0, 399]
+	const unsigned int dayOfYear = (153 * (dt.month > 2 ? dt.month - 3 : dt.month + 9) + 2) / 5 + dt.day - 1;  // [0, 365]
+	const unsigned int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;  // [0, 146096]
+	const uint64_t days = uint64_t(era) * 146097 + dayOfEra - daysTo1601;
+	ft = days * ftPerDay + ((uint64_t(dt.hour) * 60 + dt.minute) * 60 + dt.second) * 10000000ULL + uint64_t(dt.milliseconds) * 10000;
+	return true;
+}
+
+// Current time as a FILETIME value. On Windows, system_clock counts 100-nanosecond intervals since
+// 1970 like GetSystemTimeAsFileTime; elsewhere, it is converted from its own resolution.
+static uint64_t FileTimeNow()
+{
+	// 100-nanosecond intervals from 1601-01-01 to 1970-01-01
+	const uint64_t ftUnixEpoch = 116444736000000000ULL;
+	const auto sinceUnixEpoch = std::chrono::system_clock::now().time_since_epoch();
+	return ftUnixEpoch + uint64_t(std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10000000>>>(sinceUnixEpoch).count());
+}
+
+/// <summary>
+/// Writes an alpha-sortable, fixed-width date/time string for a 64-bit FILETIME value (100-nanosecond
+/// intervals since January 1, 1601 UTC) into a caller-supplied buffer, in the format yyyy-MM-dd HH:mm:ss[.fff].
+/// If the value is zero, writes an empty string.
+/// </summary>
+/// <param name="ft">Input: FILETIME value</param>
+/// <param name="bIncludeMilliseconds">Input: true to include milliseconds, false otherwise</param>
+/// <param name="pBuf">Output: buffer of at least cchTimestampBuffer characters; receives a NUL-terminated string</param>
+/// <returns>Number of characters written, not including the NUL terminator</returns>
+size_t FileTimeToWChars(uint64_t ft, bool bIncludeMilliseconds, wchar_t* pBuf)
+{
+	pBuf[0] = L'\0';
+	// FileTimeToSystemTime rejects values with the high bit set; so do we.
+	if (0 == ft || 0 != (ft >> 63))
+		return 0;
+	return DateTimeToWChars(DateTimeFromFileTime(ft), bIncludeMilliseconds, false, pBuf);
+}
+
+// Reads a fixed number of decimal digits and advances the pointer; returns false if any is not a digit
+static inline bool GetDigits(const wchar_t*& p, size_t nDigits, unsigned int& value)
+{
+	value = 0;
+	for (size_t ix = 0; ix < nDigits; ++ix, ++p)
+	{
+		if (*p < L'0' || *p > L'9')
+			return false;
+		value = value * 10 + unsigned(*p - L'0');
+	}
+	return true;
+}
+
+/// <summary>
+/// Parses a UTC date/time string of the form yyyy-MM-dd, yyyy-MM-dd HH:mm, or yyyy-MM-dd HH:mm:ss
+/// (a "T" can separate the date and time, and a trailing "Z" is allowed) into a 64-bit FILETIME value.
+/// </summary>
+/// <param name="sTimestamp">Input: date/time string</param>
+/// <param name="ft">Output: FILETIME value</param>
+/// <returns>true if the string is a valid date/time, false otherwise</returns>
+bool WStringToFileTime(const std::wstring& sTimestamp, uint64_t& ft)
+{
+	DateTime_t dt = {};
+	const wchar_t* p = sTimestamp.c_str();
+	if (!GetDigits(p, 4, dt.year) || L'-' != *p++ || !GetDigits(p, 2, dt.month) || L'-' != *p++ || !GetDigits(p, 2, dt.day))
+		return false;
+	if (L' ' == *p || L'T' == *p)
+	{
+		++p;
+		if (!GetDigits(p, 2, dt.hour) || L':' != *p++ || !GetDigits(p, 2, dt.minute))
+			return false;
+		if (L':' == *p)
+		{
+			++p;
+			if (!GetDigits(p, 2, dt.second))
+				return false;
+		}
+	}
+	if (L'Z' == *p)
+		++p;
+	if (L'\0' != *p)
+		return false;
+
+	// Validates the fields (e.g., rejects February 30)
+	return FileTimeFromDateTime(dt, ft);
+}
+
+#ifdef _WIN32
+/// <summary>
+/// Writes an alpha-sortable, fixed-width date/time string into a caller-supplied buffer, without
+/// memory allocation or printf-style formatting. Same formats as SystemTimeToWString.
+/// </summary>
+/// <param name="st">Input: SYSTEMTIME structure representing the date/time to convert to a string</param>
+/// <param name="bIncludeMilliseconds">Input: true to include milliseconds, false otherwise</param>
+/// <param name="bForFileSystem">Input: true to limit to file-object-valid characters</param>
+/// <param name="pBuf">Output: buffer of at least cchTimestampBuffer characters; receives a NUL-terminated string</param>
+/// <returns>Number of characters written, not including the NUL terminator</returns>
+size_t SystemTimeToWChars(const SYSTEMTIME& st, bool bIncludeMilliseconds, bool bForFileSystem, wchar_t* pBuf)
+{
+	const DateTime_t dt = { st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds };
+	return DateTimeToWChars(dt, bIncludeMilliseconds, bForFileSystem, pBuf);
+}
+
 /// <summary>
 /// Convert input system time structure to an alpha-sortable date/time string, optionally including 
 /// milliseconds, and optionally including only characters that are valid in directory and file names.
@@ -66,21 +293,9 @@ std::wstring& WString_To_Upper(std::wstring& str)
 /// <returns>Timestamp string with a format like yyyy-MM-dd HH:mm:ss.fff</returns>
 std::wstring SystemTimeToWString(const SYSTEMTIME& st, bool bIncludeMilliseconds, bool bForFileSystem)
 {
-	wchar_t szTimestamp[32];
-	const size_t bufferSize = sizeof(szTimestamp) / sizeof(szTimestamp[0]);
-	if (bIncludeMilliseconds)
-	{
-		swprintf(szTimestamp, bufferSize, 
-			bForFileSystem ? L"%04d%02d%02d_%02d%02d%02d_%03d" : L"%04d-%02d-%02d %02d:%02d:%02d.%03d",
-			st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds);
-	}
-	else
-	{
-		swprintf(szTimestamp, bufferSize, 
-			bForFileSystem ? L"%04d%02d%02d_%02d%02d%02d" : L"%04d-%02d-%02d %02d:%02d:%02d",
-			st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-	}
-	return szTimestamp;
+	wchar_t szTimestamp[cchTimestampBuffer];
+	size_t cch = SystemTimeToWChars(st, bIncludeMilliseconds, bForFileSystem, szTimestamp);
+	return std::wstring(szTimestamp, cch);
 }
 
 /// <summary>
@@ -97,9 +312,9 @@ std::wstring FileTimeToWString(const FILETIME& ft, bool bIncludeMilliseconds, co
 	if (0 == ft.dwHighDateTime && 0 == ft.dwLowDateTime)
 		return szIfZero ? szIfZero : L"";
 
-	SYSTEMTIME st;
-	FileTimeToSystemTime(&ft, &st);
-	return SystemTimeToWString(st, bIncludeMilliseconds, false);
+	wchar_t szTimestamp[cchTimestampBuffer];
+	size_t cch = FileTimeToWChars((uint64_t(ft.dwHighDateTime) << 32) | uint64_t(ft.dwLowDateTime), bIncludeMilliseconds, szTimestamp);
+	return std::wstring(szTimestamp, cch);
 }
 
 /// <summary>
@@ -117,6 +332,7 @@ std::wstring LargeIntegerToDateTimeString(const LARGE_INTEGER& l, bool bIncludeM
 	ft.dwLowDateTime = l.LowPart;
 	return FileTimeToWString(ft, bIncludeMilliseconds, szIfZero);
 }
+#endif
 
 /// <summary>
 /// Creates and returns an alpha-sortable timestamp string from the current time, optionally including milliseconds
@@ -125,10 +341,9 @@ std::wstring LargeIntegerToDateTimeString(const LARGE_INTEGER& l, bool bIncludeM
 /// <returns>Alpha-sortable timestamp string</returns>
 std::wstring TimestampUTC(bool bIncludeMilliseconds /*= false*/)
 {
-	//wchar_t szTimestamp[32];
-	SYSTEMTIME st;
-	GetSystemTime(&st);
-	return SystemTimeToWString(st, bIncludeMilliseconds, false);
+	wchar_t szTimestamp[cchTimestampBuffer];
+	size_t cch = DateTimeToWChars(DateTimeFromFileTime(FileTimeNow()), bIncludeMilliseconds, false, szTimestamp);
+	return std::wstring(szTimestamp, cch);
 }
 
 /// <summary>
@@ -139,13 +354,11 @@ std::wstring TimestampUTC(bool bIncludeMilliseconds /*= false*/)
 /// <returns>Alpha-sortable timestamp string</returns>
 std::wstring TimestampUTCforFilepath(bool bIncludeMilliseconds /*= false*/)
 {
-	//wchar_t szTimestamp[32];
-	SYSTEMTIME st;
-	GetSystemTime(&st);
-	return SystemTimeToWString(st, bIncludeMilliseconds, true);
+	wchar_t szTimestamp[cchTimestampBuffer];
+	size_t cch = DateTimeToWChars(DateTimeFromFileTime(FileTimeNow()), bIncludeMilliseconds, true, szTimestamp);
+	return std::wstring(szTimestamp, cch);
 }
 
-
 // ----------------------------------------------------------------------------------------------------
 /// <summary>
 /// Encodes string for XML. E.g., EncodeForXml(L"<root>") returns "&lt;root&gt;".
@@ -187,9 +400,10 @@ std::wstring EncodeForXml(const wchar_t* sz)
 			else
 			{
 				// Encoding for control characters 0 through 0x1f
-				wchar_t buf[8];
-				swprintf(buf, sizeof(buf) / sizeof(buf[0]), L"&#x%02X;", (int)(c & 0xFFFF));
-				retval.append(buf);
+				wchar_t buf[8] = { L'&', L'#', L'x' };
+				wchar_t* p = HexToChars(buf + 3, uint64_t(c & 0xFFFF), 2, true);
+				*p++ = L';';
+				retval.append(buf, p);
 			}
 			break;
 		}
@@ -198,3 +412,45 @@ std::wstring EncodeForXml(const wchar_t* sz)
 	return retval;
 }
 
+
+// ----------------------------------------------------------------------------------------------------
+/// <summary>
+/// Case-insensitive match of a string against a wildcard pattern, where "*" matches any
+/// sequence of characters (including none) and "?" matches any single character.
+/// </summary>
+bool WildcardMatchCaseInsensitive(const wchar_t* szPattern, const wchar_t* szText)
+{
+	if (NULL == szPattern || NULL == szText)
+		return false;
+
+	// Greedy match with backtracking to the most recent "*": on a mismatch, let that "*"
+	// consume one more character and resume matching after it.
+	const wchar_t* pStar = NULL;
+	const wchar_t* pStarText = NULL;
+	while (*szText)
+	{
+		if (L'*' == *szPattern)
+		{
+			pStar = szPattern++;
+			pStarText = szText;
+		}
+		else if (L'?' == *szPattern || (*szPattern && UpperCaseChar(*szPattern) == UpperCaseChar(*szText)))
+		{
+			++szPattern;
+			++szText;
+		}
+		else if (NULL != pStar)
+		{
+			szPattern = pStar + 1;
+			szText = ++pStarText;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	// Any remaining pattern characters must all be "*"
+	while (L'*' == *szPattern)
+		++szPattern;
+	return (0 == *szPattern);
+}
@@ -1,11 +1,23 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
+#include <iterator>
+#include <cstdint>
+#include <cwchar>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+// POSIX equivalents of the Microsoft C runtime's case-insensitive wide-string comparisons
+#define _wcsicmp wcscasecmp
+#define _wcsnicmp wcsncasecmp
+#endif
 
 // ------------------------------------------------------------------------------------------
-// StartsWith, EndsWith, SplitStringToVector
+// StartsWith, EndsWith, SplitStringToVector, WStringSplitter
 
 /// <summary>
 /// Returns true if the input string "str" starts with the input string "with".
@@ -45,14 +57,189 @@ inline bool EndsWith(const std::wstring& str, wchar_t chr)
 /// <param name="elems">Output: vector of substrings</param>
 void SplitStringToVector(const std::wstring& strInput, wchar_t delim, std::vector<std::wstring>& elems);
 
+/// <summary>
+/// Lazy, allocation-free split of a string on a delimiter character. Segments are returned as views into
+/// the input string, which must outlive the splitter and any segments taken from it.
+///
+/// Produces the same segments as SplitStringToVector: an empty input has no segments; otherwise there is
+/// one more segment than there are delimiters, so leading, trailing and adjacent delimiters yield empty
+/// segments.
+///
+/// Usage:
+/// 	for (std::wstring_view segment : WStringSplitter(sParentId, L'/'))
+/// 		...
+/// 	std::wstring_view sName = WStringSplitter(sParentId, L'/').Last();
+/// </summary>
+class WStringSplitter
+{
+public:
+	/// <summary>
+	/// Forward iterator over the segments.
+	/// </summary>
+	class const_iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef std::wstring_view value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const std::wstring_view* pointer;
+		typedef const std::wstring_view& reference;
+
+		const_iterator() : m_ixNext(npos), m_delim(0), m_bEnd(true) {}
+
+		reference operator*() const { return m_segment; }
+		pointer operator->() const { return &m_segment; }
+
+		const_iterator& operator++()
+		{
+			if (npos == m_ixNext)
+			{
+				// Past the last segment
+				m_segment = std::wstring_view();
+				m_bEnd = true;
+			}
+			else
+			{
+				Find(m_ixNext);
+			}
+			return *this;
+		}
+		const_iterator operator++(int) { const_iterator prev = *this; ++*this; return prev; }
+
+		bool operator==(const const_iterator& other) const
+		{
+			return m_bEnd == other.m_bEnd && (m_bEnd || m_segment.data() == other.m_segment.data());
+		}
+		bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+	private:
+		friend class WStringSplitter;
+		static const size_t npos = std::wstring_view::npos;
+
+		const_iterator(std::wstring_view sv, wchar_t delim)
+			: m_sv(sv), m_ixNext(npos), m_delim(delim), m_bEnd(sv.empty())
+		{
+			if (!m_bEnd)
+				Find(0);
+		}
+
+		// Makes the segment starting at ixStart current.
+		void Find(size_t ixStart)
+		{
+			const size_t ixDelim = m_sv.find(m_delim, ixStart);
+			if (npos == ixDelim)
+			{
+				m_segment = m_sv.substr(ixStart);
+				m_ixNext = npos;
+			}
+			else
+			{
+				m_segment = m_sv.substr(ixStart, ixDelim - ixStart);
+				m_ixNext = ixDelim + 1;
+			}
+		}
+
+		std::wstring_view m_sv;
+		std::wstring_view m_segment;
+		// Start of the segment after the current one; npos if the current segment is the last
+		size_t m_ixNext;
+		wchar_t m_delim;
+		// true for the end iterator
+		bool m_bEnd;
+	};
+
+	WStringSplitter(std::wstring_view sv, wchar_t delim) : m_sv(sv), m_delim(delim) {}
+
+	const_iterator begin() const { return const_iterator(m_sv, m_delim); }
+	const_iterator end() const { return const_iterator(); }
+
+	/// <summary>
+	/// Number of segments.
+	/// </summary>
+	size_t Count() const
+	{
+		if (m_sv.empty())
+			return 0;
+		size_t nSegments = 1;
+		for (wchar_t ch : m_sv)
+		{
+			if (m_delim == ch)
+				++nSegments;
+		}
+		return nSegments;
+	}
+
+	/// <summary>
+	/// Returns the last segment: everything after the last delimiter, or the entire string if there is no delimiter.
+	/// </summary>
+	std::wstring_view Last() const
+	{
+		const size_t ixDelim = m_sv.rfind(m_delim);
+		return (std::wstring_view::npos == ixDelim) ? m_sv : m_sv.substr(ixDelim + 1);
+	}
+
+	/// <summary>
+	/// Gets the zero-based nth segment.
+	/// </summary>
+	/// <param name="n">Input: index of the segment to get</param>
+	/// <param name="segment">Output: the segment; empty if there are not enough segments</param>
+	/// <returns>true if the segment exists, false if there are fewer than n + 1 segments</returns>
+	bool Nth(size_t n, std::wstring_view& segment) const
+	{
+		for (const_iterator iter = begin(); iter != end(); ++iter, --n)
+		{
+			if (0 == n)
+			{
+				segment = *iter;
+				return true;
+			}
+		}
+		segment = std::wstring_view();
+		return false;
+	}
+
+	/// <summary>
+	/// Copies up to nMaxSegments segments into an array, and returns the total number of segments
+	/// (which can be more than nMaxSegments). For fixed-format records with a known number of fields.
+	/// </summary>
+	size_t CopyTo(std::wstring_view* pSegments, size_t nMaxSegments) const
+	{
+		size_t nSegments = 0;
+		for (const_iterator iter = begin(); iter != end(); ++iter, ++nSegments)
+		{
+			if (nSegments < nMaxSegments)
+				pSegments[nSegments] = *iter;
+		}
+		return nSegments;
+	}
+
+private:
+	std::wstring_view m_sv;
+	wchar_t m_delim;
+};
+
+/// <summary>
+/// Parses an unsigned decimal number that makes up the entire string view (no sign, spaces, or other characters).
+/// </summary>
+/// <param name="sv">Input: decimal digits</param>
+/// <param name="value">Output: the number</param>
+/// <returns>true if the string is a valid number that fits in 64 bits, false otherwise</returns>
+bool WStringViewToUInt64(std::wstring_view sv, uint64_t& value);
+
 // ------------------------------------------------------------------------------------------
 /// <summary>
-/// Convert a wstring in place to locale-sensitive upper-case
+/// Convert a wstring in place to upper-case, using Windows' invariant uppercase mapping independently
+/// of the user's locale (see CaseFolding.h)
 /// </summary>
 /// <param name="str"></param>
-/// <returns></returns>
+/// <returns>str</returns>
 std::wstring& WString_To_Upper(std::wstring& str);
 
+/// <summary>
+/// Returns an upper-case copy of a string; see WString_To_Upper.
+/// </summary>
+std::wstring WString_Upper(std::wstring_view sv);
+
 // ------------------------------------------------------------------------------------------
 // Replace all instances of one substring with another (std::wstring and std::string)
 
@@ -92,6 +279,13 @@ inline std::string replaceStringAll(std::string str,
 // ------------------------------------------------------------------------------------------
 // Date/time-related string manipulation
 
+/// <summary>
+/// Size of a buffer large enough for any timestamp written by SystemTimeToWChars or FileTimeToWChars,
+/// including the terminating NUL. Years after 9999 (up to 30828, the last FILETIME year) take five digits.
+/// </summary>
+const size_t cchTimestampBuffer = 25;
+
+#ifdef _WIN32
 /// <summary>
 /// Convert input system time structure to an alpha-sortable date/time string, optionally including 
 /// milliseconds, and optionally including only characters that are valid in directory and file names.
@@ -102,6 +296,39 @@ inline std::string replaceStringAll(std::string str,
 /// <returns>Timestamp string with a format like yyyy-MM-dd HH:mm:ss.fff</returns>
 std::wstring SystemTimeToWString(const SYSTEMTIME& st, bool bIncludeMilliseconds, bool bForFileSystem = false);
 
+/// <summary>
+/// Writes an alpha-sortable, fixed-width date/time string into a caller-supplied buffer, without
+/// memory allocation or printf-style formatting. Same formats as SystemTimeToWString.
+/// </summary>
+/// <param name="st">Input: SYSTEMTIME structure representing the date/time to convert to a string</param>
+/// <param name="bIncludeMilliseconds">Input: true to include milliseconds, false otherwise</param>
+/// <param name="bForFileSystem">Input: true to limit to file-object-valid characters</param>
+/// <param name="pBuf">Output: buffer of at least cchTimestampBuffer characters; receives a NUL-terminated string</param>
+/// <returns>Number of characters written, not including the NUL terminator</returns>
+size_t SystemTimeToWChars(const SYSTEMTIME& st, bool bIncludeMilliseconds, bool bForFileSystem, wchar_t* pBuf);
+#endif
+
+/// <summary>
+/// Writes an alpha-sortable, fixed-width date/time string for a 64-bit FILETIME value (100-nanosecond
+/// intervals since January 1, 1601 UTC) into a caller-supplied buffer, in the format yyyy-MM-dd HH:mm:ss[.fff].
+/// If the value is zero, writes an empty string.
+/// </summary>
+/// <param name="ft">Input: FILETIME value</param>
+/// <param name="bIncludeMilliseconds">Input: true to include milliseconds, false otherwise</param>
+/// <param name="pBuf">Output: buffer of at least cchTimestampBuffer characters; receives a NUL-terminated string</param>
+/// <returns>Number of characters written, not including the NUL terminator</returns>
+size_t FileTimeToWChars(uint64_t ft, bool bIncludeMilliseconds, wchar_t* pBuf);
+
+/// <summary>
+/// Parses a UTC date/time string of the form yyyy-MM-dd, yyyy-MM-dd HH:mm, or yyyy-MM-dd HH:mm:ss
+/// (a "T" can separate the date and time, and a trailing "Z" is allowed) into a 64-bit FILETIME value.
+/// </summary>
+/// <param name="sTimestamp">Input: date/time string</param>
+/// <param name="ft">Output: FILETIME value</param>
+/// <returns>true if the string is a valid date/time, false otherwise</returns>
+bool WStringToFileTime(const std::wstring& sTimestamp, uint64_t& ft);
+
+#ifdef _WIN32
 /// <summary>
 /// Convert input filetime structure to an alpha-sortable date/time string, optionally including
 /// milliseconds and optionally including only characters that are valid in directory and file names.
@@ -122,6 +349,7 @@ std::wstring FileTimeToWString(const FILETIME& ft, bool bIncludeMilliseconds, co
 /// <param name="szIfZero">Input (optional): the string to return if the ft is zero.</param>
 /// <returns>Timestamp string with a format like yyyy-MM-dd HH:mm:ss.fff, or alternate string value</returns>
 std::wstring LargeIntegerToDateTimeString(const LARGE_INTEGER& l, bool bIncludeMilliseconds = true, const wchar_t* szIfZero = L"");
+#endif
 
 /// <summary>
 /// Creates and returns an alpha-sortable timestamp string from the current time, optionally including milliseconds
@@ -158,5 +386,14 @@ inline bool EqualCaseInsensitive(const std::wstring& str1, const std::wstring& s
 	return (0 == _wcsicmp(str1.c_str(), str2.c_str()));
 }
 
+/// <summary>
+/// Case-insensitive match of a string against a wildcard pattern, where "*" matches any
+/// sequence of characters (including none) and "?" matches any single character.
+/// </summary>
+/// <param name="szPattern">Input: wildcard pattern; e.g., L"*.AppLocker"</param>
+/// <param name="szText">Input: string to test</param>
+/// <returns>true if the entire string matches the pattern</returns>
+bool WildcardMatchCaseInsensitive(const wchar_t* szPattern, const wchar_t* szText);
+
 
 
@@ -0,0 +1,145 @@
+// Error codes with deferred, cached message formatting
+
+#ifdef _WIN32
+#include <Windows.h>
+#include "SysErrorMessage.h"
+#endif
+#include <mutex>
+#include "SysError.h"
+#include "HEX.h"
+
+// ----------------------------------------------------------------------------------------------------
+// Built-in messages
+
+struct BuiltInMessage_t
+{
+	uint32_t dwErrCode;
+	bool bNtStatus;
+	const wchar_t* szMessage;
+};
+
+// English text of common codes, as the system's message tables have it
+static const BuiltInMessage_t builtInMessages[] = {
+	// Win32
+	{ 0, false, L"The operation completed successfully." },
+	{ 2, false, L"The system cannot find the file specified." },
+	{ 3, false, L"The system cannot find the path specified." },
+	{ 5, false, L"Access is denied." },
+	{ 6, false, L"The handle is invalid." },
+	{ 8, false, L"Not enough memory resources are available to process this command." },
+	{ 32, false, L"The process cannot access the file because it is being used by another process." },
+	{ 80, false, L"The file exists." },
+	{ 87, false, L"The parameter is incorrect." },
+	{ 112, false, L"There is not enough space on the disk." },
+	{ 122, false, L"The data area passed to a system call is too small." },
+	{ 145, false, L"The directory is not empty." },
+	{ 183, false, L"Cannot create a file when that file already exists." },
+	{ 1314, false, L"A required privilege is not held by the client." },
+	// HRESULT
+	{ 0x80004001, false, L"Not implemented" },
+	{ 0x80004005, false, L"Unspecified error" },
+	{ 0x80070005, false, L"Access is denied." },
+	{ 0x8007000E, false, L"Not enough memory resources are available to complete this operation." },
+	{ 0x80070057, false, L"The parameter is incorrect." },
+	// NTSTATUS
+	{ 0xC0000034, true, L"Object Name not found." },
+};
+
+bool BuiltInErrorMessage(uint32_t dwErrCode, bool bNtStatus, std::wstring& sMessage)
+{
+	for (const BuiltInMessage_t& builtIn : builtInMessages)
+	{
+		if (builtIn.dwErrCode == dwErrCode && builtIn.bNtStatus == bNtStatus)
+		{
+			sMessage = builtIn.szMessage;
+			return true;
+		}
+	}
+	sMessage.clear();
+	return false;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// ErrorMessageCache
+
+ErrorMessageCache::ErrorMessageCache(ErrorMessageSource_t source, size_t nMaxEntries)
+	: m_source(source), m_nMaxEntries(nMaxEntries)
+{
+}
+
+bool ErrorMessageCache::AppendMessage(uint32_t dwErrCode, bool bNtStatus, std::wstring& sTarget)
+{
+	const uint64_t key = uint64_t(dwErrCode) | (bNtStatus ? (uint64_t(1) << 32) : 0);
+	{
+		std::shared_lock<std::shared_mutex> readLock(m_lock);
+		const auto iter = m_entries.find(key);
+		if (m_entries.end() != iter)
+		{
+			if (iter->second.bFound)
+				sTarget += iter->second.sMessage;
+			return iter->second.bFound;
+		}
+	}
+
+	// Not cached: get the text from the source outside the lock, then cache it if there's room.
+	// Two threads can both fetch the same new code; the second insert is a no-op.
+	Entry_t entry;
+	entry.bFound = m_source(dwErrCode, bNtStatus, entry.sMessage);
+	const bool bFound = entry.bFound;
+	if (bFound)
+		sTarget += entry.sMessage;
+	{
+		std::unique_lock<std::shared_mutex> writeLock(m_lock);
+		if (m_entries.size() < m_nMaxEntries)
+			m_entries.emplace(key, std::move(entry));
+	}
+	return bFound;
+}
+
+size_t ErrorMessageCache::Size() const
+{
+	std::shared_lock<std::shared_mutex> readLock(m_lock);
+	return m_entries.size();
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Formatting
+
+std::wstring FormatSysError(uint32_t dwErrCode, bool bNtStatus, bool bWithErrorCode)
+{
+#ifdef _WIN32
+	static ErrorMessageCache cache(SystemErrorMessage);
+#else
+	static ErrorMessageCache cache(BuiltInErrorMessage);
+#endif
+	std::wstring sRetval;
+	const bool bFound = cache.AppendMessage(dwErrCode, bNtStatus, sRetval);
+	if (bFound && bWithErrorCode)
+		sRetval += L' ';
+	// Add error code to return value if explicitly requested or if unable to get human-language text.
+	if (!bFound || bWithErrorCode)
+		AppendErrorCode(dwErrCode, sRetval);
+	return sRetval;
+}
+
+void AppendErrorCode(uint32_t dwErrCode, std::wstring& sTarget)
+{
+	wchar_t szHex[8];
+	sTarget += L"Error # ";
+	sTarget += std::to_wstring(dwErrCode);
+	sTarget += L" (0x";
+	sTarget.append(szHex, HexToChars(szHex, dwErrCode, 8, true));
+	sTarget += L')';
+}
+
+#ifdef _WIN32
+SysError SysError::Last()
+{
+	return SysError(GetLastError());
+}
+#endif
+
+std::wostream& operator << (std::wostream& os, const SysError& err)
+{
+	return os << err.Message();
+}
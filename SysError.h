@@ -0,0 +1,145 @@
+// Error codes with deferred, cached message formatting
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <ostream>
+
+// ----------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// Gets the human-language text for an error code, without a trailing CR/LF.
+/// </summary>
+/// <param name="dwErrCode">Input: Win32, HRESULT, or NTSTATUS error code</param>
+/// <param name="bNtStatus">Input: true for NTSTATUS code, false for Win32 or HRESULT code</param>
+/// <param name="sMessage">Output: the message text</param>
+/// <returns>true if text is available for the code, false otherwise</returns>
+typedef bool (*ErrorMessageSource_t)(uint32_t dwErrCode, bool bNtStatus, std::wstring& sMessage);
+
+/// <summary>
+/// Message source with built-in English text for common Win32, HRESULT, and NTSTATUS codes.
+/// Used where the system's message tables aren't available (e.g., on Linux).
+/// </summary>
+bool BuiltInErrorMessage(uint32_t dwErrCode, bool bNtStatus, std::wstring& sMessage);
+
+/// <summary>
+/// Thread-safe cache of error messages from a message source, keyed by error code and NTSTATUS flag.
+/// Codes for which the source has no text are cached too.
+///
+/// The cache is bounded: once it holds nMaxEntries codes, the messages for further codes are fetched
+/// from the source on every request. Error-heavy loops (e.g., deleting thousands of files that all fail
+/// with "access denied") hit a handful of codes, so a small bound is enough.
+/// </summary>
+class ErrorMessageCache
+{
+public:
+	/// <summary>
+	/// Default maximum number of cached codes
+	/// </summary>
+	static const size_t nDefaultMaxEntries = 256;
+
+	// Constructor
+	explicit ErrorMessageCache(ErrorMessageSource_t source, size_t nMaxEntries = nDefaultMaxEntries);
+	// Default destructor
+	~ErrorMessageCache() = default;
+
+	/// <summary>
+	/// Appends the text for an error code to sTarget.
+	/// </summary>
+	/// <returns>true if text was available and appended, false otherwise</returns>
+	bool AppendMessage(uint32_t dwErrCode, bool bNtStatus, std::wstring& sTarget);
+
+	/// <summary>
+	/// Number of codes in the cache
+	/// </summary>
+	size_t Size() const;
+
+private:
+	struct Entry_t
+	{
+		bool bFound;
+		std::wstring sMessage;
+	};
+	ErrorMessageSource_t m_source;
+	size_t m_nMaxEntries;
+	// Key: error code in the low 32 bits, NTSTATUS flag above them
+	std::unordered_map<uint64_t, Entry_t> m_entries;
+	mutable std::shared_mutex m_lock;
+
+private:
+	// Not implemented
+	ErrorMessageCache(const ErrorMessageCache&) = delete;
+	ErrorMessageCache& operator = (const ErrorMessageCache&) = delete;
+};
+
+/// <summary>
+/// Returns human-language error text for a Win32, HRESULT, or NTSTATUS error code, through the process-wide
+/// message cache. If text isn't available or bWithErrorCode is true, the text includes the code; e.g.,
+/// "Access is denied. Error # 5 (0x00000005)".
+/// The message source is the system's message tables on Windows (SystemErrorMessage in SysErrorMessage.cpp),
+/// and BuiltInErrorMessage elsewhere.
+/// </summary>
+std::wstring FormatSysError(uint32_t dwErrCode, bool bNtStatus, bool bWithErrorCode);
+
+/// <summary>
+/// Appends an error code as text to a string: "Error # " followed by the code in decimal and in
+/// zero-filled hex; e.g., "Error # 5 (0x00000005)".
+/// </summary>
+void AppendErrorCode(uint32_t dwErrCode, std::wstring& sTarget);
+
+/// <summary>
+/// A Win32, HRESULT, or NTSTATUS error code whose message is formatted only when displayed.
+/// Cheap to copy and store; e.g., a loop can record the SysError of each failure and report later.
+///
+/// Usage:
+/// 	SysError err = SysError::Last();  // on Windows; captures GetLastError()
+/// 	...
+/// 	std::wcerr << sPath << L": " << err << std::endl;
+/// </summary>
+class SysError
+{
+public:
+	// Constructor
+	explicit SysError(uint32_t dwErrCode = 0, bool bNtStatus = false)
+		: m_dwErrCode(dwErrCode), m_bNtStatus(bNtStatus)
+	{}
+
+#ifdef _WIN32
+	/// <summary>
+	/// The calling thread's last Win32 error code.
+	/// </summary>
+	static SysError Last();
+#endif
+
+	/// <summary>
+	/// The error code
+	/// </summary>
+	uint32_t Code() const { return m_dwErrCode; }
+
+	/// <summary>
+	/// true if the code is an NTSTATUS code
+	/// </summary>
+	bool IsNtStatus() const { return m_bNtStatus; }
+
+	/// <summary>
+	/// Human-language error text (see FormatSysError)
+	/// </summary>
+	std::wstring Message() const { return FormatSysError(m_dwErrCode, m_bNtStatus, false); }
+
+	/// <summary>
+	/// Human-language error text including the error code
+	/// </summary>
+	std::wstring MessageWithCode() const { return FormatSysError(m_dwErrCode, m_bNtStatus, true); }
+
+private:
+	uint32_t m_dwErrCode;
+	bool m_bNtStatus;
+};
+
+/// <summary>
+/// Writes the error's human-language text.
+/// </summary>
+std::wostream& operator << (std::wostream& os, const SysError& err);
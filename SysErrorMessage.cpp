@@ -1,7 +1,5 @@
 #include <Windows.h>
-#include <sstream>
 #include "SysErrorMessage.h"
-#include "HEX.h"
 
 // --------------------------------------------------------------------------------
 
@@ -24,10 +22,9 @@ wchar_t* RemoveTrailingCRLF(wchar_t* psz)
 	return psz;
 }
 
-static std::wstring SysErrorMessage_Impl(DWORD dwErrCode, bool bWithErrorCode, bool bNtStatus)
+bool SystemErrorMessage(uint32_t dwErrCode, bool bNtStatus, std::wstring& sMessage)
 {
 	LPWSTR pszErrMsg = NULL;
-	std::wstringstream sRetval;
 	DWORD flags =
 		FORMAT_MESSAGE_ALLOCATE_BUFFER |
 		FORMAT_MESSAGE_IGNORE_INSERTS |
@@ -49,20 +46,12 @@ static std::wstring SysErrorMessage_Impl(DWORD dwErrCode, bool bWithErrorCode, b
 		NULL);
 	if (dwFM)
 	{
-		sRetval << RemoveTrailingCRLF(pszErrMsg);
+		sMessage = RemoveTrailingCRLF(pszErrMsg);
 		LocalFree(pszErrMsg);
-		if (bWithErrorCode)
-		{
-			sRetval << L" ";
-		}
-	}
-	if (!dwFM || bWithErrorCode)
-	{
-		// Add error code to return value if explicitly requested or if unable to get human-language text.
-		sRetval << L"Error # " << dwErrCode << L" (" << HEX(dwErrCode, 8, true, true) << L")";
+		return true;
 	}
-
-	return sRetval.str();
+	sMessage.clear();
+	return false;
 }
 
 /// <summary>
@@ -70,7 +59,7 @@ static std::wstring SysErrorMessage_Impl(DWORD dwErrCode, bool bWithErrorCode, b
 /// </summary>
 std::wstring SysErrorMessage(DWORD dwErrCode /*= GetLastError()*/, bool bNtStatus /*= false*/)
 {
-	return SysErrorMessage_Impl(dwErrCode, false, bNtStatus);
+	return FormatSysError(dwErrCode, bNtStatus, false);
 }
 
 /// <summary>
@@ -78,6 +67,5 @@ std::wstring SysErrorMessage(DWORD dwErrCode /*= GetLastError()*/, bool bNtStatu
 /// </summary>
 std::wstring SysErrorMessageWithCode(DWORD dwErrCode /*= GetLastError()*/, bool bNtStatus /*= false*/)
 {
-	return SysErrorMessage_Impl(dwErrCode, true, bNtStatus);
+	return FormatSysError(dwErrCode, bNtStatus, true);
 }
-
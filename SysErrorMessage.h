@@ -2,11 +2,13 @@
 
 #include <Windows.h>
 #include <string>
+#include "SysError.h"
 
 // ----------------------------------------------------------------------------------------------------
 
 /// <summary>
 /// Returns human-language error text from a Windows or NTSTATUS error code
+/// Messages are cached (see FormatSysError), so repeated errors cost no FormatMessage calls.
 /// </summary>
 /// <param name="dwErrCode">Win32 or NTSTATUS error code</param>
 /// <param name="bNtStatus">true for NTSTATUS code, false for Win32 code</param>
@@ -19,3 +21,8 @@ std::wstring SysErrorMessage(DWORD dwErrCode = GetLastError(), bool bNtStatus =
 /// <param name="bNtStatus">true for NTSTATUS code, false for Win32 code</param>
 std::wstring SysErrorMessageWithCode(DWORD dwErrCode = GetLastError(), bool bNtStatus = false);
 
+/// <summary>
+/// Message source (see ErrorMessageSource_t) that gets text from the system's message tables with
+/// FormatMessageW: ntdll.dll's for NTSTATUS codes.
+/// </summary>
+bool SystemErrorMessage(uint32_t dwErrCode, bool bNtStatus, std::wstring& sMessage);
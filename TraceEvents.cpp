@@ -0,0 +1,119 @@
+// Timeline of begin/end events, written in Chrome trace-event format
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "TraceEvents.h"
+
+std::atomic<bool> TraceEvents::s_bEnabled(false);
+
+// One begin or end event
+struct TraceEvent_t
+{
+	const char* szName;
+	uint64_t microseconds;
+	char phase;  // 'B' or 'E'
+};
+
+// One thread's events. Only the owning thread writes; WriteJson reads after recording has stopped.
+struct ThreadTraceBuffer_t
+{
+	uint32_t threadId;
+	std::vector<TraceEvent_t> events;
+	// Total events recorded; the newest is at (nRecorded - 1) % capacity
+	std::atomic<size_t> nRecorded;
+
+	ThreadTraceBuffer_t(uint32_t id, size_t nCapacity) : threadId(id), events(nCapacity), nRecorded(0) {}
+};
+
+// All threads' buffers; they outlive their threads so that WriteJson can read them at exit.
+static std::mutex buffersLock;
+static std::vector<std::unique_ptr<ThreadTraceBuffer_t>> threadBuffers;
+static size_t nEventsPerThread = TraceEvents::nDefaultEventsPerThread;
+static std::chrono::steady_clock::time_point epoch;
+
+// The calling thread's buffer, registered on its first event
+static thread_local ThreadTraceBuffer_t* pThreadBuffer = nullptr;
+
+static ThreadTraceBuffer_t* ThreadBuffer()
+{
+	if (nullptr == pThreadBuffer)
+	{
+		std::lock_guard<std::mutex> guard(buffersLock);
+		// Thread IDs are assigned in order of first event, starting at 1.
+		threadBuffers.push_back(std::unique_ptr<ThreadTraceBuffer_t>(new ThreadTraceBuffer_t(uint32_t(threadBuffers.size() + 1), nEventsPerThread)));
+		pThreadBuffer = threadBuffers.back().get();
+	}
+	return pThreadBuffer;
+}
+
+static void Record(const char* szName, char phase)
+{
+	ThreadTraceBuffer_t* pBuffer = ThreadBuffer();
+	const size_t nRecorded = pBuffer->nRecorded.load(std::memory_order_relaxed);
+	TraceEvent_t& event = pBuffer->events[nRecorded % pBuffer->events.size()];
+	event.szName = szName;
+	event.microseconds = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count());
+	event.phase = phase;
+	pBuffer->nRecorded.store(nRecorded + 1, std::memory_order_release);
+}
+
+void TraceEvents::Enable(size_t nEventsPerThreadIn)
+{
+	std::lock_guard<std::mutex> guard(buffersLock);
+	if (Enabled())
+		return;
+	nEventsPerThread = nEventsPerThreadIn > 0 ? nEventsPerThreadIn : 1;
+	epoch = std::chrono::steady_clock::now();
+	s_bEnabled.store(true, std::memory_order_release);
+}
+
+void TraceEvents::Begin(const char* szName)
+{
+	if (Enabled())
+		Record(szName, 'B');
+}
+
+void TraceEvents::End(const char* szName)
+{
+	if (Enabled())
+		Record(szName, 'E');
+}
+
+size_t TraceEvents::WriteJson(std::ostream& os)
+{
+	std::lock_guard<std::mutex> guard(buffersLock);
+	size_t nWritten = 0;
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (const std::unique_ptr<ThreadTraceBuffer_t>& pBuffer : threadBuffers)
+	{
+		const size_t nCapacity = pBuffer->events.size();
+		const size_t nRecorded = pBuffer->nRecorded.load(std::memory_order_acquire);
+		const size_t ixFirst = nRecorded > nCapacity ? nRecorded - nCapacity : 0;
+		// If the ring wrapped, the oldest surviving events can include ends whose begins were
+		// overwritten; skip those so that the viewer sees balanced spans.
+		size_t nOpen = 0;
+		for (size_t ixEvent = ixFirst; ixEvent < nRecorded; ++ixEvent)
+		{
+			const TraceEvent_t& event = pBuffer->events[ixEvent % nCapacity];
+			if ('E' == event.phase)
+			{
+				if (0 == nOpen)
+					continue;
+				--nOpen;
+			}
+			else
+			{
+				++nOpen;
+			}
+			// Event names are ASCII literals, so no JSON escaping is needed.
+			os << (0 == nWritten ? "\n" : ",\n")
+				<< "{\"name\":\"" << event.szName << "\",\"ph\":\"" << event.phase
+				<< "\",\"ts\":" << event.microseconds << ",\"pid\":1,\"tid\":" << pBuffer->threadId << "}";
+			++nWritten;
+		}
+	}
+	os << "\n]}\n";
+	return nWritten;
+}
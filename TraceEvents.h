@@ -0,0 +1,61 @@
+// Timeline of begin/end events, written in Chrome trace-event format
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <ostream>
+
+/// <summary>
+/// Process-wide recorder of begin/end events for a timeline viewer (chrome://tracing, Perfetto).
+///
+/// Each thread records into its own fixed-size ring buffer, allocated on the thread's first event;
+/// recording takes no lock and, once the buffer exists, allocates nothing. When a buffer is full,
+/// the oldest events are overwritten. WriteJson writes every thread's events as Chrome trace-event
+/// JSON; call it only when no other thread is recording (e.g., at exit).
+///
+/// Recording is off until Enable is called. Stats::ScopedTimer (STATS_SCOPE) records its scope as
+/// a begin/end pair when recording is on, so every timed phase shows up in the timeline.
+/// </summary>
+class TraceEvents
+{
+public:
+	/// <summary>
+	/// Default number of events each thread's ring buffer holds
+	/// </summary>
+	static const size_t nDefaultEventsPerThread = 65536;
+
+	/// <summary>
+	/// Turns on recording. Timestamps are relative to the first call.
+	/// </summary>
+	/// <param name="nEventsPerThread">Input: capacity of each thread's ring buffer</param>
+	static void Enable(size_t nEventsPerThread = nDefaultEventsPerThread);
+
+	/// <summary>
+	/// true if recording is on
+	/// </summary>
+	static bool Enabled() { return s_bEnabled.load(std::memory_order_relaxed); }
+
+	/// <summary>
+	/// Records the beginning of a named span on the calling thread.
+	/// </summary>
+	/// <param name="szName">Input: span name; must be a string literal or otherwise outlive WriteJson</param>
+	static void Begin(const char* szName);
+
+	/// <summary>
+	/// Records the end of the calling thread's innermost open span.
+	/// </summary>
+	/// <param name="szName">Input: span name, as passed to Begin</param>
+	static void End(const char* szName);
+
+	/// <summary>
+	/// Writes all recorded events as a Chrome trace-event JSON object.
+	/// </summary>
+	/// <param name="os">Output: stream to write to</param>
+	/// <returns>Number of events written</returns>
+	static size_t WriteJson(std::ostream& os);
+
+private:
+	static std::atomic<bool> s_bEnabled;
+};
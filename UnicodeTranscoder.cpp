@@ -0,0 +1,505 @@
+// Validating conversions between wide strings and the UTF-8 and UTF-16 (little-/big-endian) encodings
+
+#include <cstdint>
+#include <cstring>
+#include "UnicodeTranscoder.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define UNICODE_TRANSCODER_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if WCHAR_MAX > 0xFFFF
+#define UNICODE_TRANSCODER_WCHAR32
+#endif
+
+// ------------------------------------------------------------------------------------------
+// Helpers
+
+static const uint32_t cpReplacement = 0xFFFD;
+
+static inline bool IsHighSurrogate(uint32_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+static inline bool IsLowSurrogate(uint32_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+static inline bool IsSurrogate(uint32_t c) { return c >= 0xD800 && c <= 0xDFFF; }
+
+// Index of the lowest set bit of a nonzero mask
+static inline unsigned LowestSetBit(unsigned mask)
+{
+#if defined(_MSC_VER)
+	unsigned long ix;
+	_BitScanForward(&ix, mask);
+	return unsigned(ix);
+#else
+	return unsigned(__builtin_ctz(mask));
+#endif
+}
+
+// Decodes one UTF-8 sequence starting at p (p[0] >= 0x80), validating it.
+// Returns Transcode_Partial if the input ends within an otherwise valid sequence.
+static inline TranscodeStatus_t DecodeUtf8Sequence(const uint8_t* p, size_t cb, uint32_t& cp, size_t& cbSeq)
+{
+	const uint8_t b0 = p[0];
+	// Allowed range of the second byte, which also rules out overlong forms, surrogates, and values above U+10FFFF
+	uint8_t lo2 = 0x80, hi2 = 0xBF;
+	if (b0 >= 0xC2 && b0 <= 0xDF)
+	{
+		cbSeq = 2;
+		cp = b0 & 0x1F;
+	}
+	else if (b0 >= 0xE0 && b0 <= 0xEF)
+	{
+		cbSeq = 3;
+		cp = b0 & 0x0F;
+		if (0xE0 == b0) lo2 = 0xA0;
+		else if (0xED == b0) hi2 = 0x9F;
+	}
+	else if (b0 >= 0xF0 && b0 <= 0xF4)
+	{
+		cbSeq = 4;
+		cp = b0 & 0x07;
+		if (0xF0 == b0) lo2 = 0x90;
+		else if (0xF4 == b0) hi2 = 0x8F;
+	}
+	else
+	{
+		return Transcode_Invalid;
+	}
+
+	for (size_t ix = 1; ix < cbSeq; ++ix)
+	{
+		if (ix >= cb)
+			return Transcode_Partial;
+		const uint8_t b = p[ix];
+		if (1 == ix ? (b < lo2 || b > hi2) : (b < 0x80 || b > 0xBF))
+			return Transcode_Invalid;
+		cp = (cp << 6) | (b & 0x3F);
+	}
+	return Transcode_OK;
+}
+
+// Encodes a code point (not a surrogate, at most U+10FFFF) as UTF-8; returns the number of bytes.
+static inline size_t EncodeUtf8(uint32_t cp, uint8_t* p)
+{
+	if (cp < 0x80)
+	{
+		p[0] = uint8_t(cp);
+		return 1;
+	}
+	if (cp < 0x800)
+	{
+		p[0] = uint8_t(0xC0 | (cp >> 6));
+		p[1] = uint8_t(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000)
+	{
+		p[0] = uint8_t(0xE0 | (cp >> 12));
+		p[1] = uint8_t(0x80 | ((cp >> 6) & 0x3F));
+		p[2] = uint8_t(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	p[0] = uint8_t(0xF0 | (cp >> 18));
+	p[1] = uint8_t(0x80 | ((cp >> 12) & 0x3F));
+	p[2] = uint8_t(0x80 | ((cp >> 6) & 0x3F));
+	p[3] = uint8_t(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+// Number of wchar_t elements needed for a code point
+static inline size_t WideLength(uint32_t cp)
+{
+#ifdef UNICODE_TRANSCODER_WCHAR32
+	(void)cp;
+	return 1;
+#else
+	return cp >= 0x10000 ? 2 : 1;
+#endif
+}
+
+// Writes a code point as one wchar_t (UTF-32) or one or two (UTF-16); the caller ensures there is room.
+static inline size_t PutWide(uint32_t cp, wchar_t* p)
+{
+#ifndef UNICODE_TRANSCODER_WCHAR32
+	if (cp >= 0x10000)
+	{
+		cp -= 0x10000;
+		p[0] = wchar_t(0xD800 | (cp >> 10));
+		p[1] = wchar_t(0xDC00 | (cp & 0x3FF));
+		return 2;
+	}
+#endif
+	p[0] = wchar_t(cp);
+	return 1;
+}
+
+// Reads one code point from wchar_t input, combining a UTF-16 surrogate pair.
+// Returns Transcode_Partial for a high surrogate at the end of the input.
+static inline TranscodeStatus_t GetWide(const wchar_t* p, size_t cch, uint32_t& cp, size_t& cchSeq)
+{
+	cp = uint32_t(p[0]);
+	cchSeq = 1;
+#ifdef UNICODE_TRANSCODER_WCHAR32
+	(void)cch;
+	if (IsSurrogate(cp) || cp > 0x10FFFF)
+		return Transcode_Invalid;
+#else
+	if (IsHighSurrogate(cp))
+	{
+		if (cch < 2)
+			return Transcode_Partial;
+		const uint32_t lo = uint32_t(p[1]);
+		if (!IsLowSurrogate(lo))
+			return Transcode_Invalid;
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+		cchSeq = 2;
+	}
+	else if (IsLowSurrogate(cp))
+	{
+		return Transcode_Invalid;
+	}
+#endif
+	return Transcode_OK;
+}
+
+static inline uint32_t GetUtf16Unit(const uint8_t* p, bool bBigEndian)
+{
+	return bBigEndian ? ((uint32_t(p[0]) << 8) | p[1]) : ((uint32_t(p[1]) << 8) | p[0]);
+}
+
+static inline void PutUtf16Unit(uint32_t u, uint8_t* p, bool bBigEndian)
+{
+	p[bBigEndian ? 0 : 1] = uint8_t(u >> 8);
+	p[bBigEndian ? 1 : 0] = uint8_t(u & 0xFF);
+}
+
+#ifdef UNICODE_TRANSCODER_SSE2
+// Stores 8 16-bit values as wchar_t
+static inline void StoreWide8(__m128i v16, wchar_t* pDst)
+{
+#ifdef UNICODE_TRANSCODER_WCHAR32
+	const __m128i zero = _mm_setzero_si128();
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), _mm_unpacklo_epi16(v16, zero));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4), _mm_unpackhi_epi16(v16, zero));
+#else
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), v16);
+#endif
+}
+
+// Loads 8 wchar_t as 16-bit values; sets bFits to false if any doesn't fit in 16 bits
+static inline __m128i LoadWide8(const wchar_t* pSrc, bool& bFits)
+{
+#ifdef UNICODE_TRANSCODER_WCHAR32
+	const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+	const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 4));
+	const __m128i hi = _mm_set1_epi32(int(0xFFFF0000));
+	bFits = (0xFFFF == _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(v1, v2), hi), _mm_setzero_si128())));
+	// Subtract 0x8000 so that signed saturation packs 0..0xFFFF without change, then add it back
+	const __m128i bias32 = _mm_set1_epi32(0x8000);
+	const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(v1, bias32), _mm_sub_epi32(v2, bias32));
+	return _mm_add_epi16(packed, _mm_set1_epi16(int16_t(-0x8000)));
+#else
+	bFits = true;
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+#endif
+}
+
+// Returns true if none of the 8 16-bit values is a surrogate
+static inline bool NoSurrogates8(__m128i v16)
+{
+	const __m128i masked = _mm_and_si128(v16, _mm_set1_epi16(int16_t(0xF800)));
+	return 0 == _mm_movemask_epi8(_mm_cmpeq_epi16(masked, _mm_set1_epi16(int16_t(0xD800))));
+}
+
+// Swaps the bytes of each 16-bit value
+static inline __m128i ByteSwap16(__m128i v16)
+{
+	return _mm_or_si128(_mm_slli_epi16(v16, 8), _mm_srli_epi16(v16, 8));
+}
+#endif
+
+// ------------------------------------------------------------------------------------------
+// UTF-8
+
+TranscodeStatus_t Utf8ToWide(const char* pSrc, size_t cbSrc, wchar_t* pDst, size_t cchDst, size_t& cbRead, size_t& cchWritten)
+{
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(pSrc);
+	size_t ixSrc = 0, ixDst = 0;
+	TranscodeStatus_t status = Transcode_OK;
+	while (ixSrc < cbSrc)
+	{
+#ifdef UNICODE_TRANSCODER_SSE2
+		// Fast path: 16 bytes at a time while they are all ASCII
+		if (cbSrc - ixSrc >= 16 && cchDst - ixDst >= 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + ixSrc));
+			const unsigned mask = unsigned(_mm_movemask_epi8(v));
+			if (0 == mask)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				StoreWide8(_mm_unpacklo_epi8(v, zero), pDst + ixDst);
+				StoreWide8(_mm_unpackhi_epi8(v, zero), pDst + ixDst + 8);
+				ixSrc += 16;
+				ixDst += 16;
+				continue;
+			}
+			// Copy the ASCII bytes before the first non-ASCII byte, then decode that sequence below.
+			for (unsigned nAscii = LowestSetBit(mask); nAscii > 0; --nAscii)
+			{
+				pDst[ixDst++] = wchar_t(p[ixSrc++]);
+			}
+		}
+#endif
+		const uint8_t b0 = p[ixSrc];
+		if (b0 < 0x80)
+		{
+			if (ixDst >= cchDst)
+			{
+				status = Transcode_Partial;
+				break;
+			}
+			pDst[ixDst++] = wchar_t(b0);
+			++ixSrc;
+			continue;
+		}
+
+		uint32_t cp;
+		size_t cbSeq;
+		status = DecodeUtf8Sequence(p + ixSrc, cbSrc - ixSrc, cp, cbSeq);
+		if (Transcode_OK != status)
+			break;
+		if (cchDst - ixDst < WideLength(cp))
+		{
+			status = Transcode_Partial;
+			break;
+		}
+		ixDst += PutWide(cp, pDst + ixDst);
+		ixSrc += cbSeq;
+	}
+	cbRead = ixSrc;
+	cchWritten = ixDst;
+	return status;
+}
+
+TranscodeStatus_t WideToUtf8(const wchar_t* pSrc, size_t cchSrc, char* pDst, size_t cbDst, size_t& cchRead, size_t& cbWritten)
+{
+	uint8_t* p = reinterpret_cast<uint8_t*>(pDst);
+	size_t ixSrc = 0, ixDst = 0;
+	TranscodeStatus_t status = Transcode_OK;
+	while (ixSrc < cchSrc)
+	{
+#ifdef UNICODE_TRANSCODER_SSE2
+		// Fast path: 16 characters at a time while they are all ASCII
+		if (cchSrc - ixSrc >= 16 && cbDst - ixDst >= 16)
+		{
+			bool bFits1, bFits2;
+			const __m128i v1 = LoadWide8(pSrc + ixSrc, bFits1);
+			const __m128i v2 = LoadWide8(pSrc + ixSrc + 8, bFits2);
+			const __m128i nonAscii = _mm_and_si128(_mm_or_si128(v1, v2), _mm_set1_epi16(int16_t(0xFF80)));
+			if (bFits1 && bFits2 && 0xFFFF == _mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())))
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p + ixDst), _mm_packus_epi16(v1, v2));
+				ixSrc += 16;
+				ixDst += 16;
+				continue;
+			}
+		}
+#endif
+		const uint32_t c = uint32_t(pSrc[ixSrc]);
+		if (c < 0x80)
+		{
+			if (ixDst >= cbDst)
+			{
+				status = Transcode_Partial;
+				break;
+			}
+			p[ixDst++] = uint8_t(c);
+			++ixSrc;
+			continue;
+		}
+
+		uint32_t cp;
+		size_t cchSeq;
+		status = GetWide(pSrc + ixSrc, cchSrc - ixSrc, cp, cchSeq);
+		if (Transcode_OK != status)
+			break;
+		uint8_t encoded[4];
+		const size_t cbSeq = EncodeUtf8(cp, encoded);
+		if (cbDst - ixDst < cbSeq)
+		{
+			status = Transcode_Partial;
+			break;
+		}
+		memcpy(p + ixDst, encoded, cbSeq);
+		ixDst += cbSeq;
+		ixSrc += cchSeq;
+	}
+	cchRead = ixSrc;
+	cbWritten = ixDst;
+	return status;
+}
+
+// ------------------------------------------------------------------------------------------
+// UTF-16
+
+TranscodeStatus_t Utf16ToWide(const char* pSrc, size_t cbSrc, bool bBigEndian, wchar_t* pDst, size_t cchDst, size_t& cbRead, size_t& cchWritten)
+{
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(pSrc);
+	size_t ixSrc = 0, ixDst = 0;
+	TranscodeStatus_t status = Transcode_OK;
+	while (ixSrc < cbSrc)
+	{
+#ifdef UNICODE_TRANSCODER_SSE2
+		// Fast path: 8 code units at a time while none is a surrogate
+		if (cbSrc - ixSrc >= 16 && cchDst - ixDst >= 8)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + ixSrc));
+			if (bBigEndian)
+				v = ByteSwap16(v);
+			if (NoSurrogates8(v))
+			{
+				StoreWide8(v, pDst + ixDst);
+				ixSrc += 16;
+				ixDst += 8;
+				continue;
+			}
+		}
+#endif
+		if (cbSrc - ixSrc < 2)
+		{
+			status = Transcode_Partial;
+			break;
+		}
+		uint32_t cp = GetUtf16Unit(p + ixSrc, bBigEndian);
+		size_t cbSeq = 2;
+		if (IsHighSurrogate(cp))
+		{
+			if (cbSrc - ixSrc < 4)
+			{
+				status = Transcode_Partial;
+				break;
+			}
+			const uint32_t lo = GetUtf16Unit(p + ixSrc + 2, bBigEndian);
+			if (!IsLowSurrogate(lo))
+			{
+				status = Transcode_Invalid;
+				break;
+			}
+			cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+			cbSeq = 4;
+		}
+		else if (IsLowSurrogate(cp))
+		{
+			status = Transcode_Invalid;
+			break;
+		}
+		if (cchDst - ixDst < WideLength(cp))
+		{
+			status = Transcode_Partial;
+			break;
+		}
+		ixDst += PutWide(cp, pDst + ixDst);
+		ixSrc += cbSeq;
+	}
+	cbRead = ixSrc;
+	cchWritten = ixDst;
+	return status;
+}
+
+TranscodeStatus_t WideToUtf16(const wchar_t* pSrc, size_t cchSrc, bool bBigEndian, char* pDst, size_t cbDst, size_t& cchRead, size_t& cbWritten)
+{
+	uint8_t* p = reinterpret_cast<uint8_t*>(pDst);
+	size_t ixSrc = 0, ixDst = 0;
+	TranscodeStatus_t status = Transcode_OK;
+	while (ixSrc < cchSrc)
+	{
+#ifdef UNICODE_TRANSCODER_SSE2
+		// Fast path: 8 characters at a time while none is a surrogate or (UTF-32) a supplementary character
+		if (cchSrc - ixSrc >= 8 && cbDst - ixDst >= 16)
+		{
+			bool bFits;
+			__m128i v = LoadWide8(pSrc + ixSrc, bFits);
+			if (bFits && NoSurrogates8(v))
+			{
+				if (bBigEndian)
+					v = ByteSwap16(v);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p + ixDst), v);
+				ixSrc += 8;
+				ixDst += 16;
+				continue;
+			}
+		}
+#endif
+		uint32_t cp;
+		size_t cchSeq;
+		status = GetWide(pSrc + ixSrc, cchSrc - ixSrc, cp, cchSeq);
+		if (Transcode_OK != status)
+			break;
+		const size_t cbSeq = (cp >= 0x10000) ? 4 : 2;
+		if (cbDst - ixDst < cbSeq)
+		{
+			status = Transcode_Partial;
+			break;
+		}
+		if (cp >= 0x10000)
+		{
+			PutUtf16Unit(0xD800 | ((cp - 0x10000) >> 10), p + ixDst, bBigEndian);
+			PutUtf16Unit(0xDC00 | ((cp - 0x10000) & 0x3FF), p + ixDst + 2, bBigEndian);
+		}
+		else
+		{
+			PutUtf16Unit(cp, p + ixDst, bBigEndian);
+		}
+		ixDst += cbSeq;
+		ixSrc += cchSeq;
+	}
+	cchRead = ixSrc;
+	cbWritten = ixDst;
+	return status;
+}
+
+// ------------------------------------------------------------------------------------------
+// Whole-string conversions
+
+bool Utf8ToWString(const char* pSrc, size_t cbSrc, std::wstring& sOut)
+{
+	// One wchar_t per input byte is always enough; shrink to the actual length afterwards.
+	sOut.resize(cbSrc);
+	size_t cbRead = 0, cchWritten = 0;
+	const TranscodeStatus_t status = (cbSrc > 0) ? Utf8ToWide(pSrc, cbSrc, &sOut[0], sOut.length(), cbRead, cchWritten) : Transcode_OK;
+	sOut.resize(cchWritten);
+	return Transcode_OK == status;
+}
+
+bool Utf16ToWString(const char* pSrc, size_t cbSrc, bool bBigEndian, std::wstring& sOut)
+{
+	sOut.resize(cbSrc / 2);
+	size_t cbRead = 0, cchWritten = 0;
+	const TranscodeStatus_t status = (cbSrc > 0) ? Utf16ToWide(pSrc, cbSrc, bBigEndian, sOut.empty() ? NULL : &sOut[0], sOut.length(), cbRead, cchWritten) : Transcode_OK;
+	sOut.resize(cchWritten);
+	return Transcode_OK == status;
+}
+
+void AppendWStringAsUtf8(const wchar_t* pSrc, size_t cchSrc, std::string& sOut)
+{
+	const size_t cbOriginal = sOut.length();
+	sOut.resize(cbOriginal + cchSrc * cbMaxUtf8PerWchar);
+	size_t ixSrc = 0, ixDst = cbOriginal;
+	while (ixSrc < cchSrc)
+	{
+		size_t cchRead = 0, cbWritten = 0;
+		const TranscodeStatus_t status = WideToUtf8(pSrc + ixSrc, cchSrc - ixSrc, &sOut[ixDst], sOut.length() - ixDst, cchRead, cbWritten);
+		ixSrc += cchRead;
+		ixDst += cbWritten;
+		if (Transcode_OK != status)
+		{
+			// Unpaired surrogate, including a high surrogate at the end of the input: its replacement
+			// character takes 3 bytes, no more than the space reserved for it.
+			ixDst += EncodeUtf8(cpReplacement, reinterpret_cast<uint8_t*>(&sOut[ixDst]));
+			++ixSrc;
+		}
+	}
+	sOut.resize(ixDst);
+}
@@ -0,0 +1,120 @@
+// Validating conversions between wide strings and the UTF-8 and UTF-16 (little-/big-endian) encodings
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cwchar>
+
+/*
+Replaces the std::codecvt_utf8 / std::codecvt_utf16 facets, which are deprecated as of C++17 and convert
+one character at a time.
+
+wchar_t strings are UTF-16 where wchar_t is 16 bits (Windows) and UTF-32 where it is 32 bits (Linux).
+Supplementary characters (U+10000 and above) are converted to and from UTF-16 surrogate pairs.
+
+All conversions validate their input: overlong UTF-8 forms, encoded surrogates, code points above U+10FFFF,
+and unpaired UTF-16 surrogates are rejected. Runs of ASCII (and, for UTF-16, runs without surrogates) are
+converted 16 code units at a time with SSE2 instructions where available, which covers nearly all of
+AppLocker policy XML; everything else takes the scalar path.
+*/
+
+/// <summary>
+/// Outcome of a buffer conversion.
+/// </summary>
+enum TranscodeStatus_t
+{
+	// All input converted
+	Transcode_OK,
+	// Conversion stopped early: the output buffer is full, or the input ends in the middle of a character.
+	// Call again with more output space, or with the unconverted input plus more input.
+	Transcode_Partial,
+	// The input has an invalid sequence at the position where conversion stopped
+	Transcode_Invalid
+};
+
+/// <summary>
+/// Maximum number of UTF-8 bytes produced per wchar_t (3 for UTF-16 wchar_t, 4 for UTF-32 wchar_t).
+/// </summary>
+const size_t cbMaxUtf8PerWchar = (WCHAR_MAX > 0xFFFF) ? 4 : 3;
+
+/// <summary>
+/// Converts UTF-8 to wchar_t. The output never needs more wchar_t elements than there are input bytes.
+/// </summary>
+/// <param name="pSrc">Input: UTF-8 bytes (no BOM handling)</param>
+/// <param name="cbSrc">Input: number of input bytes</param>
+/// <param name="pDst">Output: buffer for the converted characters</param>
+/// <param name="cchDst">Input: size of the output buffer in wchar_t elements</param>
+/// <param name="cbRead">Output: number of input bytes converted</param>
+/// <param name="cchWritten">Output: number of wchar_t elements written</param>
+/// <returns>Transcode_OK, Transcode_Partial, or Transcode_Invalid (input at pSrc + cbRead is invalid)</returns>
+TranscodeStatus_t Utf8ToWide(const char* pSrc, size_t cbSrc, wchar_t* pDst, size_t cchDst, size_t& cbRead, size_t& cchWritten);
+
+/// <summary>
+/// Converts wchar_t to UTF-8. The output never needs more than cbMaxUtf8PerWchar bytes per input element.
+/// A UTF-16 high surrogate at the end of the input is left unconverted (Transcode_Partial), so that
+/// the caller can supply the rest of the pair.
+/// </summary>
+/// <param name="pSrc">Input: characters to convert</param>
+/// <param name="cchSrc">Input: number of wchar_t elements to convert</param>
+/// <param name="pDst">Output: buffer for the UTF-8 bytes</param>
+/// <param name="cbDst">Input: size of the output buffer in bytes</param>
+/// <param name="cchRead">Output: number of wchar_t elements converted</param>
+/// <param name="cbWritten">Output: number of bytes written</param>
+/// <returns>Transcode_OK, Transcode_Partial, or Transcode_Invalid (input at pSrc + cchRead is invalid)</returns>
+TranscodeStatus_t WideToUtf8(const wchar_t* pSrc, size_t cchSrc, char* pDst, size_t cbDst, size_t& cchRead, size_t& cbWritten);
+
+/// <summary>
+/// Converts UTF-16 bytes (little- or big-endian) to wchar_t. The output never needs more wchar_t
+/// elements than half the number of input bytes.
+/// </summary>
+/// <param name="pSrc">Input: UTF-16 bytes (no BOM handling)</param>
+/// <param name="cbSrc">Input: number of input bytes</param>
+/// <param name="bBigEndian">Input: true for UTF-16BE, false for UTF-16LE</param>
+/// <param name="pDst">Output: buffer for the converted characters</param>
+/// <param name="cchDst">Input: size of the output buffer in wchar_t elements</param>
+/// <param name="cbRead">Output: number of input bytes converted</param>
+/// <param name="cchWritten">Output: number of wchar_t elements written</param>
+/// <returns>Transcode_OK, Transcode_Partial, or Transcode_Invalid (input at pSrc + cbRead is invalid)</returns>
+TranscodeStatus_t Utf16ToWide(const char* pSrc, size_t cbSrc, bool bBigEndian, wchar_t* pDst, size_t cchDst, size_t& cbRead, size_t& cchWritten);
+
+/// <summary>
+/// Converts wchar_t to UTF-16 bytes (little- or big-endian). The output never needs more than four bytes
+/// per input element. A UTF-16 high surrogate at the end of the input is left unconverted (Transcode_Partial).
+/// </summary>
+/// <param name="pSrc">Input: characters to convert</param>
+/// <param name="cchSrc">Input: number of wchar_t elements to convert</param>
+/// <param name="bBigEndian">Input: true for UTF-16BE, false for UTF-16LE</param>
+/// <param name="pDst">Output: buffer for the UTF-16 bytes</param>
+/// <param name="cbDst">Input: size of the output buffer in bytes</param>
+/// <param name="cchRead">Output: number of wchar_t elements converted</param>
+/// <param name="cbWritten">Output: number of bytes written</param>
+/// <returns>Transcode_OK, Transcode_Partial, or Transcode_Invalid (input at pSrc + cchRead is invalid)</returns>
+TranscodeStatus_t WideToUtf16(const wchar_t* pSrc, size_t cchSrc, bool bBigEndian, char* pDst, size_t cbDst, size_t& cchRead, size_t& cbWritten);
+
+/// <summary>
+/// Converts an entire UTF-8 buffer to a wide string.
+/// </summary>
+/// <returns>true if successful; false if the input is not valid UTF-8</returns>
+bool Utf8ToWString(const char* pSrc, size_t cbSrc, std::wstring& sOut);
+
+/// <summary>
+/// Converts an entire UTF-16 buffer (little- or big-endian) to a wide string.
+/// </summary>
+/// <returns>true if successful; false if the input is not valid UTF-16</returns>
+bool Utf16ToWString(const char* pSrc, size_t cbSrc, bool bBigEndian, std::wstring& sOut);
+
+/// <summary>
+/// Converts a wide string to UTF-8, appending to sOut. Unpaired surrogates are replaced with U+FFFD.
+/// </summary>
+void AppendWStringAsUtf8(const wchar_t* pSrc, size_t cchSrc, std::string& sOut);
+
+/// <summary>
+/// Converts a wide string to UTF-8. Unpaired surrogates are replaced with U+FFFD.
+/// </summary>
+inline std::string WStringToUtf8(const std::wstring& str)
+{
+	std::string sOut;
+	AppendWStringAsUtf8(str.c_str(), str.length(), sOut);
+	return sOut;
+}
@@ -1,8 +1,7 @@
 // Implementation for providing a locale for opening a UTF-8 encoded fstream for reading or writing.
 //
-//
-// *** NOTE that codecvt_* is DEPRECATED beginning in C++17 and nothing replaces it yet. ***
-//
+// The locales' conversion facets are built on the UnicodeTranscoder functions rather than on the
+// std::codecvt_utf8 / std::codecvt_utf16 facets, which are deprecated beginning in C++17.
 //
 
 // Need to allow use of fopen() -- fopen_s() isn't available in our Linux dev environment.
@@ -11,9 +10,12 @@
 #include <Windows.h>
 typedef unsigned char byte;
 #include <stdio.h>
+#include <cstring>
+#include <cstdint>
+#include <climits>
 #include "Utf8FileUtility.h"
-
-#include <codecvt>
+#include "UnicodeTranscoder.h"
+#include "MappedFile.h"
 
 // Microsoft defines std::locale::empty() which returns a transparent locale with no facets.
 // Examples online of how to create a locale object with a codecvt spec show using
@@ -22,46 +24,302 @@ typedef unsigned char byte;
 // locale object instead...
 static std::locale localeBase("");
 
+// Byte order markers
+static const char szUtf8Bom[] = "\xEF\xBB\xBF";
+static const char szUtf16LEBom[] = "\xFF\xFE";
+static const char szUtf16BEBom[] = "\xFE\xFF";
+
+/// <summary>
+/// Conversion facet between wchar_t and UTF-8, UTF-16LE or UTF-16BE, optionally consuming (when reading)
+/// or generating (when writing) a byte order marker.
+///
+/// File streams can convert one character at a time into or out of a one-element buffer. Where wchar_t
+/// is UTF-16, a supplementary character then needs two calls. Its state between the calls is kept in
+/// the stream's mbstate_t:
+/// * when reading: the high surrogate is delivered first, and only the last UTF-8 byte (or the
+///   UTF-16 low surrogate) is left in the input, for the next call to convert;
+/// * when writing: the high surrogate is consumed and held until the low surrogate arrives.
+/// </summary>
+class TranscoderFacet : public std::codecvt<wchar_t, char, std::mbstate_t>
+{
+public:
+	enum Encoding_t { Utf8, Utf16LE, Utf16BE };
+
+	TranscoderFacet(Encoding_t encoding, bool bConsumeHeader, bool bGenerateHeader)
+		: m_encoding(encoding), m_bConsumeHeader(bConsumeHeader), m_bGenerateHeader(bGenerateHeader)
+	{}
+
+protected:
+	result do_out(state_type& state,
+		const wchar_t* from, const wchar_t* from_end, const wchar_t*& from_next,
+		char* to, char* to_end, char*& to_next) const override;
+
+	result do_in(state_type& state,
+		const char* from, const char* from_end, const char*& from_next,
+		wchar_t* to, wchar_t* to_end, wchar_t*& to_next) const override;
+
+	result do_unshift(state_type& state, char* to, char* to_end, char*& to_next) const override
+	{
+		UNREFERENCED_PARAMETER(state);
+		UNREFERENCED_PARAMETER(to_end);
+		to_next = to;
+		return ok;
+	}
+
+	int do_length(state_type& state, const char* from, const char* from_end, size_t max) const override;
+
+	int do_encoding() const noexcept override { return 0; }
+	bool do_always_noconv() const noexcept override { return false; }
+	int do_max_length() const noexcept override { return m_bConsumeHeader ? 4 + int(BomLength()) : 4; }
+
+private:
+	// Conversion state kept in std::mbstate_t
+	struct State_t
+	{
+		// Flags_t values
+		uint32_t flags;
+		// Reading: the code point of the supplementary character whose high surrogate was delivered, without
+		// its last six bits (UTF-8) or with them (UTF-16). Writing: the held high surrogate.
+		uint32_t value;
+	};
+	enum Flags_t { HeaderDone = 1, PendingSurrogate = 2 };
+	static_assert(sizeof(std::mbstate_t) >= sizeof(State_t), "std::mbstate_t too small for conversion state");
+
+	static State_t GetState(const state_type& state)
+	{
+		State_t s;
+		memcpy(&s, &state, sizeof(s));
+		return s;
+	}
+	static void SetState(state_type& state, const State_t& s)
+	{
+		memcpy(&state, &s, sizeof(s));
+	}
+
+	const char* Bom() const
+	{
+		return Utf8 == m_encoding ? szUtf8Bom : (Utf16LE == m_encoding ? szUtf16LEBom : szUtf16BEBom);
+	}
+	size_t BomLength() const
+	{
+		return Utf8 == m_encoding ? 3 : 2;
+	}
+
+	const Encoding_t m_encoding;
+	const bool m_bConsumeHeader, m_bGenerateHeader;
+};
+
+TranscoderFacet::result TranscoderFacet::do_out(state_type& state,
+	const wchar_t* from, const wchar_t* from_end, const wchar_t*& from_next,
+	char* to, char* to_end, char*& to_next) const
+{
+	from_next = from;
+	to_next = to;
+	State_t s = GetState(state);
+
+	if (m_bGenerateHeader && !(s.flags & HeaderDone))
+	{
+		if (size_t(to_end - to_next) < BomLength())
+			return partial;
+		memcpy(to_next, Bom(), BomLength());
+		to_next += BomLength();
+		s.flags |= HeaderDone;
+		SetState(state, s);
+	}
+
+	size_t cchRead = 0, cbWritten = 0;
+	TranscodeStatus_t status;
+
+	// Complete a surrogate pair whose high surrogate arrived in the previous call.
+	if (s.flags & PendingSurrogate)
+	{
+		if (from_next == from_end)
+			return partial;
+		const wchar_t pair[2] = { wchar_t(s.value), *from_next };
+		status = (Utf8 == m_encoding) ?
+			WideToUtf8(pair, 2, to_next, size_t(to_end - to_next), cchRead, cbWritten) :
+			WideToUtf16(pair, 2, Utf16BE == m_encoding, to_next, size_t(to_end - to_next), cchRead, cbWritten);
+		if (Transcode_Invalid == status)
+			return error;
+		if (2 != cchRead)
+			return partial;
+		++from_next;
+		to_next += cbWritten;
+		s.flags &= ~uint32_t(PendingSurrogate);
+		SetState(state, s);
+	}
+
+	const size_t cchSrc = size_t(from_end - from_next);
+	status = (Utf8 == m_encoding) ?
+		WideToUtf8(from_next, cchSrc, to_next, size_t(to_end - to_next), cchRead, cbWritten) :
+		WideToUtf16(from_next, cchSrc, Utf16BE == m_encoding, to_next, size_t(to_end - to_next), cchRead, cbWritten);
+	from_next += cchRead;
+	to_next += cbWritten;
+	if (Transcode_Invalid == status)
+		return error;
+
+	// A high surrogate at the end of the input is held until its low surrogate arrives.
+	if (Transcode_Partial == status && from_next + 1 == from_end && *from_next >= 0xD800 && *from_next <= 0xDBFF)
+	{
+		s.value = uint32_t(*from_next++);
+		s.flags |= PendingSurrogate;
+		SetState(state, s);
+	}
+
+	return (from_next == from_end) ? ok : partial;
+}
+
+TranscoderFacet::result TranscoderFacet::do_in(state_type& state,
+	const char* from, const char* from_end, const char*& from_next,
+	wchar_t* to, wchar_t* to_end, wchar_t*& to_next) const
+{
+	from_next = from;
+	to_next = to;
+	State_t s = GetState(state);
+
+	if (m_bConsumeHeader && !(s.flags & HeaderDone))
+	{
+		// Wait for enough input to tell whether it starts with a BOM.
+		const size_t cbAvail = size_t(from_end - from_next);
+		const size_t cbCompare = (cbAvail < BomLength()) ? cbAvail : BomLength();
+		const bool bBom = (0 == memcmp(from_next, Bom(), cbCompare));
+		if (bBom && cbAvail < BomLength())
+			return partial;
+		if (bBom)
+			from_next += BomLength();
+		s.flags |= HeaderDone;
+		SetState(state, s);
+	}
+
+	// Deliver the low surrogate of a supplementary character whose high surrogate went out in the previous call.
+	if (s.flags & PendingSurrogate)
+	{
+		if (to_next == to_end)
+			return partial;
+		uint32_t cp;
+		if (Utf8 == m_encoding)
+		{
+			if (from_next == from_end)
+				return partial;
+			const uint8_t b = uint8_t(*from_next);
+			if (0x80 != (b & 0xC0))
+				return error;
+			cp = s.value | (b & 0x3Fu);
+			from_next += 1;
+		}
+		else
+		{
+			if (from_end - from_next < 2)
+				return partial;
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(from_next);
+			const uint32_t u = (Utf16BE == m_encoding) ? (uint32_t(p[0]) << 8 | p[1]) : (uint32_t(p[1]) << 8 | p[0]);
+			if (u < 0xDC00 || u > 0xDFFF)
+				return error;
+			cp = s.value | (u & 0x3FFu);
+			from_next += 2;
+		}
+		*to_next++ = wchar_t(0xDC00 | ((cp - 0x10000) & 0x3FF));
+		s.flags &= ~uint32_t(PendingSurrogate);
+		SetState(state, s);
+	}
+
+	size_t cbRead = 0, cchWritten = 0;
+	const size_t cbSrc = size_t(from_end - from_next);
+	TranscodeStatus_t status = (Utf8 == m_encoding) ?
+		Utf8ToWide(from_next, cbSrc, to_next, size_t(to_end - to_next), cbRead, cchWritten) :
+		Utf16ToWide(from_next, cbSrc, Utf16BE == m_encoding, to_next, size_t(to_end - to_next), cbRead, cchWritten);
+	from_next += cbRead;
+	to_next += cchWritten;
+	if (Transcode_Invalid == status)
+		return error;
+
+	// Room for only one more wchar_t: if the next character is a complete supplementary character (a surrogate
+	// pair where wchar_t is UTF-16), deliver its high surrogate and leave the last code unit for the next call.
+	if (Transcode_Partial == status && 1 == to_end - to_next)
+	{
+		wchar_t pair[2];
+		status = (Utf8 == m_encoding) ?
+			Utf8ToWide(from_next, size_t(from_end - from_next), pair, 2, cbRead, cchWritten) :
+			Utf16ToWide(from_next, size_t(from_end - from_next), Utf16BE == m_encoding, pair, 2, cbRead, cchWritten);
+		if (2 == cchWritten && pair[0] >= 0xD800 && pair[0] <= 0xDBFF)
+		{
+			const uint32_t cp = 0x10000 + ((uint32_t(pair[0]) - 0xD800) << 10) + (uint32_t(pair[1]) - 0xDC00);
+			*to_next++ = pair[0];
+			if (Utf8 == m_encoding)
+			{
+				s.value = cp & ~0x3Fu;
+				from_next += 3;
+			}
+			else
+			{
+				s.value = cp & ~0x3FFu;
+				from_next += 2;
+			}
+			s.flags |= PendingSurrogate;
+			SetState(state, s);
+		}
+	}
+
+	return (from_next == from_end) ? ok : partial;
+}
+
+int TranscoderFacet::do_length(state_type& state, const char* from, const char* from_end, size_t max) const
+{
+	// Convert into a scratch buffer until max characters are produced or the input is exhausted.
+	wchar_t buf[256];
+	const char* from_next = from;
+	while (max > 0 && from_next < from_end)
+	{
+		wchar_t* to_next = buf;
+		const size_t cchChunk = (max < sizeof(buf) / sizeof(buf[0])) ? max : sizeof(buf) / sizeof(buf[0]);
+		const char* from_start = from_next;
+		result r = do_in(state, from_start, from_end, from_next, buf, buf + cchChunk, to_next);
+		max -= size_t(to_next - buf);
+		if (error == r || from_next == from_start)
+			break;
+	}
+	return int(from_next - from);
+}
 
 const std::locale& Utf8FileUtility::LocaleForReadingUtf8File()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf8<wchar_t, 0x10ffff, std::consume_header>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf8, true, false));
 	return loc;
 }
 
 const std::locale& Utf8FileUtility::LocaleForWritingUtf8File()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf8<wchar_t, 0x10ffff, std::generate_header>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf8, false, true));
 	return loc;
 }
 
 const std::locale& Utf8FileUtility::LocaleForWritingUtf8NoHeader()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf8<wchar_t, 0x10ffff>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf8, false, false));
 	return loc;
 }
 
 const std::locale& Utf8FileUtility::LocaleForReadingUtf16LEFile()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf16<wchar_t, 0x10ffff, (std::codecvt_mode)(std::little_endian | std::consume_header)>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf16LE, true, false));
 	return loc;
 }
 
 const std::locale& Utf8FileUtility::LocaleForWritingUtf16LEFile()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf16<wchar_t, 0x10ffff, (std::codecvt_mode)(std::little_endian | std::generate_header)>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf16LE, false, true));
 	return loc;
 }
 
 const std::locale& Utf8FileUtility::LocaleForReadingUtf16BEFile()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf16<wchar_t, 0x10ffff, std::consume_header>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf16BE, true, false));
 	return loc;
 }
 
 const std::locale& Utf8FileUtility::LocaleForWritingUtf16BEFile()
 {
-	static std::locale loc(localeBase, new std::codecvt_utf16<wchar_t, 0x10ffff, std::generate_header>);
+	static std::locale loc(localeBase, new TranscoderFacet(TranscoderFacet::Utf16BE, false, true));
 	return loc;
 }
 
@@ -118,3 +376,65 @@ bool Utf8FileUtility::OpenForReadingWithLocale(std::wifstream& fs, const wchar_t
 
 	return true;
 }
+
+/// <summary>
+/// Reads an entire text file into a wide string, decoding it according to its byte order marker.
+/// </summary>
+bool Utf8FileUtility::ReadTextFile(const wchar_t* szFilename, std::wstring& sText, std::wstring& sErrorInfo)
+{
+	sText.clear();
+	MappedFile mappedFile;
+	if (!mappedFile.Open(szFilename, sErrorInfo))
+		return false;
+
+	const char* pData = reinterpret_cast<const char*>(mappedFile.Data());
+	size_t cbData = mappedFile.Size();
+	bool bOK;
+	if (cbData >= 2 && 0 == memcmp(pData, szUtf16LEBom, 2))
+	{
+		bOK = Utf16ToWString(pData + 2, cbData - 2, false, sText);
+	}
+	else if (cbData >= 2 && 0 == memcmp(pData, szUtf16BEBom, 2))
+	{
+		bOK = Utf16ToWString(pData + 2, cbData - 2, true, sText);
+	}
+	else if (cbData >= 3 && 0 == memcmp(pData, szUtf8Bom, 3))
+	{
+		bOK = Utf8ToWString(pData + 3, cbData - 3, sText);
+	}
+	else
+	{
+		// No BOM: UTF-8 if it's valid UTF-8 (which includes plain ASCII), otherwise the ANSI code page.
+		bOK = Utf8ToWString(pData, cbData, sText);
+		if (!bOK && cbData <= size_t(INT_MAX))
+		{
+			int cch = MultiByteToWideChar(CP_ACP, 0, pData, int(cbData), NULL, 0);
+			sText.resize(size_t(cch));
+			bOK = (cch > 0 && cch == MultiByteToWideChar(CP_ACP, 0, pData, int(cbData), &sText[0], cch));
+		}
+	}
+
+	if (!bOK)
+	{
+		sText.clear();
+		sErrorInfo = L"Invalid text encoding in file ";
+		sErrorInfo += szFilename;
+		return false;
+	}
+
+	// Same line endings as a text-mode stream would deliver
+	size_t ixOut = sText.find(L"\r\n");
+	if (std::wstring::npos != ixOut)
+	{
+		for (size_t ixIn = ixOut; ixIn < sText.length(); ++ixIn)
+		{
+			if (L'\r' == sText[ixIn] && ixIn + 1 < sText.length() && L'\n' == sText[ixIn + 1])
+				continue;
+			sText[ixOut++] = sText[ixIn];
+		}
+		sText.resize(ixOut);
+	}
+
+	sErrorInfo.clear();
+	return true;
+}
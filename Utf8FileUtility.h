@@ -4,6 +4,7 @@
 
 #include <locale>
 #include <fstream>
+#include <string>
 
 //TODO: Rename "Utf8FileUtility" class, .h and .cpp files to "UnicodeFileUtility," or better "UnicodeStreamUtility."
 class Utf8FileUtility
@@ -57,5 +58,16 @@ public:
 	/// <returns>true if file stream opened successfully; false otherwise.</returns>
 	static bool OpenForReadingWithLocale(std::wifstream& fs, const wchar_t* szFilename);
 
+	/// <summary>
+	/// Reads an entire text file into a wide string in one pass, decoding it according to its byte order
+	/// marker (UTF-8, UTF-16LE or UTF-16BE). A file without a BOM is decoded as UTF-8 if it is valid UTF-8,
+	/// otherwise with the ANSI code page. CR/LF line endings are converted to LF, as a text-mode stream would.
+	/// </summary>
+	/// <param name="szFilename">Input: name of the file to read</param>
+	/// <param name="sText">Output: the file's content</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if successful; false if the file cannot be read or is not validly encoded.</returns>
+	static bool ReadTextFile(const wchar_t* szFilename, std::wstring& sText, std::wstring& sErrorInfo);
+
 };
 
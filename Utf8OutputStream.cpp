@@ -0,0 +1,431 @@
+// Buffered UTF-8 output to stdout or to a file
+
+#ifdef _WIN32
+#include <Windows.h>
+#include "SysErrorMessage.h"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include "FileSystemUtils-Posix.h"
+#endif
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include "Utf8OutputStream.h"
+#include "UnicodeTranscoder.h"
+
+static const char szUtf8Bom[] = "\xEF\xBB\xBF";
+// U+FFFD, written in place of unpaired surrogates
+static const char szUtf8Replacement[] = "\xEF\xBF\xBD";
+
+static inline bool IsHighSurrogate(wchar_t ch)
+{
+	return ch >= 0xD800 && ch <= 0xDBFF;
+}
+
+Utf8OutputBuffer::Utf8OutputBuffer(size_t cbBuffer)
+	: m_target(None), m_hFile(NULL), m_fd(-1), m_bCrLf(false),
+	// Room for at least a surrogate pair and a CR/LF
+	m_bytes(cbBuffer < 64 ? 64 : cbBuffer), m_cbUsed(0),
+	m_chPendingHigh(0)
+{
+	setp(m_chars, m_chars + sizeof(m_chars) / sizeof(m_chars[0]));
+}
+
+Utf8OutputBuffer::~Utf8OutputBuffer()
+{
+	// Uncommitted output to stdout or a non-atomic file is still written; an uncommitted atomic file is discarded.
+	if (File == m_target && !m_sTempFilename.empty())
+	{
+		CloseTarget();
+	}
+	else if (None != m_target)
+	{
+		std::wstring sErrorInfo;
+		Close(sErrorInfo);
+	}
+}
+
+void Utf8OutputBuffer::OpenStdout(bool bWriteBom)
+{
+	if (IsOpen())
+	{
+		std::wstring sErrorInfo;
+		Close(sErrorInfo);
+	}
+	m_sErrorInfo.clear();
+	m_target = Stdout;
+#ifdef _WIN32
+	m_hFile = GetStdHandle(STD_OUTPUT_HANDLE);
+	m_bCrLf = true;
+#else
+	m_fd = STDOUT_FILENO;
+	m_bCrLf = false;
+#endif
+	if (bWriteBom)
+		AppendBytes(szUtf8Bom, 3);
+}
+
+bool Utf8OutputBuffer::OpenFile(const std::wstring& sFilename, bool bAtomic, bool bWriteBom, std::wstring& sErrorInfo)
+{
+	if (IsOpen())
+		Close(sErrorInfo);
+	sErrorInfo.clear();
+	m_sErrorInfo.clear();
+	m_sFilename = sFilename;
+	m_sTempFilename.clear();
+
+	// An atomic file's temporary file is new and uniquely named, so that no other file is overwritten and
+	// concurrent writers don't collide, and is in the target's directory, so that the rename is within a volume.
+#ifdef _WIN32
+	std::wstring sCreatePath = sFilename;
+	DWORD dwCreationDisposition = CREATE_ALWAYS;
+	if (bAtomic)
+	{
+		const size_t ixLastPathSep = sFilename.find_last_of(L"/\\");
+		const std::wstring sDirectory = (std::wstring::npos == ixLastPathSep) ? std::wstring(L".") : sFilename.substr(0, ixLastPathSep + 1);
+		wchar_t szTempFilename[MAX_PATH];
+		if (0 == GetTempFileNameW(sDirectory.c_str(), L"alp", 0, szTempFilename))
+		{
+			sErrorInfo = L"Cannot create a temporary file in " + sDirectory + L": " + SysErrorMessage();
+			return false;
+		}
+		// GetTempFileNameW created the file.
+		sCreatePath = m_sTempFilename = szTempFilename;
+		dwCreationDisposition = TRUNCATE_EXISTING;
+	}
+	HANDLE hFile = CreateFileW(sCreatePath.c_str(), GENERIC_WRITE, 0, NULL, dwCreationDisposition, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+	{
+		sErrorInfo = L"Cannot create " + sCreatePath + L": " + SysErrorMessage();
+		if (bAtomic)
+			DeleteFileW(sCreatePath.c_str());
+		m_sTempFilename.clear();
+		return false;
+	}
+	m_hFile = hFile;
+	m_bCrLf = true;
+#else
+	// Like mkstemp, but with the usual permissions for new files (0666 less the umask) rather than 0600
+	static std::atomic<unsigned> nTempFiles(0);
+	std::wstring sCreatePath = sFilename;
+	for (unsigned nAttempts = 0; ; ++nAttempts)
+	{
+		if (bAtomic)
+			sCreatePath = sFilename + L"." + std::to_wstring(getpid()) + L"-" + std::to_wstring(++nTempFiles) + L".tmp";
+		m_fd = open(PosixPathFromWString(sCreatePath).c_str(), O_WRONLY | O_CREAT | (bAtomic ? O_EXCL : O_TRUNC) | O_CLOEXEC, 0666);
+		if (m_fd >= 0 || !bAtomic || EEXIST != errno || nAttempts >= 100)
+			break;
+	}
+	if (m_fd < 0)
+	{
+		sErrorInfo = L"Cannot create " + sCreatePath + L": " + WStringFromPosixName(strerror(errno));
+		return false;
+	}
+	if (bAtomic)
+		m_sTempFilename = sCreatePath;
+	m_bCrLf = false;
+#endif
+	m_target = File;
+	if (bWriteBom)
+		AppendBytes(szUtf8Bom, 3);
+	return true;
+}
+
+bool Utf8OutputBuffer::Close(std::wstring& sErrorInfo)
+{
+	sErrorInfo.clear();
+	if (None == m_target)
+		return true;
+
+	EncodePutArea();
+	if (0 != m_chPendingHigh)
+	{
+		m_chPendingHigh = 0;
+		AppendBytes(szUtf8Replacement, 3);
+	}
+	FlushBytes();
+	// Make an atomic file's content durable before the rename makes it the target; otherwise, after a
+	// crash, the target could be replaced by an empty or partial file.
+	if (!m_sTempFilename.empty() && m_sErrorInfo.empty())
+	{
+#ifdef _WIN32
+		if (!FlushFileBuffers(m_hFile))
+			m_sErrorInfo = L"Cannot write " + m_sTempFilename + L": " + SysErrorMessage();
+#else
+		if (0 != fsync(m_fd))
+			m_sErrorInfo = L"Cannot write " + m_sTempFilename + L": " + WStringFromPosixName(strerror(errno));
+#endif
+	}
+	// Take the temporary file name so that CloseTarget doesn't discard the file.
+	const std::wstring sTempFilename = m_sTempFilename;
+	m_sTempFilename.clear();
+	CloseTarget();
+
+	if (!sTempFilename.empty())
+	{
+		if (m_sErrorInfo.empty())
+		{
+#ifdef _WIN32
+			if (!MoveFileExW(sTempFilename.c_str(), m_sFilename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+				m_sErrorInfo = L"Cannot replace " + m_sFilename + L": " + SysErrorMessage();
+#else
+			if (0 != rename(PosixPathFromWString(sTempFilename).c_str(), PosixPathFromWString(m_sFilename).c_str()))
+				m_sErrorInfo = L"Cannot replace " + m_sFilename + L": " + WStringFromPosixName(strerror(errno));
+#endif
+		}
+		if (!m_sErrorInfo.empty())
+		{
+#ifdef _WIN32
+			DeleteFileW(sTempFilename.c_str());
+#else
+			unlink(PosixPathFromWString(sTempFilename).c_str());
+#endif
+		}
+	}
+
+	sErrorInfo = m_sErrorInfo;
+	return sErrorInfo.empty();
+}
+
+bool Utf8OutputBuffer::WriteBytes(const void* pb, size_t cb)
+{
+	if (!EncodePutArea())
+		return false;
+	// Large blocks are written directly rather than copied through the byte buffer.
+	if (cb > BytesFree())
+		return FlushBytes() && WriteTarget(static_cast<const char*>(pb), cb);
+	return AppendBytes(static_cast<const char*>(pb), cb);
+}
+
+Utf8OutputBuffer::int_type Utf8OutputBuffer::overflow(int_type ch)
+{
+	if (!EncodePutArea())
+		return traits_type::eof();
+	if (traits_type::eq_int_type(ch, traits_type::eof()))
+		return traits_type::not_eof(ch);
+	*pptr() = traits_type::to_char_type(ch);
+	pbump(1);
+	return ch;
+}
+
+std::streamsize Utf8OutputBuffer::xsputn(const wchar_t* pch, std::streamsize cch)
+{
+	if (cch <= 0)
+		return 0;
+	// Short strings are collected in the put area; long ones are encoded straight from the caller's buffer.
+	if (cch <= epptr() - pptr())
+	{
+		wmemcpy(pptr(), pch, size_t(cch));
+		pbump(int(cch));
+		return cch;
+	}
+	if (!EncodePutArea() || !Encode(pch, size_t(cch)))
+		return 0;
+	return cch;
+}
+
+int Utf8OutputBuffer::sync()
+{
+	return (EncodePutArea() && FlushBytes()) ? 0 : -1;
+}
+
+bool Utf8OutputBuffer::EncodePutArea()
+{
+	const size_t cch = size_t(pptr() - pbase());
+	setp(m_chars, m_chars + sizeof(m_chars) / sizeof(m_chars[0]));
+	return Encode(m_chars, cch);
+}
+
+bool Utf8OutputBuffer::Encode(const wchar_t* pch, size_t cch)
+{
+	if (None == m_target)
+		return false;
+
+	// Complete a surrogate pair split across calls.
+	if (0 != m_chPendingHigh && cch > 0)
+	{
+		const wchar_t pair[2] = { m_chPendingHigh, *pch };
+		m_chPendingHigh = 0;
+		if (BytesFree() < cbMaxUtf8PerWchar * 2 && !FlushBytes())
+			return false;
+		size_t cchRead, cbWritten;
+		if (Transcode_OK == WideToUtf8(pair, 2, &m_bytes[m_cbUsed], BytesFree(), cchRead, cbWritten))
+		{
+			m_cbUsed += cbWritten;
+			++pch;
+			--cch;
+		}
+		else if (!AppendBytes(szUtf8Replacement, 3))
+		{
+			return false;
+		}
+	}
+
+	while (cch > 0)
+	{
+		// Encode up to the next LF, which is then written as CR/LF.
+		size_t cchSegment = cch;
+		const wchar_t* pNewline = m_bCrLf ? wmemchr(pch, L'\n', cch) : NULL;
+		if (NULL != pNewline)
+			cchSegment = size_t(pNewline - pch);
+
+		while (cchSegment > 0)
+		{
+			if (BytesFree() < cbMaxUtf8PerWchar * 2 && !FlushBytes())
+				return false;
+			size_t cchRead, cbWritten;
+			TranscodeStatus_t status = WideToUtf8(pch, cchSegment, &m_bytes[m_cbUsed], BytesFree(), cchRead, cbWritten);
+			m_cbUsed += cbWritten;
+			pch += cchRead;
+			cch -= cchRead;
+			cchSegment -= cchRead;
+			if (Transcode_OK == status || 0 == cchSegment)
+				continue;
+
+			const bool bLoneHighSurrogate = (1 == cchSegment && IsHighSurrogate(*pch));
+			if (Transcode_Partial == status && !bLoneHighSurrogate)
+			{
+				// Byte buffer full
+				continue;
+			}
+			if (bLoneHighSurrogate && 1 == cch)
+			{
+				// High surrogate at the end of this call's input: its low surrogate may come in the next call.
+				m_chPendingHigh = *pch;
+			}
+			else if (!AppendBytes(szUtf8Replacement, 3))
+			{
+				return false;
+			}
+			++pch;
+			--cch;
+			--cchSegment;
+		}
+
+		if (NULL != pNewline)
+		{
+			if (!AppendBytes("\r\n", 2))
+				return false;
+			++pch;
+			--cch;
+		}
+	}
+	return true;
+}
+
+bool Utf8OutputBuffer::AppendBytes(const char* pb, size_t cb)
+{
+	if (BytesFree() < cb && !FlushBytes())
+		return false;
+	memcpy(&m_bytes[m_cbUsed], pb, cb);
+	m_cbUsed += cb;
+	return true;
+}
+
+bool Utf8OutputBuffer::FlushBytes()
+{
+	const size_t cb = m_cbUsed;
+	m_cbUsed = 0;
+	if (!m_sErrorInfo.empty())
+		return false;
+	return 0 == cb || WriteTarget(m_bytes.data(), cb);
+}
+
+bool Utf8OutputBuffer::WriteTarget(const char* pb, size_t cb)
+{
+#ifdef _WIN32
+	// Output through the C runtime or std::wcout must come first.
+	if (Stdout == m_target)
+		fflush(stdout);
+	while (cb > 0)
+	{
+		const DWORD cbChunk = (cb > 0x40000000) ? 0x40000000 : DWORD(cb);
+		DWORD cbWritten = 0;
+		if (!WriteFile(m_hFile, pb, cbChunk, &cbWritten, NULL) || 0 == cbWritten)
+		{
+			m_sErrorInfo = L"Cannot write " + TargetName() + L": " + SysErrorMessage();
+			return false;
+		}
+		pb += cbWritten;
+		cb -= cbWritten;
+	}
+#else
+	if (Stdout == m_target)
+		fflush(stdout);
+	while (cb > 0)
+	{
+		const ssize_t cbWritten = write(m_fd, pb, cb);
+		if (cbWritten < 0 && EINTR == errno)
+			continue;
+		if (cbWritten <= 0)
+		{
+			m_sErrorInfo = L"Cannot write " + TargetName() + L": " + WStringFromPosixName(strerror(errno));
+			return false;
+		}
+		pb += cbWritten;
+		cb -= size_t(cbWritten);
+	}
+#endif
+	return true;
+}
+
+std::wstring Utf8OutputBuffer::TargetName() const
+{
+	if (Stdout == m_target)
+		return L"stdout";
+	return m_sTempFilename.empty() ? m_sFilename : m_sTempFilename;
+}
+
+void Utf8OutputBuffer::CloseTarget()
+{
+	if (File == m_target)
+	{
+#ifdef _WIN32
+		CloseHandle(m_hFile);
+#else
+		close(m_fd);
+#endif
+		// A discarded atomic file
+		if (!m_sTempFilename.empty())
+		{
+#ifdef _WIN32
+			DeleteFileW(m_sTempFilename.c_str());
+#else
+			unlink(PosixPathFromWString(m_sTempFilename).c_str());
+#endif
+			m_sTempFilename.clear();
+		}
+	}
+	m_target = None;
+	m_hFile = NULL;
+	m_fd = -1;
+	m_cbUsed = 0;
+	m_chPendingHigh = 0;
+	setp(m_chars, m_chars + sizeof(m_chars) / sizeof(m_chars[0]));
+}
+
+Utf8OutputStream::Utf8OutputStream(size_t cbBuffer)
+	: std::wostream(NULL), m_buffer(cbBuffer)
+{
+	rdbuf(&m_buffer);
+}
+
+bool Utf8OutputStream::Open(const std::wstring& sFilename, std::wstring& sErrorInfo)
+{
+	clear();
+	sErrorInfo.clear();
+	if (sFilename.empty())
+	{
+		m_buffer.OpenStdout(false);
+		return true;
+	}
+	return m_buffer.OpenFile(sFilename, true, true, sErrorInfo);
+}
+
+bool Utf8OutputStream::Close(std::wstring& sErrorInfo)
+{
+	return m_buffer.Close(sErrorInfo);
+}
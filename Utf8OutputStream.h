@@ -0,0 +1,162 @@
+// Buffered UTF-8 output to stdout or to a file
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Stream buffer that encodes wide characters to UTF-8 into a large byte buffer and writes the
+/// buffer to stdout or to a file in bulk.
+///
+/// Characters are encoded when the small wide-character put area fills, when the stream is flushed,
+/// and directly from the caller's buffer for large writes, so a long string is never copied as a whole.
+/// Encoded bytes are written only when the byte buffer fills, when the stream is flushed, or on Close().
+/// Unpaired surrogates are written as U+FFFD.
+///
+/// On Windows, LF is written as CR/LF, as a text-mode stream would.
+///
+/// A file can be written atomically: the content goes to a new, uniquely named temporary file next to
+/// the target, which is flushed to disk and then replaces the target only when Close() succeeds. If the
+/// object is destroyed without a successful Close(), the temporary file is deleted and the target is
+/// left unchanged.
+/// </summary>
+class Utf8OutputBuffer : public std::wstreambuf
+{
+public:
+	/// <summary>
+	/// Default size of the encoded-byte buffer.
+	/// </summary>
+	static const size_t cbDefaultBuffer = 1024 * 1024;
+
+	// Constructor
+	explicit Utf8OutputBuffer(size_t cbBuffer = cbDefaultBuffer);
+	// Destructor
+	virtual ~Utf8OutputBuffer();
+
+	/// <summary>
+	/// Directs output to stdout. Any previous target is closed first.
+	/// </summary>
+	/// <param name="bWriteBom">Input: true to begin the output with a UTF-8 byte order marker</param>
+	void OpenStdout(bool bWriteBom);
+
+	/// <summary>
+	/// Creates (or truncates) a file, or for atomic output a temporary file, and directs output to it.
+	/// Any previous target is closed first.
+	/// </summary>
+	/// <param name="sFilename">Input: path of the file to write</param>
+	/// <param name="bAtomic">Input: true to write to a temporary file that replaces sFilename on Close()</param>
+	/// <param name="bWriteBom">Input: true to begin the file with a UTF-8 byte order marker</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if successful, false otherwise</returns>
+	bool OpenFile(const std::wstring& sFilename, bool bAtomic, bool bWriteBom, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Writes bytes as they are, after any characters already written; e.g., binary content for an
+	/// atomic file. LF bytes are not translated.
+	/// </summary>
+	/// <param name="pb">Input: bytes to write</param>
+	/// <param name="cb">Input: number of bytes</param>
+	/// <returns>true if successful; false after a write error, which Close() reports</returns>
+	bool WriteBytes(const void* pb, size_t cb);
+
+	/// <summary>
+	/// Writes all buffered output and closes the target. For an atomic file, replaces the target file
+	/// with the temporary file.
+	/// </summary>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if all output was written, false otherwise</returns>
+	bool Close(std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Returns true if output is directed to stdout or to a file.
+	/// </summary>
+	bool IsOpen() const { return None != m_target; }
+
+protected:
+	int_type overflow(int_type ch) override;
+	std::streamsize xsputn(const wchar_t* pch, std::streamsize cch) override;
+	int sync() override;
+
+private:
+	bool EncodePutArea();
+	bool Encode(const wchar_t* pch, size_t cch);
+	bool AppendBytes(const char* pb, size_t cb);
+	bool FlushBytes();
+	bool WriteTarget(const char* pb, size_t cb);
+	void CloseTarget();
+	std::wstring TargetName() const;
+	size_t BytesFree() const { return m_bytes.size() - m_cbUsed; }
+
+	enum Target_t { None, Stdout, File };
+	Target_t m_target;
+	// File target handle (Windows HANDLE, or POSIX file descriptor)
+	void* m_hFile;
+	int m_fd;
+	std::wstring m_sFilename, m_sTempFilename;
+	// Translate LF to CR/LF
+	bool m_bCrLf;
+
+	// Encoded bytes not yet written
+	std::vector<char> m_bytes;
+	size_t m_cbUsed;
+	// Put area for characters written one or a few at a time
+	wchar_t m_chars[4096];
+	// High surrogate at the end of the last encoded characters, waiting for its low surrogate
+	wchar_t m_chPendingHigh;
+	// First write error, if any
+	std::wstring m_sErrorInfo;
+
+private:
+	// Not implemented
+	Utf8OutputBuffer(const Utf8OutputBuffer&) = delete;
+	Utf8OutputBuffer& operator = (const Utf8OutputBuffer&) = delete;
+};
+
+/// <summary>
+/// Wide output stream over a Utf8OutputBuffer. Output goes to stdout, or atomically to a UTF-8 file
+/// with a byte order marker. Output to stdout has no byte order marker, so that it can be piped to
+/// other programs (e.g., JSON to jq) and can follow text already written to the console.
+///
+/// Usage:
+/// 	Utf8OutputStream os;
+/// 	if (os.Open(sOutputFile, sErrorInfo))
+/// 	{
+/// 		os << sPolicyXml << L"\n";
+/// 		bOK = os.Close(sErrorInfo);
+/// 	}
+///
+/// Close() must be called for file output to replace the target file.
+/// Stream std::endl sparingly: each one writes all buffered output to the target.
+/// </summary>
+class Utf8OutputStream : public std::wostream
+{
+public:
+	// Constructor
+	explicit Utf8OutputStream(size_t cbBuffer = Utf8OutputBuffer::cbDefaultBuffer);
+	// Destructor
+	virtual ~Utf8OutputStream() = default;
+
+	/// <summary>
+	/// Directs output to a file, or to stdout if sFilename is empty. A file begins with a UTF-8 byte
+	/// order marker; stdout output doesn't.
+	/// </summary>
+	/// <param name="sFilename">Input: path of the file to write (empty string for stdout)</param>
+	/// <param name="sErrorInfo">Output: error information on failure</param>
+	/// <returns>true if successful, false otherwise</returns>
+	bool Open(const std::wstring& sFilename, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Writes all buffered output and closes the target; see Utf8OutputBuffer::Close().
+	/// </summary>
+	bool Close(std::wstring& sErrorInfo);
+
+private:
+	Utf8OutputBuffer m_buffer;
+
+private:
+	// Not implemented
+	Utf8OutputStream(const Utf8OutputStream&) = delete;
+	Utf8OutputStream& operator = (const Utf8OutputStream&) = delete;
+};
@@ -1,244 +1,111 @@
 #include <Windows.h>
-#include <unordered_set>
 #include <shlobj_core.h>
 #include <UserEnv.h>
+#include <chrono>
+#include <mutex>
 #pragma comment(lib, "Userenv.lib")
+// shell32.dll and userenv.dll are delay-loaded (see the project's linker settings), so commands that
+// don't need known folders or profile directories don't load them at all.
+#pragma comment(lib, "delayimp.lib")
 #include "StringUtils.h"
 #include "CaseInsensitiveStringLookup.h"
 #include "FileSystemUtils.h"
 #include "WindowsDirectories.h"
 
-// Implemented so that the "static initialization order fiasco" doesn't happen.
+// Each value is resolved on first access and held in a function-local static. C++11 guarantees that
+// such a static is initialized exactly once, on first use, even when several threads call the
+// accessor at the same time; it also means there's no "static initialization order fiasco":
 // https://isocpp.org/wiki/faq/ctors#static-init-order
 // I.e., it works even if another compilation unit's static initialization depends on methods in this
 // compilation unit and happens before this compilation unit's static initialization.
+// A command that needs only System32 doesn't pay for known-folder (shell32) or profile (userenv) lookups.
 
 // ------------------------------------------------------------------------------------------
-// Private implementation for this compilation unit, created and fully initialized on first use.
-class WindowsDirectories_SingletonImpl
-{
-public:
-	// Access to these instance variables guaranteed to take place after initialization.
-	std::wstring sSystemDriveDirectory;
-	std::wstring sWindowsDirectory;
-	std::wstring sSystem32Directory;
-	std::wstring sProgramFiles;
-	std::wstring sProgramFilesX86;
-	std::wstring sProgramData;
-	std::wstring sCommonStartMenu;
-	std::wstring sCommonStartMenuPrograms;
-	std::wstring sCommonStartMenuStartup;
-	std::wstring sProfilesDirectory;
-	std::wstring sDefaultUserProfileDirectory;
-	std::wstring sPublicUserProfileDirectory;
-	std::wstring sAppDataLocalSubdir;
-	std::wstring sAppDataRoamingSubdir;
-	std::wstring sAppDataLocalTempSubdir;
-	std::wstring sDesktopSubdir;
-	std::wstring sDownloadsSubdir;
-	std::wstring sStartMenuSubdir;
-	std::wstring sStartMenuProgramsSubdir;
-	std::wstring sStartMenuStartupSubdir;
-	CaseInsensitiveStringLookup lookupDefaultRootDirs;
-
-public:
-	/// <summary>
-	/// The only way to get access to the member variables is through this singleton accessor
-	/// method which returns a reference to the singleton instance, created and initialized on
-	/// first access.
-	/// </summary>
-	static const WindowsDirectories_SingletonImpl& Get()
-	{
-		if (NULL == pInstance)
-		{
-			pInstance = new WindowsDirectories_SingletonImpl();
-		}
-		return *pInstance;
-	}
+// Resolution timing
 
-private:
-	// Internal reference to singleton instance
-	static WindowsDirectories_SingletonImpl* pInstance;
-	// Constructor accessible only to the static Get() method.
-	WindowsDirectories_SingletonImpl() { Initialize(); }
-	~WindowsDirectories_SingletonImpl() {}
-	// One-time initialization of the singleton instance.
-	void Initialize();
+// Timing records, in order of resolution
+static std::mutex& ResolveTimingsLock()
+{
+	static std::mutex lock;
+	return lock;
+}
+static std::vector<WindowsDirectories::ResolveTiming_t>& ResolveTimingRecords()
+{
+	static std::vector<WindowsDirectories::ResolveTiming_t> timings;
+	return timings;
+}
 
-private:
-	// Not implemented
-	WindowsDirectories_SingletonImpl(const WindowsDirectories_SingletonImpl&) = delete;
-	WindowsDirectories_SingletonImpl& operator = (const WindowsDirectories_SingletonImpl&) = delete;
-};
+// Calls the resolver function and records how long it took.
+// The time of a value that depends on another value includes that value's resolution, if it happens then.
+template <typename Resolver_t>
+static std::wstring Resolve(const wchar_t* szName, Resolver_t resolver)
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::wstring sValue = resolver();
+	const WindowsDirectories::ResolveTiming_t timing = {
+		szName,
+		uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count())
+	};
+	std::lock_guard<std::mutex> guard(ResolveTimingsLock());
+	ResolveTimingRecords().push_back(timing);
+	return sValue;
+}
 
-// Private static member that points to the singleton instance
-WindowsDirectories_SingletonImpl* WindowsDirectories_SingletonImpl::pInstance = NULL;
+std::vector<WindowsDirectories::ResolveTiming_t> WindowsDirectories::ResolveTimings()
+{
+	std::lock_guard<std::mutex> guard(ResolveTimingsLock());
+	return ResolveTimingRecords();
+}
 
 // ------------------------------------------------------------------------------------------
-// Helper functions to initialize wstring values from named environment variables or folder IDs
+// Helper functions to get values from named environment variables or folder IDs
 
-static bool InitFromEnvVar(std::wstring& str, const wchar_t* szEnvVar)
+static std::wstring FromEnvVar(const wchar_t* szEnvVar)
 {
 	const DWORD cchBufsize = MAX_PATH * 2;
 	wchar_t filepathbuffer[cchBufsize];
 	if (GetEnvironmentVariableW(szEnvVar, filepathbuffer, cchBufsize) > 0)
 	{
-		str = filepathbuffer;
-		return true;
+		return filepathbuffer;
 	}
-	return false;
+	return std::wstring();
 }
 
 // Get the default full path associated with the folder ID for the "default user."
 // Note that it does not verify the existence of the directory in the default user profile.
 // E.g., there is no "Startup" subdir in the default user's Start Menu; not verifying
 // enables this function to return the value anyway.
-// See the additional commentary above the InitFromFolderIdSubstring definition.
-static bool InitFromFolderId(std::wstring& str, REFKNOWNFOLDERID rfid)
+// See the additional commentary above the FromFolderIdSubstring definition.
+static std::wstring FromFolderId(REFKNOWNFOLDERID rfid)
 {
 	PWSTR pszPath = NULL;
-	bool retval = false;
+	std::wstring str;
 	// hToken parameter set to -1 for "default user"
 	if (SUCCEEDED(SHGetKnownFolderPath(rfid, KF_FLAG_DONT_VERIFY, HANDLE(-1), &pszPath)))
 	{
 		str = pszPath;
-		retval = true;
 	}
 	CoTaskMemFree(pszPath);
-	return retval;
+	return str;
 }
 
-// Get the relative portion path associated with the folder ID, removing the base path
-// E.g., if the folder ID lookup returns "C:\Users\Default\AppData\Local" and the base is 
-// "C:\Users\Default", this function returns "AppData\Local".
+// Get the relative portion path associated with the folder ID, removing the default user profile
+// directory. E.g., if the folder ID lookup returns "C:\Users\Default\AppData\Local" and the default
+// user profile is "C:\Users\Default", this function returns "AppData\Local".
 // Note that appending the returned value to another user's profile gets the *default* location --
 // the actual location might have been changed through user choice (e.g., Documents -> Properties -> Location),
 // through Group Policy, or by an app (e.g., OneDrive redirecting a user's default Documents folder
 // to the user's OneDrive Documents).
-static bool InitFromFolderIdSubstring(std::wstring& str, REFKNOWNFOLDERID rfid, const std::wstring& sBase)
+static std::wstring FromFolderIdSubstring(REFKNOWNFOLDERID rfid)
 {
-	std::wstring strFullPath;
-	bool retval = InitFromFolderId(strFullPath, rfid);
-	if (retval)
+	const std::wstring& sBase = WindowsDirectories::DefaultUserProfileDirectory();
+	std::wstring strFullPath = FromFolderId(rfid);
+	if (strFullPath.length() > sBase.length())
 	{
-		// Skip the part that matches the input string plus one to cover the backslash
-		str = strFullPath.substr(sBase.length() + 1);
+		// Skip the part that matches the base plus one to cover the backslash
+		return strFullPath.substr(sBase.length() + 1);
 	}
-	return retval;
-}
-
-// ------------------------------------------------------------------------------------------
-// One time initialization
-void WindowsDirectories_SingletonImpl::Initialize()
-{
-	const DWORD cchBufsize = MAX_PATH * 2;
-	DWORD cchSize = cchBufsize;
-	wchar_t filepathbuffer[cchBufsize];
-
-	// SystemDrive (typically C:). I didn't find an API that returned this value; the best way I
-	// could come up with is the environment variable.
-	InitFromEnvVar(sSystemDriveDirectory, L"SystemDrive");
-
-	// Windows directory (typically C:\Windows)
-	if (GetWindowsDirectoryW(filepathbuffer, cchBufsize) > 0)
-	{
-		sWindowsDirectory = filepathbuffer;
-	}
-
-	// System32Directory (typically C:\Windows\system32, and returns the same thing whether x64 or WOW64)
-	if (GetSystemDirectoryW(filepathbuffer, cchBufsize) > 0)
-	{
-		sSystem32Directory = filepathbuffer;
-	}
-
-	// Program Files directories, in a way that works identically for x86 and x64 code
-	// and on 32- and 64-bit Windows. The standard APIs return different data for x86 and
-	// x64 code, so I'm going to lean on environment variables instead. Typical observed
-	// values listed in this table:
-	//
-	// Env var            x86 on 32-bit Win   x86 on 64-bit Win       x64 on 64-bit Win
-	// ProgramFiles       C:\Program Files    C:\Program Files (x86)  C:\Program Files
-	// ProgramW6432       [not present]       C:\Program Files        C:\Program Files
-	// ProgramFiles(x86)  [not present]       C:\Program Files (x86)  C:\Program Files (x86)
-	//
-	// For any code on 64-bit Windows:
-	if (!InitFromEnvVar(sProgramFiles, L"ProgramW6432"))
-	{
-		// For x86 code on 32-bit Windows:
-		InitFromEnvVar(sProgramFiles, L"ProgramFiles");
-	}
-	// For x86 or x64 code on 64-bit Windows. 
-	// sProgramFilesX86 is left empty on 32-bit Windows.
-	InitFromEnvVar(sProgramFilesX86, L"ProgramFiles(x86)");
-
-	// ProgramData
-	InitFromFolderId(sProgramData, FOLDERID_ProgramData);
-
-	// CommonStartMenu, CommonStartMenuPrograms, and CommonStartMenuStartup
-	InitFromFolderId(sCommonStartMenu, FOLDERID_CommonStartMenu);
-	InitFromFolderId(sCommonStartMenuPrograms, FOLDERID_CommonPrograms);
-	InitFromFolderId(sCommonStartMenuStartup, FOLDERID_CommonStartup);
-
-	// Profiles directory (typically C:\Users
-	cchSize = cchBufsize;
-	if (GetProfilesDirectoryW(filepathbuffer, &cchSize))
-	{
-		sProfilesDirectory = filepathbuffer;
-	}
-
-	// Default user profile
-	cchSize = cchBufsize;
-	if (GetDefaultUserProfileDirectoryW(filepathbuffer, &cchSize))
-	{
-		sDefaultUserProfileDirectory = filepathbuffer;
-	}
-
-	// Public user profile directory
-	InitFromFolderId(sPublicUserProfileDirectory, FOLDERID_Public);
-
-	// Default subdirectory paths (doesn't account for individual users' redirected directories)
-	// AppData\Local subdir (that can be appended to user profile directories)
-	InitFromFolderIdSubstring(sAppDataLocalSubdir, FOLDERID_LocalAppData, sDefaultUserProfileDirectory);
-	// AppData\Roaming subdir (that can be appended to user profile directories)
-	InitFromFolderIdSubstring(sAppDataRoamingSubdir, FOLDERID_RoamingAppData, sDefaultUserProfileDirectory);
-	// AppData\Local\Temp subdir (that can be appended to user profile directories)
-	// Note that this value includes hardcoded "Temp" as there isn't a GUID or an API to get this value by itself
-	// in the absence of a non-System user context.
-	sAppDataLocalTempSubdir = sAppDataLocalSubdir + L"\\Temp";
-	// Desktop
-	InitFromFolderIdSubstring(sDesktopSubdir, FOLDERID_Desktop, sDefaultUserProfileDirectory);
-	// Downloads
-	InitFromFolderIdSubstring(sDownloadsSubdir, FOLDERID_Downloads, sDefaultUserProfileDirectory);
-	// Start Menu
-	InitFromFolderIdSubstring(sStartMenuSubdir, FOLDERID_StartMenu, sDefaultUserProfileDirectory);
-	// Start Menu Programs
-	InitFromFolderIdSubstring(sStartMenuProgramsSubdir, FOLDERID_Programs, sDefaultUserProfileDirectory);
-	// Start Menu Startup folder
-	InitFromFolderIdSubstring(sStartMenuStartupSubdir, FOLDERID_Startup, sDefaultUserProfileDirectory);
-
-	/// <summary>
-	/// List of root-directory subdirectories that are always (or frequently) on all Windows systems.
-	/// </summary>
-	const wchar_t* szDefaultRootDirs[] = {
-		L"$Recycle.Bin",
-		L"$WINDOWS.~BT", // Appears during in-place upgrades
-		L"Config.Msi",
-		L"MSOCache",
-		L"MSOTraceLite",
-		L"OneDriveTemp",
-		L"PerfLogs",
-		L"Program Files",
-		L"Program Files (x86)",
-		L"ProgramData",
-		L"Recovery",
-		L"System Volume Information",
-		L"Users",
-		L"Windows",
-		L"Windows.old"
-	};
-	const size_t nDefaultRootDirs = sizeof(szDefaultRootDirs) / sizeof(szDefaultRootDirs[0]);
-
-	lookupDefaultRootDirs.Add(szDefaultRootDirs, nDefaultRootDirs);
+	return std::wstring();
 }
 
 // ------------------------------------------------------------------------------------------
@@ -246,120 +113,218 @@ void WindowsDirectories_SingletonImpl::Initialize()
 
 const std::wstring& WindowsDirectories::SystemDriveDirectory()
 {
-	return WindowsDirectories_SingletonImpl::Get().sSystemDriveDirectory;
+	// SystemDrive (typically C:). I didn't find an API that returned this value; the best way I
+	// could come up with is the environment variable.
+	static const std::wstring sValue = Resolve(L"SystemDrive", [] { return FromEnvVar(L"SystemDrive"); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::WindowsDirectory()
 {
-	return WindowsDirectories_SingletonImpl::Get().sWindowsDirectory;
+	// Windows directory (typically C:\Windows)
+	static const std::wstring sValue = Resolve(L"WindowsDirectory", [] {
+		wchar_t filepathbuffer[MAX_PATH * 2];
+		if (GetWindowsDirectoryW(filepathbuffer, MAX_PATH * 2) > 0)
+			return std::wstring(filepathbuffer);
+		return std::wstring();
+		});
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::System32Directory()
 {
-	return WindowsDirectories_SingletonImpl::Get().sSystem32Directory;
+	// System32Directory (typically C:\Windows\system32, and returns the same thing whether x64 or WOW64)
+	static const std::wstring sValue = Resolve(L"System32Directory", [] {
+		wchar_t filepathbuffer[MAX_PATH * 2];
+		if (GetSystemDirectoryW(filepathbuffer, MAX_PATH * 2) > 0)
+			return std::wstring(filepathbuffer);
+		return std::wstring();
+		});
+	return sValue;
 }
 
+// Program Files directories, in a way that works identically for x86 and x64 code
+// and on 32- and 64-bit Windows. The standard APIs return different data for x86 and
+// x64 code, so I'm going to lean on environment variables instead. Typical observed
+// values listed in this table:
+//
+// Env var            x86 on 32-bit Win   x86 on 64-bit Win       x64 on 64-bit Win
+// ProgramFiles       C:\Program Files    C:\Program Files (x86)  C:\Program Files
+// ProgramW6432       [not present]       C:\Program Files        C:\Program Files
+// ProgramFiles(x86)  [not present]       C:\Program Files (x86)  C:\Program Files (x86)
+//
 const std::wstring& WindowsDirectories::ProgramFiles()
 {
-	return WindowsDirectories_SingletonImpl::Get().sProgramFiles;
+	static const std::wstring sValue = Resolve(L"ProgramFiles", [] {
+		// For any code on 64-bit Windows:
+		std::wstring str = FromEnvVar(L"ProgramW6432");
+		if (str.empty())
+		{
+			// For x86 code on 32-bit Windows:
+			str = FromEnvVar(L"ProgramFiles");
+		}
+		return str;
+		});
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::ProgramFilesX86()
 {
-	return WindowsDirectories_SingletonImpl::Get().sProgramFilesX86;
+	// For x86 or x64 code on 64-bit Windows.
+	// Empty on 32-bit Windows.
+	static const std::wstring sValue = Resolve(L"ProgramFilesX86", [] { return FromEnvVar(L"ProgramFiles(x86)"); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::ProgramData()
 {
-	return WindowsDirectories_SingletonImpl::Get().sProgramData;
+	static const std::wstring sValue = Resolve(L"ProgramData", [] { return FromFolderId(FOLDERID_ProgramData); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::CommonStartMenu()
 {
-	return WindowsDirectories_SingletonImpl::Get().sCommonStartMenu;
+	static const std::wstring sValue = Resolve(L"CommonStartMenu", [] { return FromFolderId(FOLDERID_CommonStartMenu); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::CommonStartMenuPrograms()
 {
-	return WindowsDirectories_SingletonImpl::Get().sCommonStartMenuPrograms;
+	static const std::wstring sValue = Resolve(L"CommonStartMenuPrograms", [] { return FromFolderId(FOLDERID_CommonPrograms); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::CommonStartMenuStartup()
 {
-	return WindowsDirectories_SingletonImpl::Get().sCommonStartMenuStartup;
+	static const std::wstring sValue = Resolve(L"CommonStartMenuStartup", [] { return FromFolderId(FOLDERID_CommonStartup); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::ProfilesDirectory()
 {
-	return WindowsDirectories_SingletonImpl::Get().sProfilesDirectory;
+	// Profiles directory (typically C:\Users)
+	static const std::wstring sValue = Resolve(L"ProfilesDirectory", [] {
+		wchar_t filepathbuffer[MAX_PATH * 2];
+		DWORD cchSize = MAX_PATH * 2;
+		if (GetProfilesDirectoryW(filepathbuffer, &cchSize))
+			return std::wstring(filepathbuffer);
+		return std::wstring();
+		});
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::DefaultUserProfileDirectory()
 {
-	return WindowsDirectories_SingletonImpl::Get().sDefaultUserProfileDirectory;
+	static const std::wstring sValue = Resolve(L"DefaultUserProfileDirectory", [] {
+		wchar_t filepathbuffer[MAX_PATH * 2];
+		DWORD cchSize = MAX_PATH * 2;
+		if (GetDefaultUserProfileDirectoryW(filepathbuffer, &cchSize))
+			return std::wstring(filepathbuffer);
+		return std::wstring();
+		});
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::PublicUserProfileDirectory()
 {
-	return WindowsDirectories_SingletonImpl::Get().sPublicUserProfileDirectory;
+	static const std::wstring sValue = Resolve(L"PublicUserProfileDirectory", [] { return FromFolderId(FOLDERID_Public); });
+	return sValue;
 }
 
+// Default subdirectory paths (don't account for individual users' redirected directories)
+
 const std::wstring& WindowsDirectories::AppDataLocalSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sAppDataLocalSubdir;
+	// AppData\Local subdir (that can be appended to user profile directories)
+	static const std::wstring sValue = Resolve(L"AppDataLocalSubdir", [] { return FromFolderIdSubstring(FOLDERID_LocalAppData); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::AppDataRoamingSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sAppDataRoamingSubdir;
+	// AppData\Roaming subdir (that can be appended to user profile directories)
+	static const std::wstring sValue = Resolve(L"AppDataRoamingSubdir", [] { return FromFolderIdSubstring(FOLDERID_RoamingAppData); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::AppDataLocalTempSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sAppDataLocalTempSubdir;
+	// AppData\Local\Temp subdir (that can be appended to user profile directories)
+	// Note that this value includes hardcoded "Temp" as there isn't a GUID or an API to get this value by itself
+	// in the absence of a non-System user context.
+	static const std::wstring sValue = AppDataLocalSubdir() + L"\\Temp";
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::DesktopSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sDesktopSubdir;
+	static const std::wstring sValue = Resolve(L"DesktopSubdir", [] { return FromFolderIdSubstring(FOLDERID_Desktop); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::DownloadsSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sDownloadsSubdir;
+	static const std::wstring sValue = Resolve(L"DownloadsSubdir", [] { return FromFolderIdSubstring(FOLDERID_Downloads); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::StartMenuSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sStartMenuSubdir;
+	static const std::wstring sValue = Resolve(L"StartMenuSubdir", [] { return FromFolderIdSubstring(FOLDERID_StartMenu); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::StartMenuProgramsSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sStartMenuProgramsSubdir;
+	static const std::wstring sValue = Resolve(L"StartMenuProgramsSubdir", [] { return FromFolderIdSubstring(FOLDERID_Programs); });
+	return sValue;
 }
 
 const std::wstring& WindowsDirectories::StartMenuStartupSubdir()
 {
-	return WindowsDirectories_SingletonImpl::Get().sStartMenuStartupSubdir;
+	static const std::wstring sValue = Resolve(L"StartMenuStartupSubdir", [] { return FromFolderIdSubstring(FOLDERID_Startup); });
+	return sValue;
 }
 
 bool WindowsDirectories::IsDefaultRootDirName(const wchar_t* szDirName)
 {
-	return WindowsDirectories_SingletonImpl::Get().lookupDefaultRootDirs.IsInSet(szDirName);
+	/// <summary>
+	/// List of root-directory subdirectories that are always (or frequently) on all Windows systems.
+	/// </summary>
+	static const wchar_t* const szDefaultRootDirs[] = {
+		L"$Recycle.Bin",
+		L"$WINDOWS.~BT", // Appears during in-place upgrades
+		L"Config.Msi",
+		L"MSOCache",
+		L"MSOTraceLite",
+		L"OneDriveTemp",
+		L"PerfLogs",
+		L"Program Files",
+		L"Program Files (x86)",
+		L"ProgramData",
+		L"Recovery",
+		L"System Volume Information",
+		L"Users",
+		L"Windows",
+		L"Windows.old"
+	};
+	static const CaseInsensitiveStringLookup lookupDefaultRootDirs = [] {
+		CaseInsensitiveStringLookup lookup;
+		for (const wchar_t* szDefaultRootDir : szDefaultRootDirs)
+			lookup.Add(szDefaultRootDir);
+		return lookup;
+	}();
+	return lookupDefaultRootDirs.IsInSet(szDirName);
 }
 
 const std::wstring& WindowsDirectories::ThisExeDirectory()
 {
-	// Initialize sThisExeDirectory the first time it's called in this process:
-	static std::wstring sThisExeDirectory;
-	if (0 == sThisExeDirectory.length())
-	{
+	// Initialized the first time it's called in this process:
+	static const std::wstring sThisExeDirectory = [] {
 		wchar_t szPath[MAX_PATH + 1] = { 0 };
 		if (GetModuleFileNameW(NULL, szPath, MAX_PATH))
-		{
-			sThisExeDirectory = GetDirectoryNameFromFilePath(szPath);
-		}
-	}
+			return GetDirectoryNameFromFilePath(szPath);
+		return std::wstring();
+	}();
 	return sThisExeDirectory;
 }
@@ -3,10 +3,11 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 /// <summary>
 /// Windows absolute and relative paths
-/// Each value initialized only once per execution.
+/// Each value is resolved only once per execution, on first access; access is thread-safe.
 /// </summary>
 class WindowsDirectories
 {
@@ -136,5 +137,21 @@ public:
 	/// Returns the path to the directory in which the current executable image is.
 	/// </summary>
 	static const std::wstring& ThisExeDirectory();
+
+	/// <summary>
+	/// Time spent resolving a value
+	/// </summary>
+	struct ResolveTiming_t
+	{
+		const wchar_t* szName;
+		uint64_t microseconds;
+	};
+
+	/// <summary>
+	/// Returns the values resolved so far, in order of resolution, with the time each took.
+	/// A value that depends on another (e.g., AppDataLocalSubdir on DefaultUserProfileDirectory) includes
+	/// the other's time if it was resolved then.
+	/// </summary>
+	static std::vector<ResolveTiming_t> ResolveTimings();
 };
 
@@ -0,0 +1,94 @@
+// Timing helpers for the benchmark executables
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// <summary>
+/// Times repeated calls of a function and prints the cost per call, or the throughput.
+/// Each benchmark executable takes an optional "quick" argument, which CTest passes so that the benchmarks
+/// are built and exercised on every test run without taking long; without it, iteration counts are full size.
+///
+/// Usage:
+/// 	int main(int argc, char** argv)
+/// 	{
+/// 		BenchmarkTimer timer(argc, argv);
+/// 		timer.NanosecondsPerCall("Sample", timer.Iterations(1000000), [&]() { ... });
+/// 	}
+/// </summary>
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer(int argc, char** argv)
+		: m_bQuick(argc > 1 && 0 == strcmp(argv[1], "quick"))
+	{
+	}
+
+	/// <summary>
+	/// true if only a quick pass was requested
+	/// </summary>
+	bool Quick() const { return m_bQuick; }
+
+	/// <summary>
+	/// The full iteration count, or a small fraction of it for a quick pass.
+	/// </summary>
+	size_t Iterations(size_t nFull) const { return m_bQuick ? (nFull / 1000 + 1) : nFull; }
+
+	/// <summary>
+	/// Calls fn nIterations times and prints the average nanoseconds per call.
+	/// </summary>
+	template<typename Fn>
+	double NanosecondsPerCall(const char* szName, size_t nIterations, Fn fn) const
+	{
+		const double seconds = Time(nIterations, fn);
+		const double ns = seconds * 1e9 / double(nIterations);
+		printf("%-48s %10.1f ns/call\n", szName, ns);
+		return ns;
+	}
+
+	/// <summary>
+	/// Calls fn nIterations times, each processing cbPerCall bytes, and prints the throughput in MB/s.
+	/// </summary>
+	template<typename Fn>
+	double MegabytesPerSecond(const char* szName, size_t nIterations, size_t cbPerCall, Fn fn) const
+	{
+		const double seconds = Time(nIterations, fn);
+		const double mbps = (seconds > 0) ? double(cbPerCall) * double(nIterations) / 1048576.0 / seconds : 0;
+		printf("%-48s %10.0f MB/s\n", szName, mbps);
+		return mbps;
+	}
+
+private:
+	template<typename Fn>
+	static double Time(size_t nIterations, Fn& fn)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t ix = 0; ix < nIterations; ++ix)
+			fn();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+private:
+	bool m_bQuick;
+};
+
+/// <summary>
+/// Keeps the compiler from discarding a benchmarked computation whose result is otherwise unused.
+/// </summary>
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+#ifdef _MSC_VER
+	static volatile const void* s_pSink;
+	s_pSink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
@@ -0,0 +1,92 @@
+// Per-call cost of the hex and timestamp formatters (HEX.h, FileTimeToWChars), against the iostream and
+// swprintf formatting they replaced
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cwchar>
+#include <ctime>
+#include <cstdint>
+#include "HEX.h"
+#include "StringUtils.h"
+#include "BenchmarkTimer.h"
+
+// HEXW as it was, through a wstringstream
+static std::wstring StreamHex(uint32_t num, unsigned long fieldwidth, bool bUpcase, bool b0xPrefix)
+{
+	std::wstringstream str;
+	str.fill(L'0');
+	str << (b0xPrefix ? L"0x" : L"") << std::hex << (bUpcase ? std::uppercase : std::nouppercase) << std::setw(int(fieldwidth));
+	str << uint64_t(num);
+	return str.str();
+}
+
+// Timestamp as it was: convert to calendar fields with the C library, then swprintf
+static size_t PrintfTimestamp(uint64_t ft, wchar_t* pBuf)
+{
+	const int64_t nUnixEpochIn100ns = 116444736000000000LL;
+	const time_t t = time_t((int64_t(ft) - nUnixEpochIn100ns) / 10000000);
+	struct tm tmUtc = {};
+#ifdef _WIN32
+	gmtime_s(&tmUtc, &t);
+#else
+	gmtime_r(&t, &tmUtc);
+#endif
+	const int nMilliseconds = int((ft / 10000) % 1000);
+	return size_t(swprintf(pBuf, cchTimestampBuffer, L"%04d-%02d-%02d %02d:%02d:%02d.%03d",
+		tmUtc.tm_year + 1900, tmUtc.tm_mon + 1, tmUtc.tm_mday, tmUtc.tm_hour, tmUtc.tm_min, tmUtc.tm_sec, nMilliseconds));
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkTimer timer(argc, argv);
+	const size_t nIterations = timer.Iterations(10000000);
+	bool bSame = true;
+
+	// Varying values, so that the digit count and the date change from call to call
+	uint64_t value = 0x0123456789ABCDEFULL;
+	wchar_t hexBuf[16];
+	timer.NanosecondsPerCall("HexToChars (16 digits)", nIterations, [&]()
+		{
+			value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+			DoNotOptimize(HexToChars(hexBuf, value, 16));
+		});
+
+	uint32_t u32 = 0x12345678;
+	timer.NanosecondsPerCall("HEXW (uint32, 8 digits, 0x prefix)", nIterations, [&]()
+		{
+			u32 = u32 * 1664525 + 1013904223;
+			const std::wstring s = HEXW(u32, 8, true, true);
+			DoNotOptimize(s);
+		});
+	timer.NanosecondsPerCall("  previous: wstringstream", timer.Iterations(1000000), [&]()
+		{
+			u32 = u32 * 1664525 + 1013904223;
+			const std::wstring s = StreamHex(u32, 8, true, true);
+			DoNotOptimize(s);
+		});
+	for (unsigned long fieldwidth : { 0UL, 4UL, 8UL, 20UL, 100UL })
+	{
+		bSame = bSame && HEXW(u32, fieldwidth, false, true) == StreamHex(u32, fieldwidth, false, true);
+	}
+
+	// FILETIME values from 2020 on, a little over a second apart
+	uint64_t ft = 132223104000000000ULL;
+	wchar_t timeBuf[cchTimestampBuffer];
+	timer.NanosecondsPerCall("FileTimeToWChars (with milliseconds)", nIterations, [&]()
+		{
+			ft += 10000123;
+			DoNotOptimize(FileTimeToWChars(ft, true, timeBuf));
+		});
+	timer.NanosecondsPerCall("  previous: calendar conversion + swprintf", timer.Iterations(1000000), [&]()
+		{
+			ft += 10000123;
+			DoNotOptimize(PrintfTimestamp(ft, timeBuf));
+		});
+	wchar_t expectedBuf[cchTimestampBuffer];
+	PrintfTimestamp(ft, expectedBuf);
+	FileTimeToWChars(ft, true, timeBuf);
+	bSame = bSame && 0 == wcscmp(expectedBuf, timeBuf);
+
+	return bSame ? 0 : 1;
+}
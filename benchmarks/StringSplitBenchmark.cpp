@@ -0,0 +1,52 @@
+// Per-call cost of WStringSplitter against SplitStringToVector, on CSP ParentID-like strings
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "StringUtils.h"
+#include "BenchmarkTimer.h"
+
+int main(int argc, char** argv)
+{
+	BenchmarkTimer timer(argc, argv);
+	const size_t nIterations = timer.Iterations(2000000);
+	const std::wstring sParentId = L"./Vendor/MSFT/AppLocker/ApplicationLaunchRestrictions/Group0001/EXE/Policy";
+	bool bSame = true;
+
+	std::vector<std::wstring> elems;
+	timer.NanosecondsPerCall("Last segment: SplitStringToVector", nIterations, [&]()
+		{
+			SplitStringToVector(sParentId, L'/', elems);
+			DoNotOptimize(elems.back());
+		});
+	std::wstring_view sLast;
+	timer.NanosecondsPerCall("Last segment: WStringSplitter::Last", nIterations, [&]()
+		{
+			sLast = WStringSplitter(sParentId, L'/').Last();
+			DoNotOptimize(sLast);
+		});
+	bSame = bSame && elems.back() == sLast;
+
+	std::wstring_view sNth;
+	timer.NanosecondsPerCall("Segment 5: WStringSplitter::Nth", nIterations, [&]()
+		{
+			WStringSplitter(sParentId, L'/').Nth(5, sNth);
+			DoNotOptimize(sNth);
+		});
+	bSame = bSame && elems[5] == sNth;
+
+	size_t cchTotal = 0;
+	timer.NanosecondsPerCall("All segments: WStringSplitter iteration", nIterations, [&]()
+		{
+			cchTotal = 0;
+			for (std::wstring_view segment : WStringSplitter(sParentId, L'/'))
+				cchTotal += segment.length();
+			DoNotOptimize(cchTotal);
+		});
+	size_t cchExpected = 0;
+	for (const std::wstring& sElem : elems)
+		cchExpected += sElem.length();
+	bSame = bSame && cchExpected == cchTotal;
+
+	return bSame ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+// Throughput of the UnicodeTranscoder conversions on AppLocker-policy-like XML
+
+#include <string>
+#include <vector>
+#include "UnicodeTranscoder.h"
+#include "BenchmarkTimer.h"
+
+int main(int argc, char** argv)
+{
+	BenchmarkTimer timer(argc, argv);
+
+	// Mostly ASCII, with an occasional non-ASCII path, as in real policies
+	const std::string sRule =
+		"<FilePublisherRule Id=\"a9e18c21-ff8f-43cf-b9fc-db40eed693ba\" Name=\"Signed by O=MICROSOFT CORPORATION, L=REDMOND, S=WASHINGTON, C=US\" "
+		"Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\"><Conditions><FilePublisherCondition PublisherName=\"O=MICROSOFT CORPORATION, "
+		"L=REDMOND, S=WASHINGTON, C=US\" ProductName=\"*\" BinaryName=\"*\"><BinaryVersionRange LowSection=\"*\" HighSection=\"*\" />"
+		"</FilePublisherCondition></Conditions></FilePublisherRule>\r\n";
+	const std::string sIntlRule = "<FilePathRule Name=\"%OSDRIVE%\\Programme\\\xC3\x9C" "berpr\xC3\xBC" "fung\\R\xC3\xA9" "cup\xC3\xA9ration\\*\" Action=\"Allow\" />\r\n";
+	std::string sXml;
+	const size_t cbXml = timer.Quick() ? (64 << 10) : (16 << 20);
+	while (sXml.size() < cbXml)
+	{
+		for (int ix = 0; ix < 20; ++ix)
+			sXml += sRule;
+		sXml += sIntlRule;
+	}
+	const size_t nIterations = timer.Quick() ? 1 : 10;
+
+	std::wstring sWide;
+	timer.MegabytesPerSecond("Utf8ToWString", nIterations, sXml.size(), [&]()
+		{
+			Utf8ToWString(sXml.data(), sXml.size(), sWide);
+			DoNotOptimize(sWide);
+		});
+
+	std::string sUtf8;
+	timer.MegabytesPerSecond("AppendWStringAsUtf8", nIterations, sXml.size(), [&]()
+		{
+			sUtf8.clear();
+			AppendWStringAsUtf8(sWide.data(), sWide.size(), sUtf8);
+			DoNotOptimize(sUtf8);
+		});
+
+	std::vector<char> utf16(sWide.size() * 4);
+	timer.MegabytesPerSecond("WideToUtf16 (little-endian)", nIterations, sXml.size(), [&]()
+		{
+			size_t cchRead = 0, cbWritten = 0;
+			WideToUtf16(sWide.data(), sWide.size(), false, utf16.data(), utf16.size(), cchRead, cbWritten);
+			DoNotOptimize(utf16);
+		});
+
+	size_t cchRead = 0, cbUtf16 = 0;
+	WideToUtf16(sWide.data(), sWide.size(), false, utf16.data(), utf16.size(), cchRead, cbUtf16);
+	timer.MegabytesPerSecond("Utf16ToWString (little-endian)", nIterations, sXml.size(), [&]()
+		{
+			Utf16ToWString(utf16.data(), cbUtf16, false, sWide);
+			DoNotOptimize(sWide);
+		});
+
+	return (sUtf8 == sXml) ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Tests for AppLockerCacheDecoder over a synthetic cache file: UTF-16LE text runs at odd and even offsets,
+// text and binary GUIDs, SIDs, a truncated trailing run, comparison with policy rule IDs, and cache file names
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+#include "AppLockerCacheDecoder.h"
+#include "TestCheck.h"
+
+static const wchar_t* const szGuidText = L"0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9";
+static const wchar_t* const szGuidBinary = L"{11223344-5566-7788-99AA-BBCCDDEEFF00}";
+static const wchar_t* const szGuidCacheOnly = L"FEDCBA98-7654-3210-FEDC-BA9876543210";
+static const wchar_t* const szGuidAbsent = L"00000000-0000-0000-0000-000000000042";
+
+// Builds the content of a cache file
+class CacheBuilder
+{
+public:
+	void Bytes(std::initializer_list<uint8_t> bytes) { m_data.insert(m_data.end(), bytes); }
+	// Appends text as UTF-16LE; returns the byte offset of the text
+	size_t Text(const std::wstring& sText)
+	{
+		const size_t offset = m_data.size();
+		for (wchar_t ch : sText)
+		{
+			m_data.push_back(uint8_t(ch & 0xFF));
+			m_data.push_back(uint8_t((ch >> 8) & 0xFF));
+		}
+		return offset;
+	}
+	// Appends a GUID in its in-memory layout: Data1, Data2, and Data3 little-endian, then Data4 in order
+	void BinaryGuid(uint32_t data1, uint16_t data2, uint16_t data3, std::initializer_list<uint8_t> data4)
+	{
+		Bytes({ uint8_t(data1), uint8_t(data1 >> 8), uint8_t(data1 >> 16), uint8_t(data1 >> 24) });
+		Bytes({ uint8_t(data2), uint8_t(data2 >> 8), uint8_t(data3), uint8_t(data3 >> 8) });
+		Bytes(data4);
+	}
+	const std::vector<uint8_t>& Data() const { return m_data; }
+private:
+	std::vector<uint8_t> m_data;
+};
+
+static bool HasRun(const AppLockerCacheDecoder& decoder, size_t offset, const std::wstring& sText)
+{
+	for (const CacheTextRun_t& textRun : decoder.TextRuns())
+	{
+		if (textRun.offset == offset)
+			return textRun.cch == sText.length() && decoder.Text(textRun) == sText;
+	}
+	return false;
+}
+
+static void TestDecode()
+{
+	CacheBuilder cache;
+	cache.Bytes({ 0x01, 0x02, 0x03 });
+	// Odd offsets
+	const size_t ixName = cache.Text(L"Allow everyone \x00e9");
+	cache.Bytes({ 0x00, 0x07 });
+	const std::wstring sIdText = L"Id {" + std::wstring(szGuidText) + L"}";
+	const size_t ixId = cache.Text(sIdText);
+	// Even offsets; a character outside ASCII and Latin-1 splits a run, and a short run isn't reported.
+	cache.Bytes({ 0x10 });
+	const size_t ixSid = cache.Text(L"User S-1-5-21-1004336348-1177238915-682003330-1001-;S-1-1-0");
+	cache.Bytes({ 0x00, 0x00 });
+	const size_t ixBefore = cache.Text(L"Name");
+	cache.Text(L"\x4e2d");
+	const size_t ixAfter = cache.Text(L"Text");
+	cache.Bytes({ 0x00, 0x00 });
+	cache.Text(L"abc");
+	cache.Bytes({ 0x00, 0x00 });
+	cache.BinaryGuid(0x11223344, 0x5566, 0x7788, { 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00 });
+	cache.Bytes({ 0x01, 0x01 });
+	const size_t ixCacheOnly = cache.Text(szGuidCacheOnly);
+	cache.Bytes({ 0x05 });
+	// A trailing run whose last character is cut off: the lone byte at the end isn't read.
+	const size_t ixTail = cache.Text(L"Truncated");
+	cache.Bytes({ 'x' });
+
+	const std::vector<uint8_t>& data = cache.Data();
+	CHECK(1 == ixName % 2 && 1 == ixId % 2 && 0 == ixSid % 2 && 1 == ixTail % 2);
+	const AppLockerCacheDecoder decoder(data.data(), data.size());
+
+	CHECK(HasRun(decoder, ixName, L"Allow everyone \x00e9"));
+	CHECK(HasRun(decoder, ixId, sIdText));
+	CHECK(HasRun(decoder, ixSid, L"User S-1-5-21-1004336348-1177238915-682003330-1001-;S-1-1-0"));
+	CHECK(HasRun(decoder, ixBefore, L"Name"));
+	CHECK(HasRun(decoder, ixAfter, L"Text"));
+	CHECK(HasRun(decoder, ixCacheOnly, szGuidCacheOnly));
+	CHECK(HasRun(decoder, ixTail, L"Truncated"));
+	for (const CacheTextRun_t& textRun : decoder.TextRuns())
+	{
+		CHECK(textRun.cch >= AppLockerCacheDecoder::nMinTextRunChars);
+		CHECK(textRun.offset + 2 * textRun.cch <= data.size());
+		CHECK(std::wstring::npos == decoder.Text(textRun).find(L"abc"));
+	}
+	// Runs are in file order and don't overlap.
+	for (size_t ix = 1; ix < decoder.TextRuns().size(); ++ix)
+		CHECK(decoder.TextRuns()[ix - 1].offset + 2 * decoder.TextRuns()[ix - 1].cch <= decoder.TextRuns()[ix].offset);
+	// A run outside the data has no text.
+	CHECK(decoder.Text(CacheTextRun_t{ data.size() - 2, 4 }).empty());
+
+	CHECK((std::set<std::wstring>{ L"0A1B2C3D-4E5F-6071-8293-A4B5C6D7E8F9", szGuidCacheOnly }) == decoder.TextRuleIds());
+	// Trailing dashes aren't part of a SID.
+	CHECK((std::set<std::wstring>{ L"S-1-5-21-1004336348-1177238915-682003330-1001", L"S-1-1-0" }) == decoder.TextSids());
+
+	// Text GUIDs match case-insensitively, with or without braces; binary GUIDs match in their in-memory layout.
+	CHECK(decoder.ContainsGuid(L"{0A1B2C3D-4E5F-6071-8293-A4B5C6D7E8F9}"));
+	CHECK(decoder.ContainsGuid(szGuidText));
+	CHECK(decoder.ContainsGuid(szGuidBinary));
+	CHECK(decoder.ContainsGuid(L"11223344-5566-7788-99aa-bbccddeeff00"));
+	CHECK(!decoder.ContainsGuid(szGuidAbsent));
+	CHECK(!decoder.ContainsGuid(L"not a GUID"));
+
+	// Empty and one-byte content
+	const AppLockerCacheDecoder empty(nullptr, 0);
+	CHECK(empty.TextRuns().empty() && !empty.ContainsGuid(szGuidText));
+	const AppLockerCacheDecoder oneByte(data.data(), 1);
+	CHECK(oneByte.TextRuns().empty());
+}
+
+static void TestCompare()
+{
+	CacheBuilder cache;
+	cache.Bytes({ 0x01 });
+	cache.Text(szGuidText);
+	cache.Bytes({ 0x00, 0x00 });
+	cache.BinaryGuid(0x11223344, 0x5566, 0x7788, { 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00 });
+	cache.Bytes({ 0x01, 0x01 });
+	cache.Text(szGuidCacheOnly);
+	const AppLockerCacheDecoder decoder(cache.Data().data(), cache.Data().size());
+
+	const std::wstring sPolicyXml =
+		L"<AppLockerPolicy Version=\"1\">"
+		L"<RuleCollection Type=\"Exe\" EnforcementMode=\"Enabled\">"
+		L"<FilePathRule Id=\"0a1b2c3d-4e5f-6071-8293-a4b5c6d7e8f9\" Name=\"A\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+		L"<Conditions><FilePathCondition Path=\"%OSDRIVE%\\A\\*\" /></Conditions></FilePathRule>"
+		L"<FilePathRule Id=\"11223344-5566-7788-99AA-BBCCDDEEFF00\" Name=\"B\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+		L"<Conditions><FilePathCondition Path=\"%OSDRIVE%\\B\\*\" /></Conditions></FilePathRule>"
+		L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000042\" Name=\"C\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Deny\">"
+		L"<Conditions><FilePathCondition Path=\"%OSDRIVE%\\C\\*\" /></Conditions></FilePathRule>"
+		L"</RuleCollection>"
+		L"<RuleCollection Type=\"Dll\" EnforcementMode=\"NotConfigured\" />"
+		L"</AppLockerPolicy>";
+	std::set<std::wstring> ruleIds;
+	CHECK(AppLockerCacheDecoder::GetPolicyRuleIds(sPolicyXml, L"Exe", ruleIds));
+	CHECK(3 == ruleIds.size() && 1 == ruleIds.count(L"0A1B2C3D-4E5F-6071-8293-A4B5C6D7E8F9"));
+	std::set<std::wstring> dllRuleIds;
+	CHECK(AppLockerCacheDecoder::GetPolicyRuleIds(sPolicyXml, L"Dll", dllRuleIds) && dllRuleIds.empty());
+	CHECK(!AppLockerCacheDecoder::GetPolicyRuleIds(sPolicyXml, L"Com", dllRuleIds));
+
+	CacheComparison_t comparison;
+	decoder.Compare(ruleIds, comparison);
+	CHECK((std::vector<std::wstring>{ L"0A1B2C3D-4E5F-6071-8293-A4B5C6D7E8F9", L"11223344-5566-7788-99AA-BBCCDDEEFF00" }) == comparison.inBoth);
+	CHECK((std::vector<std::wstring>{ szGuidAbsent }) == comparison.policyOnly);
+	CHECK((std::vector<std::wstring>{ szGuidCacheOnly }) == comparison.cacheOnly);
+
+	// Against an empty policy, every rule ID in the cache is cache-only; binary GUIDs can't be listed.
+	decoder.Compare(std::set<std::wstring>(), comparison);
+	CHECK(comparison.inBoth.empty() && comparison.policyOnly.empty() && 2 == comparison.cacheOnly.size());
+}
+
+static void TestFilenames()
+{
+	CHECK(L"Exe" == AppLockerCacheDecoder::RuleCollectionTypeFromFilename(L"Exe.AppLocker"));
+	CHECK(L"Script" == AppLockerCacheDecoder::RuleCollectionTypeFromFilename(L"SCRIPT.applocker"));
+	CHECK(L"Appx" == AppLockerCacheDecoder::RuleCollectionTypeFromFilename(L"appx.AppLocker"));
+	CHECK(AppLockerCacheDecoder::RuleCollectionTypeFromFilename(L"Exe.AppLocker.bak").empty());
+	CHECK(AppLockerCacheDecoder::RuleCollectionTypeFromFilename(L"AppCache.dat").empty());
+	CHECK(AppLockerCacheDecoder::RuleCollectionTypeFromFilename(L".AppLocker").empty());
+}
+
+int main()
+{
+	TestDecode();
+	TestCompare();
+	TestFilenames();
+	return TestCheck::ExitCode("AppLockerCacheDecoderTests");
+}
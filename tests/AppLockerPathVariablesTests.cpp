@@ -0,0 +1,137 @@
+// Tests for AppLockerPathVariables with injected directory layouts: longest-prefix contraction, expansion,
+// normalization, equivalent forms, and path-rule lookups in a compiled policy image in either form
+
+#include <string>
+#include <vector>
+#include "AppLockerPathVariables.h"
+#include "AppLockerPolicyImage.h"
+#include "TestCheck.h"
+
+// Typical 64-bit Windows layout
+static PathVariableDirectories_t Layout64()
+{
+	PathVariableDirectories_t directories;
+	directories.sOsDrive = L"C:";
+	directories.sWindows = L"C:\\Windows";
+	directories.sSystem32 = L"C:\\Windows\\System32";
+	directories.sSysWow64 = L"C:\\Windows\\SysWOW64";
+	directories.sProgramFiles = L"C:\\Program Files";
+	directories.sProgramFilesX86 = L"C:\\Program Files (x86)";
+	return directories;
+}
+
+static std::wstring Contracted(const AppLockerPathVariables& variables, const wchar_t* szPath)
+{
+	std::wstring sContracted;
+	variables.Contract(szPath, sContracted);
+	return sContracted;
+}
+
+static void TestContract()
+{
+	const AppLockerPathVariables variables(Layout64());
+	// The longest directory wins: System32 over Windows over the drive.
+	CHECK(L"%SYSTEM32%\\cmd.exe" == Contracted(variables, L"C:\\Windows\\System32\\cmd.exe"));
+	CHECK(L"%SYSTEM32%\\cmd.exe" == Contracted(variables, L"c:\\windows\\syswow64\\cmd.exe"));
+	CHECK(L"%WINDIR%\\Temp\\x.exe" == Contracted(variables, L"C:\\Windows\\Temp\\x.exe"));
+	CHECK(L"%PROGRAMFILES%\\App\\*" == Contracted(variables, L"C:\\Program Files (x86)\\App\\*"));
+	CHECK(L"%PROGRAMFILES%\\App\\*" == Contracted(variables, L"C:\\Program Files\\App\\*"));
+	CHECK(L"%OSDRIVE%\\Tools\\x.exe" == Contracted(variables, L"C:\\Tools\\x.exe"));
+	CHECK(L"%SYSTEM32%" == Contracted(variables, L"C:\\Windows\\System32"));
+	// Only at a component boundary
+	CHECK(L"%WINDIR%\\System32x\\a.exe" == Contracted(variables, L"C:\\Windows\\System32x\\a.exe"));
+	CHECK(L"%OSDRIVE%\\Windows2\\a.exe" == Contracted(variables, L"C:\\Windows2\\a.exe"));
+	std::wstring sContracted;
+	CHECK(!variables.Contract(L"D:\\Data\\a.exe", sContracted) && L"D:\\Data\\a.exe" == sContracted);
+	CHECK(!variables.Contract(L"\\\\server\\share\\a.exe", sContracted));
+
+	// Nonstandard layout: Windows on D:, Program Files elsewhere, 32-bit (no SysWOW64 or x86 directory),
+	// and trailing backslashes in the injected values.
+	PathVariableDirectories_t directories;
+	directories.sOsDrive = L"D:\\";
+	directories.sWindows = L"D:\\WINNT\\";
+	directories.sSystem32 = L"D:\\WINNT\\System32";
+	directories.sProgramFiles = L"E:\\Apps";
+	const AppLockerPathVariables custom(directories);
+	CHECK(L"%SYSTEM32%\\drivers\\x.sys" == Contracted(custom, L"D:\\WINNT\\System32\\drivers\\x.sys"));
+	CHECK(L"%WINDIR%\\x.exe" == Contracted(custom, L"d:\\winnt\\x.exe"));
+	CHECK(L"%PROGRAMFILES%\\x.exe" == Contracted(custom, L"E:\\Apps\\x.exe"));
+	CHECK(L"%OSDRIVE%\\Windows\\x.exe" == Contracted(custom, L"D:\\Windows\\x.exe"));
+	CHECK(L"C:\\Windows\\x.exe" == Contracted(custom, L"C:\\Windows\\x.exe"));
+}
+
+static void TestExpandAndNormalize()
+{
+	const AppLockerPathVariables variables(Layout64());
+	std::vector<std::wstring> paths;
+	CHECK(variables.Expand(L"%system32%\\cmd.exe", paths));
+	CHECK(2 == paths.size() && L"C:\\Windows\\System32\\cmd.exe" == paths[0] && L"C:\\Windows\\SysWOW64\\cmd.exe" == paths[1]);
+	CHECK(variables.Expand(L"%OSDRIVE%\\x", paths) && 1 == paths.size() && L"C:\\x" == paths[0]);
+	CHECK(variables.Expand(L"D:\\x", paths) && 1 == paths.size() && L"D:\\x" == paths[0]);
+	CHECK(!variables.Expand(L"%HOT%\\x.exe", paths));
+	CHECK(!variables.Expand(L"%USERPROFILE%\\x.exe", paths));
+
+	std::wstring sNormalized;
+	CHECK(variables.Normalize(L"%ProgramFiles%\\App\\*", sNormalized) && L"%PROGRAMFILES%\\App\\*" == sNormalized);
+	CHECK(variables.Normalize(L"C:\\Program Files\\App\\*", sNormalized) && L"%PROGRAMFILES%\\App\\*" == sNormalized);
+	CHECK(variables.Normalize(L"%removable%\\*", sNormalized) && L"%REMOVABLE%\\*" == sNormalized);
+	CHECK(!variables.Normalize(L"%TEMP%\\x.exe", sNormalized));
+
+	// Every form, not only the longest contraction
+	CHECK(variables.Equivalents(L"C:\\Windows\\System32\\cmd.exe", paths));
+	const std::vector<std::wstring> expected = {
+		L"%SYSTEM32%\\cmd.exe",
+		L"C:\\Windows\\System32\\cmd.exe",
+		L"%WINDIR%\\System32\\cmd.exe",
+		L"%OSDRIVE%\\Windows\\System32\\cmd.exe",
+		L"C:\\Windows\\SysWOW64\\cmd.exe",
+		L"%WINDIR%\\SysWOW64\\cmd.exe",
+		L"%OSDRIVE%\\Windows\\SysWOW64\\cmd.exe",
+	};
+	CHECK(expected == paths);
+	CHECK(variables.Equivalents(L"%HOT%\\x.exe", paths) && 1 == paths.size());
+	CHECK(!variables.Equivalents(L"%TEMP%\\x.exe", paths) && 1 == paths.size() && L"%TEMP%\\x.exe" == paths[0]);
+}
+
+static void TestPolicyImageLookup()
+{
+	const std::wstring sPolicyXml =
+		L"<AppLockerPolicy Version=\"1\"><RuleCollection Type=\"Exe\" EnforcementMode=\"Enabled\">"
+		L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000001\" Name=\"Windows\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+		L"<Conditions><FilePathCondition Path=\"%WINDIR%\\*\" /></Conditions></FilePathRule>"
+		L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000002\" Name=\"Tools\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+		L"<Conditions><FilePathCondition Path=\"C:\\Tools\\*\" /></Conditions></FilePathRule>"
+		L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000003\" Name=\"App\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Deny\">"
+		L"<Conditions><FilePathCondition Path=\"%PROGRAMFILES%\\App\\app.exe\" /></Conditions></FilePathRule>"
+		L"</RuleCollection></AppLockerPolicy>";
+	std::vector<uint8_t> image;
+	std::wstring sErrorInfo;
+	CHECK(AppLockerPolicyImage::Compile(sPolicyXml, image, sErrorInfo));
+	AppLockerPolicyImage policyImage;
+	CHECK(policyImage.Load(image.data(), image.size(), sErrorInfo));
+
+	const AppLockerPathVariables variables(Layout64());
+	std::vector<uint32_t> ruleIndexes;
+	// Absolute path against a variable-form rule
+	policyImage.FindPathRules(L"C:\\Windows\\System32\\cmd.exe", variables, ruleIndexes);
+	CHECK(1 == ruleIndexes.size() && 0 == ruleIndexes[0]);
+	// Variable-form path against an absolute rule
+	policyImage.FindPathRules(L"%OSDRIVE%\\Tools\\x.exe", variables, ruleIndexes);
+	CHECK(1 == ruleIndexes.size() && 1 == ruleIndexes[0]);
+	// Either Program Files directory
+	policyImage.FindPathRules(L"C:\\Program Files (x86)\\App\\APP.EXE", variables, ruleIndexes);
+	CHECK(1 == ruleIndexes.size() && 2 == ruleIndexes[0]);
+	policyImage.FindPathRules(L"D:\\Other\\x.exe", variables, ruleIndexes);
+	CHECK(ruleIndexes.empty());
+	// Without the variables, only the literal form matches.
+	policyImage.FindPathRules(L"C:\\Windows\\System32\\cmd.exe", ruleIndexes);
+	CHECK(ruleIndexes.empty());
+}
+
+int main()
+{
+	TestContract();
+	TestExpandAndNormalize();
+	TestPolicyImageLookup();
+	return TestCheck::ExitCode("AppLockerPathVariablesTests");
+}
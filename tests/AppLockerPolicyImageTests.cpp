@@ -0,0 +1,247 @@
+// Tests for AppLockerPolicyImage: compile, decompile, and recompile to an identical image, including the
+// rule collections' extensions; Load's checks of truncated, misaligned, and damaged images; lookups by
+// entity-encoded, case-varied, and wildcard keys; and the warnings for what an image doesn't represent
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "AppLockerPolicyImage.h"
+#include "TestCheck.h"
+
+static const wchar_t* const szPolicyXml =
+	L"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+	L"<AppLockerPolicy Version=\"1\">\n"
+	L"<!-- <RuleCollection Type=\"Msi\" EnforcementMode=\"Enabled\"></RuleCollection> -->\n"
+	L"<RuleCollection Type=\"Exe\" EnforcementMode=\"Enabled\">\n"
+	// 0: entity-encoded path
+	L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000001\" Name=\"R&amp;D tools\" Description=\"\" UserOrGroupSid=\"S-1-5-32-544\" Action=\"Allow\">"
+	L"<Conditions><FilePathCondition Path=\"%OSDRIVE%\\R&amp;D\\*\" /></Conditions></FilePathRule>\n"
+	// 1: wildcard that isn't a trailing "\*"
+	L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000002\" Name=\"Tools\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+	L"<Conditions><FilePathCondition Path=\"%OSDRIVE%\\Tools\\*.exe\" /></Conditions></FilePathRule>\n"
+	// 2: exact path, with a condition only in a comment and another only in a CDATA section
+	L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000003\" Name=\"App\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Deny\">"
+	L"<Conditions><!-- <FilePathCondition Path=\"C:\\Commented\\*\" /> --><![CDATA[<FilePathCondition Path=\"C:\\CData\\*\" />]]>"
+	L"<FilePathCondition Path=\"%PROGRAMFILES%\\App\\App.exe\" /></Conditions>"
+	L"<Exceptions><FilePathCondition Path=\"%PROGRAMFILES%\\App\\Safe.exe\" /></Exceptions></FilePathRule>\n"
+	// 3: entity-encoded publisher, with a version range
+	L"<FilePublisherRule Id=\"00000000-0000-0000-0000-000000000004\" Name=\"Signed\" Description=\"\" UserOrGroupSid=\"S-1-5-32-544\" Action=\"Allow\">"
+	L"<Conditions><FilePublisherCondition PublisherName=\"O=R&amp;D CORP, C=US\" ProductName=\"*\" BinaryName=\"Tool.exe\">"
+	L"<BinaryVersionRange LowSection=\"1.0.0.0\" HighSection=\"*\" /></FilePublisherCondition></Conditions></FilePublisherRule>\n"
+	// 4: the same hash twice
+	L"<FileHashRule Id=\"00000000-0000-0000-0000-000000000005\" Name=\"Hashed\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Deny\">"
+	L"<Conditions><FileHashCondition>"
+	L"<FileHash Type=\"SHA256\" Data=\"0x3A6BC0FFEE\" SourceFileName=\"a.exe\" SourceFileLength=\"1\" />"
+	L"<FileHash Type=\"SHA256\" Data=\"0x3a6bc0ffee\" SourceFileName=\"b.exe\" SourceFileLength=\"1\" />"
+	L"</FileHashCondition></Conditions></FileHashRule>\n"
+	L"</RuleCollection>\n"
+	L"<RuleCollection Type=\"Script\" EnforcementMode=\"NotConfigured\">\n"
+	L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000006\" Name=\"Discarded\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+	L"<Conditions><FilePathCondition Path=\"*\" /></Conditions></FilePathRule>\n"
+	L"</RuleCollection>\n"
+	L"</AppLockerPolicy>";
+
+static bool Compile(const std::wstring& sPolicyXml, std::vector<uint8_t>& image, std::vector<std::wstring>& warnings)
+{
+	std::wstring sErrorInfo;
+	return AppLockerPolicyImage::Compile(sPolicyXml, image, warnings, sErrorInfo) && sErrorInfo.empty();
+}
+
+static void TestRoundTrip()
+{
+	std::vector<uint8_t> image, recompiled;
+	std::vector<std::wstring> warnings;
+	CHECK(Compile(szPolicyXml, image, warnings));
+	AppLockerPolicyImage policyImage;
+	std::wstring sErrorInfo, sCanonicalXml, sRecompiledXml;
+	CHECK(policyImage.Load(image.data(), image.size(), sErrorInfo));
+	CHECK(5 == policyImage.RuleCount());
+	CHECK(policyImage.ToXml(sCanonicalXml));
+	CHECK(std::wstring::npos == sCanonicalXml.find(L"<!--") && std::wstring::npos == sCanonicalXml.find(L"CDATA"));
+	CHECK(std::wstring::npos != sCanonicalXml.find(L"&lt;FilePathCondition Path=\"C:\\CData\\*\" /&gt;"));
+	CHECK(std::wstring::npos != sCanonicalXml.find(L"<RuleCollection Type=\"Script\" EnforcementMode=\"NotConfigured\">\n</RuleCollection>"));
+
+	// Canonical XML compiles to the same bytes, and decompiles to the same XML.
+	CHECK(Compile(sCanonicalXml, recompiled, warnings));
+	CHECK(image == recompiled);
+	AppLockerPolicyImage recompiledImage;
+	CHECK(recompiledImage.Load(recompiled.data(), recompiled.size(), sErrorInfo));
+	CHECK(recompiledImage.ToXml(sRecompiledXml) && sCanonicalXml == sRecompiledXml);
+
+	PolicyImageRule_t rule;
+	CHECK(policyImage.GetRule(0, rule));
+	CHECK(L"Exe" == rule.sCollectionType && PolicyImageRule_t::PathRule == rule.ruleType && !rule.bDeny);
+	CHECK(L"R&D tools" == rule.sName && L"S-1-5-32-544" == rule.sUserOrGroupSid);
+	CHECK(policyImage.GetRule(4, rule) && PolicyImageRule_t::HashRule == rule.ruleType && rule.bDeny);
+	CHECK(!policyImage.GetRule(5, rule));
+}
+
+static void TestExtensionsRoundTrip()
+{
+	// Without the extensions, applying the decompiled policy would change how services and system apps are treated.
+	const std::wstring sExeExtensions =
+		L"<RuleCollectionExtensions><ThresholdExtensions><Services EnforcementMode=\"Enabled\" /></ThresholdExtensions>"
+		L"<RedstoneExtensions><SystemApps Allow=\"Enabled\" /></RedstoneExtensions></RuleCollectionExtensions>";
+	const std::wstring sDllExtensions = L"<RuleCollectionExtensions />";
+	const std::wstring sPolicyXml =
+		L"<AppLockerPolicy Version=\"1\"><RuleCollection Type=\"Exe\" EnforcementMode=\"AuditOnly\">"
+		L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000001\" Name=\"All\" Description=\"\" UserOrGroupSid=\"S-1-1-0\" Action=\"Allow\">"
+		L"<Conditions><FilePathCondition Path=\"*\" /></Conditions></FilePathRule>" + sExeExtensions + L"</RuleCollection>"
+		L"<RuleCollection Type=\"Dll\" EnforcementMode=\"NotConfigured\">" + sDllExtensions + L"</RuleCollection></AppLockerPolicy>";
+	std::vector<uint8_t> image, recompiled;
+	std::vector<std::wstring> warnings;
+	CHECK(Compile(sPolicyXml, image, warnings) && warnings.empty());
+	AppLockerPolicyImage policyImage;
+	std::wstring sErrorInfo, sCanonicalXml, sRecompiledXml;
+	CHECK(policyImage.Load(image.data(), image.size(), sErrorInfo));
+	CHECK(policyImage.ToXml(sCanonicalXml));
+	CHECK(std::wstring::npos != sCanonicalXml.find(L"</FilePathRule>\n" + sExeExtensions + L"\n</RuleCollection>"));
+	CHECK(std::wstring::npos != sCanonicalXml.find(L"EnforcementMode=\"NotConfigured\">\n" + sDllExtensions + L"\n</RuleCollection>"));
+	CHECK(Compile(sCanonicalXml, recompiled, warnings) && image == recompiled);
+	CHECK(policyImage.Load(recompiled.data(), recompiled.size(), sErrorInfo) && policyImage.ToXml(sRecompiledXml) && sCanonicalXml == sRecompiledXml);
+}
+
+static void TestWarnings()
+{
+	std::vector<uint8_t> image;
+	std::vector<std::wstring> warnings;
+	CHECK(Compile(szPolicyXml, image, warnings));
+	const std::vector<std::wstring> expected = {
+		L"Rule 00000000-0000-0000-0000-000000000003: exceptions are not indexed",
+		L"Rule 00000000-0000-0000-0000-000000000004: publisher version range is not indexed",
+		L"Script rule collection is NotConfigured; its 1 rules are not kept",
+	};
+	CHECK(expected == warnings);
+
+	// A rule whose SID isn't valid is kept, with a warning.
+	const std::wstring sBadSidXml =
+		L"<AppLockerPolicy Version=\"1\"><RuleCollection Type=\"Exe\" EnforcementMode=\"Enabled\">"
+		L"<FilePathRule Id=\"00000000-0000-0000-0000-000000000009\" Name=\"Bad SID\" Description=\"\" UserOrGroupSid=\"S-1-5-32-544-\" Action=\"Allow\">"
+		L"<Conditions><FilePathCondition Path=\"%OSDRIVE%\\Tools\\*\" /></Conditions></FilePathRule>"
+		L"</RuleCollection></AppLockerPolicy>";
+	CHECK(Compile(sBadSidXml, image, warnings));
+	CHECK((std::vector<std::wstring>{ L"Rule 00000000-0000-0000-0000-000000000009: UserOrGroupSid \"S-1-5-32-544-\" is not a valid SID" }) == warnings);
+
+	// Unterminated comments and CDATA sections can't be parsed.
+	std::wstring sErrorInfo;
+	CHECK(!AppLockerPolicyImage::Compile(L"<AppLockerPolicy Version=\"1\"><!-- </AppLockerPolicy>", image, sErrorInfo) && !sErrorInfo.empty());
+	CHECK(!AppLockerPolicyImage::Compile(L"<AppLockerPolicy Version=\"1\"><![CDATA[ </AppLockerPolicy>", image, sErrorInfo) && !sErrorInfo.empty());
+}
+
+static void TestLoadRejects()
+{
+	std::vector<uint8_t> image;
+	std::vector<std::wstring> warnings;
+	CHECK(Compile(szPolicyXml, image, warnings));
+	AppLockerPolicyImage policyImage;
+	std::wstring sErrorInfo;
+
+	// Truncated: shorter than the header, and shorter than the size in the header
+	CHECK(!policyImage.Load(image.data(), 16, sErrorInfo) && L"Not a policy image" == sErrorInfo);
+	CHECK(!policyImage.Load(image.data(), image.size() - 4, sErrorInfo) && L"Invalid policy image header" == sErrorInfo);
+	CHECK(0 == policyImage.RuleCount());
+	CHECK(!policyImage.Load(nullptr, 0, sErrorInfo));
+
+	// Misaligned
+	std::vector<uint32_t> buffer(image.size() / sizeof(uint32_t) + 1);
+	uint8_t* pMisaligned = reinterpret_cast<uint8_t*>(buffer.data()) + 2;
+	memcpy(pMisaligned, image.data(), image.size());
+	CHECK(!policyImage.Load(pMisaligned, image.size(), sErrorInfo) && L"Invalid policy image header" == sErrorInfo);
+
+	// Header fields: the magic, the version, and the sections, which follow 24 bytes of other fields as offset and count pairs
+	const size_t cbHeaderFields = 24;
+	std::vector<uint8_t> damaged(image);
+	damaged[0] = 'X';
+	CHECK(!policyImage.Load(damaged.data(), damaged.size(), sErrorInfo) && L"Not a policy image" == sErrorInfo);
+	damaged = image;
+	damaged[8] = uint8_t(AppLockerPolicyImage::nFormatVersion + 1);
+	CHECK(!policyImage.Load(damaged.data(), damaged.size(), sErrorInfo) && std::wstring::npos != sErrorInfo.find(L"version"));
+	// Each section must lie within the image, after the header, on a 4-byte boundary.
+	auto rejectsSection = [&](size_t ixSection, uint32_t offset, uint32_t count) -> bool
+	{
+		damaged = image;
+		uint32_t* pSection = reinterpret_cast<uint32_t*>(damaged.data() + cbHeaderFields + ixSection * 8);
+		pSection[0] = offset;
+		pSection[1] = count;
+		return !policyImage.Load(damaged.data(), damaged.size(), sErrorInfo) && L"Invalid policy image section " + std::to_wstring(ixSection) == sErrorInfo;
+	};
+	const uint32_t* pSections = reinterpret_cast<const uint32_t*>(image.data() + cbHeaderFields);
+	CHECK(rejectsSection(2, 0xFFFFFFF0, 1));
+	CHECK(rejectsSection(2, 0, pSections[2 * 2 + 1]));
+	CHECK(rejectsSection(4, 8, 0));
+	CHECK(rejectsSection(3, pSections[3 * 2], 0x40000000));
+	CHECK(rejectsSection(1, pSections[1 * 2] + 2, pSections[1 * 2 + 1]));
+
+	// A failed Load leaves nothing to query.
+	std::vector<uint32_t> ruleIndexes(1, 0);
+	policyImage.FindSidRules(L"S-1-1-0", ruleIndexes);
+	CHECK(ruleIndexes.empty());
+	CHECK(policyImage.Load(image.data(), image.size(), sErrorInfo) && sErrorInfo.empty());
+}
+
+static void TestLookups()
+{
+	std::vector<uint8_t> image;
+	std::vector<std::wstring> warnings;
+	CHECK(Compile(szPolicyXml, image, warnings));
+	AppLockerPolicyImage policyImage;
+	std::wstring sErrorInfo;
+	CHECK(policyImage.Load(image.data(), image.size(), sErrorInfo));
+	std::vector<uint32_t> ruleIndexes;
+	const std::vector<uint32_t> none, rule0 = { 0 }, rule1 = { 1 }, rule2 = { 2 }, rule3 = { 3 }, rule4 = { 4 };
+
+	// Entity-encoded and case-varied paths
+	policyImage.FindPathRules(L"%OSDRIVE%\\R&D\\x.exe", ruleIndexes);
+	CHECK(rule0 == ruleIndexes);
+	policyImage.FindPathRules(L"%osdrive%\\r&d\\Sub\\X.EXE", ruleIndexes);
+	CHECK(rule0 == ruleIndexes);
+	policyImage.FindPathRules(L"%OSDRIVE%\\R&amp;D\\x.exe", ruleIndexes);
+	CHECK(none == ruleIndexes);
+	policyImage.FindPathRules(L"%programfiles%\\APP\\app.EXE", ruleIndexes);
+	CHECK(rule2 == ruleIndexes);
+	// Only the exact path, not its exceptions, directory, or the conditions in the comment and CDATA section
+	for (const wchar_t* szPath : { L"%PROGRAMFILES%\\App", L"%PROGRAMFILES%\\App\\Safe.exe", L"C:\\Commented\\x.exe", L"C:\\CData\\x.exe" })
+	{
+		policyImage.FindPathRules(szPath, ruleIndexes);
+		CHECK(none == ruleIndexes);
+	}
+
+	// Wildcard patterns
+	policyImage.FindPathRules(L"%OSDRIVE%\\TOOLS\\a.Exe", ruleIndexes);
+	CHECK(rule1 == ruleIndexes);
+	policyImage.FindPathRules(L"%OSDRIVE%/Tools/Sub/b.exe", ruleIndexes);
+	CHECK(rule1 == ruleIndexes);
+	policyImage.FindPathRules(L"%OSDRIVE%\\Tools\\a.dll", ruleIndexes);
+	CHECK(none == ruleIndexes);
+
+	// Publishers: entity-encoded, case-varied, and "*" product
+	policyImage.FindPublisherRules(L"o=r&d corp, c=us", L"Any Product", L"TOOL.EXE", ruleIndexes);
+	CHECK(rule3 == ruleIndexes);
+	policyImage.FindPublisherRules(L"O=R&D CORP, C=US", L"", L"Other.exe", ruleIndexes);
+	CHECK(none == ruleIndexes);
+
+	// Hashes, listed twice in one rule, reported once
+	policyImage.FindHashRules(L"0X3A6BC0FFEE", ruleIndexes);
+	CHECK(rule4 == ruleIndexes);
+	policyImage.FindHashRules(L"0x3A6BC0FFEF", ruleIndexes);
+	CHECK(none == ruleIndexes);
+
+	// SIDs, which are compared exactly
+	const std::vector<uint32_t> everyone = { 1, 2, 4 }, administrators = { 0, 3 };
+	policyImage.FindSidRules(L"S-1-1-0", ruleIndexes);
+	CHECK(everyone == ruleIndexes);
+	policyImage.FindSidRules(L"S-1-5-32-544", ruleIndexes);
+	CHECK(administrators == ruleIndexes);
+	policyImage.FindSidRules(L"S-1-5-32-545", ruleIndexes);
+	CHECK(none == ruleIndexes);
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestExtensionsRoundTrip();
+	TestWarnings();
+	TestLoadRejects();
+	TestLookups();
+	return TestCheck::ExitCode("AppLockerPolicyImageTests");
+}
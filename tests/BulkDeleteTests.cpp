@@ -0,0 +1,244 @@
+// Tests for BulkDelete: a temporary tree deleted with NativeFileSystem (POSIX only; including symbolic links,
+// which must be removed without following them, and names that aren't valid UTF-8), and an in-memory
+// IFileSystem that injects failures
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#include "BulkDelete.h"
+#ifndef _WIN32
+#include "FileSystemUtils-Posix.h"
+#endif
+#include "TestCheck.h"
+
+namespace fs = std::filesystem;
+
+static void MakeFile(const fs::path& path)
+{
+	std::ofstream(path) << "x";
+}
+
+#ifndef _WIN32
+static size_t CountEntries(const fs::path& dir)
+{
+	size_t nEntries = 0;
+	for (fs::directory_iterator iter(dir), end; iter != end; ++iter)
+		++nEntries;
+	return nEntries;
+}
+
+static void TestNativeTree(const fs::path& root)
+{
+	const fs::path tree = root / "tree", outside = root / "outside";
+	fs::create_directories(tree / "a" / "b" / "c");
+	fs::create_directories(tree / "d");
+	fs::create_directories(outside / "keep");
+	MakeFile(outside / "keep" / "target.txt");
+	MakeFile(outside / "target.txt");
+
+	MakeFile(tree / "top.txt");
+	MakeFile(tree / "a" / "1.txt");
+	MakeFile(tree / "a" / "b" / "2.txt");
+	MakeFile(tree / "a" / "b" / "c" / "3.txt");
+	MakeFile(tree / "d" / "readonly.txt");
+	fs::permissions(tree / "d" / "readonly.txt", fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read);
+	// Links (the POSIX counterpart of reparse points) are deleted as entries; their targets must survive.
+	fs::create_directory_symlink(outside / "keep", tree / "a" / "dirlink");
+	fs::create_symlink(outside / "target.txt", tree / "filelink");
+	fs::create_symlink(root / "does-not-exist", tree / "d" / "dangling");
+	CHECK(0 == mkfifo((tree / "d" / "fifo").c_str(), 0600));
+
+	NativeFileSystem fileSystem;
+	BulkDelete bulkDelete(fileSystem);
+	bulkDelete.SetConcurrency(4);
+	CHECK(bulkDelete.DeleteContents(tree.wstring()));
+	CHECK(0 == bulkDelete.Failures());
+	CHECK(bulkDelete.EnumerationFailures().empty());
+	CHECK(9 == bulkDelete.FilesDeleted());
+	CHECK(4 == bulkDelete.DirectoriesRemoved());
+	CHECK(13 == bulkDelete.Results().size());
+	CHECK(fs::exists(tree) && 0 == CountEntries(tree));
+	CHECK(fs::exists(outside / "keep" / "target.txt"));
+	CHECK(fs::exists(outside / "target.txt"));
+
+	// Files are reported first, then directories deepest first. Paths are joined with '\'.
+	const DeleteResultCollection_t& results = bulkDelete.Results();
+	const std::wstring sTree = tree.wstring();
+	CHECK(!results[8].bIsDirectory && results[9].bIsDirectory);
+	CHECK(bulkDelete.ResultPath(results[9]) == sTree + L"\\a\\b\\c");
+	CHECK(bulkDelete.ResultPath(results[12]) == sTree + L"\\d" || bulkDelete.ResultPath(results[12]) == sTree + L"\\a");
+
+	// Including the root
+	MakeFile(tree / "again.txt");
+	CHECK(bulkDelete.DeleteContents(tree.wstring(), true));
+	CHECK(1 == bulkDelete.FilesDeleted() && 1 == bulkDelete.DirectoriesRemoved());
+	CHECK(!fs::exists(tree));
+
+	// A root that can't be enumerated
+	CHECK(!bulkDelete.DeleteContents(tree.wstring()));
+	CHECK(1 == bulkDelete.EnumerationFailures().size());
+	CHECK(bulkDelete.Results().empty());
+}
+
+// POSIX names are bytes: names that aren't valid UTF-8 must come back from enumeration as paths that
+// name the same files, or deleting them fails with ENOENT.
+static void TestNonUtf8Names(const fs::path& root)
+{
+	// Latin-1 "é", a truncated sequence, an overlong "/", an encoded surrogate, and bytes that are never valid
+	const std::string names[] = { "caf\xE9.txt", "x\xC3", "a\xC0\xAF" "b", "\xED\xA0\x80", "\xFF\xFE" };
+	for (const std::string& sName : names)
+	{
+		const std::wstring sWide = WStringFromPosixName(sName.c_str());
+		CHECK(sName == PosixPathFromWString(sWide));
+	}
+	CHECK(L"caf\xDCE9.txt" == WStringFromPosixName(names[0].c_str()));
+	CHECK(L"x\xDCC3" == WStringFromPosixName(names[1].c_str()));
+	// Valid UTF-8, including a supplementary character, is unchanged.
+	CHECK(L"caf\x00E9\x1F600" == WStringFromPosixName("caf\xC3\xA9\xF0\x9F\x98\x80"));
+	CHECK("a/b" == PosixPathFromWString(L"a\\b"));
+
+	const fs::path tree = root / "nonutf8";
+	fs::create_directories(tree / names[4]);
+	for (const std::string& sName : names)
+		MakeFile(tree / names[4] / sName);
+	MakeFile(tree / names[0]);
+
+	NativeFileSystem fileSystem;
+	BulkDelete bulkDelete(fileSystem);
+	CHECK(bulkDelete.DeleteContents(tree.wstring()));
+	CHECK(0 == bulkDelete.Failures() && bulkDelete.EnumerationFailures().empty());
+	CHECK(6 == bulkDelete.FilesDeleted() && 1 == bulkDelete.DirectoriesRemoved());
+	CHECK(fs::exists(tree) && 0 == CountEntries(tree));
+}
+#endif // _WIN32
+
+/// <summary>
+/// In-memory file system: a set of paths, each a file or directory. Removing a directory that still has
+/// entries fails, as it would on disk. Paths listed in failDelete and failEnumerate fail those operations.
+/// </summary>
+class FakeFileSystem : public IFileSystem
+{
+public:
+	static const uint32_t dwAccessDenied = 5, dwDirNotEmpty = 145, dwNotFound = 2;
+
+	void AddDirectory(const std::wstring& sPath) { m_entries[sPath] = true; }
+	void AddFile(const std::wstring& sPath) { m_entries[sPath] = false; }
+	bool Exists(const std::wstring& sPath) const { return m_entries.count(sPath) > 0; }
+
+	std::set<std::wstring> failDelete, failEnumerate;
+
+	bool Enumerate(const std::wstring& sDirectoryPath, DirEntryCollection_t& files, DirEntryCollection_t& subdirectories) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		files.clear();
+		subdirectories.clear();
+		if (failEnumerate.count(sDirectoryPath) > 0 || !Exists(sDirectoryPath))
+			return false;
+		for (std::map<std::wstring, bool>::const_iterator iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+		{
+			if (!IsChild(sDirectoryPath, iter->first))
+				continue;
+			DirEntry_t entry;
+			entry.sName = iter->first.substr(sDirectoryPath.length() + 1);
+			entry.dwAttributes = iter->second ? 0x10 : 0x80;
+			(iter->second ? subdirectories : files).push_back(entry);
+		}
+		return true;
+	}
+
+	uint32_t DeleteFileObject(const std::wstring& sFilePath, uint32_t /*dwAttributes*/) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (failDelete.count(sFilePath) > 0)
+			return dwAccessDenied;
+		return (m_entries.erase(sFilePath) > 0) ? 0 : dwNotFound;
+	}
+
+	uint32_t RemoveDirectoryObject(const std::wstring& sDirectoryPath, uint32_t /*dwAttributes*/) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (failDelete.count(sDirectoryPath) > 0)
+			return dwAccessDenied;
+		for (std::map<std::wstring, bool>::const_iterator iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+		{
+			if (IsChild(sDirectoryPath, iter->first))
+				return dwDirNotEmpty;
+		}
+		return (m_entries.erase(sDirectoryPath) > 0) ? 0 : dwNotFound;
+	}
+
+private:
+	static bool IsChild(const std::wstring& sDirectoryPath, const std::wstring& sPath)
+	{
+		return sPath.length() > sDirectoryPath.length() + 1 &&
+			0 == sPath.compare(0, sDirectoryPath.length(), sDirectoryPath) &&
+			L'\\' == sPath[sDirectoryPath.length()] &&
+			std::wstring::npos == sPath.find(L'\\', sDirectoryPath.length() + 1);
+	}
+
+	std::mutex m_mutex;
+	std::map<std::wstring, bool> m_entries;
+};
+
+static void TestInjectedFailures()
+{
+	FakeFileSystem fileSystem;
+	for (const wchar_t* szDir : { L"R", L"R\\a", L"R\\a\\b", L"R\\c", L"R\\locked" })
+		fileSystem.AddDirectory(szDir);
+	for (const wchar_t* szFile : { L"R\\1", L"R\\a\\2", L"R\\a\\b\\3", L"R\\a\\b\\4", L"R\\c\\5", L"R\\locked\\6" })
+		fileSystem.AddFile(szFile);
+	fileSystem.failDelete.insert(L"R\\a\\b\\3");
+	fileSystem.failEnumerate.insert(L"R\\locked");
+
+	BulkDelete bulkDelete(fileSystem);
+	bulkDelete.SetConcurrency(3);
+	CHECK(!bulkDelete.DeleteContents(L"R"));
+
+	// R\a\b\3 can't be deleted, so R\a\b and then R\a aren't empty; R\locked wasn't enumerated, so it isn't empty either.
+	CHECK(1 == bulkDelete.EnumerationFailures().size() && L"R\\locked" == bulkDelete.EnumerationFailures()[0]);
+	CHECK(4 == bulkDelete.FilesDeleted());
+	CHECK(1 == bulkDelete.DirectoriesRemoved());
+	CHECK(4 == bulkDelete.Failures());
+	std::map<std::wstring, uint32_t> errors;
+	for (const DeleteResult_t& result : bulkDelete.Results())
+	{
+		if (0 != result.dwError)
+			errors[bulkDelete.ResultPath(result)] = result.dwError;
+	}
+	CHECK(FakeFileSystem::dwAccessDenied == errors[L"R\\a\\b\\3"]);
+	CHECK(FakeFileSystem::dwDirNotEmpty == errors[L"R\\a\\b"]);
+	CHECK(FakeFileSystem::dwDirNotEmpty == errors[L"R\\a"]);
+	CHECK(FakeFileSystem::dwDirNotEmpty == errors[L"R\\locked"]);
+	CHECK(!fileSystem.Exists(L"R\\c") && !fileSystem.Exists(L"R\\a\\b\\4"));
+	CHECK(fileSystem.Exists(L"R\\locked\\6"));
+
+	// The same object can be used again; the previous run's results are discarded.
+	fileSystem.failDelete.clear();
+	fileSystem.failEnumerate.clear();
+	CHECK(bulkDelete.DeleteContents(L"R", true));
+	CHECK(0 == bulkDelete.Failures() && bulkDelete.EnumerationFailures().empty());
+	CHECK(2 == bulkDelete.FilesDeleted() && 4 == bulkDelete.DirectoriesRemoved());
+	CHECK(!fileSystem.Exists(L"R"));
+}
+
+int main()
+{
+	const fs::path root = fs::temp_directory_path() / ("BulkDeleteTests-" + std::to_string(std::hash<std::string>()(fs::current_path().string()) % 100000));
+	fs::remove_all(root);
+	fs::create_directories(root);
+
+#ifndef _WIN32
+	TestNativeTree(root);
+	TestNonUtf8Names(root);
+#endif
+	TestInjectedFailures();
+
+	fs::remove_all(root);
+	return TestCheck::ExitCode("BulkDeleteTests");
+}
@@ -0,0 +1,192 @@
+// Tests for UpperCaseChar and UpperCase: fixed mappings, bulk results against per-character results,
+// and, on Windows, a differential test against LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE)
+// over every UTF-16 code unit. Also tests CaseInsensitiveHash, CaseInsensitiveEqual, and
+// CaseInsensitiveStringLookup, and where their simple case folding differs from uppercasing.
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include "CaseFolding.h"
+#include "CaseInsensitiveStringLookup.h"
+#include "Stats.h"
+#include "StringUtils.h"
+#include "TestCheck.h"
+
+static void TestFixedMappings()
+{
+	for (wchar_t ch = 0; ch < 0x80; ++ch)
+		CHECK(UpperCaseChar(ch) == ((ch >= L'a' && ch <= L'z') ? wchar_t(ch - 0x20) : ch));
+	// Dotless i is not mapped to ASCII 'I', whatever the user's locale.
+	CHECK(wchar_t(0x0131) == UpperCaseChar(wchar_t(0x0131)));
+	CHECK(wchar_t(0x00C9) == UpperCaseChar(wchar_t(0x00E9)));
+	CHECK(wchar_t(0x0416) == UpperCaseChar(wchar_t(0x0436)));
+	CHECK(wchar_t(0x00C9) == UpperCaseChar(wchar_t(0x00C9)));
+	for (wchar_t ch = 0xD800; ch < 0xE000; ++ch)
+		CHECK(ch == UpperCaseChar(ch));
+
+	std::wstring sPath = L"%osdrive%\\users\\\x00e9mile\\appdata\\local\\temp\\*.exe";
+	CHECK(L"%OSDRIVE%\\USERS\\\x00c9MILE\\APPDATA\\LOCAL\\TEMP\\*.EXE" == WString_To_Upper(sPath));
+	CHECK(WildcardMatchCaseInsensitive(L"%OSDRIVE%\\USERS\\*\\APPDATA\\*", L"%osdrive%\\Users\\\x00e9mile\\AppData\\x.exe"));
+}
+
+// Every code unit except surrogates
+static std::wstring AllCodeUnits()
+{
+	std::wstring str;
+	for (unsigned int cp = 0; cp < 0x10000; ++cp)
+	{
+		if (cp < 0xD800 || cp >= 0xE000)
+			str.push_back(wchar_t(cp));
+	}
+	return str;
+}
+
+static void TestBulkMatchesPerCharacter()
+{
+	// Long ASCII runs take the vector path; non-ASCII characters at every offset take the table path.
+	std::wstring sSource = AllCodeUnits();
+	for (int ixRepeat = 0; ixRepeat < 3; ++ixRepeat)
+		sSource += L"c:\\program files\\windowsapps\\microsoft.windowsterminal_1.0\\wt.exe";
+	for (size_t ixOffset = 0; ixOffset < 17; ++ixOffset)
+	{
+		const std::wstring sPart = sSource.substr(ixOffset);
+		std::wstring sExpected(sPart);
+		for (wchar_t& ch : sExpected)
+			ch = UpperCaseChar(ch);
+		CHECK(sExpected == WString_Upper(sPart));
+		std::wstring sInPlace(sPart);
+		UpperCase(sInPlace.data(), sInPlace.length(), sInPlace.data());
+		CHECK(sExpected == sInPlace);
+	}
+}
+
+#ifdef _WIN32
+// The mapping must be Windows' own, character by character and in bulk.
+static void TestAgainstLCMapStringEx()
+{
+	size_t nMismatches = 0, nChanged = 0;
+	for (unsigned int cp = 0; cp < 0x10000; ++cp)
+	{
+		if (cp >= 0xD800 && cp < 0xE000)
+			continue;
+		const wchar_t ch = wchar_t(cp);
+		wchar_t chWindows = ch;
+		CHECK(1 == LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, &ch, 1, &chWindows, 1, NULL, NULL, 0));
+		if (chWindows != ch)
+			++nChanged;
+		if (chWindows != UpperCaseChar(ch))
+		{
+			if (++nMismatches <= 10)
+				fprintf(stderr, "U+%04X: LCMapStringEx U+%04X, UpperCaseChar U+%04X\n", cp, unsigned(chWindows), unsigned(UpperCaseChar(ch)));
+		}
+	}
+	CHECK(0 == nMismatches);
+	CHECK(nChanged > 26);
+	printf("LCMapStringEx invariant uppercasing changes %u BMP code units\n", unsigned(nChanged));
+
+	const std::wstring sAll = AllCodeUnits();
+	std::wstring sWindows(sAll.length(), L'\0');
+	CHECK(int(sAll.length()) == LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, sAll.c_str(), int(sAll.length()), &sWindows[0], int(sWindows.length()), NULL, NULL, 0));
+	CHECK(sWindows == WString_Upper(sAll));
+}
+#endif
+
+// Pairs of strings that are equal by simple case folding; long ones take the vector path.
+static const wchar_t* const szFoldedEqualPairs[][2] = {
+	{ L"ProgramData", L"PROGRAMDATA" },
+	{ L"%OSDRIVE%\\Users\\\x00c9mile\\AppData\\Local\\Temp", L"%osdrive%\\USERS\\\x00e9MILE\\appdata\\local\\temp" },
+	{ L"\x0416\x0443\x0440\x043d\x0430\x043b", L"\x0436\x0423\x0420\x041d\x0410\x041b" },
+	{ L"\x03a3\x0391\x03a3", L"\x03c3\x03b1\x03c2" },
+	{ L"\x212A", L"k" },
+	{ L"", L"" },
+};
+
+static void TestHashAndEqual()
+{
+	const CaseInsensitiveHash hash;
+	const CaseInsensitiveEqual equal;
+	for (const auto& pair : szFoldedEqualPairs)
+	{
+		CHECK(equal(pair[0], pair[1]));
+		CHECK(hash(pair[0]) == hash(pair[1]));
+		// The same string as std::wstring, std::wstring_view, and C string
+		CHECK(hash(std::wstring(pair[0])) == hash(pair[0]));
+	}
+	CHECK(!equal(L"ProgramData", L"ProgramDat"));
+	CHECK(!equal(L"ProgramData", L"ProgramDatb"));
+	CHECK(!equal(L"\x00e9", L"e"));
+	// Dotless i folds to itself, not to ASCII 'i'.
+	CHECK(!equal(L"\x0131", L"i") && !equal(L"\x0131", L"I"));
+	CHECK(wchar_t(0x03c3) == FoldCaseChar(wchar_t(0x03c2)));
+	CHECK(wchar_t(0x00e9) == FoldCaseChar(wchar_t(0x00c9)));
+}
+
+// Simple case folding and Windows' uppercasing (NTFS's name comparison) disagree on some characters.
+static void TestFoldingDiffersFromUpperCase()
+{
+	// KELVIN SIGN folds to 'k', so the functors treat it as "k", but Windows doesn't uppercase it to 'K'.
+	CHECK(L'k' == FoldCaseChar(wchar_t(0x212A)));
+	CHECK(wchar_t(0x212A) == UpperCaseChar(wchar_t(0x212A)));
+	CHECK(CaseInsensitiveEqual()(L"\x212A" L"ey", L"key"));
+	std::wstring sKelvin(L"\x212A" L"ey"), sKey(L"key");
+	CHECK(WString_To_Upper(sKelvin) != WString_To_Upper(sKey));
+
+	CaseInsensitiveStringLookup lookup;
+	lookup.Add(L"Kernel");
+	CHECK(lookup.IsInSet(L"\x212A" L"ernel"));
+}
+
+static void TestStringLookup()
+{
+	CaseInsensitiveStringLookup lookup;
+	const wchar_t* szNames[] = { L"ProgramData", L"Program Files", L"\x00c9mile", NULL };
+	lookup.Add(szNames);
+	CHECK(3 == lookup.size());
+	CHECK(!lookup.Add(L"PROGRAMDATA"));
+	CHECK(3 == lookup.size());
+
+	// Views of the added strings stay valid as the set grows: many Adds reallocate the hash table, and
+	// strings longer than the small-string buffer would dangle if their storage moved.
+	const size_t nStrings = 20000;
+	for (size_t ix = 0; ix < nStrings; ++ix)
+		CHECK(lookup.Add(L"Directory number " + std::to_wstring(ix) + L" with a name longer than the small-string buffer"));
+	CHECK(3 + nStrings == lookup.size());
+	for (size_t ix = 0; ix < nStrings; ix += 7)
+		CHECK(lookup.IsInSet(L"DIRECTORY NUMBER " + std::to_wstring(ix) + L" WITH A NAME LONGER THAN THE SMALL-STRING BUFFER"));
+	CHECK(lookup.IsInSet(L"programdata") && lookup.IsInSet(L"\x00e9MILE"));
+	CHECK(!lookup.IsInSet(L"Directory number 20000 with a name longer than the small-string buffer"));
+
+	// A copy refers to its own strings.
+	CaseInsensitiveStringLookup copy(lookup);
+	lookup.clear();
+	CHECK(lookup.empty() && !lookup.IsInSet(L"ProgramData"));
+	CHECK(copy.IsInSet(L"PROGRAM FILES") && copy.IsInSet(L"directory number 19999 with a name longer than the small-string buffer"));
+
+#if STATS_ENABLED
+	// Lookups by view don't allocate, whatever the string's length or case.
+	const std::wstring sLong(L"DIRECTORY NUMBER 12345 WITH A NAME LONGER THAN THE SMALL-STRING BUFFER");
+	const std::wstring sMissing(L"directory number 12345 with a name longer than the small-string buffer!");
+	AllocationAccounting::Enable();
+	const uint64_t nAllocationsBefore = AllocationAccounting::Current().nAllocations;
+	const bool bFound = copy.IsInSet(std::wstring_view(sLong)) && copy.IsInSet(L"program files");
+	const bool bMissing = copy.IsInSet(std::wstring_view(sMissing));
+	CHECK(nAllocationsBefore == AllocationAccounting::Current().nAllocations);
+	CHECK(bFound && !bMissing);
+#endif
+}
+
+int main()
+{
+	TestFixedMappings();
+	TestBulkMatchesPerCharacter();
+	TestHashAndEqual();
+	TestFoldingDiffersFromUpperCase();
+	TestStringLookup();
+#ifdef _WIN32
+	TestAgainstLCMapStringEx();
+#endif
+	return TestCheck::ExitCode("CaseMappingTests");
+}
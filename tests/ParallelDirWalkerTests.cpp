@@ -0,0 +1,160 @@
+// Tests for ParallelDirWalker on temporary directory trees: deterministic order, agreement between
+// thread counts and ordering modes, depth limits, and invalid roots
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "ParallelDirWalker.h"
+#include "TestCheck.h"
+
+namespace fs = std::filesystem;
+
+// One callback invocation, with the directory path relative to the walk's root
+struct Visit_t
+{
+	std::wstring sRelativeDir;
+	size_t nDepth;
+	std::vector<std::wstring> files, subdirectories;
+
+	bool operator == (const Visit_t& other) const
+	{
+		return sRelativeDir == other.sRelativeDir && nDepth == other.nDepth && files == other.files && subdirectories == other.subdirectories;
+	}
+	bool operator < (const Visit_t& other) const { return sRelativeDir < other.sRelativeDir; }
+};
+
+static void MakeFile(const fs::path& path)
+{
+	std::ofstream(path) << "x";
+}
+
+// Walks the tree and records each callback; relative paths use '\', as the walker joins names with it.
+static bool Walk(const fs::path& root, size_t nThreads, bool bDeterministic, size_t nMaxDepth, std::vector<Visit_t>& visits)
+{
+	visits.clear();
+	const std::wstring sRoot = root.wstring();
+	ParallelDirWalker dirWalker;
+	dirWalker.SetConcurrency(nThreads);
+	dirWalker.SetDeterministicOrder(bDeterministic);
+	dirWalker.SetMaxDepth(nMaxDepth);
+	std::wstringstream strErrorInfo;
+	const bool bOK = dirWalker.Walk(sRoot.c_str(),
+		[&](const std::wstring& sDirectory, size_t nDepth, const DirEntryCollection_t& files, const DirEntryCollection_t& subdirectories)
+		{
+			Visit_t visit;
+			visit.sRelativeDir = sDirectory.substr(sRoot.length());
+			visit.nDepth = nDepth;
+			for (const DirEntry_t& file : files)
+				visit.files.push_back(file.sName);
+			for (const DirEntry_t& subdirectory : subdirectories)
+				visit.subdirectories.push_back(subdirectory.sName);
+			visits.push_back(visit);
+		},
+		strErrorInfo);
+	CHECK(dirWalker.DirectoriesProcessed() == visits.size());
+	CHECK(0 == dirWalker.EnumerationFailures());
+	return bOK;
+}
+
+// Names differing in case and punctuation: NTFS order (upper-cased ordinal) is A, b, C, _x;
+// a case-sensitive ordinal sort would give A, C, _x, b.
+static void TestDeterministicOrder(const fs::path& root)
+{
+	for (const char* szDir : { "b", "A", "C", "_x", "A/z", "A/Y", "b/m" })
+		fs::create_directories(root / szDir);
+	for (const char* szFile : { "f2.txt", "F1.txt", "e.txt" })
+		MakeFile(root / szFile);
+	MakeFile(root / "A" / "y.dat");
+
+	const std::vector<Visit_t> expected = {
+		{ L"", 0, { L"e.txt", L"F1.txt", L"f2.txt" }, { L"A", L"b", L"C", L"_x" } },
+		{ L"\\A", 1, { L"y.dat" }, { L"Y", L"z" } },
+		{ L"\\b", 1, {}, { L"m" } },
+		{ L"\\C", 1, {}, {} },
+		{ L"\\_x", 1, {}, {} },
+		{ L"\\A\\Y", 2, {}, {} },
+		{ L"\\A\\z", 2, {}, {} },
+		{ L"\\b\\m", 2, {}, {} },
+	};
+	for (size_t nThreads : { 1, 2, 8 })
+	{
+		std::vector<Visit_t> visits;
+		CHECK(Walk(root, nThreads, true, ParallelDirWalker::UnlimitedDepth, visits));
+		CHECK(visits == expected);
+	}
+}
+
+// A wider tree: every thread count and both ordering modes must visit the same directories with the same entries.
+static void TestAgreement(const fs::path& root)
+{
+	for (int ix1 = 0; ix1 < 12; ++ix1)
+	{
+		const fs::path dir1 = root / ("d" + std::to_string(ix1));
+		for (int ix2 = 0; ix2 < 8; ++ix2)
+		{
+			const fs::path dir2 = dir1 / ("s" + std::to_string(ix2));
+			fs::create_directories(dir2 / "leaf");
+			for (int ixFile = 0; ixFile < ix2; ++ixFile)
+				MakeFile(dir2 / ("file" + std::to_string(ixFile)));
+		}
+	}
+
+	std::vector<Visit_t> reference;
+	CHECK(Walk(root, 1, true, ParallelDirWalker::UnlimitedDepth, reference));
+	CHECK(1 + 12 + 12 * 8 * 2 == reference.size());
+	for (size_t nThreads : { 2, 4, 16 })
+	{
+		std::vector<Visit_t> visits;
+		CHECK(Walk(root, nThreads, true, ParallelDirWalker::UnlimitedDepth, visits));
+		CHECK(visits == reference);
+
+		// Unordered: same visits once sorted, with each directory's entries sorted too
+		CHECK(Walk(root, nThreads, false, ParallelDirWalker::UnlimitedDepth, visits));
+		std::vector<Visit_t> sortedReference(reference);
+		for (std::vector<Visit_t>* pVisits : { &visits, &sortedReference })
+		{
+			for (Visit_t& visit : *pVisits)
+			{
+				std::sort(visit.files.begin(), visit.files.end());
+				std::sort(visit.subdirectories.begin(), visit.subdirectories.end());
+			}
+			std::sort(pVisits->begin(), pVisits->end());
+		}
+		CHECK(visits == sortedReference);
+	}
+
+	// Depth limit: the root and its subdirectories only, though the subdirectories still report theirs
+	std::vector<Visit_t> visits;
+	CHECK(Walk(root, 4, true, 1, visits));
+	CHECK(1 + 12 == visits.size());
+	CHECK(visits.size() > 1 && 8 == visits[1].subdirectories.size());
+}
+
+static void TestInvalidRoot(const fs::path& root)
+{
+	ParallelDirWalker dirWalker;
+	std::wstringstream strErrorInfo;
+	const std::wstring sMissing = (root / "does-not-exist").wstring();
+	size_t nCallbacks = 0;
+	CHECK(!dirWalker.Walk(sMissing.c_str(), [&](const std::wstring&, size_t, const DirEntryCollection_t&, const DirEntryCollection_t&) { ++nCallbacks; }, strErrorInfo));
+	CHECK(0 == nCallbacks);
+	CHECK(!strErrorInfo.str().empty());
+	CHECK(!dirWalker.Walk(L"", [&](const std::wstring&, size_t, const DirEntryCollection_t&, const DirEntryCollection_t&) { ++nCallbacks; }, strErrorInfo));
+}
+
+int main()
+{
+	const fs::path root = fs::temp_directory_path() / ("ParallelDirWalkerTests-" + std::to_string(std::hash<std::string>()(fs::current_path().string()) % 100000));
+	fs::remove_all(root);
+	fs::create_directories(root / "ordered");
+	fs::create_directories(root / "wide");
+
+	TestDeterministicOrder(root / "ordered");
+	TestAgreement(root / "wide");
+	TestInvalidRoot(root);
+
+	fs::remove_all(root);
+	return TestCheck::ExitCode("ParallelDirWalkerTests");
+}
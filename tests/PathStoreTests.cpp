@@ -0,0 +1,69 @@
+// Tests for PathStore: full paths, invalid parents, and Compact releasing nodes while keeping the
+// paths of the nodes that remain
+
+#include <string>
+#include <vector>
+#include "PathStore.h"
+#include "TestCheck.h"
+
+static void TestPaths()
+{
+	PathStore paths;
+	const PathStore::PathId_t rootId = paths.AddRoot(L"C:\\Root");
+	const PathStore::PathId_t dirId = paths.Add(rootId, L"dir");
+	const PathStore::PathId_t fileId = paths.Add(dirId, L"file.txt");
+	CHECK(L"C:\\Root\\dir\\file.txt" == paths.FullPath(fileId));
+	CHECK(L"file.txt" == paths.Name(fileId));
+	CHECK(dirId == paths.Parent(fileId));
+	CHECK(PathStore::InvalidId == paths.Parent(rootId));
+
+	// A parent that isn't in the store
+	CHECK(PathStore::InvalidId == paths.Add(PathStore::PathId_t(paths.Count()), L"orphan"));
+	CHECK(PathStore::InvalidId == paths.Add(PathStore::InvalidId - 1, L"orphan"));
+	CHECK(3 == paths.Count());
+	CHECK(paths.FullPath(PathStore::InvalidId).empty());
+}
+
+static void TestCompact()
+{
+	// Root with directories d0..d9, each with files f0..f9
+	PathStore paths;
+	const PathStore::PathId_t rootId = paths.AddRoot(L"R");
+	std::vector<PathStore::PathId_t> dirIds, fileIds;
+	for (int ixDir = 0; ixDir < 10; ++ixDir)
+	{
+		dirIds.push_back(paths.Add(rootId, L"d" + std::to_wstring(ixDir)));
+		for (int ixFile = 0; ixFile < 10; ++ixFile)
+			fileIds.push_back(paths.Add(dirIds.back(), L"f" + std::to_wstring(ixFile)));
+	}
+	CHECK(111 == paths.Count());
+
+	// Keep two files in d7 and one in d2; their directories and the root are kept as ancestors.
+	std::vector<PathStore::PathId_t> keep = { fileIds[75], fileIds[23], fileIds[79] };
+	const size_t cbBefore = paths.MemoryUsage();
+	paths.Compact(keep);
+	CHECK(6 == paths.Count());
+	CHECK(paths.MemoryUsage() < cbBefore);
+	CHECK(3 == keep.size());
+	CHECK(L"R\\d7\\f5" == paths.FullPath(keep[0]));
+	CHECK(L"R\\d2\\f3" == paths.FullPath(keep[1]));
+	CHECK(L"R\\d7\\f9" == paths.FullPath(keep[2]));
+	CHECK(paths.Parent(keep[0]) == paths.Parent(keep[2]));
+
+	// Nodes can be added after compaction, under the kept nodes.
+	const PathStore::PathId_t newId = paths.Add(paths.Parent(keep[1]), L"new");
+	CHECK(L"R\\d2\\new" == paths.FullPath(newId));
+
+	// Keeping nothing releases everything; an invalid ID stays invalid.
+	std::vector<PathStore::PathId_t> none = { PathStore::InvalidId };
+	paths.Compact(none);
+	CHECK(0 == paths.Count());
+	CHECK(PathStore::InvalidId == none[0]);
+}
+
+int main()
+{
+	TestPaths();
+	TestCompact();
+	return TestCheck::ExitCode("PathStoreTests");
+}
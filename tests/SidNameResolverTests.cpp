@@ -0,0 +1,145 @@
+// Tests for SidNameResolver with MapSidLookup as the resolver: batching, caching, time-to-live of
+// unresolved SIDs, the separate well-known SID lookup, and recovery after failed lookups
+
+#include <string>
+#include <vector>
+#include <thread>
+#include "SidStrings.h"
+#include "SidNameResolver.h"
+#include "TestCheck.h"
+
+static const std::wstring sAlice = L"S-1-5-21-1000-2000-3000-1001";
+static const std::wstring sBob = L"S-1-5-21-1000-2000-3000-1002";
+static const std::wstring sUnknown = L"S-1-5-21-1000-2000-3000-9999";
+
+static void AddNames(MapSidLookup& lookup)
+{
+	lookup.Add(sAlice, L"CONTOSO", L"alice");
+	lookup.Add(sBob, L"CONTOSO", L"bob");
+	for (size_t ixWellKnown = 0; ixWellKnown < SidString::nAllWellKnown; ++ixWellKnown)
+		lookup.Add(SidString::AllWellKnown[ixWellKnown], L"", L"WellKnown" + std::to_wstring(ixWellKnown));
+}
+
+static void TestBatchingAndCaching()
+{
+	MapSidLookup lookup;
+	AddNames(lookup);
+	SidNameResolver resolver(lookup);
+
+	// The well-known SIDs are looked up in their own call, then the batch's distinct SIDs in another.
+	std::vector<SidName_t> names;
+	resolver.LookupBatch({ sAlice, sBob, sAlice, sUnknown }, names);
+	CHECK(2 == lookup.Calls());
+	CHECK(SidString::nAllWellKnown + 3 == lookup.SidsLookedUp());
+	CHECK((std::vector<std::wstring>{ sAlice, sBob, sUnknown }) == lookup.LastSids());
+	CHECK(4 == names.size());
+	CHECK(L"CONTOSO\\alice" == names[0].DomainAndUsername() && L"CONTOSO\\bob" == names[1].DomainAndUsername());
+	CHECK(names[2].bResolved && !names[3].bResolved);
+
+	// Cached: no more calls, for resolved or well-known SIDs.
+	SidName_t name;
+	CHECK(resolver.Lookup(sBob, name) && L"bob" == name.sUserName);
+	CHECK(resolver.Lookup(SidString::AllWellKnown[0], name) && L"WellKnown0" == name.sUserName);
+	CHECK(!resolver.Lookup(sUnknown, name));
+	CHECK(2 == lookup.Calls());
+
+	// Large batches are split.
+	std::vector<std::wstring> many;
+	for (size_t ix = 0; ix < 2 * SidNameResolver::nMaxBatch + 5; ++ix)
+		many.push_back(L"S-1-5-21-1-2-3-" + std::to_wstring(100000 + ix));
+	resolver.LookupBatch(many, names);
+	CHECK(5 == lookup.Calls());
+	CHECK(many.size() == names.size());
+
+	// Clear discards everything, including the well-known SIDs.
+	resolver.Clear();
+	CHECK(resolver.Lookup(sAlice, name));
+	CHECK(7 == lookup.Calls());
+}
+
+static void TestTimeToLive()
+{
+	MapSidLookup lookup;
+	AddNames(lookup);
+	// Resolved names live an hour; unresolved SIDs expire at once.
+	SidNameResolver resolver(lookup, 3600, 0);
+	SidName_t name;
+	CHECK(!resolver.Lookup(sUnknown, name));
+	CHECK(2 == lookup.Calls());
+	// The account is created: the next lookup finds it.
+	lookup.Add(sUnknown, L"CONTOSO", L"carol");
+	CHECK(resolver.Lookup(sUnknown, name) && L"carol" == name.sUserName);
+	CHECK(3 == lookup.Calls());
+	CHECK(resolver.Lookup(sUnknown, name));
+	CHECK(3 == lookup.Calls());
+
+	// Everything expires at once: well-known SIDs still don't.
+	SidNameResolver shortResolver(lookup, 0, 0);
+	CHECK(shortResolver.Lookup(sAlice, name));
+	CHECK(shortResolver.Lookup(sAlice, name));
+	CHECK(6 == lookup.Calls());
+	CHECK(shortResolver.Lookup(SidString::AllWellKnown[1], name));
+	CHECK(6 == lookup.Calls());
+}
+
+static void TestFailedLookups()
+{
+	MapSidLookup lookup;
+	AddNames(lookup);
+	SidNameResolver resolver(lookup);
+
+	// The LSA is unavailable: nothing resolves, and nothing is cached.
+	lookup.SetFailing(true);
+	std::vector<SidName_t> names;
+	resolver.LookupBatch({ sAlice, SidString::AllWellKnown[0] }, names);
+	CHECK(!names[0].bResolved && !names[1].bResolved);
+	CHECK(2 == lookup.Calls());
+
+	// Once it's back, the well-known SIDs and the batch are looked up again and resolve.
+	lookup.SetFailing(false);
+	resolver.LookupBatch({ sAlice, SidString::AllWellKnown[0] }, names);
+	CHECK(names[0].bResolved && names[1].bResolved);
+	CHECK(4 == lookup.Calls());
+	CHECK((std::vector<std::wstring>{ sAlice }) == lookup.LastSids());
+
+	// A later failure doesn't affect what's cached.
+	lookup.SetFailing(true);
+	SidName_t name;
+	CHECK(resolver.Lookup(sAlice, name) && L"alice" == name.sUserName);
+	CHECK(!resolver.Lookup(sBob, name));
+	CHECK(5 == lookup.Calls());
+}
+
+static void TestConcurrentLookups()
+{
+	MapSidLookup lookup;
+	AddNames(lookup);
+	SidNameResolver resolver(lookup);
+	std::vector<std::thread> threads;
+	std::vector<int> results(8, 0);
+	for (size_t ixThread = 0; ixThread < results.size(); ++ixThread)
+	{
+		threads.push_back(std::thread([&, ixThread]()
+			{
+				SidName_t name;
+				for (int ix = 0; ix < 100; ++ix)
+				{
+					if (resolver.Lookup((0 == ix % 2) ? sAlice : sBob, name) && resolver.Lookup(SidString::AllWellKnown[ixThread % SidString::nAllWellKnown], name))
+						++results[ixThread];
+				}
+			}));
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	for (int nResolved : results)
+		CHECK(100 == nResolved);
+}
+
+int main()
+{
+	TestBatchingAndCaching();
+	TestTimeToLive();
+	TestFailedLookups();
+	TestConcurrentLookups();
+	return TestCheck::ExitCode("SidNameResolverTests");
+}
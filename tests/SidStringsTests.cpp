@@ -0,0 +1,85 @@
+// Tests for SidString::Parse, IsValid, Format, and Canonical: the binary layout, what is accepted and
+// rejected, hex numbers, limits, and the well-known SID strings
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SidStrings.h"
+#include "TestCheck.h"
+
+static void TestBinaryLayout()
+{
+	std::vector<uint8_t> sid;
+	CHECK(SidString::Parse(SidString::BuiltinAdministrators, sid));
+	// Revision 1, two subauthorities, authority 5 (big-endian), then 32 and 544 (little-endian)
+	CHECK((std::vector<uint8_t>{ 1, 2, 0, 0, 0, 0, 0, 5, 32, 0, 0, 0, 0x20, 0x02, 0, 0 }) == sid);
+	CHECK(std::wstring(SidString::BuiltinAdministrators) == SidString::Format(sid.data(), sid.size()));
+
+	CHECK(SidString::Parse(L"S-1-0", sid));
+	CHECK((std::vector<uint8_t>{ 1, 0, 0, 0, 0, 0, 0, 0 }) == sid);
+	CHECK(L"S-1-0" == SidString::Format(sid.data(), sid.size()));
+}
+
+static void TestAcceptedAndRejected()
+{
+	for (const wchar_t* szValid : {
+		L"S-1-1-0", L"s-1-5-18", L"S-1-5-21-1004336348-1177238915-682003330-1001",
+		L"S-1-5-32-0x220", L"S-1-0xFFFFFFFFFFFF-4294967295", L"S-1-5-0-1-2-3-4-5-6-7-8-9-10-11-12-13-14" })
+	{
+		CHECK(SidString::IsValid(szValid));
+	}
+	for (const wchar_t* szInvalid : {
+		L"", L"S", L"S-", L"S-1", L"S-1-", L"X-1-5", L"S-2-5-32", L"S-1-5-", L"S-1-5--32", L"S-1-5-32-544-",
+		L" S-1-5", L"S-1-5 ", L"S-1--5", L"S-1-+5", L"S-1-5-4294967296", L"S-1-0x1000000000000", L"S-1-281474976710656",
+		L"S-1-5-0x", L"S-1-5-0-1-2-3-4-5-6-7-8-9-10-11-12-13-14-15", L"BA", L"S-1-5-18x" })
+	{
+		CHECK(!SidString::IsValid(szInvalid));
+	}
+	CHECK(!SidString::IsValid(nullptr));
+	std::vector<uint8_t> sid(3, 0xFF);
+	CHECK(!SidString::Parse(L"S-1-5-32-544-", sid) && sid.empty());
+}
+
+static void TestCanonical()
+{
+	CHECK(L"S-1-5-32-544" == SidString::Canonical(L"s-1-5-032-0x220"));
+	CHECK(L"S-1-5-32-544" == SidString::Canonical(L"S-01-05-32-544"));
+	// Authorities of 2^32 and more are written in hex, as ConvertSidToStringSid does.
+	CHECK(L"S-1-4294967295-1" == SidString::Canonical(L"S-1-0xFFFFFFFF-1"));
+	CHECK(L"S-1-0x0010000000ab-1" == SidString::Canonical(L"S-1-0x10000000AB-1"));
+	CHECK(L"S-1-0xffffffffffff" == SidString::Canonical(L"S-1-281474976710655"));
+	CHECK(SidString::Canonical(L"S-1-5-").empty());
+
+	// Every well-known SID string is valid and canonical.
+	for (size_t ix = 0; ix < SidString::nAllWellKnown; ++ix)
+		CHECK(std::wstring(SidString::AllWellKnown[ix]) == SidString::Canonical(SidString::AllWellKnown[ix]));
+}
+
+static void TestFormatRejects()
+{
+	std::vector<uint8_t> sid;
+	CHECK(SidString::Parse(L"S-1-5-21-1-2-3", sid));
+	// Too short for the subauthority count, wrong revision, too many subauthorities
+	CHECK(SidString::Format(sid.data(), sid.size() - 1).empty());
+	CHECK(SidString::Format(sid.data(), 7).empty());
+	CHECK(SidString::Format(nullptr, 0).empty());
+	std::vector<uint8_t> damaged(sid);
+	damaged[0] = 2;
+	CHECK(SidString::Format(damaged.data(), damaged.size()).empty());
+	damaged = sid;
+	damaged[1] = 16;
+	damaged.resize(8 + 4 * 16);
+	CHECK(SidString::Format(damaged.data(), damaged.size()).empty());
+	// Bytes past the SID are ignored.
+	sid.push_back(0xFF);
+	CHECK(L"S-1-5-21-1-2-3" == SidString::Format(sid.data(), sid.size()));
+}
+
+int main()
+{
+	TestBinaryLayout();
+	TestAcceptedAndRejected();
+	TestCanonical();
+	TestFormatRejects();
+	return TestCheck::ExitCode("SidStringsTests");
+}
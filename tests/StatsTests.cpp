@@ -0,0 +1,305 @@
+// Tests for Stats: counters, accumulation of phase times, WriteJson producing valid JSON, and, with
+// AllocationAccounting, per-phase peaks of nested scopes and of command-thread scopes while worker-thread
+// scopes come and go
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Stats.h"
+#include "TestCheck.h"
+
+static std::wstring StatsJson()
+{
+	std::wostringstream os;
+	Stats::WriteJson(os, 0, 0);
+	return os.str();
+}
+
+// Value of a numeric field of a phase in Stats::WriteJson output, or -1 if the phase doesn't have it
+static int64_t PhaseField(const std::wstring& sJson, const wchar_t* szPhase, const wchar_t* szField)
+{
+	const size_t ixPhase = sJson.find(L"\"" + std::wstring(szPhase) + L"\": {");
+	if (std::wstring::npos == ixPhase)
+		return -1;
+	const size_t ixEnd = sJson.find(L'}', ixPhase);
+	const std::wstring sName = L"\"" + std::wstring(szField) + L"\": ";
+	const size_t ixField = sJson.find(sName, ixPhase);
+	if (std::wstring::npos == ixField || ixField > ixEnd)
+		return -1;
+	return std::stoll(sJson.substr(ixField + sName.length()));
+}
+
+// Minimal JSON syntax check: objects, arrays, strings, numbers, true, false, and null
+class JsonChecker
+{
+public:
+	static bool IsValid(const std::wstring& sJson)
+	{
+		JsonChecker checker(sJson);
+		return checker.Value() && checker.AtEnd();
+	}
+private:
+	explicit JsonChecker(const std::wstring& sJson) : m_p(sJson.c_str()) {}
+	void SkipSpace()
+	{
+		while (L' ' == *m_p || L'\t' == *m_p || L'\n' == *m_p || L'\r' == *m_p)
+			++m_p;
+	}
+	bool AtEnd()
+	{
+		SkipSpace();
+		return L'\0' == *m_p;
+	}
+	bool Literal(const wchar_t* szLiteral)
+	{
+		for (; L'\0' != *szLiteral; ++szLiteral, ++m_p)
+		{
+			if (*m_p != *szLiteral)
+				return false;
+		}
+		return true;
+	}
+	bool String()
+	{
+		if (L'"' != *m_p++)
+			return false;
+		for (; L'"' != *m_p; ++m_p)
+		{
+			if (*m_p < L' ')
+				return false;
+			if (L'\\' == *m_p && L'\0' == *++m_p)
+				return false;
+		}
+		++m_p;
+		return true;
+	}
+	bool Number()
+	{
+		if (L'-' == *m_p)
+			++m_p;
+		const wchar_t* pDigits = m_p;
+		while (*m_p >= L'0' && *m_p <= L'9')
+			++m_p;
+		return m_p != pDigits && !(L'0' == *pDigits && m_p - pDigits > 1);
+	}
+	// Object members or array elements, up to and including the closing character
+	bool Members(wchar_t chClose, bool bObject)
+	{
+		++m_p;
+		SkipSpace();
+		if (chClose == *m_p)
+		{
+			++m_p;
+			return true;
+		}
+		for (;;)
+		{
+			SkipSpace();
+			if (bObject)
+			{
+				if (!String())
+					return false;
+				SkipSpace();
+				if (L':' != *m_p++)
+					return false;
+			}
+			if (!Value())
+				return false;
+			SkipSpace();
+			if (chClose == *m_p)
+			{
+				++m_p;
+				return true;
+			}
+			if (L',' != *m_p++)
+				return false;
+		}
+	}
+	bool Value()
+	{
+		SkipSpace();
+		switch (*m_p)
+		{
+		case L'{': return Members(L'}', true);
+		case L'[': return Members(L']', false);
+		case L'"': return String();
+		case L't': return Literal(L"true");
+		case L'f': return Literal(L"false");
+		case L'n': return Literal(L"null");
+		default: return Number();
+		}
+	}
+	const wchar_t* m_p;
+};
+
+static void TestJsonChecker()
+{
+	CHECK(JsonChecker::IsValid(L"{ \"a\": [1, -2, \"x\\\"y\", true, null], \"b\": {} }"));
+	CHECK(!JsonChecker::IsValid(L"{ \"a\": 1, }"));
+	CHECK(!JsonChecker::IsValid(L"{ \"a\": 1 } }"));
+	CHECK(!JsonChecker::IsValid(L"{ \"a\" 1 }"));
+	CHECK(!JsonChecker::IsValid(L"{ \"a\": 01 }"));
+}
+
+static void TestCounters()
+{
+	// Nothing is counted until collection is on.
+	Stats::Add(Stats::Rules, 5);
+	CHECK(0 == Stats::Get(Stats::Rules));
+	CHECK(!Stats::Enabled());
+	Stats::Enable();
+	CHECK(Stats::Enabled());
+
+	Stats::Add(Stats::Rules, 5);
+	Stats::Add(Stats::Rules, 2);
+	STATS_ADD(RegistryWrites, 3);
+	CHECK(7 == Stats::Get(Stats::Rules));
+#if STATS_ENABLED
+	CHECK(3 == Stats::Get(Stats::RegistryWrites));
+#else
+	CHECK(0 == Stats::Get(Stats::RegistryWrites));
+#endif
+	CHECK(0 == Stats::Get(Stats::WmiCalls));
+
+	// Counters from several threads add up.
+	std::vector<std::thread> threads;
+	for (int ixThread = 0; ixThread < 4; ++ixThread)
+	{
+		threads.emplace_back([]()
+			{
+				for (int ix = 0; ix < 10000; ++ix)
+					Stats::Add(Stats::FilesDeleted, 1);
+			});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	CHECK(40000 == Stats::Get(Stats::FilesDeleted));
+}
+
+static void TestPhases()
+{
+	Stats::AddPhaseTime("phase.a", 10);
+	Stats::AddPhaseTime("phase.b", 5);
+	Stats::AddPhaseTime("phase.a", 30);
+	Stats::AddPhaseTime("phase.a", 20);
+	for (int ix = 0; ix < 3; ++ix)
+	{
+		STATS_SCOPE("phase.scoped");
+	}
+
+	const std::wstring sJson = StatsJson();
+	CHECK(JsonChecker::IsValid(sJson));
+	CHECK(3 == PhaseField(sJson, L"phase.a", L"count"));
+	CHECK(60 == PhaseField(sJson, L"phase.a", L"microseconds"));
+	CHECK(30 == PhaseField(sJson, L"phase.a", L"maxMicroseconds"));
+	CHECK(1 == PhaseField(sJson, L"phase.b", L"count"));
+	CHECK(5 == PhaseField(sJson, L"phase.b", L"microseconds"));
+#if STATS_ENABLED
+	CHECK(3 == PhaseField(sJson, L"phase.scoped", L"count"));
+#else
+	CHECK(-1 == PhaseField(sJson, L"phase.scoped", L"count"));
+#endif
+	// Without allocation counting, phases have no allocation fields.
+	CHECK(-1 == PhaseField(sJson, L"phase.a", L"allocations"));
+	CHECK(std::wstring::npos != sJson.find(L"\"rules\": 7"));
+	CHECK(std::wstring::npos != sJson.find(L"\"filesDeleted\": 40000"));
+	CHECK(std::wstring::npos == sJson.find(L"\"allocations\": {"));
+
+	std::wostringstream os;
+	Stats::WriteJson(os, 1234, 5678);
+	CHECK(std::wstring::npos != os.str().find(L"\"startupMicroseconds\": 1234,"));
+	CHECK(std::wstring::npos != os.str().find(L"\"commandMicroseconds\": 5678,"));
+}
+
+#if STATS_ENABLED
+// Keeps the compiler from eliding new/delete pairs
+static void* volatile pSink = nullptr;
+
+static void AllocateAndFree(size_t cb)
+{
+	pSink = new char[cb];
+	delete[] static_cast<char*>(pSink);
+}
+
+static const size_t cbLarge = 1 << 20;
+
+static void TestNestedScopes()
+{
+	{
+		STATS_SCOPE("nested.outer");
+		{
+			STATS_SCOPE("nested.inner");
+			AllocateAndFree(cbLarge);
+		}
+		{
+			// A later sibling with a lower peak doesn't lower the outer scope's.
+			STATS_SCOPE("nested.inner2");
+			AllocateAndFree(cbLarge / 4);
+		}
+	}
+	const std::wstring sJson = StatsJson();
+	CHECK(PhaseField(sJson, L"nested.inner", L"peakLiveBytes") >= int64_t(cbLarge));
+	CHECK(PhaseField(sJson, L"nested.inner2", L"peakLiveBytes") >= int64_t(cbLarge / 4));
+	CHECK(PhaseField(sJson, L"nested.inner2", L"peakLiveBytes") < int64_t(cbLarge));
+	CHECK(PhaseField(sJson, L"nested.outer", L"peakLiveBytes") >= int64_t(cbLarge));
+	CHECK(PhaseField(sJson, L"nested.outer", L"allocations") >= 2);
+}
+
+static void TestWorkerScopes()
+{
+	// The command-thread scope reaches its peak, then ends while a worker scope that began afterwards is
+	// still open. A worker scope that reset the process-wide peak would hide the command scope's peak.
+	std::mutex lock;
+	std::condition_variable changed;
+	bool bWorkerStarted = false, bCommandDone = false;
+	std::thread worker;
+	{
+		STATS_SCOPE("command.phase");
+		AllocateAndFree(cbLarge);
+		worker = std::thread([&]()
+			{
+				STATS_SCOPE("worker.phase");
+				AllocateAndFree(cbLarge / 4);
+				std::unique_lock<std::mutex> guard(lock);
+				bWorkerStarted = true;
+				changed.notify_all();
+				changed.wait(guard, [&]() { return bCommandDone; });
+			});
+		std::unique_lock<std::mutex> guard(lock);
+		changed.wait(guard, [&]() { return bWorkerStarted; });
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		bCommandDone = true;
+		changed.notify_all();
+	}
+	worker.join();
+
+	const std::wstring sJson = StatsJson();
+	CHECK(PhaseField(sJson, L"command.phase", L"peakLiveBytes") >= int64_t(cbLarge));
+	// The worker's phase counts its allocations but has no peak.
+	CHECK(PhaseField(sJson, L"worker.phase", L"allocations") >= 1);
+	CHECK(PhaseField(sJson, L"worker.phase", L"allocatedBytes") >= int64_t(cbLarge / 4));
+	CHECK(-1 == PhaseField(sJson, L"worker.phase", L"peakLiveBytes"));
+}
+#endif
+
+int main()
+{
+	TestJsonChecker();
+	TestCounters();
+	TestPhases();
+#if STATS_ENABLED
+	AllocationAccounting::Enable();
+	TestNestedScopes();
+	TestWorkerScopes();
+	// With allocation counting, the output is still valid JSON.
+	CHECK(JsonChecker::IsValid(StatsJson()));
+	CHECK(std::wstring::npos != StatsJson().find(L"\"allocations\": {"));
+#endif
+	return TestCheck::ExitCode("StatsTests");
+}
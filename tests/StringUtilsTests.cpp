@@ -0,0 +1,67 @@
+// Tests for the FILETIME timestamp functions: formatting across the whole FILETIME range, including
+// five-digit years up to the FILETIME maximum, and parsing
+
+#include <cstdint>
+#include <string>
+#include "StringUtils.h"
+#include "TestCheck.h"
+
+static std::wstring FileTimeString(uint64_t ft, bool bIncludeMilliseconds)
+{
+	// Guard characters past the documented buffer size catch overruns
+	wchar_t buf[cchTimestampBuffer + 2];
+	buf[cchTimestampBuffer] = buf[cchTimestampBuffer + 1] = L'#';
+	const size_t cch = FileTimeToWChars(ft, bIncludeMilliseconds, buf);
+	CHECK(cch < cchTimestampBuffer && L'\0' == buf[cch]);
+	CHECK(L'#' == buf[cchTimestampBuffer] && L'#' == buf[cchTimestampBuffer + 1]);
+	return std::wstring(buf, cch);
+}
+
+static void TestFormat()
+{
+	CHECK(FileTimeString(0, true).empty());
+	CHECK(L"1601-01-01 00:00:00.001" == FileTimeString(10000, true));
+	// 2000-02-29 12:34:56.789
+	uint64_t ft = 0;
+	CHECK(WStringToFileTime(L"2000-02-29T12:34:56Z", ft));
+	CHECK(L"2000-02-29 12:34:56.789" == FileTimeString(ft + 7890000, true));
+	CHECK(L"2000-02-29 12:34:56" == FileTimeString(ft, false));
+}
+
+static void TestFiveDigitYears()
+{
+	// The last millisecond of 9999, then the first of 10000
+	uint64_t ft = 0;
+	CHECK(WStringToFileTime(L"9999-12-31 23:59:59", ft));
+	ft += 9990000;
+	CHECK(L"9999-12-31 23:59:59.999" == FileTimeString(ft, true));
+	CHECK(L"10000-01-01 00:00:00.000" == FileTimeString(ft + 10000, true));
+	CHECK(L"10000-01-01 00:00:00" == FileTimeString(ft + 10000, false));
+
+	// The largest FILETIME value FileTimeToSystemTime accepts; its timestamp fills the buffer
+	const uint64_t ftMax = 0x7FFFFFFFFFFFFFFFULL;
+	const std::wstring sMax = FileTimeString(ftMax, true);
+	CHECK(L"30828-09-14 02:48:05.477" == sMax);
+	CHECK(cchTimestampBuffer == sMax.length() + 1);
+	// Values with the high bit set are rejected
+	CHECK(FileTimeString(ftMax + 1, true).empty());
+}
+
+static void TestParse()
+{
+	uint64_t ft = 0;
+	CHECK(WStringToFileTime(L"1601-01-01", ft) && 0 == ft);
+	CHECK(WStringToFileTime(L"2024-02-29 08:15", ft) && L"2024-02-29 08:15:00" == FileTimeString(ft, false));
+	CHECK(!WStringToFileTime(L"2023-02-29", ft));
+	CHECK(!WStringToFileTime(L"1600-12-31", ft));
+	CHECK(!WStringToFileTime(L"2024-01-01 24:00", ft));
+	CHECK(!WStringToFileTime(L"2024-01-01x", ft));
+}
+
+int main()
+{
+	TestFormat();
+	TestFiveDigitYears();
+	TestParse();
+	return TestCheck::ExitCode("StringUtilsTests");
+}
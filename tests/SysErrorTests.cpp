@@ -0,0 +1,189 @@
+// Tests for ErrorMessageCache and FormatSysError: caching of known and unknown codes with a counting
+// message source, the size bound, concurrent use from several threads, and the error code format
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SysError.h"
+#include "HEX.h"
+#include "TestCheck.h"
+
+// Source calls per key (code, NTSTATUS flag)
+static std::mutex countLock;
+static std::map<std::pair<uint32_t, bool>, size_t> sourceCalls;
+
+static size_t SourceCalls(uint32_t dwErrCode, bool bNtStatus)
+{
+	std::lock_guard<std::mutex> guard(countLock);
+	const auto iter = sourceCalls.find(std::make_pair(dwErrCode, bNtStatus));
+	return (sourceCalls.end() == iter) ? 0 : iter->second;
+}
+
+static void ResetSourceCalls()
+{
+	std::lock_guard<std::mutex> guard(countLock);
+	sourceCalls.clear();
+}
+
+static std::wstring ExpectedMessage(uint32_t dwErrCode, bool bNtStatus)
+{
+	return (bNtStatus ? L"Status " : L"Message ") + std::to_wstring(dwErrCode);
+}
+
+// Message source that counts its calls; codes of 1000 and above have no text.
+static bool CountingSource(uint32_t dwErrCode, bool bNtStatus, std::wstring& sMessage)
+{
+	{
+		std::lock_guard<std::mutex> guard(countLock);
+		++sourceCalls[std::make_pair(dwErrCode, bNtStatus)];
+	}
+	if (dwErrCode >= 1000)
+	{
+		sMessage.clear();
+		return false;
+	}
+	sMessage = ExpectedMessage(dwErrCode, bNtStatus);
+	return true;
+}
+
+static void TestCaching()
+{
+	ResetSourceCalls();
+	ErrorMessageCache cache(CountingSource);
+	for (int ixRepeat = 0; ixRepeat < 3; ++ixRepeat)
+	{
+		std::wstring sText(L"prefix: ");
+		CHECK(cache.AppendMessage(5, false, sText) && L"prefix: Message 5" == sText);
+		std::wstring sStatus;
+		CHECK(cache.AppendMessage(5, true, sStatus) && L"Status 5" == sStatus);
+		// Unknown codes are cached too, and append nothing.
+		std::wstring sUnknown(L"unchanged");
+		CHECK(!cache.AppendMessage(1234, false, sUnknown) && L"unchanged" == sUnknown);
+	}
+	CHECK(1 == SourceCalls(5, false) && 1 == SourceCalls(5, true) && 1 == SourceCalls(1234, false));
+	CHECK(3 == cache.Size());
+}
+
+static void TestBound()
+{
+	ResetSourceCalls();
+	const size_t nMaxEntries = 4;
+	ErrorMessageCache cache(CountingSource, nMaxEntries);
+	for (int ixRepeat = 0; ixRepeat < 3; ++ixRepeat)
+	{
+		for (uint32_t dwErrCode = 0; dwErrCode < 10; ++dwErrCode)
+		{
+			std::wstring sText;
+			CHECK(cache.AppendMessage(dwErrCode, false, sText) && ExpectedMessage(dwErrCode, false) == sText);
+		}
+	}
+	CHECK(nMaxEntries == cache.Size());
+	// The first codes are cached; the messages for the rest are fetched on every request.
+	for (uint32_t dwErrCode = 0; dwErrCode < 10; ++dwErrCode)
+		CHECK((dwErrCode < nMaxEntries ? 1u : 3u) == SourceCalls(dwErrCode, false));
+}
+
+static void TestThreads()
+{
+	// Eight threads request the same codes, known and unknown, at once. Each code is fetched at most once
+	// per thread, and every request gets the right text.
+	const size_t nThreads = 8, nCodes = 64;
+	const uint32_t dwFirstUnknown = 1000 - nCodes / 4;
+	for (size_t nMaxEntries : { size_t(1000), size_t(16) })
+	{
+		ResetSourceCalls();
+		ErrorMessageCache cache(CountingSource, nMaxEntries);
+		std::atomic<size_t> nWrong(0);
+		std::vector<std::thread> threads;
+		for (size_t ixThread = 0; ixThread < nThreads; ++ixThread)
+		{
+			threads.emplace_back([&cache, &nWrong, ixThread, dwFirstUnknown]()
+				{
+					for (int ixRepeat = 0; ixRepeat < 200; ++ixRepeat)
+					{
+						for (size_t ix = 0; ix < nCodes; ++ix)
+						{
+							// Each thread goes through the codes in a different order.
+							const uint32_t dwErrCode = dwFirstUnknown - uint32_t(nCodes / 2) + uint32_t((ix * 7 + ixThread * 13) % nCodes);
+							const bool bNtStatus = (0 != (dwErrCode & 4));
+							std::wstring sText;
+							const bool bFound = cache.AppendMessage(dwErrCode, bNtStatus, sText);
+							if (bFound != (dwErrCode < 1000) || (bFound ? ExpectedMessage(dwErrCode, bNtStatus) : std::wstring()) != sText)
+								++nWrong;
+						}
+					}
+				});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		CHECK(0 == nWrong);
+		CHECK(std::min(nMaxEntries, nCodes) == cache.Size());
+
+		// Afterwards, exactly the cached codes are served without calling the source.
+		size_t nFetchedWhileCached = 0, nFromCache = 0;
+		for (uint32_t dwErrCode = dwFirstUnknown - uint32_t(nCodes / 2); dwErrCode < dwFirstUnknown + nCodes / 2; ++dwErrCode)
+		{
+			for (bool bNtStatus : { false, true })
+			{
+				const size_t nCallsBefore = SourceCalls(dwErrCode, bNtStatus);
+				if (0 == nCallsBefore)
+					continue;
+				std::wstring sText;
+				cache.AppendMessage(dwErrCode, bNtStatus, sText);
+				const size_t nCallsAfter = SourceCalls(dwErrCode, bNtStatus);
+				if (nCallsAfter == nCallsBefore)
+				{
+					++nFromCache;
+					if (nCallsBefore > nThreads)
+						++nFetchedWhileCached;
+				}
+			}
+		}
+		CHECK(cache.Size() == nFromCache);
+		CHECK(0 == nFetchedWhileCached);
+	}
+}
+
+static void TestFormat()
+{
+	// The code in decimal and in eight upper-case hex digits, as HEX formats it
+	for (uint32_t dwErrCode : { 0u, 5u, 0x1Fu, 0x80070005u, 0xC0000034u, 0xFFFFFFFFu })
+	{
+		std::wstring sText;
+		AppendErrorCode(dwErrCode, sText);
+		CHECK(L"Error # " + std::to_wstring(dwErrCode) + L" (" + HEXW(dwErrCode, 8, true, true) + L")" == sText);
+	}
+	std::wstring sFive;
+	AppendErrorCode(5, sFive);
+	CHECK(L"Error # 5 (0x00000005)" == sFive);
+
+	// The message, then the code if requested or if there's no message
+	const std::wstring sAccessDenied = FormatSysError(5, false, false);
+	CHECK(!sAccessDenied.empty() && std::wstring::npos == sAccessDenied.find(L"Error #"));
+	CHECK(sAccessDenied + L" Error # 5 (0x00000005)" == FormatSysError(5, false, true));
+	std::wostringstream os;
+	os << SysError(5);
+	CHECK(sAccessDenied == os.str());
+	CHECK(sAccessDenied + L" Error # 5 (0x00000005)" == SysError(5).MessageWithCode());
+#ifndef _WIN32
+	CHECK(L"Access is denied." == sAccessDenied);
+	CHECK(L"Object Name not found." == SysError(0xC0000034, true).Message());
+	CHECK(L"Error # 3735928559 (0xDEADBEEF)" == FormatSysError(0xDEADBEEF, false, false));
+	CHECK(L"Error # 3735928559 (0xDEADBEEF)" == FormatSysError(0xDEADBEEF, false, true));
+#endif
+}
+
+int main()
+{
+	TestCaching();
+	TestBound();
+	TestThreads();
+	TestFormat();
+	return TestCheck::ExitCode("SysErrorTests");
+}
@@ -0,0 +1,53 @@
+// Minimal checks for the unit tests, which are plain executables run by CTest
+
+#pragma once
+
+#include <cstdio>
+#include <cstddef>
+
+/// <summary>
+/// Failure counting for a test executable. CHECK reports each failed expression to stderr with its
+/// file and line and keeps going, so one run shows every failure; main returns TestCheck::ExitCode().
+///
+/// Usage:
+/// 	int main()
+/// 	{
+/// 		CHECK(1 + 1 == 2);
+/// 		return TestCheck::ExitCode("SampleTests");
+/// 	}
+/// </summary>
+namespace TestCheck
+{
+	inline size_t& Failures()
+	{
+		static size_t nFailures = 0;
+		return nFailures;
+	}
+
+	inline bool Check(bool bResult, const char* szExpr, const char* szFile, int nLine)
+	{
+		if (!bResult)
+		{
+			++Failures();
+			fprintf(stderr, "%s(%d): CHECK failed: %s\n", szFile, nLine, szExpr);
+		}
+		return bResult;
+	}
+
+	/// <summary>
+	/// Reports the result and returns the exit code for main: 0 if every check passed.
+	/// </summary>
+	inline int ExitCode(const char* szTestName)
+	{
+		if (0 == Failures())
+		{
+			printf("%s: all checks passed\n", szTestName);
+			return 0;
+		}
+		printf("%s: %zu check(s) failed\n", szTestName, Failures());
+		return 1;
+	}
+}
+
+// Evaluates to the result of the check, so that dependent checks can be skipped.
+#define CHECK(expr) TestCheck::Check(!!(expr), #expr, __FILE__, __LINE__)
@@ -0,0 +1,140 @@
+// Tests for TraceEvents: several threads wrapping small ring buffers at different points within nested
+// spans, and WriteJson writing each thread's newest events as balanced spans
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TraceEvents.h"
+#include "TestCheck.h"
+
+static const size_t nEventsPerThread = 61;
+static const size_t nThreads = 6;
+
+// Nested spans; the number of leaf spans depends on the thread, so the rings wrap at different depths.
+static void RecordSpans(size_t nLeaves, size_t nIterations)
+{
+	for (size_t ixIteration = 0; ixIteration < nIterations; ++ixIteration)
+	{
+		TraceEvents::Begin("outer");
+		TraceEvents::Begin("middle");
+		for (size_t ixLeaf = 0; ixLeaf < nLeaves; ++ixLeaf)
+		{
+			TraceEvents::Begin("leaf");
+			TraceEvents::End("leaf");
+		}
+		TraceEvents::End("middle");
+		TraceEvents::Begin("sibling");
+		TraceEvents::End("sibling");
+		TraceEvents::End("outer");
+	}
+}
+
+struct ParsedEvent_t
+{
+	std::string sName;
+	char phase;
+	uint64_t ts;
+};
+
+// Value of a field in one event line written by WriteJson
+static std::string Field(const std::string& sLine, const char* szField)
+{
+	const std::string sKey = std::string("\"") + szField + "\":";
+	const size_t ixKey = sLine.find(sKey);
+	if (std::string::npos == ixKey)
+		return std::string();
+	size_t ixValue = ixKey + sKey.length();
+	size_t ixEnd = sLine.find_first_of(",}", ixValue);
+	if ('"' == sLine[ixValue])
+		ixEnd = sLine.find('"', ++ixValue);
+	return sLine.substr(ixValue, ixEnd - ixValue);
+}
+
+static void TestWrappedRings()
+{
+	TraceEvents::Enable(nEventsPerThread);
+	// The main thread leaves a span open.
+	TraceEvents::Begin("main.done");
+	TraceEvents::End("main.done");
+	TraceEvents::Begin("main.open");
+
+	std::vector<std::thread> threads;
+	for (size_t ixThread = 0; ixThread < nThreads; ++ixThread)
+	{
+		threads.emplace_back([ixThread]()
+			{
+				RecordSpans(ixThread % 4, 100 + 37 * ixThread);
+			});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	std::ostringstream os;
+	const size_t nWritten = TraceEvents::WriteJson(os);
+	const std::string sJson = os.str();
+	CHECK(0 == sJson.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"));
+	CHECK(sJson.length() >= 4 && "\n]}\n" == sJson.substr(sJson.length() - 4));
+
+	// Events by thread, in the order written
+	std::map<std::string, std::vector<ParsedEvent_t>> threadEvents;
+	std::istringstream lines(sJson);
+	std::string sLine;
+	size_t nLines = 0;
+	while (std::getline(lines, sLine))
+	{
+		if (0 != sLine.find("{\"name\":"))
+			continue;
+		++nLines;
+		CHECK("1" == Field(sLine, "pid"));
+		threadEvents[Field(sLine, "tid")].push_back(ParsedEvent_t{ Field(sLine, "name"), Field(sLine, "ph")[0], std::stoull(Field(sLine, "ts")) });
+	}
+	CHECK(nWritten == nLines);
+	CHECK(1 + nThreads == threadEvents.size());
+
+	for (const auto& thread : threadEvents)
+	{
+		const std::vector<ParsedEvent_t>& events = thread.second;
+		CHECK(events.size() <= nEventsPerThread);
+		// Every end matches the innermost open begin; timestamps don't go backwards.
+		std::vector<std::string> openSpans;
+		for (size_t ix = 0; ix < events.size(); ++ix)
+		{
+			CHECK('B' == events[ix].phase || 'E' == events[ix].phase);
+			CHECK(0 == ix || events[ix - 1].ts <= events[ix].ts);
+			if ('B' == events[ix].phase)
+			{
+				openSpans.push_back(events[ix].sName);
+			}
+			else
+			{
+				CHECK(!openSpans.empty() && openSpans.back() == events[ix].sName);
+				if (!openSpans.empty())
+					openSpans.pop_back();
+			}
+		}
+		if ("1" == thread.first)
+		{
+			// The main thread's ring didn't wrap.
+			CHECK(3 == events.size());
+			CHECK((std::vector<std::string>{ "main.open" }) == openSpans);
+		}
+		else
+		{
+			// The workers' rings wrapped: at most the ends of the spans cut off at the start are dropped,
+			// and the newest event, the last outer end, is kept.
+			CHECK(events.size() + 3 >= nEventsPerThread);
+			CHECK(openSpans.empty());
+			CHECK("outer" == events.back().sName && 'E' == events.back().phase);
+		}
+	}
+	TraceEvents::End("main.open");
+}
+
+int main()
+{
+	TestWrappedRings();
+	return TestCheck::ExitCode("TraceEventsTests");
+}
@@ -0,0 +1,147 @@
+// Tests for UnicodeTranscoder: round trips, rejection of invalid input, and conversion in pieces
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include "UnicodeTranscoder.h"
+#include "TestCheck.h"
+
+// Wide string for a sequence of code points, with surrogate pairs where wchar_t is 16 bits
+static std::wstring FromCodePoints(const std::vector<unsigned long>& codePoints)
+{
+	std::wstring str;
+	for (unsigned long cp : codePoints)
+	{
+#if WCHAR_MAX <= 0xFFFF
+		if (cp >= 0x10000)
+		{
+			str.push_back(wchar_t(0xD800 + ((cp - 0x10000) >> 10)));
+			str.push_back(wchar_t(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+			continue;
+		}
+#endif
+		str.push_back(wchar_t(cp));
+	}
+	return str;
+}
+
+static void TestRoundTrips()
+{
+	const std::wstring samples[] = {
+		L"",
+		L"<AppLockerPolicy Version=\"1\"><RuleCollection Type=\"Exe\" EnforcementMode=\"Enabled\" /></AppLockerPolicy>",
+		FromCodePoints({ 'A', 0xE9, 0x20AC, 0x4E2D, 0xFFFD, 0x10000, 0x1F600, 0x10FFFF, 'z' }),
+		// Long enough for the 16-unit fast paths, with non-ASCII at either end and in the middle
+		FromCodePoints({ 0xDC, 'b', 'e', 'r', 'p', 'r', 0xFC, 'f', 'u', 'n', 'g', '\\', 'R', 0xE9, 'c', 'u', 'p', 0xE9, 'r', 'a', 't', 'i', 'o', 'n', '\\', '*', 0x1F600 }),
+	};
+	for (const std::wstring& sample : samples)
+	{
+		const std::string sUtf8 = WStringToUtf8(sample);
+		std::wstring sBack;
+		CHECK(Utf8ToWString(sUtf8.data(), sUtf8.size(), sBack) && sBack == sample);
+
+		for (int bigEndian = 0; bigEndian < 2; ++bigEndian)
+		{
+			std::vector<char> utf16(sample.size() * 4 + 4);
+			size_t cchRead = 0, cbWritten = 0;
+			CHECK(Transcode_OK == WideToUtf16(sample.data(), sample.size(), 0 != bigEndian, utf16.data(), utf16.size(), cchRead, cbWritten));
+			CHECK(cchRead == sample.size());
+			CHECK(Utf16ToWString(utf16.data(), cbWritten, 0 != bigEndian, sBack) && sBack == sample);
+		}
+	}
+
+	// Known encodings
+	const std::wstring sEuro = FromCodePoints({ 0x20AC });
+	CHECK(WStringToUtf8(sEuro) == "\xE2\x82\xAC");
+	const std::wstring sEmoji = FromCodePoints({ 0x1F600 });
+	CHECK(WStringToUtf8(sEmoji) == "\xF0\x9F\x98\x80");
+	char utf16[8];
+	size_t cchRead = 0, cbWritten = 0;
+	CHECK(Transcode_OK == WideToUtf16(sEmoji.data(), sEmoji.size(), true, utf16, sizeof(utf16), cchRead, cbWritten));
+	CHECK(4 == cbWritten && std::string(utf16, cbWritten) == std::string("\xD8\x3D\xDE\x00", 4));
+}
+
+static void TestInvalidUtf8()
+{
+	const char* const invalid[] = {
+		"\xC0\x80",             // Overlong NUL
+		"\xE0\x80\xAF",         // Overlong '/'
+		"\xED\xA0\x80",         // Encoded surrogate
+		"\xF4\x90\x80\x80",     // Above U+10FFFF
+		"\x80",                 // Unexpected continuation byte
+		"\xFF",                 // Never valid
+		"abc\xE2\x82x",         // Continuation byte missing
+	};
+	for (const char* szInvalid : invalid)
+	{
+		std::wstring sOut;
+		CHECK(!Utf8ToWString(szInvalid, strlen(szInvalid), sOut));
+	}
+
+	// The position of the invalid sequence is reported after the valid prefix.
+	const std::string sInput = "0123456789abcdefghij\xC0\x80";
+	std::vector<wchar_t> out(sInput.size());
+	size_t cbRead = 0, cchWritten = 0;
+	CHECK(Transcode_Invalid == Utf8ToWide(sInput.data(), sInput.size(), out.data(), out.size(), cbRead, cchWritten));
+	CHECK(20 == cbRead && 20 == cchWritten);
+
+	// A character cut off at the end of the input is partial, not invalid.
+	CHECK(Transcode_Partial == Utf8ToWide("ab\xE2\x82", 4, out.data(), out.size(), cbRead, cchWritten));
+	CHECK(2 == cbRead && 2 == cchWritten);
+}
+
+static void TestInvalidUtf16()
+{
+	// Unpaired high and low surrogates (little-endian)
+	const char unpairedHigh[] = { 'a', 0, char(0x00), char(0xD8), 'b', 0 };
+	const char unpairedLow[] = { char(0x00), char(0xDC), 'a', 0 };
+	std::wstring sOut;
+	CHECK(!Utf16ToWString(unpairedHigh, sizeof(unpairedHigh), false, sOut));
+	CHECK(!Utf16ToWString(unpairedLow, sizeof(unpairedLow), false, sOut));
+
+	// Unpaired surrogates in a wide string become U+FFFD in UTF-8.
+	std::wstring sBad(L"ab");
+	sBad.insert(sBad.begin() + 1, wchar_t(0xD800));
+	CHECK(WStringToUtf8(sBad) == "a\xEF\xBF\xBD" "b");
+}
+
+static void TestInPieces()
+{
+	// Convert with a tiny output buffer, and then with the input split at every position.
+	const std::wstring sample = FromCodePoints({ 'x', 0xE9, 0x20AC, 0x1F600, 'y', 0x4E2D, 0x10FFFF, 'z' });
+	const std::string sUtf8 = WStringToUtf8(sample);
+
+	std::string sChunked;
+	for (size_t ixIn = 0; ixIn < sample.size(); )
+	{
+		char buffer[4];
+		size_t cchRead = 0, cbWritten = 0;
+		WideToUtf8(sample.data() + ixIn, sample.size() - ixIn, buffer, sizeof(buffer), cchRead, cbWritten);
+		if (!CHECK(cchRead > 0))
+			break;
+		sChunked.append(buffer, cbWritten);
+		ixIn += cchRead;
+	}
+	CHECK(sChunked == sUtf8);
+
+	for (size_t ixSplit = 0; ixSplit <= sUtf8.size(); ++ixSplit)
+	{
+		std::vector<wchar_t> out(sUtf8.size());
+		size_t cbRead1 = 0, cchWritten1 = 0, cbRead2 = 0, cchWritten2 = 0;
+		const TranscodeStatus_t status1 = Utf8ToWide(sUtf8.data(), ixSplit, out.data(), out.size(), cbRead1, cchWritten1);
+		CHECK(Transcode_Invalid != status1);
+		// Resume from the first unconverted byte, as a streaming reader does.
+		const TranscodeStatus_t status2 = Utf8ToWide(sUtf8.data() + cbRead1, sUtf8.size() - cbRead1, out.data() + cchWritten1, out.size() - cchWritten1, cbRead2, cchWritten2);
+		CHECK(Transcode_OK == status2);
+		CHECK(std::wstring(out.data(), cchWritten1 + cchWritten2) == sample);
+	}
+}
+
+int main()
+{
+	TestRoundTrips();
+	TestInvalidUtf8();
+	TestInvalidUtf16();
+	TestInPieces();
+	return TestCheck::ExitCode("UnicodeTranscoderTests");
+}
@@ -0,0 +1,203 @@
+// Tests for Utf8OutputBuffer and Utf8OutputStream: surrogates split across writes and unpaired, writes
+// larger than the buffers, atomic replacement on Close, the temporary file discarded without Close, binary
+// content, and no byte order marker on stdout (POSIX only)
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "Utf8OutputStream.h"
+#include "UnicodeTranscoder.h"
+#include "TestCheck.h"
+
+namespace fs = std::filesystem;
+
+static const std::string sBom("\xEF\xBB\xBF");
+static const std::string sReplacement("\xEF\xBF\xBD");
+
+static std::string ReadFileBytes(const fs::path& path)
+{
+	std::ifstream fs(path, std::ios_base::in | std::ios_base::binary);
+	return std::string(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+}
+
+static void WriteFileBytes(const fs::path& path, const std::string& sBytes)
+{
+	std::ofstream(path, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary) << sBytes;
+}
+
+static std::set<std::string> DirectoryEntries(const fs::path& dir)
+{
+	std::set<std::string> entries;
+	for (fs::directory_iterator iter(dir), end; iter != end; ++iter)
+		entries.insert(iter->path().filename().string());
+	return entries;
+}
+
+// Writes through a stream over a Utf8OutputBuffer (non-atomic, no BOM) and returns the file's bytes
+template<typename WriteFn>
+static std::string WriteThrough(const fs::path& path, size_t cbBuffer, WriteFn write)
+{
+	Utf8OutputBuffer buffer(cbBuffer);
+	std::wstring sErrorInfo;
+	CHECK(buffer.OpenFile(path.wstring(), false, false, sErrorInfo));
+	std::wostream os(&buffer);
+	write(os);
+	CHECK(buffer.Close(sErrorInfo) && sErrorInfo.empty());
+	return ReadFileBytes(path);
+}
+
+static void TestSurrogates(const fs::path& root)
+{
+	const fs::path path = root / "surrogates.txt";
+	// Unpaired surrogates, including a high surrogate left at the end by Close, become U+FFFD.
+	CHECK("a" + sReplacement + "b" + sReplacement == WriteThrough(path, 64, [](std::wostream& os)
+		{
+			os << L'a' << wchar_t(0xDC00) << L'b' << wchar_t(0xD83D);
+		}));
+	CHECK(sReplacement + "x" == WriteThrough(path, 64, [](std::wostream& os)
+		{
+			os << wchar_t(0xD83D) << std::flush << L'x';
+		}));
+#if WCHAR_MAX <= 0xFFFF
+	// A surrogate pair split across encodings (the flush encodes the high surrogate alone) is still one character.
+	CHECK("\xF0\x9F\x98\x80" == WriteThrough(path, 64, [](std::wostream& os)
+		{
+			os << wchar_t(0xD83D) << std::flush << wchar_t(0xDE00);
+		}));
+#else
+	// Supplementary characters are single wide characters here.
+	CHECK("\xF0\x9F\x98\x80" == WriteThrough(path, 64, [](std::wostream& os)
+		{
+			os << wchar_t(0x1F600) << std::flush;
+		}));
+#endif
+}
+
+static void TestLargeWrites(const fs::path& root)
+{
+	// Larger than both the put area and the byte buffer, so it is encoded from the caller's buffer in pieces
+	std::wstring sLarge;
+	for (size_t ix = 0; sLarge.length() < 100000; ++ix)
+		sLarge += L"caf\x00E9 \x4E2D\x6587 " + std::to_wstring(ix) + L" ";
+	const std::string sExpected = "prefix " + WStringToUtf8(sLarge) + WStringToUtf8(sLarge);
+	CHECK(sExpected == WriteThrough(root / "large.txt", 64, [&sLarge](std::wostream& os)
+		{
+			os << L"prefix " << sLarge;
+			os.write(sLarge.data(), std::streamsize(sLarge.length()));
+		}));
+	CHECK(sExpected == WriteThrough(root / "large.txt", Utf8OutputBuffer::cbDefaultBuffer, [&sLarge](std::wostream& os)
+		{
+			os << L"prefix " << sLarge << sLarge;
+		}));
+}
+
+static void TestAtomicReplace(const fs::path& root)
+{
+	const fs::path dir = root / "atomic", target = dir / "out.txt";
+	fs::create_directories(dir);
+	WriteFileBytes(target, "old");
+	// A file with the name a fixed temporary-file scheme would use must not be touched.
+	WriteFileBytes(dir / "out.txt.tmp", "unrelated");
+
+	std::wstring sErrorInfo;
+	{
+		Utf8OutputStream os;
+		CHECK(os.Open(target.wstring(), sErrorInfo));
+		os << L"new \x00E9";
+		// Until Close, the target is unchanged and the content is in one new file.
+		CHECK("old" == ReadFileBytes(target));
+		CHECK(3 == DirectoryEntries(dir).size());
+		CHECK(os.Close(sErrorInfo) && sErrorInfo.empty());
+	}
+	CHECK(sBom + "new \xC3\xA9" == ReadFileBytes(target));
+	CHECK("unrelated" == ReadFileBytes(dir / "out.txt.tmp"));
+	CHECK((std::set<std::string>{ "out.txt", "out.txt.tmp" }) == DirectoryEntries(dir));
+
+	// Two writers of the same target at once don't collide; the last to close wins.
+	{
+		Utf8OutputStream first, second;
+		CHECK(first.Open(target.wstring(), sErrorInfo) && second.Open(target.wstring(), sErrorInfo));
+		first << L"first";
+		second << L"second";
+		CHECK(4 == DirectoryEntries(dir).size());
+		CHECK(first.Close(sErrorInfo) && second.Close(sErrorInfo));
+	}
+	CHECK(sBom + "second" == ReadFileBytes(target));
+	CHECK(2 == DirectoryEntries(dir).size());
+
+	// Without Close, the temporary file is discarded and the target is unchanged.
+	{
+		Utf8OutputStream os;
+		CHECK(os.Open(target.wstring(), sErrorInfo));
+		os << L"discarded" << std::flush;
+		CHECK(3 == DirectoryEntries(dir).size());
+	}
+	CHECK(sBom + "second" == ReadFileBytes(target));
+	CHECK((std::set<std::string>{ "out.txt", "out.txt.tmp" }) == DirectoryEntries(dir));
+
+	// A directory that doesn't exist
+	Utf8OutputStream os;
+	CHECK(!os.Open((dir / "missing" / "out.txt").wstring(), sErrorInfo) && !sErrorInfo.empty());
+}
+
+static void TestBinaryBytes(const fs::path& root)
+{
+	// Bytes as they are, LF included, both through the byte buffer and (larger than it) directly
+	std::string sBytes;
+	for (size_t ix = 0; ix < 1000; ++ix)
+		sBytes.push_back(char(ix * 7));
+	const fs::path target = root / "image.bin";
+	Utf8OutputBuffer buffer(256);
+	std::wstring sErrorInfo;
+	CHECK(buffer.OpenFile(target.wstring(), true, false, sErrorInfo));
+	CHECK(buffer.WriteBytes(sBytes.data(), 10) && buffer.WriteBytes(sBytes.data() + 10, sBytes.length() - 10));
+	CHECK(!fs::exists(target));
+	CHECK(buffer.Close(sErrorInfo));
+	CHECK(sBytes == ReadFileBytes(target));
+}
+
+#ifndef _WIN32
+static void TestStdoutHasNoBom(const fs::path& root)
+{
+	const fs::path path = root / "stdout.txt";
+	fflush(stdout);
+	const int fdSaved = dup(STDOUT_FILENO);
+	const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	CHECK(fdSaved >= 0 && fd >= 0 && dup2(fd, STDOUT_FILENO) >= 0);
+	close(fd);
+	{
+		Utf8OutputStream os;
+		std::wstring sErrorInfo;
+		CHECK(os.Open(std::wstring(), sErrorInfo));
+		os << L"{\"name\": \"caf\x00E9\"}\n";
+		CHECK(os.Close(sErrorInfo));
+	}
+	dup2(fdSaved, STDOUT_FILENO);
+	close(fdSaved);
+	CHECK("{\"name\": \"caf\xC3\xA9\"}\n" == ReadFileBytes(path));
+}
+#endif
+
+int main()
+{
+	const fs::path root = fs::temp_directory_path() / ("Utf8OutputStreamTests-" + std::to_string(std::hash<std::string>()(fs::current_path().string()) % 100000));
+	fs::remove_all(root);
+	fs::create_directories(root);
+
+	TestSurrogates(root);
+	TestLargeWrites(root);
+	TestAtomicReplace(root);
+	TestBinaryBytes(root);
+#ifndef _WIN32
+	TestStdoutHasNoBom(root);
+#endif
+
+	fs::remove_all(root);
+	return TestCheck::ExitCode("Utf8OutputStreamTests");
+}